@@ -0,0 +1,100 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// aio_cost measures the fixed cost that every asynchronous operation
+// pays: starting an aio with a timeout (which computes a deadline and
+// puts it on the expiration list) and finishing it.  It also reports
+// the cost of the precise and the coarse clocks on their own.  This
+// uses internal interfaces, and so must be linked statically.
+//
+// Usage: aio_cost [<count>]
+
+#include "core/nng_impl.h"
+#include "nng.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+static void
+cancel(nni_aio *aio, int rv)
+{
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+report(const char *what, nni_time start, int count)
+{
+	nni_time end = nni_clock();
+
+	printf("%-22s %8.1f [ns/op]\n", what,
+	    (double) (end - start) * 1000000.0 / (double) count);
+}
+
+int
+main(int argc, char **argv)
+{
+	nni_aio *         aio;
+	nni_time          start;
+	volatile nni_time sink = 0;
+	int               count = 10000000;
+	int               rv;
+
+	if (argc > 2) {
+		die("Usage: aio_cost [<count>]");
+	}
+	if ((argc == 2) && ((count = atoi(argv[1])) < 1)) {
+		die("Count must be positive");
+	}
+	if (((rv = nni_init()) != 0) ||
+	    ((rv = nni_aio_init(&aio, NULL, NULL)) != 0)) {
+		die("init: %s", nng_strerror(rv));
+	}
+
+	start = nni_clock();
+	for (int i = 0; i < count; i++) {
+		sink += nni_clock();
+	}
+	report("nni_clock", start, count);
+
+	start = nni_clock();
+	for (int i = 0; i < count; i++) {
+		sink += nni_clock_coarse();
+	}
+	report("nni_clock_coarse", start, count);
+
+	// No callback, so finishing does not involve the taskq; what is
+	// left is the bookkeeping under the aio lock.
+	nni_aio_set_timeout(aio, 10000);
+	start = nni_clock();
+	for (int i = 0; i < count; i++) {
+		if (nni_aio_start(aio, cancel, NULL) != 0) {
+			die("nni_aio_start failed");
+		}
+		nni_aio_finish(aio, 0, 0);
+	}
+	report("aio start/finish", start, count);
+
+	nni_aio_fini(aio);
+	nni_fini();
+	return (0);
+}
@@ -0,0 +1,245 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// batch_curve measures small message throughput and round trip latency
+// over the tcp and ipc transports, for message sizes from 16 to 256
+// bytes, with send batching (NNG_OPT_SEND_BATCH) off and on.  Throughput
+// is a PUSH streaming to a PULL; latency is a PAIR bouncing one message
+// back and forth, which is the case where batching must not cost
+// anything.  The batch time budget, if given, applies to both.
+//
+// Usage: batch_curve [<count> [<batch-bytes> [<batch-ms>]]]
+
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "protocol/pipeline0/pull.h"
+#include "protocol/pipeline0/push.h"
+#include "supplemental/util/platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+static int          count     = 100000;
+static size_t       batchsz   = 64 * 1024;
+static nng_duration batchtime = 0;
+
+// setup listens on s1 and dials from s2, with batching on the dialer,
+// which is the side that sends.
+static void
+setup(nng_socket s1, nng_socket s2, const char *scheme, size_t batch)
+{
+	static int   seq;
+	nng_listener l;
+	nng_dialer   d;
+	char         addr[NNG_MAXADDRLEN];
+	size_t       sz;
+	int          rv;
+
+	if (strcmp(scheme, "ipc") == 0) {
+		(void) snprintf(addr, sizeof(addr),
+		    "ipc:///tmp/batch_curve.%d.%d", (int) getpid(), seq++);
+	} else {
+		(void) snprintf(addr, sizeof(addr), "tcp://127.0.0.1:0");
+	}
+	sz = sizeof(addr);
+	if (((rv = nng_listen(s1, addr, &l, 0)) != 0) ||
+	    ((rv = nng_listener_getopt(l, NNG_OPT_URL, addr, &sz)) != 0) ||
+	    ((rv = nng_dialer_create(&d, s2, addr)) != 0) ||
+	    ((rv = nng_dialer_setopt_size(d, NNG_OPT_SEND_BATCH, batch)) !=
+	        0) ||
+	    ((rv = nng_dialer_setopt_ms(
+	          d, NNG_OPT_SEND_BATCH_TIME, batchtime)) != 0) ||
+	    ((rv = nng_dialer_start(d, 0)) != 0)) {
+		die("setup %s: %s", addr, nng_strerror(rv));
+	}
+}
+
+static void
+sink(void *arg)
+{
+	nng_socket *s = arg;
+	nng_msg *   msg;
+	int         rv;
+
+	for (int i = 0; i < count; i++) {
+		if ((rv = nng_recvmsg(*s, &msg, 0)) != 0) {
+			die("nng_recvmsg: %s", nng_strerror(rv));
+		}
+		nng_msg_free(msg);
+	}
+}
+
+static double
+throughput(const char *scheme, size_t batch, size_t size)
+{
+	nng_socket  push;
+	nng_socket  pull;
+	nng_thread *thr;
+	nng_msg *   msg;
+	nng_time    start;
+	nng_time    end;
+	int         rv;
+
+	if (((rv = nng_push0_open(&push)) != 0) ||
+	    ((rv = nng_pull0_open(&pull)) != 0)) {
+		die("open: %s", nng_strerror(rv));
+	}
+	// Queue on both sides, so the sender can run ahead.
+	if (((rv = nng_setopt_int(push, NNG_OPT_SENDBUF, 1024)) != 0) ||
+	    ((rv = nng_setopt_int(pull, NNG_OPT_RECVBUF, 1024)) != 0)) {
+		die("nng_setopt_int: %s", nng_strerror(rv));
+	}
+	setup(pull, push, scheme, batch);
+	nng_msleep(100);
+
+	start = nng_clock();
+	if ((rv = nng_thread_create(&thr, sink, &pull)) != 0) {
+		die("nng_thread_create: %s", nng_strerror(rv));
+	}
+	for (int i = 0; i < count; i++) {
+		if (((rv = nng_msg_alloc(&msg, size)) != 0) ||
+		    ((rv = nng_sendmsg(push, msg, 0)) != 0)) {
+			die("send: %s", nng_strerror(rv));
+		}
+	}
+	nng_thread_destroy(thr);
+	end = nng_clock();
+
+	nng_close(push);
+	nng_close(pull);
+	if (end == start) {
+		end++;
+	}
+	return ((double) count * 1000.0 / (double) (end - start));
+}
+
+static void
+echo(void *arg)
+{
+	nng_socket *s = arg;
+	nng_msg *   msg;
+	int         rv;
+
+	for (int i = 0; i < count / 10; i++) {
+		if (((rv = nng_recvmsg(*s, &msg, 0)) != 0) ||
+		    ((rv = nng_sendmsg(*s, msg, 0)) != 0)) {
+			die("echo: %s", nng_strerror(rv));
+		}
+	}
+}
+
+static double
+latency(const char *scheme, size_t batch, size_t size)
+{
+	nng_socket  s1;
+	nng_socket  s2;
+	nng_thread *thr;
+	nng_msg *   msg;
+	nng_time    start;
+	nng_time    end;
+	int         n = count / 10;
+	int         rv;
+
+	if (((rv = nng_pair1_open(&s1)) != 0) ||
+	    ((rv = nng_pair1_open(&s2)) != 0)) {
+		die("open: %s", nng_strerror(rv));
+	}
+	// Both directions are batched, as both ends send.
+	if (((rv = nng_setopt_size(s1, NNG_OPT_SEND_BATCH, batch)) != 0) ||
+	    ((rv = nng_setopt_ms(s1, NNG_OPT_SEND_BATCH_TIME, batchtime)) !=
+	        0)) {
+		die("nng_setopt: %s", nng_strerror(rv));
+	}
+	setup(s1, s2, scheme, batch);
+	nng_msleep(100);
+
+	if ((rv = nng_thread_create(&thr, echo, &s1)) != 0) {
+		die("nng_thread_create: %s", nng_strerror(rv));
+	}
+	if ((rv = nng_msg_alloc(&msg, size)) != 0) {
+		die("nng_msg_alloc: %s", nng_strerror(rv));
+	}
+	start = nng_clock();
+	for (int i = 0; i < n; i++) {
+		if (((rv = nng_sendmsg(s2, msg, 0)) != 0) ||
+		    ((rv = nng_recvmsg(s2, &msg, 0)) != 0)) {
+			die("ping: %s", nng_strerror(rv));
+		}
+	}
+	end = nng_clock();
+	nng_msg_free(msg);
+	nng_thread_destroy(thr);
+
+	nng_close(s1);
+	nng_close(s2);
+	return ((double) (end - start) * 1000.0 / (double) n);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const char *schemes[] = { "tcp", "ipc" };
+	static size_t      sizes[]   = { 16, 32, 64, 128, 256 };
+
+	if (argc > 4) {
+		die("Usage: batch_curve "
+		    "[<count> [<batch-bytes> [<batch-ms>]]]");
+	}
+	if ((argc > 1) && ((count = atoi(argv[1])) < 10)) {
+		die("Count must be at least 10");
+	}
+	if ((argc > 2) && ((batchsz = (size_t) atoi(argv[2])) == 0)) {
+		die("Batch size must be positive");
+	}
+	if ((argc > 3) && ((batchtime = atoi(argv[3])) < 0)) {
+		die("Batch time must not be negative");
+	}
+	printf("count: %d, batch: %d [B], batch time: %d [ms]\n", count,
+	    (int) batchsz, (int) batchtime);
+	printf("%-5s %-5s %5s %12s %10s %10s\n", "tran", "batch", "size",
+	    "[msg/s]", "[Mb/s]", "[us rtt]");
+
+	for (size_t i = 0; i < sizeof(schemes) / sizeof(schemes[0]); i++) {
+		for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+			for (int on = 0; on < 2; on++) {
+				size_t b = on ? batchsz : 0;
+				size_t n = sizes[j];
+				double thr;
+				double lat;
+
+				thr = throughput(schemes[i], b, n);
+				lat = latency(schemes[i], b, n);
+
+				printf("%-5s %-5s %5d %12.0f %10.1f %10.1f\n",
+				    schemes[i], on ? "on" : "off",
+				    (int) n, thr,
+				    thr * (double) n * 8 / 1000000.0, lat);
+			}
+		}
+	}
+
+	nng_fini();
+	return (0);
+}
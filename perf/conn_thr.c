@@ -0,0 +1,154 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// conn_thr measures aggregate throughput when traffic is spread over
+// many connections.  A PUSH socket dials a PULL listener <conns> times,
+// so that the messages are distributed over that many TCP (or IPC)
+// pipes, and the main thread receives them.  This is mostly useful to
+// compare I/O backends; run it with NNG_DISABLE_IO_URING set in the
+// environment to measure the poller instead of io_uring.
+//
+// Usage: conn_thr <conns> <msg-size> <count> [<url>]
+
+#include "nng.h"
+#include "protocol/pipeline0/pull.h"
+#include "protocol/pipeline0/push.h"
+#include "supplemental/util/platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/resource.h>
+
+static nng_socket tx;
+static nng_socket rx;
+static size_t     msgsize;
+static int        count;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+static int
+parse_int(const char *arg, const char *what)
+{
+	long  val;
+	char *eptr;
+
+	val = strtol(arg, &eptr, 10);
+	// Must be a postive number less than around a billion.
+	if ((val < 0) || (val > 1000000000) || (*eptr != 0) ||
+	    (eptr == arg)) {
+		die("Invalid %s", what);
+	}
+	return ((int) val);
+}
+
+static void
+sender(void *arg)
+{
+	nng_msg *msg;
+	int      rv;
+
+	(void) arg;
+	for (int i = 0; i < count; i++) {
+		if (((rv = nng_msg_alloc(&msg, msgsize)) != 0) ||
+		    ((rv = nng_sendmsg(tx, msg, 0)) != 0)) {
+			die("send: %s", nng_strerror(rv));
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *  url = "tcp://127.0.0.1:45671";
+	struct rlimit rl;
+	nng_thread *  thr;
+	nng_msg *     msg;
+	nng_time      start;
+	nng_time      end;
+	double        secs;
+	int           conns;
+	int           rv;
+
+	if ((argc != 4) && (argc != 5)) {
+		die("Usage: conn_thr <conns> <msg-size> <count> [<url>]");
+	}
+	conns   = parse_int(argv[1], "connection count");
+	msgsize = (size_t) parse_int(argv[2], "message size");
+	count   = parse_int(argv[3], "count");
+	if (argc == 5) {
+		url = argv[4];
+	}
+	if ((conns < 1) || (count < 1)) {
+		die("Counts must be positive");
+	}
+
+	// Both ends of every connection live in this process.
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+		rl.rlim_cur = rl.rlim_max;
+		(void) setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	if (((rv = nng_pull0_open(&rx)) != 0) ||
+	    ((rv = nng_push0_open(&tx)) != 0)) {
+		die("nng_socket: %s", nng_strerror(rv));
+	}
+	if (((rv = nng_setopt_ms(rx, NNG_OPT_RECVTIMEO, 5000)) != 0) ||
+	    ((rv = nng_setopt_int(rx, NNG_OPT_RECVBUF, 128)) != 0) ||
+	    ((rv = nng_setopt_int(tx, NNG_OPT_SENDBUF, 128)) != 0)) {
+		die("nng_setopt: %s", nng_strerror(rv));
+	}
+	if ((rv = nng_listen(rx, url, NULL, 0)) != 0) {
+		die("nng_listen: %s", nng_strerror(rv));
+	}
+	for (int i = 0; i < conns; i++) {
+		if ((rv = nng_dial(tx, url, NULL, 0)) != 0) {
+			die("nng_dial #%d: %s", i, nng_strerror(rv));
+		}
+	}
+	// Give the listener a moment to accept the backlog.
+	nng_msleep(500);
+
+	start = nng_clock();
+	if ((rv = nng_thread_create(&thr, sender, NULL)) != 0) {
+		die("nng_thread_create: %s", nng_strerror(rv));
+	}
+	for (int i = 0; i < count; i++) {
+		if ((rv = nng_recvmsg(rx, &msg, 0)) != 0) {
+			die("recv after %d messages: %s", i, nng_strerror(rv));
+		}
+		nng_msg_free(msg);
+	}
+	end = nng_clock();
+	nng_thread_destroy(thr);
+
+	secs = (end > start) ? (double) (end - start) / 1000.0 : 0.001;
+	printf("connections: %d\n", conns);
+	printf("message size: %d [B]\n", (int) msgsize);
+	printf("message count: %d\n", count);
+	printf("throughput: %.0f [msg/s]\n", (double) count / secs);
+
+	nng_close(tx);
+	nng_close(rx);
+	nng_fini();
+	return (0);
+}
@@ -0,0 +1,153 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// fd_thr measures receive throughput for an event loop style consumer,
+// which waits for NNG_OPT_RECVFD to become readable with poll(), and
+// then drains the socket with non-blocking receives -- the way libev
+// or libuv based applications integrate nng.  A separate thread sends
+// the messages.  Besides throughput it reports how many times the
+// consumer was woken, which shows how well notifications coalesce.
+//
+// Usage: fd_thr <msg-size> <count> [<url>]
+
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "supplemental/util/platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <poll.h>
+
+static nng_socket tx;
+static nng_socket rx;
+static size_t     msgsize;
+static int        count;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+static int
+parse_int(const char *arg, const char *what)
+{
+	long  val;
+	char *eptr;
+
+	val = strtol(arg, &eptr, 10);
+	// Must be a postive number less than around a billion.
+	if ((val < 0) || (val > 1000000000) || (*eptr != 0) ||
+	    (eptr == arg)) {
+		die("Invalid %s", what);
+	}
+	return ((int) val);
+}
+
+static void
+sender(void *arg)
+{
+	nng_msg *msg;
+	int      rv;
+
+	(void) arg;
+	for (int i = 0; i < count; i++) {
+		if (((rv = nng_msg_alloc(&msg, msgsize)) != 0) ||
+		    ((rv = nng_sendmsg(tx, msg, 0)) != 0)) {
+			die("send: %s", nng_strerror(rv));
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *  url = "inproc://fd_thr";
+	nng_thread *  thr;
+	struct pollfd pfd;
+	nng_msg *     msg;
+	nng_time      start;
+	nng_time      end;
+	double        secs;
+	int           fd;
+	int           rcvd   = 0;
+	int           wakeup = 0;
+	int           rv;
+
+	if ((argc != 3) && (argc != 4)) {
+		die("Usage: fd_thr <msg-size> <count> [<url>]");
+	}
+	msgsize = (size_t) parse_int(argv[1], "message size");
+	count   = parse_int(argv[2], "count");
+	if (argc == 4) {
+		url = argv[3];
+	}
+	if (count < 1) {
+		die("Count must be positive");
+	}
+
+	if (((rv = nng_pair1_open(&rx)) != 0) ||
+	    ((rv = nng_pair1_open(&tx)) != 0)) {
+		die("nng_pair1_open: %s", nng_strerror(rv));
+	}
+	if (((rv = nng_setopt_int(rx, NNG_OPT_RECVBUF, 128)) != 0) ||
+	    ((rv = nng_setopt_int(tx, NNG_OPT_SENDBUF, 128)) != 0) ||
+	    ((rv = nng_getopt_int(rx, NNG_OPT_RECVFD, &fd)) != 0)) {
+		die("nng_setopt: %s", nng_strerror(rv));
+	}
+	if (((rv = nng_listen(rx, url, NULL, 0)) != 0) ||
+	    ((rv = nng_dial(tx, url, NULL, 0)) != 0)) {
+		die("connect: %s", nng_strerror(rv));
+	}
+
+	start = nng_clock();
+	if ((rv = nng_thread_create(&thr, sender, NULL)) != 0) {
+		die("nng_thread_create: %s", nng_strerror(rv));
+	}
+	pfd.fd     = fd;
+	pfd.events = POLLIN;
+	while (rcvd < count) {
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 1000) == 0) {
+			die("timed out after %d messages", rcvd);
+		}
+		wakeup++;
+		while ((rv = nng_recvmsg(rx, &msg, NNG_FLAG_NONBLOCK)) == 0) {
+			nng_msg_free(msg);
+			rcvd++;
+		}
+		if (rv != NNG_EAGAIN) {
+			die("recv: %s", nng_strerror(rv));
+		}
+	}
+	end = nng_clock();
+	nng_thread_destroy(thr);
+
+	secs = (end > start) ? (double) (end - start) / 1000.0 : 0.001;
+	printf("message size: %d [B]\n", (int) msgsize);
+	printf("message count: %d\n", count);
+	printf("wakeups: %d (%.1f msgs/wakeup)\n", wakeup,
+	    (double) rcvd / (double) wakeup);
+	printf("throughput: %.0f [msg/s]\n", (double) rcvd / secs);
+
+	nng_close(tx);
+	nng_close(rx);
+	nng_fini();
+	return (0);
+}
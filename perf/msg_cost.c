@@ -0,0 +1,174 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// msg_cost measures the cost of allocating and freeing a message of a
+// given size, of duplicating one, and of allocating one empty and then
+// appending the body to it, which is what a sender building a message
+// piecewise pays.  Finally it measures messages allocated by one thread
+// and freed by another, handed over in batches, as happens when a
+// transport receives messages for an application.
+//
+// Usage: msg_cost [<msg-size> [<count>]]
+
+#include "nng.h"
+#include "supplemental/util/platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+#define BATCH 256
+
+static nng_mtx *xfer_mtx;
+static nng_cv * xfer_cv;
+static nng_msg *xfer_msgs[BATCH];
+static bool     xfer_full;
+static int      xfer_batches;
+
+static void
+consumer(void *arg)
+{
+	nng_msg *msgs[BATCH];
+
+	(void) arg;
+	for (int i = 0; i < xfer_batches; i++) {
+		nng_mtx_lock(xfer_mtx);
+		while (!xfer_full) {
+			nng_cv_wait(xfer_cv);
+		}
+		memcpy(msgs, xfer_msgs, sizeof(msgs));
+		xfer_full = false;
+		nng_cv_wake(xfer_cv);
+		nng_mtx_unlock(xfer_mtx);
+		for (int j = 0; j < BATCH; j++) {
+			nng_msg_free(msgs[j]);
+		}
+	}
+}
+
+static void
+report(const char *what, nng_time start, int count)
+{
+	nng_time end = nng_clock();
+
+	printf("%-22s %8.1f [ns/op]\n", what,
+	    (double) (end - start) * 1000000.0 / (double) count);
+}
+
+int
+main(int argc, char **argv)
+{
+	static char       buf[65536];
+	nng_msg *         msg;
+	nng_msg *         dup;
+	nng_thread *      thr;
+	nng_bufpool_stats stats;
+	nng_time          start;
+	int               size  = 64;
+	int               count = 10000000;
+	int               rv;
+
+	if (argc > 3) {
+		die("Usage: msg_cost [<msg-size> [<count>]]");
+	}
+	if ((argc > 1) &&
+	    (((size = atoi(argv[1])) < 0) || (size > (int) sizeof(buf)))) {
+		die("Size must be between 0 and %d", (int) sizeof(buf));
+	}
+	if ((argc > 2) && ((count = atoi(argv[2])) < 1)) {
+		die("Count must be positive");
+	}
+	printf("message size: %d [B]\n", size);
+
+	start = nng_clock();
+	for (int i = 0; i < count; i++) {
+		if ((rv = nng_msg_alloc(&msg, size)) != 0) {
+			die("nng_msg_alloc: %s", nng_strerror(rv));
+		}
+		nng_msg_free(msg);
+	}
+	report("alloc/free", start, count);
+
+	if ((rv = nng_msg_alloc(&msg, size)) != 0) {
+		die("nng_msg_alloc: %s", nng_strerror(rv));
+	}
+	start = nng_clock();
+	for (int i = 0; i < count; i++) {
+		if ((rv = nng_msg_dup(&dup, msg)) != 0) {
+			die("nng_msg_dup: %s", nng_strerror(rv));
+		}
+		nng_msg_free(dup);
+	}
+	report("dup/free", start, count);
+	nng_msg_free(msg);
+
+	start = nng_clock();
+	for (int i = 0; i < count; i++) {
+		if (((rv = nng_msg_alloc(&msg, 0)) != 0) ||
+		    ((rv = nng_msg_append(msg, buf, size)) != 0) ||
+		    ((rv = nng_msg_header_append_u32(msg, i)) != 0)) {
+			die("build: %s", nng_strerror(rv));
+		}
+		nng_msg_free(msg);
+	}
+	report("alloc/append/free", start, count);
+
+	if (((rv = nng_mtx_alloc(&xfer_mtx)) != 0) ||
+	    ((rv = nng_cv_alloc(&xfer_cv, xfer_mtx)) != 0)) {
+		die("nng_mtx_alloc: %s", nng_strerror(rv));
+	}
+	xfer_batches = count / BATCH;
+	start        = nng_clock();
+	if ((rv = nng_thread_create(&thr, consumer, NULL)) != 0) {
+		die("nng_thread_create: %s", nng_strerror(rv));
+	}
+	for (int i = 0; i < xfer_batches; i++) {
+		nng_msg *msgs[BATCH];
+		for (int j = 0; j < BATCH; j++) {
+			if ((rv = nng_msg_alloc(&msgs[j], size)) != 0) {
+				die("nng_msg_alloc: %s", nng_strerror(rv));
+			}
+		}
+		nng_mtx_lock(xfer_mtx);
+		while (xfer_full) {
+			nng_cv_wait(xfer_cv);
+		}
+		memcpy(xfer_msgs, msgs, sizeof(msgs));
+		xfer_full = true;
+		nng_cv_wake(xfer_cv);
+		nng_mtx_unlock(xfer_mtx);
+	}
+	nng_thread_destroy(thr);
+	report("cross-thread alloc/free", start, xfer_batches * BATCH);
+	nng_cv_free(xfer_cv);
+	nng_mtx_free(xfer_mtx);
+
+	nng_bufpool_get_stats(&stats);
+	if (stats.s_allocs != 0) {
+		printf("%-22s %8.1f [%%]\n", "buffer pool hit rate",
+		    (double) stats.s_hits * 100.0 / (double) stats.s_allocs);
+	}
+
+	nng_fini();
+	return (0);
+}
@@ -0,0 +1,124 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// startup measures what a short lived program pays to use the library:
+// the time from a cold start (the library not yet initialized) until a
+// first message has made a round trip over inproc, and how many threads
+// the library has started by then (where /proc/self/task exists).  The
+// cycle is repeated, with nng_fini in between, and the average reported.
+//
+// Usage: startup [<count> [<task-threads>]]
+
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+static double
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec * 1000000.0 + (double) ts.tv_nsec / 1000.0);
+}
+
+static int
+count_threads(void)
+{
+	DIR *          dir;
+	struct dirent *ent;
+	int            n = 0;
+
+	if ((dir = opendir("/proc/self/task")) == NULL) {
+		return (-1);
+	}
+	while ((ent = readdir(dir)) != NULL) {
+		if (ent->d_name[0] != '.') {
+			n++;
+		}
+	}
+	closedir(dir);
+	return (n);
+}
+
+static int
+cycle(void)
+{
+	nng_socket s1;
+	nng_socket s2;
+	nng_msg *  msg;
+	int        nthr;
+	int        rv;
+
+	if (((rv = nng_pair1_open(&s1)) != 0) ||
+	    ((rv = nng_pair1_open(&s2)) != 0) ||
+	    ((rv = nng_listen(s1, "inproc://startup", NULL, 0)) != 0) ||
+	    ((rv = nng_dial(s2, "inproc://startup", NULL, 0)) != 0) ||
+	    ((rv = nng_msg_alloc(&msg, 0)) != 0) ||
+	    ((rv = nng_sendmsg(s2, msg, 0)) != 0) ||
+	    ((rv = nng_recvmsg(s1, &msg, 0)) != 0)) {
+		die("round trip: %s", nng_strerror(rv));
+	}
+	nng_msg_free(msg);
+	nthr = count_threads();
+	nng_close(s2);
+	nng_close(s1);
+	return (nthr);
+}
+
+int
+main(int argc, char **argv)
+{
+	int    count = 100;
+	int    nthr  = 0;
+	double start;
+	double total = 0;
+
+	if (argc > 3) {
+		die("Usage: startup [<count> [<task-threads>]]");
+	}
+	if ((argc > 1) && ((count = atoi(argv[1])) < 1)) {
+		die("Count must be positive");
+	}
+	for (int i = 0; i < count; i++) {
+		if (argc > 2) {
+			nng_init_set_parameter(
+			    NNG_INIT_NUM_TASK_THREADS, atoi(argv[2]));
+		}
+		start = now_us();
+		nthr  = cycle();
+		total += now_us() - start;
+		nng_fini();
+	}
+
+	printf("startup + first round trip: %.1f [us]\n", total / count);
+	if (nthr >= 0) {
+		// Less one, for the main thread.
+		printf("library threads: %d\n", nthr - 1);
+	}
+	return (0);
+}
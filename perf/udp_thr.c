@@ -0,0 +1,254 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// udp_thr measures raw loopback UDP throughput through the platform
+// layer (nni_plat_udp), which is what the ZeroTier transport runs on.
+// It keeps a window of sends and receives outstanding so that the
+// platform can batch them, and reports datagrams per second.
+//
+// Usage: udp_thr <msg-size> <count> [<port>]
+
+#include "core/nng_impl.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+#define UDP_THR_WINDOW 64
+
+typedef struct {
+	nni_aio *    aio;
+	uint8_t *    buf;
+	nng_sockaddr sa;
+} udp_slot;
+
+static nni_mtx       mtx;
+static nni_cv        cv;
+static nni_plat_udp *txudp;
+static nni_plat_udp *rxudp;
+static nng_sockaddr  dst;
+static size_t        msgsize;
+static int           count;
+static int           issued;
+static int           sending;
+static int           rcvd;
+static int           closing;
+static nni_time      last;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+static int
+parse_int(const char *arg, const char *what)
+{
+	long  val;
+	char *eptr;
+
+	val = strtol(arg, &eptr, 10);
+	// Must be a postive number less than around a billion.
+	if ((val < 0) || (val > 1000000000) || (*eptr != 0) ||
+	    (eptr == arg)) {
+		die("Invalid %s", what);
+	}
+	return ((int) val);
+}
+
+static void
+udp_post(nni_plat_udp *udp, udp_slot *slot, int send)
+{
+	nni_iov iov;
+
+	iov.iov_buf = slot->buf;
+	iov.iov_len = msgsize;
+	nni_aio_set_iov(slot->aio, 1, &iov);
+	nni_aio_set_input(slot->aio, 0, &slot->sa);
+	if (send) {
+		nni_plat_udp_send(udp, slot->aio);
+	} else {
+		nni_plat_udp_recv(udp, slot->aio);
+	}
+}
+
+static void
+udp_send_cb(void *arg)
+{
+	udp_slot *slot = arg;
+	int       rv;
+
+	if ((rv = nni_aio_result(slot->aio)) != 0) {
+		die("send: %s", nng_strerror(rv));
+	}
+	nni_mtx_lock(&mtx);
+	if (issued < count) {
+		issued++;
+		nni_mtx_unlock(&mtx);
+		udp_post(txudp, slot, 1);
+		return;
+	}
+	sending--;
+	nni_cv_wake(&cv);
+	nni_mtx_unlock(&mtx);
+}
+
+static void
+udp_recv_cb(void *arg)
+{
+	udp_slot *slot = arg;
+
+	if (nni_aio_result(slot->aio) != 0) {
+		return; // closed
+	}
+	nni_mtx_lock(&mtx);
+	rcvd++;
+	last = nni_clock();
+	nni_cv_wake(&cv);
+	// Repost under the lock, so that we cannot race against close.
+	if (!closing) {
+		udp_post(rxudp, slot, 0);
+	}
+	nni_mtx_unlock(&mtx);
+}
+
+static int
+udp_slots_init(udp_slot *slots, nni_cb cb)
+{
+	int rv;
+
+	for (int i = 0; i < UDP_THR_WINDOW; i++) {
+		if ((rv = nni_aio_init(&slots[i].aio, cb, &slots[i])) != 0) {
+			return (rv);
+		}
+		if ((slots[i].buf = nni_alloc(msgsize)) == NULL) {
+			return (NNG_ENOMEM);
+		}
+		memset(slots[i].buf, 'u', msgsize);
+	}
+	return (0);
+}
+
+static void
+udp_slots_fini(udp_slot *slots)
+{
+	for (int i = 0; i < UDP_THR_WINDOW; i++) {
+		nni_aio_fini(slots[i].aio);
+		nni_free(slots[i].buf, msgsize);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	static udp_slot txs[UDP_THR_WINDOW];
+	static udp_slot rxs[UDP_THR_WINDOW];
+	nng_sockaddr    src;
+	nni_time        start;
+	nni_time        end;
+	double          secs;
+	int             port = 47000;
+	int             rv;
+
+	if ((argc != 3) && (argc != 4)) {
+		die("Usage: udp_thr <msg-size> <count> [<port>]");
+	}
+	msgsize = (size_t) parse_int(argv[1], "message size");
+	count   = parse_int(argv[2], "count");
+	if (argc == 4) {
+		port = parse_int(argv[3], "port");
+	}
+	if ((msgsize < 1) || (msgsize > 65000) || (count < 1)) {
+		die("Message size must be 1-65000, and count positive");
+	}
+
+	if ((rv = nni_init()) != 0) {
+		die("nni_init: %s", nng_strerror(rv));
+	}
+	nni_mtx_init(&mtx);
+	nni_cv_init(&cv, &mtx);
+
+	memset(&dst, 0, sizeof(dst));
+	dst.s_un.s_in.sa_family = NNG_AF_INET;
+	dst.s_un.s_in.sa_addr   = htonl(0x7f000001);
+	dst.s_un.s_in.sa_port   = htons((uint16_t) port);
+	src                     = dst;
+	src.s_un.s_in.sa_port   = 0;
+
+	if (((rv = nni_plat_udp_open(&rxudp, &dst)) != 0) ||
+	    ((rv = nni_plat_udp_open(&txudp, &src)) != 0)) {
+		die("nni_plat_udp_open: %s", nng_strerror(rv));
+	}
+	if (((rv = udp_slots_init(txs, udp_send_cb)) != 0) ||
+	    ((rv = udp_slots_init(rxs, udp_recv_cb)) != 0)) {
+		die("udp_slots_init: %s", nng_strerror(rv));
+	}
+
+	for (int i = 0; i < UDP_THR_WINDOW; i++) {
+		udp_post(rxudp, &rxs[i], 0);
+	}
+
+	start = nni_clock();
+	nni_mtx_lock(&mtx);
+	for (int i = 0; (i < UDP_THR_WINDOW) && (issued < count); i++) {
+		txs[i].sa = dst;
+		issued++;
+		sending++;
+		nni_mtx_unlock(&mtx);
+		udp_post(txudp, &txs[i], 1);
+		nni_mtx_lock(&mtx);
+	}
+	while (sending > 0) {
+		nni_cv_wait(&cv);
+	}
+	end = nni_clock();
+
+	// Loopback UDP can still drop when the receiver falls behind, so
+	// we only wait for stragglers until things go quiet.
+	last = end;
+	while ((rcvd < count) && (nni_clock() < (last + 500))) {
+		(void) nni_cv_until(&cv, last + 500);
+	}
+	if (rcvd > 0) {
+		end = last;
+	}
+	closing = 1;
+	nni_mtx_unlock(&mtx);
+
+	nni_plat_udp_close(txudp);
+	nni_plat_udp_close(rxudp);
+	udp_slots_fini(txs);
+	udp_slots_fini(rxs);
+
+	secs = (end > start) ? (double) (end - start) / 1000.0 : 0.001;
+	printf("message size: %d [B]\n", (int) msgsize);
+	printf("message count: %d\n", count);
+	printf("received: %d (%.2f%% lost)\n", rcvd,
+	    100.0 * (double) (count - rcvd) / (double) count);
+	printf("throughput: %.0f [datagrams/s]\n", (double) rcvd / secs);
+	printf("throughput: %.3f [Mb/s]\n",
+	    ((double) rcvd * msgsize * 8) / (secs * 1000000.0));
+
+	nni_cv_fini(&cv);
+	nni_mtx_fini(&mtx);
+	nng_fini();
+	return (0);
+}
@@ -18,6 +18,8 @@ static int      nni_aio_expire_run;
 static nni_thr  nni_aio_expire_thr;
 static nni_list nni_aio_expire_aios;
 
+static void nni_aio_expire_loop(void *);
+
 // Design notes.
 //
 // AIOs are only ever "completed" by the provider, which must call
@@ -300,6 +302,14 @@ nni_aio_wait(nni_aio *aio)
 int
 nni_aio_start(nni_aio *aio, nni_aio_cancelfn cancelfn, void *data)
 {
+	nni_time now = 0;
+
+	// Read the clock before taking the lock, which is shared by every
+	// aio in the system; there is no need to hold it that much longer.
+	if (aio->a_timeout > 0) {
+		now = nni_clock();
+	}
+
 	nni_mtx_lock(&nni_aio_lk);
 	if (aio->a_fini) {
 		// We should not reschedule anything at this point.
@@ -330,7 +340,7 @@ nni_aio_start(nni_aio *aio, nni_aio_cancelfn cancelfn, void *data)
 		aio->a_expire = NNI_TIME_NEVER;
 		break;
 	default:
-		aio->a_expire = nni_clock() + aio->a_timeout;
+		aio->a_expire = now + aio->a_timeout;
 		nni_aio_expire_add(aio);
 		break;
 	}
@@ -441,12 +451,31 @@ nni_aio_list_active(nni_aio *aio)
 	return (nni_list_node_active(&aio->a_prov_node));
 }
 
+// nni_aio_expire_start starts the expiration thread, which is only
+// needed once an aio with a timeout is used.  If that fails, we will
+// try again with the next one.
+static void
+nni_aio_expire_start(void)
+{
+	if (nni_aio_expire_run) {
+		return;
+	}
+	if (nni_thr_init(&nni_aio_expire_thr, nni_aio_expire_loop, NULL) !=
+	    0) {
+		return;
+	}
+	nni_aio_expire_run = 1;
+	nni_thr_run(&nni_aio_expire_thr);
+}
+
 static void
 nni_aio_expire_add(nni_aio *aio)
 {
 	nni_list *list = &nni_aio_expire_aios;
 	nni_aio * naio;
 
+	nni_aio_expire_start();
+
 	// This is a reverse walk of the list.  We're more likely to find
 	// a match at the end of the list.
 	for (naio = nni_list_last(list); naio != NULL;
@@ -633,21 +662,13 @@ nni_aio_sys_fini(void)
 int
 nni_aio_sys_init(void)
 {
-	int      rv;
 	nni_mtx *mtx = &nni_aio_lk;
 	nni_cv * cv  = &nni_aio_expire_cv;
-	nni_thr *thr = &nni_aio_expire_thr;
 
 	NNI_LIST_INIT(&nni_aio_expire_aios, nni_aio, a_expire_node);
 	nni_mtx_init(mtx);
 	nni_cv_init(cv, mtx);
 
-	if ((rv = nni_thr_init(thr, nni_aio_expire_loop, NULL)) != 0) {
-		nni_aio_sys_fini();
-		return (rv);
-	}
-
-	nni_aio_expire_run = 1;
-	nni_thr_run(thr);
+	// The expiration thread is started by the first aio that needs it.
 	return (0);
 }
@@ -0,0 +1,85 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include <string.h>
+
+#include "core/nng_impl.h"
+
+// All of the library's memory comes through here.  The hooks are only
+// changed while the library is shut down, so they are read without any
+// locking.  When no hooks are installed, all fields are NULL.
+
+static nng_allocator nni_allocator;
+
+int
+nni_alloc_set_hooks(const nng_allocator *a)
+{
+	if (a == NULL) {
+		memset(&nni_allocator, 0, sizeof(nni_allocator));
+		return (0);
+	}
+	if ((a->na_alloc == NULL) || (a->na_free == NULL) ||
+	    ((a->na_alloc_large == NULL) != (a->na_free_large == NULL))) {
+		return (NNG_EINVAL);
+	}
+	nni_allocator = *a;
+	return (0);
+}
+
+void *
+nni_alloc(size_t sz)
+{
+	void *ptr;
+
+	if (nni_allocator.na_alloc == NULL) {
+		return (nni_plat_alloc(sz));
+	}
+	// Callers rely on nni_alloc zeroing, as calloc() does.
+	ptr = nni_allocator.na_alloc(sz, nni_allocator.na_arg);
+	if (ptr != NULL) {
+		memset(ptr, 0, sz);
+	}
+	return (ptr);
+}
+
+void
+nni_free(void *ptr, size_t sz)
+{
+	if (ptr == NULL) {
+		return;
+	}
+	if (nni_allocator.na_free == NULL) {
+		nni_plat_free(ptr, sz);
+	} else {
+		nni_allocator.na_free(ptr, sz, nni_allocator.na_arg);
+	}
+}
+
+void *
+nni_alloc_large(size_t sz)
+{
+	if (nni_allocator.na_alloc_large == NULL) {
+		return (nni_alloc(sz));
+	}
+	return (nni_allocator.na_alloc_large(sz, nni_allocator.na_arg));
+}
+
+void
+nni_free_large(void *ptr, size_t sz)
+{
+	if (ptr == NULL) {
+		return;
+	}
+	if (nni_allocator.na_free_large == NULL) {
+		nni_free(ptr, sz);
+	} else {
+		nni_allocator.na_free_large(ptr, sz, nni_allocator.na_arg);
+	}
+}
@@ -0,0 +1,37 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef CORE_ALLOC_H
+#define CORE_ALLOC_H
+
+#include "core/defs.h"
+
+// nni_alloc allocates zeroed memory, from the application's allocator
+// hooks if any were installed, otherwise from the platform.  It is
+// permissible for this to return NULL if memory cannot be allocated.
+extern void *nni_alloc(size_t);
+
+// nni_free frees memory allocated with nni_alloc.  The size must be the
+// same size that was allocated.  This does nothing if passed NULL.
+extern void nni_free(void *, size_t);
+
+// nni_alloc_large and nni_free_large are used for message buffers that
+// are too large to pool.  The application may supply separate hooks for
+// these (for example to place them in huge pages); otherwise they are the
+// same as nni_alloc and nni_free, except that the memory is not zeroed.
+extern void *nni_alloc_large(size_t);
+extern void  nni_free_large(void *, size_t);
+
+// nni_alloc_set_hooks installs allocator hooks, or restores the platform
+// allocator if passed NULL.  It must only be called while the library
+// is not initialized, so that nothing is outstanding.
+extern int nni_alloc_set_hooks(const nng_allocator *);
+
+#endif // CORE_ALLOC_H
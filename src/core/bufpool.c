@@ -0,0 +1,483 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include <string.h>
+
+#include "core/nng_impl.h"
+
+// Message buffer pool.  Buffers are grouped in power of two size classes.
+// For each class, every thread holds two "magazines" (small stacks of free
+// buffers), and allocates from and frees to them without taking any lock.
+// When both are empty on allocation, or both full on free, the thread
+// trades a whole magazine with a shared depot: an empty one for a full
+// one, or the other way around.  That is a single lock acquisition, and
+// touches none of the buffers, no matter how many it moves.  Buffers can
+// thus cycle between a thread that mostly allocates (such as a transport
+// receiving messages) and one that mostly frees (such as an application
+// consuming them), without going through the system allocator, and
+// without the threads contending for every message.  Keeping two
+// magazines rather than one stops a thread that alternates between
+// allocating and freeing at a boundary from visiting the depot each time.
+//
+// The memory held is bounded.  Magazines are sized so that a thread holds
+// roughly the per thread limit at most, and the depot holds full
+// magazines up to the shared limit; beyond that buffers are freed.
+// Statistics are counted per thread, and added to the totals whenever the
+// thread visits the depot (and at least every NNI_BUFPOOL_FLUSH
+// operations), so they may lag a little.
+
+#define NNI_BUFPOOL_MIN_SHIFT 6  // 64 bytes
+#define NNI_BUFPOOL_MAX_SHIFT 16 // 64 KB
+#define NNI_BUFPOOL_NCLASS (NNI_BUFPOOL_MAX_SHIFT - NNI_BUFPOOL_MIN_SHIFT + 1)
+#define NNI_BUFPOOL_MIN ((size_t) 1 << NNI_BUFPOOL_MIN_SHIFT)
+#define NNI_BUFPOOL_MAX ((size_t) 1 << NNI_BUFPOOL_MAX_SHIFT)
+#define NNI_BUFPOOL_ROUNDS 128 // most buffers in one magazine
+#define NNI_BUFPOOL_EMPTIES 8  // most empty magazines kept per class
+#define NNI_BUFPOOL_FLUSH 256
+
+#ifndef NNG_BUFPOOL_THREAD_CACHE
+#define NNG_BUFPOOL_THREAD_CACHE (256 * 1024)
+#endif
+
+#ifndef NNG_BUFPOOL_SHARED_CACHE
+#define NNG_BUFPOOL_SHARED_CACHE (4 * 1024 * 1024)
+#endif
+
+typedef struct nni_bufpool_mag {
+	nni_list_node m_node;
+	int           m_n;
+	void *        m_bufs[1]; // actually nni_bufpool_rounds[class]
+} nni_bufpool_mag;
+
+typedef struct nni_bufpool_cache {
+	nni_list_node    bc_node;
+	size_t           bc_bytes; // bytes held in the magazines
+	int              bc_ops;   // operations since the last flush
+	uint64_t         bc_allocs;
+	uint64_t         bc_hits;
+	nni_bufpool_mag *bc_loaded[NNI_BUFPOOL_NCLASS];
+	nni_bufpool_mag *bc_prev[NNI_BUFPOOL_NCLASS];
+} nni_bufpool_cache;
+
+static nni_mtx      nni_bufpool_lk;
+static nni_plat_tls nni_bufpool_tls;
+static nni_list     nni_bufpool_caches;
+static nni_list     nni_bufpool_full[NNI_BUFPOOL_NCLASS];
+static nni_list     nni_bufpool_empty[NNI_BUFPOOL_NCLASS];
+static int          nni_bufpool_nempty[NNI_BUFPOOL_NCLASS];
+static int          nni_bufpool_rounds[NNI_BUFPOOL_NCLASS];
+static size_t       nni_bufpool_depot_bytes;
+static size_t       nni_bufpool_depot_max;
+static uint64_t     nni_bufpool_allocs;
+static uint64_t     nni_bufpool_hits;
+static uint64_t     nni_bufpool_refills;
+static uint64_t     nni_bufpool_drains;
+static bool         nni_bufpool_on = false;
+
+static int
+nni_bufpool_class(size_t sz)
+{
+	int    c  = 0;
+	size_t cs = NNI_BUFPOOL_MIN;
+
+	while (cs < sz) {
+		cs <<= 1;
+		c++;
+	}
+	return (c);
+}
+
+static size_t
+nni_bufpool_mag_size(int c)
+{
+	return (sizeof(nni_bufpool_mag) +
+	    (nni_bufpool_rounds[c] - 1) * sizeof(void *));
+}
+
+static nni_bufpool_mag *
+nni_bufpool_mag_alloc(int c)
+{
+	nni_bufpool_mag *mag;
+
+	if ((mag = nni_alloc(nni_bufpool_mag_size(c))) != NULL) {
+		NNI_LIST_NODE_INIT(&mag->m_node);
+	}
+	return (mag);
+}
+
+// nni_bufpool_mag_free releases a magazine, and the buffers in it.
+static void
+nni_bufpool_mag_free(int c, nni_bufpool_mag *mag)
+{
+	for (int i = 0; i < mag->m_n; i++) {
+		nni_free(mag->m_bufs[i], NNI_BUFPOOL_MIN << c);
+	}
+	nni_free(mag, nni_bufpool_mag_size(c));
+}
+
+// nni_bufpool_flush adds the thread's counters to the totals.  The
+// pool lock must be held.
+static void
+nni_bufpool_flush(nni_bufpool_cache *bc)
+{
+	nni_bufpool_allocs += bc->bc_allocs;
+	nni_bufpool_hits += bc->bc_hits;
+	bc->bc_allocs = 0;
+	bc->bc_hits   = 0;
+	bc->bc_ops    = 0;
+}
+
+// nni_bufpool_put gives a magazine to the depot.  If it has buffers and
+// the depot has room for them, it joins the full ones; if it is empty, it
+// joins the empty ones if there are not too many.  Otherwise it is
+// returned, for the caller to free outside of the lock.  The pool lock
+// must be held.
+static nni_bufpool_mag *
+nni_bufpool_put(int c, nni_bufpool_mag *mag)
+{
+	size_t bytes = mag->m_n * (NNI_BUFPOOL_MIN << c);
+
+	if (mag->m_n == 0) {
+		if (nni_bufpool_nempty[c] < NNI_BUFPOOL_EMPTIES) {
+			nni_list_prepend(&nni_bufpool_empty[c], mag);
+			nni_bufpool_nempty[c]++;
+			return (NULL);
+		}
+	} else if ((nni_bufpool_depot_bytes + bytes) <=
+	    nni_bufpool_depot_max) {
+		nni_list_prepend(&nni_bufpool_full[c], mag);
+		nni_bufpool_depot_bytes += bytes;
+		return (NULL);
+	}
+	return (mag);
+}
+
+// nni_bufpool_cache_fini is called when a thread exits.  The cache is
+// only ours to release if nni_bufpool_sys_fini has not already done so.
+static void
+nni_bufpool_cache_fini(void *arg)
+{
+	nni_bufpool_cache *bc = arg;
+	nni_bufpool_mag *  mag;
+
+	nni_mtx_lock(&nni_bufpool_lk);
+	if (!nni_list_active(&nni_bufpool_caches, bc)) {
+		nni_mtx_unlock(&nni_bufpool_lk);
+		return;
+	}
+	nni_list_remove(&nni_bufpool_caches, bc);
+	nni_bufpool_flush(bc);
+	for (int c = 0; c < NNI_BUFPOOL_NCLASS; c++) {
+		if ((bc->bc_loaded[c] != NULL) &&
+		    ((mag = nni_bufpool_put(c, bc->bc_loaded[c])) != NULL)) {
+			nni_bufpool_mag_free(c, mag);
+		}
+		if ((bc->bc_prev[c] != NULL) &&
+		    ((mag = nni_bufpool_put(c, bc->bc_prev[c])) != NULL)) {
+			nni_bufpool_mag_free(c, mag);
+		}
+	}
+	nni_mtx_unlock(&nni_bufpool_lk);
+	NNI_FREE_STRUCT(bc);
+}
+
+static nni_bufpool_cache *
+nni_bufpool_cache_get(void)
+{
+	nni_bufpool_cache *bc;
+
+	if ((bc = nni_plat_tls_get(&nni_bufpool_tls)) != NULL) {
+		return (bc);
+	}
+	if ((bc = NNI_ALLOC_STRUCT(bc)) == NULL) {
+		return (NULL);
+	}
+	nni_mtx_lock(&nni_bufpool_lk);
+	nni_list_append(&nni_bufpool_caches, bc);
+	nni_mtx_unlock(&nni_bufpool_lk);
+	nni_plat_tls_set(&nni_bufpool_tls, bc);
+	return (bc);
+}
+
+static void
+nni_bufpool_tick(nni_bufpool_cache *bc)
+{
+	if (++bc->bc_ops >= NNI_BUFPOOL_FLUSH) {
+		nni_mtx_lock(&nni_bufpool_lk);
+		nni_bufpool_flush(bc);
+		nni_mtx_unlock(&nni_bufpool_lk);
+	}
+}
+
+// nni_bufpool_refill is called when both of a thread's magazines are
+// empty (or missing).  It trades the older one for a full magazine from
+// the depot, if there is one.
+static void
+nni_bufpool_refill(nni_bufpool_cache *bc, int c)
+{
+	nni_bufpool_mag *full;
+	nni_bufpool_mag *mag = NULL;
+
+	nni_mtx_lock(&nni_bufpool_lk);
+	if ((full = nni_list_first(&nni_bufpool_full[c])) != NULL) {
+		nni_list_remove(&nni_bufpool_full[c], full);
+		nni_bufpool_depot_bytes -= full->m_n * (NNI_BUFPOOL_MIN << c);
+		if (bc->bc_prev[c] != NULL) {
+			mag = nni_bufpool_put(c, bc->bc_prev[c]);
+		}
+		bc->bc_prev[c]   = bc->bc_loaded[c];
+		bc->bc_loaded[c] = full;
+		bc->bc_bytes += full->m_n * (NNI_BUFPOOL_MIN << c);
+		nni_bufpool_refills++;
+	}
+	nni_bufpool_flush(bc);
+	nni_mtx_unlock(&nni_bufpool_lk);
+
+	if (mag != NULL) {
+		nni_bufpool_mag_free(c, mag);
+	}
+}
+
+// nni_bufpool_drain is called when both of a thread's magazines are full
+// (or missing).  It trades the older one for an empty magazine, which
+// is loaded.  This returns false if no empty magazine could be had.
+static bool
+nni_bufpool_drain(nni_bufpool_cache *bc, int c)
+{
+	nni_bufpool_mag *empty;
+	nni_bufpool_mag *mag = NULL;
+
+	nni_mtx_lock(&nni_bufpool_lk);
+	if ((empty = nni_list_first(&nni_bufpool_empty[c])) != NULL) {
+		nni_list_remove(&nni_bufpool_empty[c], empty);
+		nni_bufpool_nempty[c]--;
+	}
+	if (bc->bc_prev[c] != NULL) {
+		bc->bc_bytes -= bc->bc_prev[c]->m_n * (NNI_BUFPOOL_MIN << c);
+		if ((mag = nni_bufpool_put(c, bc->bc_prev[c])) == NULL) {
+			nni_bufpool_drains++;
+		}
+		bc->bc_prev[c] = NULL;
+	}
+	nni_bufpool_flush(bc);
+	nni_mtx_unlock(&nni_bufpool_lk);
+
+	// If the depot had no room for the full magazine, we empty it
+	// ourselves, and can then use it as the empty one.
+	if (mag != NULL) {
+		for (int i = 0; i < mag->m_n; i++) {
+			nni_free(mag->m_bufs[i], NNI_BUFPOOL_MIN << c);
+		}
+		mag->m_n = 0;
+		if (empty == NULL) {
+			empty = mag;
+		} else {
+			nni_bufpool_mag_free(c, mag);
+		}
+	}
+	if ((empty == NULL) && ((empty = nni_bufpool_mag_alloc(c)) == NULL)) {
+		return (false);
+	}
+	bc->bc_prev[c]   = bc->bc_loaded[c];
+	bc->bc_loaded[c] = empty;
+	return (true);
+}
+
+void *
+nni_buf_alloc(size_t sz, size_t *capp)
+{
+	nni_bufpool_cache *bc;
+	nni_bufpool_mag *  mag;
+	void *             buf;
+	size_t             cs;
+	int                c;
+
+	*capp = sz;
+	if (sz > NNI_BUFPOOL_MAX) {
+		return (nni_alloc_large(sz));
+	}
+	if ((!nni_bufpool_on) || ((bc = nni_bufpool_cache_get()) == NULL)) {
+		return (nni_alloc(sz));
+	}
+	c  = nni_bufpool_class(sz);
+	cs = NNI_BUFPOOL_MIN << c;
+
+	bc->bc_allocs++;
+	if (((mag = bc->bc_loaded[c]) == NULL) || (mag->m_n == 0)) {
+		if (((mag = bc->bc_prev[c]) != NULL) && (mag->m_n != 0)) {
+			bc->bc_prev[c]   = bc->bc_loaded[c];
+			bc->bc_loaded[c] = mag;
+		} else {
+			nni_bufpool_refill(bc, c);
+			mag = bc->bc_loaded[c];
+		}
+	}
+	if ((mag != NULL) && (mag->m_n != 0)) {
+		buf = mag->m_bufs[--mag->m_n];
+		bc->bc_bytes -= cs;
+		bc->bc_hits++;
+	} else if ((buf = nni_alloc(cs)) == NULL) {
+		return (NULL);
+	}
+	nni_bufpool_tick(bc);
+	*capp = cs;
+	return (buf);
+}
+
+void
+nni_buf_free(void *buf, size_t cap)
+{
+	nni_bufpool_cache *bc;
+	nni_bufpool_mag *  mag;
+	int                c;
+
+	if (buf == NULL) {
+		return;
+	}
+	if (cap > NNI_BUFPOOL_MAX) {
+		nni_free_large(buf, cap);
+		return;
+	}
+	if ((!nni_bufpool_on) || (cap < NNI_BUFPOOL_MIN) ||
+	    ((cap & (cap - 1)) != 0) ||
+	    ((bc = nni_bufpool_cache_get()) == NULL)) {
+		nni_free(buf, cap);
+		return;
+	}
+	c = nni_bufpool_class(cap);
+
+	if (((mag = bc->bc_loaded[c]) == NULL) ||
+	    (mag->m_n == nni_bufpool_rounds[c])) {
+		if (((mag = bc->bc_prev[c]) != NULL) &&
+		    (mag->m_n < nni_bufpool_rounds[c])) {
+			bc->bc_prev[c]   = bc->bc_loaded[c];
+			bc->bc_loaded[c] = mag;
+		} else if (nni_bufpool_drain(bc, c)) {
+			mag = bc->bc_loaded[c];
+		} else {
+			nni_free(buf, cap);
+			return;
+		}
+	}
+	mag->m_bufs[mag->m_n++] = buf;
+	bc->bc_bytes += cap;
+}
+
+void
+nni_bufpool_stats(nng_bufpool_stats *st)
+{
+	nni_bufpool_cache *bc;
+
+	memset(st, 0, sizeof(*st));
+	if (!nni_bufpool_on) {
+		return;
+	}
+	nni_mtx_lock(&nni_bufpool_lk);
+	st->s_allocs  = nni_bufpool_allocs;
+	st->s_hits    = nni_bufpool_hits;
+	st->s_refills = nni_bufpool_refills;
+	st->s_drains  = nni_bufpool_drains;
+	st->s_cached  = nni_bufpool_depot_bytes;
+	// The per thread byte counts are only approximate here, as their
+	// owners change them without the lock.
+	NNI_LIST_FOREACH (&nni_bufpool_caches, bc) {
+		st->s_cached += bc->bc_bytes;
+	}
+	nni_mtx_unlock(&nni_bufpool_lk);
+}
+
+int
+nni_bufpool_sys_init(void)
+{
+	size_t thread_max;
+	int    rv;
+
+	thread_max = (size_t) nni_init_get_param(
+	    NNG_INIT_BUFPOOL_THREAD_CACHE, NNG_BUFPOOL_THREAD_CACHE);
+	nni_bufpool_depot_max = (size_t) nni_init_get_param(
+	    NNG_INIT_BUFPOOL_SHARED_CACHE, NNG_BUFPOOL_SHARED_CACHE);
+	if (thread_max == 0) {
+		// Pooling disabled; everything goes to nni_alloc.
+		return (0);
+	}
+
+	// Each class gets an equal share of the per thread limit, split
+	// over its two magazines.  The smallest classes are limited by the
+	// number of rounds instead, and the largest always get at least
+	// one buffer per magazine.
+	for (int c = 0; c < NNI_BUFPOOL_NCLASS; c++) {
+		size_t n = thread_max / (2 * NNI_BUFPOOL_NCLASS) /
+		    (NNI_BUFPOOL_MIN << c);
+		if (n > NNI_BUFPOOL_ROUNDS) {
+			n = NNI_BUFPOOL_ROUNDS;
+		}
+		nni_bufpool_rounds[c] = n > 0 ? (int) n : 1;
+		NNI_LIST_INIT(&nni_bufpool_full[c], nni_bufpool_mag, m_node);
+		NNI_LIST_INIT(&nni_bufpool_empty[c], nni_bufpool_mag, m_node);
+		nni_bufpool_nempty[c] = 0;
+	}
+	NNI_LIST_INIT(&nni_bufpool_caches, nni_bufpool_cache, bc_node);
+	nni_mtx_init(&nni_bufpool_lk);
+	if ((rv = nni_plat_tls_init(
+	         &nni_bufpool_tls, nni_bufpool_cache_fini)) != 0) {
+		nni_mtx_fini(&nni_bufpool_lk);
+		return (rv);
+	}
+	nni_bufpool_depot_bytes = 0;
+	nni_bufpool_allocs      = 0;
+	nni_bufpool_hits        = 0;
+	nni_bufpool_refills     = 0;
+	nni_bufpool_drains      = 0;
+	nni_bufpool_on          = true;
+	return (0);
+}
+
+void
+nni_bufpool_sys_fini(void)
+{
+	nni_bufpool_cache *bc;
+	nni_bufpool_mag *  mag;
+
+	if (!nni_bufpool_on) {
+		return;
+	}
+	nni_bufpool_on = false;
+
+	// Nothing else may be running now.  Caches that belong to threads
+	// that are still alive are released here; the threads' slots go
+	// away with the TLS key, so the destructor won't see them again.
+	nni_plat_tls_fini(&nni_bufpool_tls);
+	nni_mtx_lock(&nni_bufpool_lk);
+	while ((bc = nni_list_first(&nni_bufpool_caches)) != NULL) {
+		nni_list_remove(&nni_bufpool_caches, bc);
+		for (int c = 0; c < NNI_BUFPOOL_NCLASS; c++) {
+			if (bc->bc_loaded[c] != NULL) {
+				nni_bufpool_mag_free(c, bc->bc_loaded[c]);
+			}
+			if (bc->bc_prev[c] != NULL) {
+				nni_bufpool_mag_free(c, bc->bc_prev[c]);
+			}
+		}
+		NNI_FREE_STRUCT(bc);
+	}
+	for (int c = 0; c < NNI_BUFPOOL_NCLASS; c++) {
+		while ((mag = nni_list_first(&nni_bufpool_full[c])) != NULL) {
+			nni_list_remove(&nni_bufpool_full[c], mag);
+			nni_bufpool_mag_free(c, mag);
+		}
+		while ((mag = nni_list_first(&nni_bufpool_empty[c])) != NULL) {
+			nni_list_remove(&nni_bufpool_empty[c], mag);
+			nni_bufpool_mag_free(c, mag);
+		}
+	}
+	nni_bufpool_depot_bytes = 0;
+	nni_mtx_unlock(&nni_bufpool_lk);
+	nni_mtx_fini(&nni_bufpool_lk);
+}
@@ -0,0 +1,32 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef CORE_BUFPOOL_H
+#define CORE_BUFPOOL_H
+
+#include "core/defs.h"
+
+// nni_buf_alloc allocates a buffer of at least the given size, for use
+// by messages.  The capacity actually allocated, which may be larger, is
+// returned through the last argument, and must be passed back to
+// nni_buf_free.  Unlike nni_alloc, the contents are not zeroed.  Sizes
+// up to 64 KB are rounded up to a power of two and served from a per
+// thread cache when possible; larger buffers come from nni_alloc_large.
+extern void *nni_buf_alloc(size_t, size_t *);
+
+// nni_buf_free releases a buffer obtained from nni_buf_alloc.  The
+// buffer is kept in the calling thread's cache if there is room.
+extern void nni_buf_free(void *, size_t);
+
+extern void nni_bufpool_stats(nng_bufpool_stats *);
+extern int  nni_bufpool_sys_init(void);
+extern void nni_bufpool_sys_fini(void);
+
+#endif // CORE_BUFPOOL_H
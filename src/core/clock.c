@@ -15,6 +15,12 @@ nni_clock(void)
 	return (nni_plat_clock());
 }
 
+nni_time
+nni_clock_coarse(void)
+{
+	return (nni_plat_clock_coarse());
+}
+
 void
 nni_msleep(nni_duration msec)
 {
@@ -15,6 +15,10 @@
 
 extern nni_time nni_clock(void);
 
+// nni_clock_coarse is a cheap clock for internal timers that can
+// tolerate firing a few milliseconds early.  See nni_plat_clock_coarse.
+extern nni_time nni_clock_coarse(void);
+
 extern void nni_msleep(nni_duration);
 
 #endif // CORE_CLOCK_H
@@ -68,9 +68,10 @@ typedef void (*nni_cb)(void *);
 
 // Notify descriptor.
 typedef struct {
-	int sn_wfd; // written to in order to flag an event
-	int sn_rfd; // read from in order to clear an event
-	int sn_init;
+	int      sn_wfd;   // written to in order to flag an event
+	int      sn_rfd;   // read from in order to clear an event
+	int      sn_init;  // descriptors have been opened
+	uint32_t sn_ready; // event is flagged (atomic)
 } nni_notifyfd;
 
 // Some default timing things.
@@ -81,8 +82,8 @@ typedef struct {
 // Structure allocation conveniences.
 #define NNI_ALLOC_STRUCT(s) nni_alloc(sizeof(*s))
 #define NNI_FREE_STRUCT(s) nni_free((s), sizeof(*s))
-#define NNI_ALLOC_STRUCTS(s, n) nni_alloc(sizeof(*s) * n)
-#define NNI_FREE_STRUCTS(s, n) nni_free(s, sizeof(*s) * n)
+#define NNI_ALLOC_STRUCTS(s, n) nni_alloc(sizeof(*s) * (n))
+#define NNI_FREE_STRUCTS(s, n) nni_free(s, sizeof(*s) * (n))
 
 #define NNI_PUT16(ptr, u)                                   \
 	do {                                                \
@@ -74,6 +74,14 @@ nni_device_cb(void *arg)
 		nni_sock_recv(p->src, aio);
 		break;
 	case NNI_DEVICE_STATE_RECV:
+		// Stale messages are not forwarded.
+		if (nni_msg_expired(nni_aio_get_msg(aio))) {
+			nni_msg_free(nni_aio_get_msg(aio));
+			nni_aio_set_msg(aio, NULL);
+			nni_sock_add_expired(p->src, 1);
+			nni_sock_recv(p->src, aio);
+			break;
+		}
 		// Leave the message where it is.
 		p->state = NNI_DEVICE_STATE_SEND;
 		nni_sock_send(p->dst, aio);
@@ -14,11 +14,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+typedef struct nni_ep_dest nni_ep_dest;
+
 struct nni_ep {
 	nni_tran_ep   ep_ops;  // transport ops
 	nni_tran *    ep_tran; // transport pointer
 	void *        ep_data; // transport private
-	uint64_t      ep_id;   // endpoint id
+	uint32_t      ep_id;   // endpoint id
 	nni_list_node ep_node; // per socket list
 	nni_sock *    ep_sock;
 	nni_url *     ep_url;
@@ -26,7 +28,6 @@ struct nni_ep {
 	int           ep_started;
 	int           ep_closed;  // full shutdown
 	int           ep_closing; // close pending (waiting on refcnt)
-	int           ep_refcnt;
 	int           ep_tmo_run;
 	nni_mtx       ep_mtx;
 	nni_cv        ep_cv;
@@ -39,6 +40,31 @@ struct nni_ep {
 	nni_duration  ep_currtime; // current time for reconnect
 	nni_duration  ep_inirtime; // initial time for reconnect
 	nni_time      ep_conntime; // time of last good connect
+	nni_ep_dest * ep_dest;     // dial scheduling destination
+	nni_list_node ep_dest_node;
+	int           ep_dest_slot; // holds a connect slot on ep_dest
+	int           ep_maxpend;   // limit on connects to ep_dest
+	int           ep_weight;    // load balancing weight of our pipes
+};
+
+// Dial scheduling.  Dialer connection attempts are admitted through a
+// central scheduler, which bounds the number of attempts in progress to
+// any single destination.  Each dialer has its own limit (its socket's
+// NNG_OPT_RECONNMAXPEND), and only starts while fewer attempts than that
+// are in progress.  Dialers that are due to connect while the
+// destination is at their limit wait in a queue, and are started as
+// earlier attempts complete.  Dialers
+// whose sockets have messages waiting to be sent are started ahead of
+// idle ones, so that recovery after an outage favors useful work.
+// All of the dest state is protected by nni_ep_dest_lk.  The lock order
+// is ep_mtx before nni_ep_dest_lk.
+struct nni_ep_dest {
+	nni_list_node d_node;
+	char *        d_url;
+	int           d_refcnt; // dialers using this destination
+	int           d_active; // connection attempts in progress
+	nni_list      d_prio; // waiting dialers with pending sends
+	nni_list      d_wait; // other waiting dialers
 };
 
 // Functionality related to end points.
@@ -50,20 +76,20 @@ static void nni_ep_con_cb(void *);
 static void nni_ep_tmo_start(nni_ep *);
 static void nni_ep_tmo_cb(void *);
 
-static nni_idhash *nni_eps;
-static nni_mtx     nni_ep_lk;
+static nni_handle_table *nni_eps;
+static nni_list          nni_ep_dests;
+static nni_mtx           nni_ep_dest_lk;
 
 int
 nni_ep_sys_init(void)
 {
 	int rv;
 
-	if ((rv = nni_idhash_init(&nni_eps)) != 0) {
+	if ((rv = nni_handle_table_init(&nni_eps)) != 0) {
 		return (rv);
 	}
-	nni_mtx_init(&nni_ep_lk);
-	nni_idhash_set_limits(
-	    nni_eps, 1, 0x7fffffff, nni_random() & 0x7fffffff);
+	nni_mtx_init(&nni_ep_dest_lk);
+	NNI_LIST_INIT(&nni_ep_dests, nni_ep_dest, d_node);
 
 	return (0);
 }
@@ -71,15 +97,72 @@ nni_ep_sys_init(void)
 void
 nni_ep_sys_fini(void)
 {
-	nni_mtx_fini(&nni_ep_lk);
-	nni_idhash_fini(nni_eps);
+	nni_mtx_fini(&nni_ep_dest_lk);
+	nni_handle_table_fini(nni_eps);
 	nni_eps = NULL;
 }
 
 uint32_t
 nni_ep_id(nni_ep *ep)
 {
-	return ((uint32_t) ep->ep_id);
+	return (ep->ep_id);
+}
+
+static int
+nni_ep_dest_hold(nni_ep *ep)
+{
+	nni_ep_dest *d;
+
+	nni_mtx_lock(&nni_ep_dest_lk);
+	NNI_LIST_FOREACH (&nni_ep_dests, d) {
+		if (strcmp(d->d_url, ep->ep_url->u_rawurl) == 0) {
+			break;
+		}
+	}
+	if (d == NULL) {
+		if ((d = NNI_ALLOC_STRUCT(d)) == NULL) {
+			nni_mtx_unlock(&nni_ep_dest_lk);
+			return (NNG_ENOMEM);
+		}
+		if ((d->d_url = nni_strdup(ep->ep_url->u_rawurl)) == NULL) {
+			nni_mtx_unlock(&nni_ep_dest_lk);
+			NNI_FREE_STRUCT(d);
+			return (NNG_ENOMEM);
+		}
+		NNI_LIST_INIT(&d->d_prio, nni_ep, ep_dest_node);
+		NNI_LIST_INIT(&d->d_wait, nni_ep, ep_dest_node);
+		nni_list_append(&nni_ep_dests, d);
+	}
+	d->d_refcnt++;
+	ep->ep_dest = d;
+	nni_mtx_unlock(&nni_ep_dest_lk);
+	return (0);
+}
+
+static void
+nni_ep_dest_rele(nni_ep *ep)
+{
+	nni_ep_dest *d;
+
+	if ((d = ep->ep_dest) == NULL) {
+		return;
+	}
+	nni_mtx_lock(&nni_ep_dest_lk);
+	nni_list_node_remove(&ep->ep_dest_node);
+	if (ep->ep_dest_slot) {
+		// Only possible if the connect was never really started.
+		ep->ep_dest_slot = 0;
+		d->d_active--;
+	}
+	ep->ep_dest = NULL;
+	d->d_refcnt--;
+	if (d->d_refcnt == 0) {
+		NNI_ASSERT(d->d_active == 0);
+		nni_list_remove(&nni_ep_dests, d);
+		nni_strfree(d->d_url);
+		NNI_FREE_STRUCT(d);
+	}
+	nni_mtx_unlock(&nni_ep_dest_lk);
 }
 
 static void
@@ -91,7 +174,7 @@ nni_ep_destroy(nni_ep *ep)
 
 	// Remove us from the table so we cannot be found.
 	if (ep->ep_id != 0) {
-		nni_idhash_remove(nni_eps, ep->ep_id);
+		nni_handle_free(nni_eps, ep->ep_id);
 	}
 
 	nni_sock_ep_remove(ep->ep_sock, ep);
@@ -106,6 +189,8 @@ nni_ep_destroy(nni_ep *ep)
 	nni_aio_fini(ep->ep_con_syn);
 	nni_aio_fini(ep->ep_tmo_aio);
 
+	nni_ep_dest_rele(ep);
+
 	nni_mtx_lock(&ep->ep_mtx);
 	if (ep->ep_data != NULL) {
 		ep->ep_ops.ep_fini(ep->ep_data);
@@ -141,10 +226,10 @@ nni_ep_create(nni_ep **epp, nni_sock *s, const char *urlstr, int mode)
 	ep->ep_closed  = 0;
 	ep->ep_started = 0;
 	ep->ep_data    = NULL;
-	ep->ep_refcnt  = 1;
 	ep->ep_sock    = s;
 	ep->ep_tran    = tran;
 	ep->ep_mode    = mode;
+	ep->ep_weight  = 1;
 
 	// Make a copy of the endpoint operations.  This allows us to
 	// modify them (to override NULLs for example), and avoids an extra
@@ -152,6 +237,7 @@ nni_ep_create(nni_ep **epp, nni_sock *s, const char *urlstr, int mode)
 	ep->ep_ops = *tran->tran_ep;
 
 	NNI_LIST_NODE_INIT(&ep->ep_node);
+	NNI_LIST_NODE_INIT(&ep->ep_dest_node);
 
 	nni_pipe_ep_list_init(&ep->ep_pipes);
 
@@ -163,7 +249,9 @@ nni_ep_create(nni_ep **epp, nni_sock *s, const char *urlstr, int mode)
 	    ((rv = nni_aio_init(&ep->ep_tmo_aio, nni_ep_tmo_cb, ep)) != 0) ||
 	    ((rv = nni_aio_init(&ep->ep_con_syn, NULL, NULL)) != 0) ||
 	    ((rv = ep->ep_ops.ep_init(&ep->ep_data, url, s, mode)) != 0) ||
-	    ((rv = nni_idhash_alloc(nni_eps, &ep->ep_id, ep)) != 0) ||
+	    ((mode == NNI_EP_MODE_DIAL) &&
+	        ((rv = nni_ep_dest_hold(ep)) != 0)) ||
+	    ((rv = nni_handle_alloc(nni_eps, &ep->ep_id, ep, 1)) != 0) ||
 	    ((rv = nni_sock_ep_add(s, ep)) != 0)) {
 		nni_ep_destroy(ep);
 		return (rv);
@@ -195,43 +283,22 @@ nni_ep_find(nni_ep **epp, uint32_t id)
 		return (rv);
 	}
 
-	nni_mtx_lock(&nni_ep_lk);
-	if ((rv = nni_idhash_find(nni_eps, id, (void **) &ep)) == 0) {
-		if (ep->ep_closed) {
-			rv = NNG_ECLOSED;
-		} else {
-			ep->ep_refcnt++;
-			*epp = ep;
-		}
+	if ((rv = nni_handle_find(nni_eps, id, (void **) &ep)) == 0) {
+		*epp = ep;
 	}
-	nni_mtx_unlock(&nni_ep_lk);
 	return (rv);
 }
 
 int
 nni_ep_hold(nni_ep *ep)
 {
-	int rv;
-	nni_mtx_lock(&nni_ep_lk);
-	if (ep->ep_closed) {
-		rv = NNG_ECLOSED;
-	} else {
-		ep->ep_refcnt++;
-		rv = 0;
-	}
-	nni_mtx_unlock(&nni_ep_lk);
-	return (rv);
+	return (nni_handle_find(nni_eps, ep->ep_id, NULL));
 }
 
 void
 nni_ep_rele(nni_ep *ep)
 {
-	nni_mtx_lock(&nni_ep_lk);
-	ep->ep_refcnt--;
-	if (ep->ep_closing) {
-		nni_cv_wake(&ep->ep_cv);
-	}
-	nni_mtx_unlock(&nni_ep_lk);
+	nni_handle_rele(nni_eps, ep->ep_id);
 }
 
 int
@@ -248,6 +315,11 @@ nni_ep_shutdown(nni_ep *ep)
 	ep->ep_closing = 1;
 	nni_mtx_unlock(&ep->ep_mtx);
 
+	// If we were waiting for our turn to connect, give up our place.
+	nni_mtx_lock(&nni_ep_dest_lk);
+	nni_list_node_remove(&ep->ep_dest_node);
+	nni_mtx_unlock(&nni_ep_dest_lk);
+
 	// Abort any remaining in-flight operations.
 	nni_aio_abort(ep->ep_acc_aio, NNG_ECLOSED);
 	nni_aio_abort(ep->ep_con_aio, NNG_ECLOSED);
@@ -272,6 +344,7 @@ nni_ep_close(nni_ep *ep)
 		return;
 	}
 	ep->ep_closed = 1;
+	nni_handle_close(nni_eps, ep->ep_id);
 	nni_mtx_unlock(&ep->ep_mtx);
 
 	nni_ep_shutdown(ep);
@@ -285,11 +358,14 @@ nni_ep_close(nni_ep *ep)
 	NNI_LIST_FOREACH (&ep->ep_pipes, p) {
 		nni_pipe_stop(p);
 	}
-	while ((!nni_list_empty(&ep->ep_pipes)) || (ep->ep_refcnt != 1)) {
+	while (!nni_list_empty(&ep->ep_pipes)) {
 		nni_cv_wait(&ep->ep_cv);
 	}
 	nni_mtx_unlock(&ep->ep_mtx);
 
+	// Wait for any other references to drop; ours is the last one.
+	nni_handle_wait(nni_eps, ep->ep_id, 1);
+
 	nni_ep_destroy(ep);
 }
 
@@ -312,26 +388,36 @@ static void
 nni_ep_tmo_start(nni_ep *ep)
 {
 	nni_duration backoff;
+	nni_duration lo;
+	nni_duration hi;
 
 	if (ep->ep_closing) {
 		return;
 	}
-	backoff = ep->ep_currtime;
-	ep->ep_currtime *= 2;
-	if (ep->ep_currtime > ep->ep_maxrtime) {
-		ep->ep_currtime = ep->ep_maxrtime;
-	}
 
-	// To minimize damage from storms, etc., we select a backoff
-	// value randomly, in the range of [0, backoff-1]; this is
-	// pretty similar to 802 style backoff, except that we have a
-	// nearly uniform time period instead of discrete slot times.
-	// This algorithm may lead to slight biases because we don't
-	// have a statistically perfect distribution with the modulo of
-	// the random number, but this really doesn't matter.
+	// To minimize damage from storms, we use "decorrelated jitter":
+	// each backoff is chosen randomly between the minimum and three
+	// times the previous backoff, capped at the maximum.  Unlike
+	// doubling with a uniform random offset, successive delays for
+	// dialers that failed together quickly drift apart.  The lower
+	// bound is half the minimum, so that there is still a useful
+	// spread when the minimum and maximum are the same (the default).
+	// The modulo introduces a slight bias, which doesn't matter here.
+	lo = ep->ep_inirtime / 2;
+	hi = ep->ep_currtime;
+	if (hi > (ep->ep_maxrtime / 3)) {
+		hi = ep->ep_maxrtime;
+	} else {
+		hi *= 3;
+	}
+	if (hi < lo) {
+		hi = lo;
+	}
+	backoff = lo + (nni_duration)(nni_random() % (uint32_t)(hi - lo + 1));
+	ep->ep_currtime =
+	    (backoff < ep->ep_inirtime) ? ep->ep_inirtime : backoff;
 
-	nni_aio_set_timeout(
-	    ep->ep_tmo_aio, (backoff ? nni_random() % backoff : 0));
+	nni_aio_set_timeout(ep->ep_tmo_aio, backoff);
 
 	ep->ep_tmo_run = 1;
 	if (nni_aio_start(ep->ep_tmo_aio, nni_ep_tmo_cancel, ep) != 0) {
@@ -339,6 +425,107 @@ nni_ep_tmo_start(nni_ep *ep)
 	}
 }
 
+// nni_ep_dest_admit checks whether the endpoint may start a connection
+// attempt now, given its own limit.  Call with nni_ep_dest_lk held.
+static bool
+nni_ep_dest_admit(nni_ep_dest *d, nni_ep *ep)
+{
+	return ((ep->ep_maxpend == 0) || (d->d_active < ep->ep_maxpend));
+}
+
+// nni_ep_dest_next returns the first waiting endpoint, favoring those
+// with pending sends, that may start now.  Call with nni_ep_dest_lk held.
+static nni_ep *
+nni_ep_dest_next(nni_ep_dest *d)
+{
+	nni_ep *ep;
+
+	NNI_LIST_FOREACH (&d->d_prio, ep) {
+		if (nni_ep_dest_admit(d, ep)) {
+			return (ep);
+		}
+	}
+	NNI_LIST_FOREACH (&d->d_wait, ep) {
+		if (nni_ep_dest_admit(d, ep)) {
+			return (ep);
+		}
+	}
+	return (NULL);
+}
+
+// nni_ep_con_sched requests a connection attempt from the dial scheduler.
+// If the destination has room, the attempt starts immediately, otherwise
+// the dialer waits for an earlier attempt to finish.  Call with the
+// endpoint lock held.
+static void
+nni_ep_con_sched(nni_ep *ep)
+{
+	nni_ep_dest *d = ep->ep_dest;
+	nni_msgq *   mq;
+
+	if (ep->ep_closing) {
+		return;
+	}
+
+	nni_mtx_lock(&nni_ep_dest_lk);
+	if (nni_ep_dest_admit(d, ep)) {
+		ep->ep_dest_slot = 1;
+		d->d_active++;
+		nni_mtx_unlock(&nni_ep_dest_lk);
+		nni_ep_con_start(ep);
+		return;
+	}
+	mq = nni_sock_sendq(ep->ep_sock);
+	nni_list_node_remove(&ep->ep_dest_node);
+	if (nni_msgq_len(mq) > 0) {
+		nni_list_append(&d->d_prio, ep);
+	} else {
+		nni_list_append(&d->d_wait, ep);
+	}
+	nni_mtx_unlock(&nni_ep_dest_lk);
+}
+
+// nni_ep_con_done releases the connect slot held by the endpoint, if any,
+// and starts waiting dialers for the same destination in its place.
+// This must be called without the endpoint lock held.
+static void
+nni_ep_con_done(nni_ep *ep)
+{
+	nni_ep_dest *d = ep->ep_dest;
+	nni_ep *     nep;
+
+	nni_mtx_lock(&nni_ep_dest_lk);
+	if (ep->ep_dest_slot) {
+		ep->ep_dest_slot = 0;
+		d->d_active--;
+	}
+	while ((nep = nni_ep_dest_next(d)) != NULL) {
+		nni_list_node_remove(&nep->ep_dest_node);
+		if (nni_ep_hold(nep) != 0) {
+			continue;
+		}
+		nep->ep_dest_slot = 1;
+		d->d_active++;
+		nni_mtx_unlock(&nni_ep_dest_lk);
+
+		nni_mtx_lock(&nep->ep_mtx);
+		if (nep->ep_closing) {
+			nni_mtx_unlock(&nep->ep_mtx);
+			nni_mtx_lock(&nni_ep_dest_lk);
+			nep->ep_dest_slot = 0;
+			d->d_active--;
+			nni_mtx_unlock(&nni_ep_dest_lk);
+		} else {
+			nni_ep_con_start(nep);
+			nni_mtx_unlock(&nep->ep_mtx);
+		}
+		nni_ep_rele(nep);
+
+		nni_mtx_lock(&nni_ep_dest_lk);
+	}
+	nni_mtx_unlock(&nni_ep_dest_lk);
+}
+
 static void
 nni_ep_tmo_cb(void *arg)
 {
@@ -348,7 +535,7 @@ nni_ep_tmo_cb(void *arg)
 	nni_mtx_lock(&ep->ep_mtx);
 	if (nni_aio_result(aio) == NNG_ETIMEDOUT) {
 		if (ep->ep_mode == NNI_EP_MODE_DIAL) {
-			nni_ep_con_start(ep);
+			nni_ep_con_sched(ep);
 		} else {
 			nni_ep_acc_start(ep);
 		}
@@ -366,6 +553,10 @@ nni_ep_con_cb(void *arg)
 	if ((rv = nni_aio_result(aio)) == 0) {
 		rv = nni_pipe_create(ep, nni_aio_get_output(aio, 0));
 	}
+
+	// Whatever the outcome, this attempt is no longer in progress.
+	nni_ep_con_done(ep);
+
 	nni_mtx_lock(&ep->ep_mtx);
 	switch (rv) {
 	case 0:
@@ -414,6 +605,7 @@ nni_ep_dial(nni_ep *ep, int flags)
 
 	nni_sock_reconntimes(ep->ep_sock, &ep->ep_inirtime, &ep->ep_maxrtime);
 	ep->ep_currtime = ep->ep_inirtime;
+	ep->ep_maxpend  = nni_sock_reconnpend(ep->ep_sock);
 
 	nni_mtx_lock(&ep->ep_mtx);
 
@@ -433,7 +625,7 @@ nni_ep_dial(nni_ep *ep, int flags)
 
 	if ((flags & NNG_FLAG_NONBLOCK) != 0) {
 		ep->ep_started = 1;
-		nni_ep_con_start(ep);
+		nni_ep_con_sched(ep);
 		nni_mtx_unlock(&ep->ep_mtx);
 		return (0);
 	}
@@ -588,6 +780,13 @@ nni_ep_setopt(nni_ep *ep, const char *name, const void *val, size_t sz)
 	if (strcmp(name, NNG_OPT_URL) == 0) {
 		return (NNG_EREADONLY);
 	}
+	if (strcmp(name, NNG_OPT_LB_WEIGHT) == 0) {
+		int rv;
+		nni_mtx_lock(&ep->ep_mtx);
+		rv = nni_setopt_int(&ep->ep_weight, val, sz, 1, 1000);
+		nni_mtx_unlock(&ep->ep_mtx);
+		return (rv);
+	}
 
 	for (eo = ep->ep_ops.ep_options; eo && eo->eo_name; eo++) {
 		int rv;
@@ -638,6 +837,9 @@ nni_ep_getopt(nni_ep *ep, const char *name, void *valp, size_t *szp)
 	if (strcmp(name, NNG_OPT_URL) == 0) {
 		return (nni_getopt_str(ep->ep_url->u_rawurl, valp, szp));
 	}
+	if (strcmp(name, NNG_OPT_LB_WEIGHT) == 0) {
+		return (nni_getopt_int(nni_ep_weight(ep), valp, szp));
+	}
 
 	return (nni_sock_getopt(ep->ep_sock, name, valp, szp));
 }
@@ -659,3 +861,14 @@ nni_ep_sock(nni_ep *ep)
 {
 	return (ep->ep_sock);
 }
+
+int
+nni_ep_weight(nni_ep *ep)
+{
+	int weight;
+
+	nni_mtx_lock(&ep->ep_mtx);
+	weight = ep->ep_weight;
+	nni_mtx_unlock(&ep->ep_mtx);
+	return (weight);
+}
@@ -0,0 +1,252 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+
+// An ID is made up of the generation number (upper 10 bits of 31) and
+// the slot index (lower 21 bits).  Index zero is never used, so that IDs
+// are never zero.  The slot state word holds the generation number in
+// its upper 10 bits, followed by the live and closed flags, and then a
+// 20 bit reference count.  Keeping all of this in one 32-bit word lets
+// us check the generation and take a reference in one compare and swap.
+//
+// Slots live in fixed size chunks, which are allocated as needed and
+// not freed until the table is destroyed.  Free slots are reused in
+// FIFO order, which keeps a just freed ID from being handed out again
+// for as long as possible.
+
+#define NNI_HANDLE_IDX_BITS 21
+#define NNI_HANDLE_IDX_MASK ((1u << NNI_HANDLE_IDX_BITS) - 1)
+#define NNI_HANDLE_GEN_MASK 0x3ffu
+#define NNI_HANDLE_GEN_SHIFT 22
+#define NNI_HANDLE_LIVE (1u << 21)
+#define NNI_HANDLE_CLOSED (1u << 20)
+#define NNI_HANDLE_REFS 0xfffffu
+
+#define NNI_HANDLE_CHUNK_BITS 10
+#define NNI_HANDLE_CHUNK (1u << NNI_HANDLE_CHUNK_BITS)
+#define NNI_HANDLE_NCHUNKS \
+	(1u << (NNI_HANDLE_IDX_BITS - NNI_HANDLE_CHUNK_BITS))
+
+typedef struct {
+	uint32_t hs_state;
+	uint32_t hs_next; // free list linkage, protected by ht_mtx
+	void *   hs_ptr;
+} nni_handle_slot;
+
+struct nni_handle_table {
+	nni_mtx          ht_mtx;
+	nni_cv           ht_cv;
+	uint32_t         ht_used; // next never used index
+	uint32_t         ht_head; // free list, oldest first
+	uint32_t         ht_tail;
+	nni_handle_slot *ht_chunks[NNI_HANDLE_NCHUNKS];
+};
+
+int
+nni_handle_table_init(nni_handle_table **tp)
+{
+	nni_handle_table *t;
+
+	if ((t = NNI_ALLOC_STRUCT(t)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	nni_mtx_init(&t->ht_mtx);
+	nni_cv_init(&t->ht_cv, &t->ht_mtx);
+	t->ht_used = 1;
+	t->ht_head = 0;
+	t->ht_tail = 0;
+	*tp        = t;
+	return (0);
+}
+
+void
+nni_handle_table_fini(nni_handle_table *t)
+{
+	if (t == NULL) {
+		return;
+	}
+	for (uint32_t i = 0; i < NNI_HANDLE_NCHUNKS; i++) {
+		if (t->ht_chunks[i] != NULL) {
+			NNI_FREE_STRUCTS(t->ht_chunks[i], NNI_HANDLE_CHUNK);
+		}
+	}
+	nni_cv_fini(&t->ht_cv);
+	nni_mtx_fini(&t->ht_mtx);
+	NNI_FREE_STRUCT(t);
+}
+
+static nni_handle_slot *
+nni_handle_get(nni_handle_table *t, uint32_t id)
+{
+	uint32_t         idx = id & NNI_HANDLE_IDX_MASK;
+	nni_handle_slot *chunk;
+
+	chunk = nni_plat_atomic_load_ptr(
+	    (void **) &t->ht_chunks[idx >> NNI_HANDLE_CHUNK_BITS]);
+	if ((idx == 0) || (chunk == NULL)) {
+		return (NULL);
+	}
+	return (&chunk[idx & (NNI_HANDLE_CHUNK - 1)]);
+}
+
+int
+nni_handle_alloc(nni_handle_table *t, uint32_t *idp, void *ptr, int refs)
+{
+	nni_handle_slot *slot;
+	uint32_t         idx;
+	uint32_t         gen;
+
+	nni_mtx_lock(&t->ht_mtx);
+	if ((idx = t->ht_head) != 0) {
+		slot = nni_handle_get(t, idx);
+		if ((t->ht_head = slot->hs_next) == 0) {
+			t->ht_tail = 0;
+		}
+	} else {
+		nni_handle_slot **chunkp;
+
+		if (t->ht_used > NNI_HANDLE_IDX_MASK) {
+			nni_mtx_unlock(&t->ht_mtx);
+			return (NNG_ENOMEM);
+		}
+		idx    = t->ht_used;
+		chunkp = &t->ht_chunks[idx >> NNI_HANDLE_CHUNK_BITS];
+		if (*chunkp == NULL) {
+			nni_handle_slot *chunk;
+
+			chunk = NNI_ALLOC_STRUCTS(chunk, NNI_HANDLE_CHUNK);
+			if (chunk == NULL) {
+				nni_mtx_unlock(&t->ht_mtx);
+				return (NNG_ENOMEM);
+			}
+			// Random starting generations make IDs less
+			// predictable, and less likely to collide with IDs
+			// from a previous instance of the library.
+			for (uint32_t i = 0; i < NNI_HANDLE_CHUNK; i++) {
+				gen = nni_random() & NNI_HANDLE_GEN_MASK;
+				gen <<= NNI_HANDLE_GEN_SHIFT;
+				chunk[i].hs_state = gen;
+			}
+			nni_plat_atomic_store_ptr((void **) chunkp, chunk);
+		}
+		t->ht_used++;
+		slot = nni_handle_get(t, idx);
+	}
+
+	gen           = slot->hs_state >> NNI_HANDLE_GEN_SHIFT;
+	slot->hs_ptr  = ptr;
+	slot->hs_next = 0;
+	nni_plat_atomic_store32(&slot->hs_state,
+	    (gen << NNI_HANDLE_GEN_SHIFT) | NNI_HANDLE_LIVE | (uint32_t) refs);
+	nni_mtx_unlock(&t->ht_mtx);
+
+	*idp = (gen << NNI_HANDLE_IDX_BITS) | idx;
+	return (0);
+}
+
+int
+nni_handle_find(nni_handle_table *t, uint32_t id, void **ptrp)
+{
+	nni_handle_slot *slot;
+	uint32_t         state;
+
+	if ((slot = nni_handle_get(t, id)) == NULL) {
+		return (NNG_ENOENT);
+	}
+	for (;;) {
+		state = nni_plat_atomic_load32(&slot->hs_state);
+		if (((state & NNI_HANDLE_LIVE) == 0) ||
+		    ((state >> NNI_HANDLE_GEN_SHIFT) !=
+		        (id >> NNI_HANDLE_IDX_BITS))) {
+			return (NNG_ENOENT);
+		}
+		if ((state & NNI_HANDLE_CLOSED) != 0) {
+			return (NNG_ECLOSED);
+		}
+		if ((state & NNI_HANDLE_REFS) == NNI_HANDLE_REFS) {
+			return (NNG_ENOMEM);
+		}
+		if (nni_plat_atomic_cas32(&slot->hs_state, state, state + 1)) {
+			break;
+		}
+	}
+
+	// The pointer cannot change while we hold the reference.
+	if (ptrp != NULL) {
+		*ptrp = slot->hs_ptr;
+	}
+	return (0);
+}
+
+void
+nni_handle_rele(nni_handle_table *t, uint32_t id)
+{
+	nni_handle_slot *slot = nni_handle_get(t, id);
+	uint32_t         state;
+
+	state = nni_plat_atomic_add32(&slot->hs_state, -1);
+	NNI_ASSERT((state & NNI_HANDLE_REFS) != NNI_HANDLE_REFS);
+
+	// Only a closed object can have somebody waiting on it.  Taking
+	// the lock here ensures that the waiter is either asleep, or has
+	// yet to check the count, so the wake up cannot be lost.
+	if ((state & NNI_HANDLE_CLOSED) != 0) {
+		nni_mtx_lock(&t->ht_mtx);
+		nni_cv_wake(&t->ht_cv);
+		nni_mtx_unlock(&t->ht_mtx);
+	}
+}
+
+void
+nni_handle_close(nni_handle_table *t, uint32_t id)
+{
+	nni_handle_slot *slot = nni_handle_get(t, id);
+	uint32_t         state;
+
+	do {
+		state = nni_plat_atomic_load32(&slot->hs_state);
+	} while (!nni_plat_atomic_cas32(
+	    &slot->hs_state, state, state | NNI_HANDLE_CLOSED));
+}
+
+void
+nni_handle_wait(nni_handle_table *t, uint32_t id, int refs)
+{
+	nni_handle_slot *slot = nni_handle_get(t, id);
+
+	nni_mtx_lock(&t->ht_mtx);
+	while ((nni_plat_atomic_load32(&slot->hs_state) & NNI_HANDLE_REFS) >
+	    (uint32_t) refs) {
+		nni_cv_wait(&t->ht_cv);
+	}
+	nni_mtx_unlock(&t->ht_mtx);
+}
+
+void
+nni_handle_free(nni_handle_table *t, uint32_t id)
+{
+	nni_handle_slot *slot = nni_handle_get(t, id);
+	uint32_t         gen;
+
+	nni_mtx_lock(&t->ht_mtx);
+	gen = ((id >> NNI_HANDLE_IDX_BITS) + 1) & NNI_HANDLE_GEN_MASK;
+	nni_plat_atomic_store32(&slot->hs_state, gen << NNI_HANDLE_GEN_SHIFT);
+	slot->hs_ptr  = NULL;
+	slot->hs_next = 0;
+	if (t->ht_tail != 0) {
+		nni_handle_get(t, t->ht_tail)->hs_next =
+		    id & NNI_HANDLE_IDX_MASK;
+	} else {
+		t->ht_head = id & NNI_HANDLE_IDX_MASK;
+	}
+	t->ht_tail = id & NNI_HANDLE_IDX_MASK;
+	nni_mtx_unlock(&t->ht_mtx);
+}
@@ -0,0 +1,57 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef CORE_HANDLE_H
+#define CORE_HANDLE_H
+
+#include "core/defs.h"
+
+// Handle tables map the IDs we give to applications (for sockets,
+// endpoints, and pipes) to the objects they refer to, and also keep
+// the reference counts on those objects.  Lookups and reference counting
+// are lock-free -- each slot has a single atomic word holding a generation
+// number, a few flags, and the reference count.  The generation number is
+// part of the ID too, so that a stale ID does not find a newer object
+// that reuses the slot.  Slots are never freed while the table exists,
+// which makes it safe for a lookup to race against a free.
+//
+// Allocating and freeing IDs, and waiting for references to drain, use
+// a lock.  IDs are always non-zero, and have the high bit clear.
+
+typedef struct nni_handle_table nni_handle_table;
+
+extern int  nni_handle_table_init(nni_handle_table **);
+extern void nni_handle_table_fini(nni_handle_table *);
+
+// nni_handle_alloc allocates a new ID for the object, with the given
+// number of references already held.
+extern int nni_handle_alloc(nni_handle_table *, uint32_t *, void *, int);
+
+// nni_handle_find looks up the object, and takes a reference on it.
+// It returns NNG_ENOENT if the ID is not valid, or NNG_ECLOSED if the
+// object is being closed.  The object pointer may be NULL.
+extern int nni_handle_find(nni_handle_table *, uint32_t, void **);
+
+// nni_handle_rele drops a reference obtained with nni_handle_find (or
+// supplied to nni_handle_alloc).
+extern void nni_handle_rele(nni_handle_table *, uint32_t);
+
+// nni_handle_close marks the object closed, so that further attempts
+// to find it fail with NNG_ECLOSED.  Existing references remain valid.
+extern void nni_handle_close(nni_handle_table *, uint32_t);
+
+// nni_handle_wait waits for the references to drop to the given count.
+// The object should be closed first, or new references can arrive.
+extern void nni_handle_wait(nni_handle_table *, uint32_t, int);
+
+// nni_handle_free releases the ID.  The caller must be the last holder.
+extern void nni_handle_free(nni_handle_table *, uint32_t);
+
+#endif // CORE_HANDLE_H
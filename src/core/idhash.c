@@ -178,7 +178,7 @@ nni_hash_resize(nni_idhash *h)
 		if (oldents[i].ihe_val == NULL) {
 			continue;
 		}
-		index = oldents[i].ihe_key & (newsize - 1);
+		index = NNI_IDHASH_INDEX(h, oldents[i].ihe_key);
 		for (;;) {
 			if (newents[index].ihe_val == NULL) {
 				h->ih_load++;
@@ -18,6 +18,43 @@ static nni_mtx  nni_init_mtx;
 static nni_list nni_init_list;
 static bool     nni_inited = false;
 
+#define NNI_INIT_NUM_PARAMS (NNG_INIT_BUFPOOL_SHARED_CACHE + 1)
+
+static struct {
+	bool     set;
+	uint64_t val;
+} nni_init_params[NNI_INIT_NUM_PARAMS];
+
+void
+nni_init_set_param(nng_init_parameter p, uint64_t val)
+{
+	if (((int) p > 0) && ((int) p < NNI_INIT_NUM_PARAMS)) {
+		nni_init_params[p].set = true;
+		nni_init_params[p].val = val;
+	}
+}
+
+uint64_t
+nni_init_get_param(nng_init_parameter p, uint64_t dflt)
+{
+	if (((int) p > 0) && ((int) p < NNI_INIT_NUM_PARAMS) &&
+	    (nni_init_params[p].set)) {
+		return (nni_init_params[p].val);
+	}
+	return (dflt);
+}
+
+int
+nni_init_set_allocator(const nng_allocator *a)
+{
+	// Memory already handed out must go back to the allocator it came
+	// from, so the hooks can only change while nothing is allocated.
+	if (nni_inited) {
+		return (NNG_EBUSY);
+	}
+	return (nni_alloc_set_hooks(a));
+}
+
 static int
 nni_init_helper(void)
 {
@@ -27,7 +64,8 @@ nni_init_helper(void)
 	NNI_LIST_INIT(&nni_init_list, nni_initializer, i_node);
 	nni_inited = true;
 
-	if (((rv = nni_taskq_sys_init()) != 0) ||
+	if (((rv = nni_bufpool_sys_init()) != 0) ||
+	    ((rv = nni_taskq_sys_init()) != 0) ||
 	    ((rv = nni_reap_sys_init()) != 0) ||
 	    ((rv = nni_timer_sys_init()) != 0) ||
 	    ((rv = nni_aio_sys_init()) != 0) ||
@@ -78,6 +116,7 @@ nni_fini(void)
 	nni_aio_sys_fini();
 	nni_timer_sys_fini();
 	nni_taskq_sys_fini();
+	nni_bufpool_sys_fini(); // last, as the others free messages
 
 	nni_mtx_fini(&nni_init_mtx);
 	nni_plat_fini();
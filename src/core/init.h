@@ -23,6 +23,18 @@ int nni_init(void);
 // that all resources used by the library are released back to the system.
 void nni_fini(void);
 
+// nni_init_set_param records an initialization parameter.  It is only
+// meaningful before the library is initialized.
+void nni_init_set_param(nng_init_parameter, uint64_t);
+
+// nni_init_get_param returns the value of an initialization parameter, or
+// the given default if the application did not set it.
+uint64_t nni_init_get_param(nng_init_parameter, uint64_t);
+
+// nni_init_set_allocator installs the application's allocator hooks.
+// It fails with NNG_EBUSY if the library is already initialized.
+int nni_init_set_allocator(const nng_allocator *);
+
 typedef struct nni_initializer {
 	int (*i_init)(void);  // i_init is called exactly once
 	void (*i_fini)(void); // i_fini is called on shutdown
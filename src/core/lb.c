@@ -0,0 +1,252 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+
+void
+nni_lb_init(nni_lb *lb)
+{
+	NNI_LIST_INIT(&lb->lb_pipes, nni_lb_pipe, lp_node);
+	lb->lb_policy  = NNG_LB_ROUND_ROBIN;
+	lb->lb_hashlen = 0;
+}
+
+void
+nni_lb_add(nni_lb *lb, nni_lb_pipe *lp, void *data, uint32_t id, int weight)
+{
+	lp->lp_data    = data;
+	lp->lp_id      = id;
+	lp->lp_weight  = weight > 0 ? weight : 1;
+	lp->lp_current = 0;
+	lp->lp_ready   = 0;
+	lp->lp_pending = 0;
+	lp->lp_latency = 0;
+	lp->lp_sampled = 0;
+	nni_list_append(&lb->lb_pipes, lp);
+}
+
+void
+nni_lb_remove(nni_lb *lb, nni_lb_pipe *lp)
+{
+	if (nni_list_active(&lb->lb_pipes, lp)) {
+		nni_list_remove(&lb->lb_pipes, lp);
+	}
+}
+
+void
+nni_lb_sample(nni_lb_pipe *lp, nni_duration msec)
+{
+	uint64_t v = (uint64_t)(msec > 0 ? msec : 0) << 4;
+
+	// Exponentially weighted, with alpha of 1/8.
+	if (!lp->lp_sampled) {
+		lp->lp_latency = v;
+		lp->lp_sampled = 1;
+	} else if (v > lp->lp_latency) {
+		lp->lp_latency += (v - lp->lp_latency) / 8;
+	} else {
+		lp->lp_latency -= (lp->lp_latency - v) / 8;
+	}
+}
+
+// Cost used by the two choices policy.  Pipes we have no measurement
+// for yet look cheap, so that they get explored.
+static uint64_t
+nni_lb_cost(nni_lb_pipe *lp)
+{
+	return ((lp->lp_latency + 1) * (lp->lp_pending + 1));
+}
+
+// 64-bit mixer (from SplitMix64), used for rendezvous hashing.
+static uint64_t
+nni_lb_mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return (x);
+}
+
+// Rendezvous (highest random weight) hashing.  Each key goes to the pipe
+// that scores highest for it, so adding or removing a pipe only moves
+// the keys that pipe wins or loses.  The chosen pipe must be ready;
+// we never divert a key elsewhere.
+static nni_lb_pipe *
+nni_lb_choose_hash(nni_lb *lb, nni_msg *msg)
+{
+	nni_lb_pipe *lp;
+	nni_lb_pipe *best = NULL;
+	uint64_t     bestscore = 0;
+	uint64_t     key       = 14695981039346656037ull; // FNV-1a
+	uint8_t *    body      = nni_msg_body(msg);
+	size_t       len       = nni_msg_len(msg);
+
+	if ((lb->lb_hashlen != 0) && (len > lb->lb_hashlen)) {
+		len = lb->lb_hashlen;
+	}
+	for (size_t i = 0; i < len; i++) {
+		key ^= body[i];
+		key *= 1099511628211ull;
+	}
+	NNI_LIST_FOREACH (&lb->lb_pipes, lp) {
+		uint64_t score = nni_lb_mix(key ^ nni_lb_mix(lp->lp_id));
+		if ((best == NULL) || (score > bestscore)) {
+			best      = lp;
+			bestscore = score;
+		}
+	}
+	return (((best != NULL) && best->lp_ready) ? best : NULL);
+}
+
+// Smooth weighted round robin: every ready pipe earns its weight, the
+// richest is chosen and pays the total.  This spreads each pipe's turns
+// out evenly, rather than sending bursts to the heavy ones.
+static nni_lb_pipe *
+nni_lb_choose_weighted(nni_lb *lb)
+{
+	nni_lb_pipe *lp;
+	nni_lb_pipe *best  = NULL;
+	int          total = 0;
+
+	NNI_LIST_FOREACH (&lb->lb_pipes, lp) {
+		if (!lp->lp_ready) {
+			continue;
+		}
+		lp->lp_current += lp->lp_weight;
+		total += lp->lp_weight;
+		if ((best == NULL) || (lp->lp_current > best->lp_current)) {
+			best = lp;
+		}
+	}
+	if (best != NULL) {
+		best->lp_current -= total;
+	}
+	return (best);
+}
+
+static nni_lb_pipe *
+nni_lb_choose_two(nni_lb *lb)
+{
+	nni_lb_pipe *lp;
+	nni_lb_pipe *a = NULL;
+	nni_lb_pipe *b = NULL;
+	uint32_t     r;
+	unsigned     n = 0;
+	unsigned     i;
+	unsigned     j;
+
+	NNI_LIST_FOREACH (&lb->lb_pipes, lp) {
+		if (lp->lp_ready) {
+			n++;
+		}
+	}
+	if (n < 2) {
+		NNI_LIST_FOREACH (&lb->lb_pipes, lp) {
+			if (lp->lp_ready) {
+				return (lp);
+			}
+		}
+		return (NULL);
+	}
+	r = nni_random();
+	i = (r & 0xffff) % n;
+	j = ((r >> 16) % (n - 1));
+	if (j >= i) {
+		j++;
+	}
+	n = 0;
+	NNI_LIST_FOREACH (&lb->lb_pipes, lp) {
+		if (!lp->lp_ready) {
+			continue;
+		}
+		if (n == i) {
+			a = lp;
+		}
+		if (n == j) {
+			b = lp;
+		}
+		n++;
+	}
+	return (nni_lb_cost(b) < nni_lb_cost(a) ? b : a);
+}
+
+void *
+nni_lb_choose(nni_lb *lb, nni_msg *msg)
+{
+	nni_lb_pipe *lp;
+	nni_lb_pipe *best = NULL;
+
+	switch (lb->lb_policy) {
+	case NNG_LB_HASH:
+		best = nni_lb_choose_hash(lb, msg);
+		break;
+	case NNG_LB_WEIGHTED:
+		best = nni_lb_choose_weighted(lb);
+		break;
+	case NNG_LB_TWO_CHOICES:
+		best = nni_lb_choose_two(lb);
+		break;
+	case NNG_LB_LEAST_PENDING:
+		NNI_LIST_FOREACH (&lb->lb_pipes, lp) {
+			if ((!lp->lp_ready) ||
+			    ((best != NULL) &&
+			        (lp->lp_pending >= best->lp_pending))) {
+				continue;
+			}
+			best = lp;
+		}
+		break;
+	default:
+		NNI_LIST_FOREACH (&lb->lb_pipes, lp) {
+			if (lp->lp_ready) {
+				best = lp;
+				break;
+			}
+		}
+		break;
+	}
+	if (best == NULL) {
+		return (NULL);
+	}
+	if ((lb->lb_policy == NNG_LB_ROUND_ROBIN) ||
+	    (lb->lb_policy == NNG_LB_LEAST_PENDING)) {
+		// Rotate, so that ties are broken in round robin order.
+		nni_list_remove(&lb->lb_pipes, best);
+		nni_list_append(&lb->lb_pipes, best);
+	}
+	return (best->lp_data);
+}
+
+int
+nni_lb_setopt_policy(nni_lb *lb, const void *buf, size_t sz)
+{
+	return (nni_setopt_int(
+	    &lb->lb_policy, buf, sz, NNG_LB_ROUND_ROBIN, NNG_LB_HASH));
+}
+
+int
+nni_lb_getopt_policy(nni_lb *lb, void *buf, size_t *szp)
+{
+	return (nni_getopt_int(lb->lb_policy, buf, szp));
+}
+
+int
+nni_lb_setopt_hashlen(nni_lb *lb, const void *buf, size_t sz)
+{
+	return (nni_setopt_size(&lb->lb_hashlen, buf, sz, 0, 65536));
+}
+
+int
+nni_lb_getopt_hashlen(nni_lb *lb, void *buf, size_t *szp)
+{
+	return (nni_getopt_size(lb->lb_hashlen, buf, szp));
+}
@@ -0,0 +1,63 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef CORE_LB_H
+#define CORE_LB_H
+
+#include "core/defs.h"
+#include "core/list.h"
+
+// Load balancing.  Protocols that send each message to just one of their
+// pipes (PUSH, REQ) use this to choose that pipe, according to the policy
+// selected with NNG_OPT_LB_POLICY.  The protocol embeds an nni_lb_pipe in
+// its own per-pipe structure, and keeps lp_ready and lp_pending up to
+// date; it may also feed in latency samples.  None of this is locked;
+// the protocol's socket lock must be held for all of these.
+
+typedef struct nni_lb      nni_lb;
+typedef struct nni_lb_pipe nni_lb_pipe;
+
+struct nni_lb_pipe {
+	nni_list_node lp_node;
+	void *        lp_data;    // the protocol's pipe
+	uint32_t      lp_id;      // pipe id, used for hashing
+	int           lp_weight;  // relative weight
+	int           lp_current; // weighted round robin state
+	int           lp_ready;   // can take a message now
+	unsigned      lp_pending; // messages given, but not yet completed
+	uint64_t      lp_latency; // smoothed latency, msec << 4
+	int           lp_sampled; // lp_latency is valid
+};
+
+struct nni_lb {
+	nni_list lb_pipes;
+	int      lb_policy;
+	size_t   lb_hashlen;
+};
+
+extern void nni_lb_init(nni_lb *);
+extern void nni_lb_add(nni_lb *, nni_lb_pipe *, void *, uint32_t, int);
+extern void nni_lb_remove(nni_lb *, nni_lb_pipe *);
+
+// nni_lb_choose returns the protocol pipe (lp_data) that should get the
+// message, or NULL if none can take it now.  In that case the protocol
+// should try again when a pipe becomes ready.  Note that with NNG_LB_HASH
+// this can happen even when other pipes are ready.
+extern void *nni_lb_choose(nni_lb *, nni_msg *);
+
+// nni_lb_sample feeds a latency measurement (msec) for the pipe.
+extern void nni_lb_sample(nni_lb_pipe *, nni_duration);
+
+extern int nni_lb_setopt_policy(nni_lb *, const void *, size_t);
+extern int nni_lb_getopt_policy(nni_lb *, void *, size_t *);
+extern int nni_lb_setopt_hashlen(nni_lb *, const void *, size_t);
+extern int nni_lb_getopt_hashlen(nni_lb *, void *, size_t *);
+
+#endif // CORE_LB_H
@@ -15,21 +15,37 @@
 
 // Message API.
 
+// NNG_MSG_INLINE_SIZE is the largest body that is stored in the same
+// allocation as the message itself.  Such messages, together with their
+// header space, cost a single allocation; a body that grows beyond the
+// inline space is moved to a separate buffer.
+#ifndef NNG_MSG_INLINE_SIZE
+#define NNG_MSG_INLINE_SIZE 256
+#endif
+
+// Header space, and the head and tail room given to small bodies.
+#define NNI_MSG_HEADER_SIZE 64
+#define NNI_MSG_ROOM 32
+
 // Message chunk, internal to the message implementation.
 typedef struct {
-	size_t   ch_cap; // allocated size
-	size_t   ch_len; // length in use
-	uint8_t *ch_buf; // underlying buffer
-	uint8_t *ch_ptr; // pointer to actual data
+	size_t   ch_cap;    // allocated size
+	size_t   ch_len;    // length in use
+	uint8_t *ch_buf;    // underlying buffer
+	uint8_t *ch_ptr;    // pointer to actual data
+	bool     ch_inline; // buffer is part of the message allocation
+	void (*ch_free)(void *, size_t); // releases a borrowed buffer
 } nni_chunk;
 
-// Underlying message structure.
+// Underlying message structure.  The inline storage for the header,
+// and possibly the body, follows this in the same allocation.
 struct nng_msg {
 	nni_chunk m_header;
 	nni_chunk m_body;
-	nni_time  m_expire; // usec
+	nni_time  m_expire; // deadline, zero if none
 	nni_list  m_options;
 	uint32_t  m_pipe; // set on receive
+	size_t    m_size; // allocated size, including inline storage
 };
 
 typedef struct {
@@ -89,6 +105,43 @@ nni_msg_dump(const char *banner, const nni_msg *msg)
 }
 #endif
 
+// nni_chunk_release frees the buffer backing a chunk, unless it is
+// part of the message allocation.  The chunk fields are left alone.
+static void
+nni_chunk_release(nni_chunk *ch)
+{
+	if ((!ch->ch_inline) && (ch->ch_cap != 0) && (ch->ch_buf != NULL)) {
+		nni_buf_free(ch->ch_buf, ch->ch_cap);
+	}
+	ch->ch_inline = false;
+}
+
+// nni_chunk_own replaces a borrowed buffer, which cannot be resized,
+// with a private copy of the data, so that the chunk can grow.
+static int
+nni_chunk_own(nni_chunk *ch)
+{
+	uint8_t *newbuf = NULL;
+	size_t   cap    = 0;
+
+	if (ch->ch_free == NULL) {
+		return (0);
+	}
+	if ((ch->ch_len != 0) &&
+	    ((newbuf = nni_buf_alloc(ch->ch_len, &cap)) == NULL)) {
+		return (NNG_ENOMEM);
+	}
+	if (ch->ch_len != 0) {
+		memcpy(newbuf, ch->ch_ptr, ch->ch_len);
+	}
+	ch->ch_free(ch->ch_buf, ch->ch_cap);
+	ch->ch_free = NULL;
+	ch->ch_buf  = newbuf;
+	ch->ch_ptr  = newbuf;
+	ch->ch_cap  = cap;
+	return (0);
+}
+
 // nni_chunk_grow increases the underlying space for a chunk.  It ensures
 // that the desired amount of trailing space (including the length)
 // and headroom (excluding the length) are available.  It also copies
@@ -104,6 +157,12 @@ nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 {
 	size_t   headroom = 0;
 	uint8_t *newbuf;
+	size_t   cap;
+	int      rv;
+
+	if ((rv = nni_chunk_own(ch)) != 0) {
+		return (rv);
+	}
 
 	// We assume that if the pointer is a valid pointer, and inside
 	// the backing store, then the entire data length fits.  In this
@@ -125,7 +184,7 @@ nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 		if (headwanted < headroom) {
 			headwanted = headroom; // Never shrink this.
 		}
-		if (((newsz + headwanted) < ch->ch_cap) &&
+		if (((newsz + headwanted) <= ch->ch_cap) &&
 		    (headwanted <= headroom)) {
 			// We have enough space at the ends already.
 			return (0);
@@ -137,27 +196,29 @@ nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 			newsz = ch->ch_cap - headroom;
 		}
 
-		if ((newbuf = nni_alloc(newsz + headwanted)) == NULL) {
+		if ((newbuf = nni_buf_alloc(newsz + headwanted, &cap)) ==
+		    NULL) {
 			return (NNG_ENOMEM);
 		}
 		// Copy all the data, but not header or trailer.
 		memcpy(newbuf + headwanted, ch->ch_ptr, ch->ch_len);
-		nni_free(ch->ch_buf, ch->ch_cap);
+		nni_chunk_release(ch);
 		ch->ch_buf = newbuf;
 		ch->ch_ptr = newbuf + headwanted;
-		ch->ch_cap = newsz + headwanted;
+		ch->ch_cap = cap;
 		return (0);
 	}
 
 	// We either don't have a data pointer yet, or it doesn't reference
 	// the backing store.  In this case, we just check against the
 	// allocated capacity and grow, or don't grow.
-	if ((newsz + headwanted) >= ch->ch_cap) {
-		if ((newbuf = nni_alloc(newsz + headwanted)) == NULL) {
+	if ((newsz + headwanted) > ch->ch_cap) {
+		if ((newbuf = nni_buf_alloc(newsz + headwanted, &cap)) ==
+		    NULL) {
 			return (NNG_ENOMEM);
 		}
-		nni_free(ch->ch_buf, ch->ch_cap);
-		ch->ch_cap = newsz + headwanted;
+		nni_chunk_release(ch);
+		ch->ch_cap = cap;
 		ch->ch_buf = newbuf;
 	}
 
@@ -168,8 +229,11 @@ nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 static void
 nni_chunk_free(nni_chunk *ch)
 {
-	if ((ch->ch_cap != 0) && (ch->ch_buf != NULL)) {
-		nni_free(ch->ch_buf, ch->ch_cap);
+	if (ch->ch_free != NULL) {
+		ch->ch_free(ch->ch_buf, ch->ch_cap);
+		ch->ch_free = NULL;
+	} else {
+		nni_chunk_release(ch);
 	}
 	ch->ch_ptr = NULL;
 	ch->ch_buf = NULL;
@@ -210,22 +274,6 @@ nni_chunk_trim(nni_chunk *ch, size_t len)
 	return (0);
 }
 
-// nni_chunk_dup allocates storage for a new chunk, and copies
-// the contents of the source to the destination.  The new chunk will
-// have the same size, headroom, and capacity as the original.
-static int
-nni_chunk_dup(nni_chunk *dst, const nni_chunk *src)
-{
-	if ((dst->ch_buf = nni_alloc(src->ch_cap)) == NULL) {
-		return (NNG_ENOMEM);
-	}
-	dst->ch_cap = src->ch_cap;
-	dst->ch_len = src->ch_len;
-	dst->ch_ptr = dst->ch_buf + (src->ch_ptr - src->ch_buf);
-	memcpy(dst->ch_ptr, src->ch_ptr, dst->ch_len);
-	return (0);
-}
-
 // nni_chunk_append appends the data to the chunk, growing as necessary.
 // If the data pointer is NULL, then the chunk data region is allocated,
 // but uninitialized.
@@ -258,6 +306,9 @@ nni_chunk_insert(nni_chunk *ch, const void *data, size_t len)
 {
 	int rv;
 
+	if ((rv = nni_chunk_own(ch)) != 0) {
+		return (rv);
+	}
 	if (ch->ch_ptr == NULL) {
 		ch->ch_ptr = ch->ch_buf;
 	}
@@ -322,21 +373,66 @@ nni_chunk_chop_u32(nni_chunk *ch)
 	return (v);
 }
 
+// nni_msg_create allocates a message, with inline space for the header
+// and at least bodycap bytes of inline space for the body.  (Any slack
+// left by rounding up the allocation goes to the body.)  If bodycap is
+// zero, the body has no storage yet.
+static nni_msg *
+nni_msg_create(size_t bodycap)
+{
+	nni_msg *m;
+	uint8_t *buf;
+	size_t   size = sizeof(*m) + NNI_MSG_HEADER_SIZE + bodycap;
+	size_t   cap;
+
+	if ((m = nni_buf_alloc(size, &cap)) == NULL) {
+		return (NULL);
+	}
+	memset(m, 0, sizeof(*m));
+	m->m_size = cap;
+	buf       = (uint8_t *) (m + 1);
+	if (bodycap != 0) {
+		bodycap += cap - size;
+	}
+
+	// Header space is split evenly between head and tail room.
+	m->m_header.ch_buf    = buf;
+	m->m_header.ch_ptr    = buf + (NNI_MSG_HEADER_SIZE / 2);
+	m->m_header.ch_cap    = NNI_MSG_HEADER_SIZE;
+	m->m_header.ch_inline = true;
+
+	if (bodycap != 0) {
+		buf += NNI_MSG_HEADER_SIZE;
+		m->m_body.ch_buf    = buf;
+		m->m_body.ch_ptr    = buf + NNI_MSG_ROOM;
+		m->m_body.ch_cap    = bodycap;
+		m->m_body.ch_inline = true;
+	}
+
+	NNI_LIST_INIT(&m->m_options, nni_msgopt, mo_node);
+	return (m);
+}
+
 int
 nni_msg_alloc(nni_msg **mp, size_t sz)
 {
 	nni_msg *m;
 	int      rv;
 
-	if ((m = NNI_ALLOC_STRUCT(m)) == NULL) {
-		return (NNG_ENOMEM);
+	// Small messages get the whole inline space, not just what they
+	// need now, so that building one up by appending stays inline.
+	if (sz <= NNG_MSG_INLINE_SIZE) {
+		m = nni_msg_create(NNG_MSG_INLINE_SIZE + 2 * NNI_MSG_ROOM);
+		if (m == NULL) {
+			return (NNG_ENOMEM);
+		}
+		m->m_body.ch_len = sz;
+		*mp              = m;
+		return (0);
 	}
 
-	// 64-bytes of header, including room for 32 bytes
-	// of headroom and 32 bytes of trailer.
-	if ((rv = nni_chunk_grow(&m->m_header, 32, 32)) != 0) {
-		NNI_FREE_STRUCT(m);
-		return (rv);
+	if ((m = nni_msg_create(0)) == NULL) {
+		return (NNG_ENOMEM);
 	}
 
 	// If the message is less than 1024 bytes, or is not power
@@ -345,24 +441,50 @@ nni_msg_alloc(nni_msg **mp, size_t sz)
 	// amount of space at the end for the same reason.  Large aligned
 	// allocations are unmolested to avoid excessive overallocation.
 	if ((sz < 1024) || ((sz & (sz - 1)) != 0)) {
-		rv = nni_chunk_grow(&m->m_body, sz + 32, 32);
+		rv = nni_chunk_grow(
+		    &m->m_body, sz + NNI_MSG_ROOM, NNI_MSG_ROOM);
 	} else {
 		rv = nni_chunk_grow(&m->m_body, sz, 0);
 	}
 	if (rv != 0) {
-		nni_chunk_free(&m->m_header);
-		NNI_FREE_STRUCT(m);
+		nni_msg_free(m);
+		return (rv);
 	}
 	if ((rv = nni_chunk_append(&m->m_body, NULL, sz)) != 0) {
 		// Should not happen since we just grew it to fit.
 		nni_panic("chunk_append failed");
 	}
 
-	NNI_LIST_INIT(&m->m_options, nni_msgopt, mo_node);
 	*mp = m;
 	return (0);
 }
 
+// nni_msg_alloc_ext allocates a message whose body is an existing buffer,
+// rather than a copy of it.  The buffer is treated as read-only; the first
+// attempt to grow or prepend to the body replaces it with a private copy.
+// The buffer is released by calling fn when no longer referenced.
+int
+nni_msg_alloc_ext(
+    nni_msg **mp, void *buf, size_t sz, void (*fn)(void *, size_t))
+{
+	nni_msg *m;
+
+	if ((m = nni_msg_create(0)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	m->m_body.ch_buf  = buf;
+	m->m_body.ch_ptr  = buf;
+	m->m_body.ch_cap  = sz;
+	m->m_body.ch_len  = sz;
+	m->m_body.ch_free = fn;
+
+	*mp = m;
+	return (0);
+}
+
+// nni_msg_dup copies the header and body of a message.  The copy is laid
+// out as a fresh message of the same size would be, so a small copy is
+// a single allocation, even if the original has spilled.
 int
 nni_msg_dup(nni_msg **dup, const nni_msg *src)
 {
@@ -371,19 +493,16 @@ nni_msg_dup(nni_msg **dup, const nni_msg *src)
 	nni_msgopt *newmo;
 	int         rv;
 
-	if ((m = NNI_ALLOC_STRUCT(m)) == NULL) {
-		return (NNG_ENOMEM);
-	}
-	memset(m, 0, sizeof(*m));
-	NNI_LIST_INIT(&m->m_options, nni_msgopt, mo_node);
-
-	if ((rv = nni_chunk_dup(&m->m_header, &src->m_header)) != 0) {
-		NNI_FREE_STRUCT(m);
+	if ((rv = nni_msg_alloc(&m, src->m_body.ch_len)) != 0) {
 		return (rv);
 	}
-	if ((rv = nni_chunk_dup(&m->m_body, &src->m_body)) != 0) {
-		nni_chunk_free(&m->m_header);
-		NNI_FREE_STRUCT(m);
+	if (src->m_body.ch_len != 0) {
+		memcpy(m->m_body.ch_ptr, src->m_body.ch_ptr,
+		    src->m_body.ch_len);
+	}
+	if ((rv = nni_chunk_append(&m->m_header, src->m_header.ch_ptr,
+	         src->m_header.ch_len)) != 0) {
+		nni_msg_free(m);
 		return (rv);
 	}
 
@@ -399,6 +518,7 @@ nni_msg_dup(nni_msg **dup, const nni_msg *src)
 		memcpy(newmo->mo_val, mo->mo_val, mo->mo_sz);
 		nni_list_append(&m->m_options, newmo);
 	}
+	m->m_expire = src->m_expire;
 
 	*dup = m;
 	return (0);
@@ -416,7 +536,7 @@ nni_msg_free(nni_msg *m)
 			nni_list_remove(&m->m_options, mo);
 			nni_free(mo, sizeof(*mo) + mo->mo_sz);
 		}
-		NNI_FREE_STRUCT(m);
+		nni_buf_free(m, m->m_size);
 	}
 }
 
@@ -629,4 +749,23 @@ uint32_t
 nni_msg_get_pipe(const nni_msg *m)
 {
 	return (m->m_pipe);
+}
+
+void
+nni_msg_set_expire(nni_msg *m, nni_time expire)
+{
+	m->m_expire = expire;
+}
+
+nni_time
+nni_msg_get_expire(const nni_msg *m)
+{
+	return (m->m_expire);
+}
+
+bool
+nni_msg_expired(const nni_msg *m)
+{
+	// Only messages with a deadline pay for reading the clock.
+	return ((m->m_expire != 0) && (nni_clock() >= m->m_expire));
 }
\ No newline at end of file
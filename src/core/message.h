@@ -46,4 +46,17 @@ extern uint32_t nni_msg_header_chop_u32(nni_msg *);
 extern void     nni_msg_set_pipe(nni_msg *, uint32_t);
 extern uint32_t nni_msg_get_pipe(const nni_msg *);
 
+// nni_msg_set_expire sets the time after which the message is stale,
+// and should be dropped rather than delivered.  Zero means never.
+// nni_msg_expired checks this against the clock.
+extern void     nni_msg_set_expire(nni_msg *, nni_time);
+extern nni_time nni_msg_get_expire(const nni_msg *);
+extern bool     nni_msg_expired(const nni_msg *);
+
+// nni_msg_alloc_ext creates a message whose body borrows the given
+// buffer; the function is called to release it.  The body may be
+// modified in place, but is copied before it is resized.
+extern int nni_msg_alloc_ext(
+    nni_msg **, void *, size_t, void (*)(void *, size_t));
+
 #endif // CORE_SOCKET_H
@@ -14,6 +14,13 @@
 // but as we have access to the internals, we have made some fundamental
 // differences and improvements.  For example, these can grow, and either
 // side can close, and they may be closed more than once.
+//
+// Besides the limit on the number of messages, a queue may be limited by
+// the bytes it holds (header and body).  A message that does not fit is
+// treated just as if the queue were full: writers wait, or in best effort
+// mode, the message is dropped.  An empty queue always accepts one
+// message, however large, so that a message bigger than the limit cannot
+// wedge the queue forever.
 
 struct nni_msgq {
 	nni_mtx   mq_lock;
@@ -28,6 +35,8 @@ struct nni_msgq {
 	int       mq_geterr;
 	int       mq_draining;
 	int       mq_besteffort;
+	size_t    mq_bytes;    // bytes of messages queued
+	size_t    mq_maxbytes; // zero for no limit
 	nni_msg **mq_msgs;
 
 	nni_list mq_aio_putq;
@@ -42,8 +51,54 @@ struct nni_msgq {
 	// Filters.
 	nni_msgq_filter mq_filter_fn;
 	void *          mq_filter_arg;
+
+	// Socket that expired messages are counted against.
+	nni_sock *mq_sock;
 };
 
+static size_t
+nni_msgq_msgsize(nni_msg *msg)
+{
+	return (nni_msg_len(msg) + nni_msg_header_len(msg));
+}
+
+// nni_msgq_room returns true if the message can be queued.
+static bool
+nni_msgq_room(nni_msgq *mq, nni_msg *msg)
+{
+	if (mq->mq_len >= mq->mq_cap) {
+		return (false);
+	}
+	if ((mq->mq_maxbytes == 0) || (mq->mq_len == 0)) {
+		return (true);
+	}
+	return (mq->mq_bytes + nni_msgq_msgsize(msg) <= mq->mq_maxbytes);
+}
+
+static void
+nni_msgq_push(nni_msgq *mq, nni_msg *msg)
+{
+	mq->mq_msgs[mq->mq_put++] = msg;
+	if (mq->mq_put == mq->mq_alloc) {
+		mq->mq_put = 0;
+	}
+	mq->mq_len++;
+	mq->mq_bytes += nni_msgq_msgsize(msg);
+}
+
+static nni_msg *
+nni_msgq_pop(nni_msgq *mq)
+{
+	nni_msg *msg = mq->mq_msgs[mq->mq_get++];
+
+	if (mq->mq_get == mq->mq_alloc) {
+		mq->mq_get = 0;
+	}
+	mq->mq_len--;
+	mq->mq_bytes -= nni_msgq_msgsize(msg);
+	return (msg);
+}
+
 int
 nni_msgq_init(nni_msgq **mqp, unsigned cap)
 {
@@ -79,6 +134,8 @@ nni_msgq_init(nni_msgq **mqp, unsigned cap)
 	mq->mq_puterr   = 0;
 	mq->mq_geterr   = 0;
 	mq->mq_draining = 0;
+	mq->mq_bytes    = 0;
+	mq->mq_maxbytes = 0;
 	*mqp            = mq;
 
 	return (0);
@@ -87,8 +144,6 @@ nni_msgq_init(nni_msgq **mqp, unsigned cap)
 void
 nni_msgq_fini(nni_msgq *mq)
 {
-	nni_msg *msg;
-
 	if (mq == NULL) {
 		return;
 	}
@@ -97,13 +152,7 @@ nni_msgq_fini(nni_msgq *mq)
 
 	/* Free any orphaned messages. */
 	while (mq->mq_len > 0) {
-		msg = mq->mq_msgs[mq->mq_get];
-		mq->mq_get++;
-		if (mq->mq_get >= mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
-		nni_msg_free(msg);
+		nni_msg_free(nni_msgq_pop(mq));
 	}
 
 	nni_free(mq->mq_msgs, mq->mq_alloc * sizeof(nng_msg *));
@@ -170,6 +219,39 @@ nni_msgq_set_filter(nni_msgq *mq, nni_msgq_filter filter, void *arg)
 	mq->mq_filter_arg = arg;
 }
 
+void
+nni_msgq_set_sock(nni_msgq *mq, nni_sock *sock)
+{
+	mq->mq_sock = sock;
+}
+
+// nni_msgq_expired frees the message, and returns true, if its deadline
+// has passed.  It is called with the lock held, on every message about
+// to be handed to a reader.
+static bool
+nni_msgq_expired(nni_msgq *mq, nni_msg *msg)
+{
+	if (!nni_msg_expired(msg)) {
+		return (false);
+	}
+	nni_msg_free(msg);
+	if (mq->mq_sock != NULL) {
+		nni_sock_add_expired(mq->mq_sock, 1);
+	}
+	return (true);
+}
+
+// nni_msgq_prune drops expired messages from the head of a full queue,
+// so that stale messages do not hold back fresh ones.  Lock held.
+static void
+nni_msgq_prune(nni_msgq *mq)
+{
+	while ((mq->mq_len != 0) &&
+	    nni_msg_expired(mq->mq_msgs[mq->mq_get])) {
+		(void) nni_msgq_expired(mq, nni_msgq_pop(mq));
+	}
+}
+
 static void
 nni_msgq_run_putq(nni_msgq *mq)
 {
@@ -190,7 +272,9 @@ nni_msgq_run_putq(nni_msgq *mq)
 			nni_aio_set_msg(waio, NULL);
 			nni_aio_list_remove(waio);
 
-			if (mq->mq_filter_fn != NULL) {
+			if (nni_msgq_expired(mq, msg)) {
+				msg = NULL;
+			} else if (mq->mq_filter_fn != NULL) {
 				msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
 			}
 			if (msg != NULL) {
@@ -203,13 +287,12 @@ nni_msgq_run_putq(nni_msgq *mq)
 		}
 
 		// Otherwise if we have room in the buffer, just queue it.
-		if (mq->mq_len < mq->mq_cap) {
+		if (!nni_msgq_room(mq, msg)) {
+			nni_msgq_prune(mq);
+		}
+		if (nni_msgq_room(mq, msg)) {
 			nni_list_remove(&mq->mq_aio_putq, waio);
-			mq->mq_msgs[mq->mq_put++] = msg;
-			if (mq->mq_put == mq->mq_alloc) {
-				mq->mq_put = 0;
-			}
-			mq->mq_len++;
+			nni_msgq_push(mq, msg);
 			nni_aio_set_msg(waio, NULL);
 			nni_aio_finish(waio, 0, len);
 			continue;
@@ -250,13 +333,11 @@ nni_msgq_run_getq(nni_msgq *mq)
 	while ((raio = nni_list_first(&mq->mq_aio_getq)) != NULL) {
 		// If anything is waiting in the queue, get it first.
 		if (mq->mq_len != 0) {
-			nni_msg *msg = mq->mq_msgs[mq->mq_get++];
-			if (mq->mq_get == mq->mq_alloc) {
-				mq->mq_get = 0;
-			}
-			mq->mq_len--;
+			nni_msg *msg = nni_msgq_pop(mq);
 
-			if (mq->mq_filter_fn != NULL) {
+			if (nni_msgq_expired(mq, msg)) {
+				msg = NULL;
+			} else if (mq->mq_filter_fn != NULL) {
 				msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
 			}
 			if (msg != NULL) {
@@ -276,7 +357,9 @@ nni_msgq_run_getq(nni_msgq *mq)
 			nni_aio_set_msg(waio, NULL);
 			nni_aio_list_remove(waio);
 
-			if (mq->mq_filter_fn != NULL) {
+			if (nni_msgq_expired(mq, msg)) {
+				msg = NULL;
+			} else if (mq->mq_filter_fn != NULL) {
 				msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
 			}
 			if (msg != NULL) {
@@ -298,18 +381,20 @@ static void
 nni_msgq_run_notify(nni_msgq *mq)
 {
 	if (mq->mq_cb_fn != NULL) {
-		int flags = 0;
+		int  flags = 0;
+		bool full = (mq->mq_len >= mq->mq_cap) ||
+		    ((mq->mq_maxbytes != 0) && (mq->mq_len != 0) &&
+		        (mq->mq_bytes >= mq->mq_maxbytes));
 
 		if (mq->mq_closed) {
 			flags |= nni_msgq_f_closed;
 		}
 		if (mq->mq_len == 0) {
 			flags |= nni_msgq_f_empty;
-		} else if (mq->mq_len == mq->mq_cap) {
+		} else if (full) {
 			flags |= nni_msgq_f_full;
 		}
-		if (mq->mq_len < mq->mq_cap ||
-		    !nni_list_empty(&mq->mq_aio_getq)) {
+		if ((!full) || !nni_list_empty(&mq->mq_aio_getq)) {
 			flags |= nni_msgq_f_can_put;
 		}
 		if ((mq->mq_len != 0) || !nni_list_empty(&mq->mq_aio_putq)) {
@@ -395,6 +480,8 @@ nni_msgq_aio_get(nni_msgq *mq, nni_aio *aio)
 
 	nni_aio_list_append(&mq->mq_aio_getq, aio);
 	nni_msgq_run_getq(mq);
+	// Taking messages out may have made room for waiting writers.
+	nni_msgq_run_putq(mq);
 	nni_msgq_run_notify(mq);
 
 	nni_mtx_unlock(&mq->mq_lock);
@@ -415,20 +502,20 @@ nni_msgq_tryput(nni_msgq *mq, nni_msg *msg)
 	// the queue is empty, otherwise it would have just taken
 	// data from the queue.
 	if ((raio = nni_list_first(&mq->mq_aio_getq)) != NULL) {
-		nni_list_remove(&mq->mq_aio_getq, raio);
-
-		nni_aio_finish_msg(raio, msg);
+		if (!nni_msgq_expired(mq, msg)) {
+			nni_list_remove(&mq->mq_aio_getq, raio);
+			nni_aio_finish_msg(raio, msg);
+		}
 		nni_mtx_unlock(&mq->mq_lock);
 		return (0);
 	}
 
 	// Otherwise if we have room in the buffer, just queue it.
-	if (mq->mq_len < mq->mq_cap) {
-		mq->mq_msgs[mq->mq_put++] = msg;
-		if (mq->mq_put == mq->mq_alloc) {
-			mq->mq_put = 0;
-		}
-		mq->mq_len++;
+	if (!nni_msgq_room(mq, msg)) {
+		nni_msgq_prune(mq);
+	}
+	if (nni_msgq_room(mq, msg)) {
+		nni_msgq_push(mq, msg);
 		nni_mtx_unlock(&mq->mq_lock);
 		return (0);
 	}
@@ -437,6 +524,95 @@ nni_msgq_tryput(nni_msgq *mq, nni_msg *msg)
 	return (NNG_EAGAIN);
 }
 
+size_t
+nni_msgq_putv(nni_msgq *mq, nni_msg **msgv, size_t n)
+{
+	nni_aio *raio;
+	nni_msg *msg;
+	size_t   i;
+
+	nni_mtx_lock(&mq->mq_lock);
+	// Errors, and writers already waiting, are left to the ordinary
+	// path, which reports the former and preserves order for the latter.
+	if (mq->mq_closed || (mq->mq_puterr != 0) ||
+	    !nni_list_empty(&mq->mq_aio_putq)) {
+		nni_mtx_unlock(&mq->mq_lock);
+		return (0);
+	}
+	for (i = 0; i < n; i++) {
+		msg = msgv[i];
+		if ((raio = nni_list_first(&mq->mq_aio_getq)) != NULL) {
+			if (nni_msgq_expired(mq, msg)) {
+				msg = NULL;
+			} else if (mq->mq_filter_fn != NULL) {
+				msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
+			}
+			if (msg != NULL) {
+				nni_aio_list_remove(raio);
+				nni_aio_finish_msg(raio, msg);
+			}
+			continue;
+		}
+		if (!nni_msgq_room(mq, msg)) {
+			nni_msgq_prune(mq);
+		}
+		if (nni_msgq_room(mq, msg)) {
+			nni_msgq_push(mq, msg);
+			continue;
+		}
+		if (mq->mq_besteffort) {
+			nni_msg_free(msg);
+			continue;
+		}
+		break;
+	}
+	nni_msgq_run_notify(mq);
+	nni_mtx_unlock(&mq->mq_lock);
+	return (i);
+}
+
+size_t
+nni_msgq_getv(nni_msgq *mq, nni_msg **msgv, size_t n)
+{
+	nni_aio *waio;
+	nni_msg *msg;
+	size_t   cnt = 0;
+
+	nni_mtx_lock(&mq->mq_lock);
+	// Readers already waiting are served first, by the ordinary path.
+	if (mq->mq_closed || (mq->mq_geterr != 0) ||
+	    !nni_list_empty(&mq->mq_aio_getq)) {
+		nni_mtx_unlock(&mq->mq_lock);
+		return (0);
+	}
+	while (cnt < n) {
+		if (mq->mq_len != 0) {
+			msg = nni_msgq_pop(mq);
+		} else if ((waio = nni_list_first(&mq->mq_aio_putq)) != NULL) {
+			// Unbuffered, take it straight from the writer.
+			msg = nni_aio_get_msg(waio);
+			nni_aio_set_msg(waio, NULL);
+			nni_aio_list_remove(waio);
+			nni_aio_finish(waio, 0, nni_msg_len(msg));
+		} else {
+			break;
+		}
+		if (nni_msgq_expired(mq, msg)) {
+			continue;
+		}
+		if (mq->mq_filter_fn != NULL) {
+			msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
+		}
+		if (msg != NULL) {
+			msgv[cnt++] = msg;
+		}
+	}
+	nni_msgq_run_putq(mq);
+	nni_msgq_run_notify(mq);
+	nni_mtx_unlock(&mq->mq_lock);
+	return (cnt);
+}
+
 void
 nni_msgq_drain(nni_msgq *mq, nni_time expire)
 {
@@ -461,12 +637,7 @@ nni_msgq_drain(nni_msgq *mq, nni_time expire)
 
 	// Free any remaining messages in the queue.
 	while (mq->mq_len > 0) {
-		nni_msg *msg = mq->mq_msgs[mq->mq_get++];
-		if (mq->mq_get >= mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
-		nni_msg_free(msg);
+		nni_msg_free(nni_msgq_pop(mq));
 	}
 	nni_mtx_unlock(&mq->mq_lock);
 }
@@ -481,12 +652,7 @@ nni_msgq_close(nni_msgq *mq)
 
 	// Free the messages orphaned in the queue.
 	while (mq->mq_len > 0) {
-		nni_msg *msg = mq->mq_msgs[mq->mq_get++];
-		if (mq->mq_get >= mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
-		nni_msg_free(msg);
+		nni_msg_free(nni_msgq_pop(mq));
 	}
 
 	// Let all pending blockers know we are closing the queue.
@@ -525,7 +691,6 @@ int
 nni_msgq_resize(nni_msgq *mq, int cap)
 {
 	int       alloc;
-	nni_msg * msg;
 	nni_msg **newq, **oldq;
 	int       oldget;
 	int       oldlen;
@@ -547,12 +712,7 @@ nni_msgq_resize(nni_msgq *mq, int cap)
 		// too many messages -- we allow that one for
 		// the case of pushback or cap == 0.
 		// we delete the oldest messages first
-		msg = mq->mq_msgs[mq->mq_get++];
-		if (mq->mq_get > mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
-		nni_msg_free(msg);
+		nni_msg_free(nni_msgq_pop(mq));
 	}
 	if (newq == NULL) {
 		// Just shrinking the queue, no changes
@@ -589,3 +749,36 @@ out:
 	nni_mtx_unlock(&mq->mq_lock);
 	return (0);
 }
+
+void
+nni_msgq_set_maxbytes(nni_msgq *mq, size_t maxbytes)
+{
+	nni_mtx_lock(&mq->mq_lock);
+	mq->mq_maxbytes = maxbytes;
+	// Writers may fit now.
+	nni_msgq_run_putq(mq);
+	nni_msgq_run_notify(mq);
+	nni_mtx_unlock(&mq->mq_lock);
+}
+
+size_t
+nni_msgq_maxbytes(nni_msgq *mq)
+{
+	size_t rv;
+
+	nni_mtx_lock(&mq->mq_lock);
+	rv = mq->mq_maxbytes;
+	nni_mtx_unlock(&mq->mq_lock);
+	return (rv);
+}
+
+size_t
+nni_msgq_bytes(nni_msgq *mq)
+{
+	size_t rv;
+
+	nni_mtx_lock(&mq->mq_lock);
+	rv = mq->mq_bytes;
+	nni_mtx_unlock(&mq->mq_lock);
+	return (rv);
+}
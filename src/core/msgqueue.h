@@ -44,6 +44,19 @@ extern void nni_msgq_aio_get(nni_msgq *, nni_aio *);
 // a zero time.
 extern int nni_msgq_tryput(nni_msgq *, nni_msg *);
 
+// nni_msgq_putv puts as many of the messages, in order, as the queue will
+// take without waiting, all under a single acquisition of the lock.  It
+// returns the number taken; the caller still owns the rest.  Nothing is
+// taken if the queue is closed or in error, or if other writers are
+// already waiting, so that the caller can fall back to nni_msgq_aio_put.
+// In best effort mode every message is taken, though some may be dropped.
+extern size_t nni_msgq_putv(nni_msgq *, nni_msg **, size_t);
+
+// nni_msgq_getv is the counterpart of nni_msgq_putv, returning up to the
+// given number of messages that are available now, and the count.
+// Expired messages and those the filter rejects are discarded as usual.
+extern size_t nni_msgq_getv(nni_msgq *, nni_msg **, size_t);
+
 // nni_msgq_set_error sets an error condition on the message queue,
 // which causes all current and future readers/writes to return the
 // given error condition (if non-zero).  Threads waiting to put or get
@@ -81,6 +94,12 @@ typedef nni_msg *(*nni_msgq_filter)(void *, nni_msg *);
 // discarded instead, and any get waiters remain waiting.
 extern void nni_msgq_set_filter(nni_msgq *, nni_msgq_filter, void *);
 
+// nni_msgq_set_sock names the socket that messages dropped from the
+// queue are counted against.  Messages whose deadline has passed (see
+// nni_msg_set_expire) are never returned by the get functions; they are
+// freed, and counted in the socket's NNG_OPT_EXPIRED statistic.
+extern void nni_msgq_set_sock(nni_msgq *, nni_sock *);
+
 // nni_msgq_cb_flags is an enumeration of flag bits used with nni_msgq_cb.
 enum nni_msgq_cb_flags {
 	nni_msgq_f_full    = 1,
@@ -129,4 +148,17 @@ extern int nni_msgq_cap(nni_msgq *mq);
 // nni_msgq_len returns the number of messages currently in the queue.
 extern int nni_msgq_len(nni_msgq *mq);
 
+// nni_msgq_set_maxbytes limits the queue by the total size (header and
+// body) of the messages it holds, in addition to its capacity.  Zero,
+// the default, means no limit.  A message that would exceed the limit is
+// handled as if the queue were full, except that an empty queue always
+// accepts one message.
+extern void nni_msgq_set_maxbytes(nni_msgq *, size_t);
+
+// nni_msgq_maxbytes returns the limit set by nni_msgq_set_maxbytes.
+extern size_t nni_msgq_maxbytes(nni_msgq *);
+
+// nni_msgq_bytes returns the number of bytes currently in the queue.
+extern size_t nni_msgq_bytes(nni_msgq *);
+
 #endif // CORE_MSQUEUE_H
@@ -27,11 +27,15 @@
 #include "core/platform.h"
 
 #include "core/aio.h"
+#include "core/alloc.h"
+#include "core/bufpool.h"
 #include "core/clock.h"
 #include "core/device.h"
 #include "core/file.h"
+#include "core/handle.h"
 #include "core/idhash.h"
 #include "core/init.h"
+#include "core/lb.h"
 #include "core/list.h"
 #include "core/message.h"
 #include "core/msgqueue.h"
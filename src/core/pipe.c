@@ -18,7 +18,7 @@
 // performed in the context of the protocol.
 
 struct nni_pipe {
-	uint64_t      p_id;
+	uint32_t      p_id;
 	nni_tran_pipe p_tran_ops;
 	void *        p_tran_data;
 	void *        p_proto_data;
@@ -28,15 +28,12 @@ struct nni_pipe {
 	nni_ep *      p_ep;
 	int           p_reap;
 	int           p_stop;
-	int           p_refcnt;
 	nni_mtx       p_mtx;
-	nni_cv        p_cv;
 	nni_list_node p_reap_node;
 	nni_aio *     p_start_aio;
 };
 
-static nni_idhash *nni_pipes;
-static nni_mtx     nni_pipe_lk;
+static nni_handle_table *nni_pipes;
 
 static nni_list nni_pipe_reap_list;
 static nni_mtx  nni_pipe_reap_lk;
@@ -52,27 +49,13 @@ nni_pipe_sys_init(void)
 	int rv;
 
 	NNI_LIST_INIT(&nni_pipe_reap_list, nni_pipe, p_reap_node);
-	nni_mtx_init(&nni_pipe_lk);
 	nni_mtx_init(&nni_pipe_reap_lk);
 	nni_cv_init(&nni_pipe_reap_cv, &nni_pipe_reap_lk);
 
-	if (((rv = nni_idhash_init(&nni_pipes)) != 0) ||
-	    ((rv = nni_thr_init(&nni_pipe_reap_thr, nni_pipe_reaper, 0)) !=
-	        0)) {
+	// The reaper thread is started when the first pipe is stopped.
+	if ((rv = nni_handle_table_init(&nni_pipes)) != 0) {
 		return (rv);
 	}
-
-	// Note that pipes have their own namespace.  ID hash will
-	// guarantee the that the first value is reasonable (non-zero),
-	// if we supply an out of range value (0).  (Consequently the
-	// value "1" has a bias -- its roughly twice as likely to be
-	// chosen as any other value.  This does not mater.)
-	nni_idhash_set_limits(
-	    nni_pipes, 1, 0x7fffffff, nni_random() & 0x7fffffff);
-
-	nni_pipe_reap_run = 1;
-	nni_thr_run(&nni_pipe_reap_thr);
-
 	return (0);
 }
 
@@ -89,11 +72,8 @@ nni_pipe_sys_fini(void)
 	nni_thr_fini(&nni_pipe_reap_thr);
 	nni_cv_fini(&nni_pipe_reap_cv);
 	nni_mtx_fini(&nni_pipe_reap_lk);
-	nni_mtx_fini(&nni_pipe_lk);
-	if (nni_pipes != NULL) {
-		nni_idhash_fini(nni_pipes);
-		nni_pipes = NULL;
-	}
+	nni_handle_table_fini(nni_pipes);
+	nni_pipes = NULL;
 }
 
 static void
@@ -108,14 +88,11 @@ nni_pipe_destroy(nni_pipe *p)
 
 	// Make sure any unlocked holders are done with this.
 	// This happens during initialization for example.
-	nni_mtx_lock(&nni_pipe_lk);
 	if (p->p_id != 0) {
-		nni_idhash_remove(nni_pipes, p->p_id);
+		nni_handle_close(nni_pipes, p->p_id);
+		nni_handle_wait(nni_pipes, p->p_id, 0);
+		nni_handle_free(nni_pipes, p->p_id);
 	}
-	while (p->p_refcnt != 0) {
-		nni_cv_wait(&p->p_cv);
-	}
-	nni_mtx_unlock(&nni_pipe_lk);
 
 	// We have exclusive access at this point, so we can check if
 	// we are still on any lists.
@@ -140,31 +117,27 @@ nni_pipe_find(nni_pipe **pp, uint32_t id)
 {
 	int       rv;
 	nni_pipe *p;
-	nni_mtx_lock(&nni_pipe_lk);
-	if ((rv = nni_idhash_find(nni_pipes, id, (void **) &p)) == 0) {
-		p->p_refcnt++;
+
+	// A pipe that is being destroyed is treated as already gone.
+	if ((rv = nni_handle_find(nni_pipes, id, (void **) &p)) == 0) {
 		*pp = p;
+	} else if (rv == NNG_ECLOSED) {
+		rv = NNG_ENOENT;
 	}
-	nni_mtx_unlock(&nni_pipe_lk);
 	return (rv);
 }
 
 void
 nni_pipe_rele(nni_pipe *p)
 {
-	nni_mtx_lock(&nni_pipe_lk);
-	p->p_refcnt--;
-	if (p->p_refcnt == 0) {
-		nni_cv_wake(&p->p_cv);
-	}
-	nni_mtx_unlock(&nni_pipe_lk);
+	nni_handle_rele(nni_pipes, p->p_id);
 }
 
 // nni_pipe_id returns the 32-bit pipe id, which can be used in backtraces.
 uint32_t
 nni_pipe_id(nni_pipe *p)
 {
-	return ((uint32_t) p->p_id);
+	return (p->p_id);
 }
 
 void
@@ -217,8 +190,14 @@ nni_pipe_stop(nni_pipe *p)
 	p->p_stop = 1;
 	nni_mtx_unlock(&p->p_mtx);
 
-	// Put it on the reaplist for async cleanup
+	// Put it on the reaplist for async cleanup.  If the reaper cannot
+	// be started, we will try again with the next pipe.
 	nni_mtx_lock(&nni_pipe_reap_lk);
+	if ((!nni_pipe_reap_run) &&
+	    (nni_thr_init(&nni_pipe_reap_thr, nni_pipe_reaper, 0) == 0)) {
+		nni_pipe_reap_run = 1;
+		nni_thr_run(&nni_pipe_reap_thr);
+	}
 	nni_list_append(&nni_pipe_reap_list, p);
 	nni_cv_wake(&nni_pipe_reap_cv);
 	nni_mtx_unlock(&nni_pipe_reap_lk);
@@ -230,6 +209,18 @@ nni_pipe_peer(nni_pipe *p)
 	return (p->p_tran_ops.p_peer(p->p_tran_data));
 }
 
+nni_sock *
+nni_pipe_sock(nni_pipe *p)
+{
+	return (p->p_sock);
+}
+
+int
+nni_pipe_weight(nni_pipe *p)
+{
+	return (nni_ep_weight(p->p_ep));
+}
+
 static void
 nni_pipe_start_cb(void *arg)
 {
@@ -273,11 +264,8 @@ nni_pipe_create(nni_ep *ep, void *tdata)
 	NNI_LIST_NODE_INIT(&p->p_ep_node);
 
 	nni_mtx_init(&p->p_mtx);
-	nni_cv_init(&p->p_cv, &nni_pipe_lk);
 	if ((rv = nni_aio_init(&p->p_start_aio, nni_pipe_start_cb, p)) == 0) {
-		nni_mtx_lock(&nni_pipe_lk);
-		rv = nni_idhash_alloc(nni_pipes, &p->p_id, p);
-		nni_mtx_unlock(&nni_pipe_lk);
+		rv = nni_handle_alloc(nni_pipes, &p->p_id, p, 0);
 	}
 
 	if ((rv != 0) || ((rv = nni_ep_pipe_add(ep, p)) != 0) ||
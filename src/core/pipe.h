@@ -57,6 +57,13 @@ extern void nni_pipe_start(nni_pipe *);
 
 extern uint16_t nni_pipe_proto(nni_pipe *);
 extern uint16_t nni_pipe_peer(nni_pipe *);
+
+// nni_pipe_sock returns the socket the pipe belongs to.
+extern nni_sock *nni_pipe_sock(nni_pipe *);
+
+// nni_pipe_weight returns the load balancing weight configured on the
+// endpoint that created the pipe (NNG_OPT_LB_WEIGHT).
+extern int nni_pipe_weight(nni_pipe *);
 extern int      nni_pipe_getopt(nni_pipe *, const char *, void *, size_t *);
 
 // nni_pipe_get_proto_data gets the protocol private data set with the
@@ -17,6 +17,7 @@
 // MS Studio have a functional <stdint.h>.  If this impacts you, just upgrade
 // your tool chain.
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -63,23 +64,23 @@ extern const char *nni_plat_strerror(int);
 // Memory Management
 //
 
-// nni_alloc allocates memory.  In most cases this can just be malloc().
-// However, you may provide a different allocator, for example it is
-// possible to use a slab allocator or somesuch.  It is permissible for this
-// to return NULL if memory cannot be allocated.
-extern void *nni_alloc(size_t);
+// nni_plat_alloc allocates zeroed memory.  In most cases this can just be
+// calloc().  It is permissible for this to return NULL if memory cannot be
+// allocated.  The rest of the library uses nni_alloc, which calls this
+// unless the application has installed its own allocator.
+extern void *nni_plat_alloc(size_t);
 
-// nni_free frees memory allocated with nni_alloc. It takes a size because
-// some allocators do not track size, or can operate more efficiently if
-// the size is provided with the free call.  Examples of this are slab
-// allocators like this found in Solaris/illumos (see libumem or kmem).
-// This routine does nothing if supplied with a NULL pointer and zero size.
-// Most implementations can just call free() here.
-extern void nni_free(void *, size_t);
+// nni_plat_free frees memory allocated with nni_plat_alloc. It takes a size
+// because some allocators do not track size, or can operate more
+// efficiently if the size is provided with the free call.  Examples of
+// this are slab allocators like this found in Solaris/illumos (see libumem
+// or kmem).  Most implementations can just call free() here.
+extern void nni_plat_free(void *, size_t);
 
 typedef struct nni_plat_mtx nni_plat_mtx;
 typedef struct nni_plat_cv  nni_plat_cv;
 typedef struct nni_plat_thr nni_plat_thr;
+typedef struct nni_plat_tls nni_plat_tls;
 
 //
 // Threading & Synchronization Support
@@ -141,6 +142,57 @@ extern int nni_plat_thr_init(nni_plat_thr *, void (*)(void *), void *);
 // is an error to reference the thread in any further way.
 extern void nni_plat_thr_fini(nni_plat_thr *);
 
+// nni_plat_tls_init allocates a thread specific storage slot, which
+// initially holds NULL in every thread.  If the platform supports it, the
+// destructor is called with a thread's non-NULL value when that thread
+// exits; otherwise callers must be prepared to reclaim the values
+// themselves.  The destructor is not called for values still present
+// when nni_plat_tls_fini is called.
+extern int nni_plat_tls_init(nni_plat_tls *, void (*)(void *));
+
+// nni_plat_tls_fini releases the slot.
+extern void nni_plat_tls_fini(nni_plat_tls *);
+
+// nni_plat_tls_get returns the calling thread's value for the slot.
+extern void *nni_plat_tls_get(nni_plat_tls *);
+
+// nni_plat_tls_set sets the calling thread's value for the slot.
+extern void nni_plat_tls_set(nni_plat_tls *, void *);
+
+//
+// Atomic Operations
+//
+// These are used for reference counts and lookups on hot paths, where
+// a global lock would be heavily contended.  All of them are sequentially
+// consistent.  Mostly 32-bit values (and pointers) are used; the 64-bit
+// operations may need library support (libatomic) on 32-bit targets, so
+// they are kept to counters that would otherwise wrap.
+//
+
+// nni_plat_atomic_load32 returns the current value.
+extern uint32_t nni_plat_atomic_load32(uint32_t *);
+
+// nni_plat_atomic_store32 sets the value.
+extern void nni_plat_atomic_store32(uint32_t *, uint32_t);
+
+// nni_plat_atomic_cas32 replaces the value with the new value (last
+// argument) if it is equal to the old value, returning true if so.
+extern bool nni_plat_atomic_cas32(uint32_t *, uint32_t, uint32_t);
+
+// nni_plat_atomic_add32 adds the (possibly negative) delta to the value,
+// and returns the result.
+extern uint32_t nni_plat_atomic_add32(uint32_t *, int32_t);
+
+// nni_plat_atomic_load64 and nni_plat_atomic_add64 are the 64-bit
+// equivalents of nni_plat_atomic_load32 and nni_plat_atomic_add32.
+extern uint64_t nni_plat_atomic_load64(uint64_t *);
+extern uint64_t nni_plat_atomic_add64(uint64_t *, int64_t);
+
+// nni_plat_atomic_load_ptr and nni_plat_atomic_store_ptr are the pointer
+// equivalents of nni_plat_atomic_load32 and nni_plat_atomic_store32.
+extern void *nni_plat_atomic_load_ptr(void **);
+extern void  nni_plat_atomic_store_ptr(void **, void *);
+
 //
 // Clock Support
 //
@@ -153,6 +205,14 @@ extern void nni_plat_thr_fini(nni_plat_thr *);
 // option of using negative values for other purposes in the future.)
 extern nni_time nni_plat_clock(void);
 
+// nni_plat_clock_coarse is a cheaper version of nni_plat_clock.  It uses
+// the same base, but may lag behind it by a scheduler tick or so (a few
+// milliseconds, sometimes more when virtualized).  Deadlines computed
+// from it may therefore fire a little early.  It is meant for internal
+// timers, such as retries, where that does not matter; anything with a
+// user visible "at least this long" promise must use nni_plat_clock.
+extern nni_time nni_plat_clock_coarse(void);
+
 // nni_plat_sleep sleeps for the specified number of milliseconds (at least).
 extern void nni_plat_sleep(nni_duration);
 
@@ -209,6 +269,17 @@ extern void nni_plat_tcp_ep_close(nni_plat_tcp_ep *);
 // to the specified path.
 extern int nni_plat_tcp_ep_listen(nni_plat_tcp_ep *, nni_sockaddr *);
 
+// nni_plat_tcp_ep_set_listeners sets the number of listening sockets that
+// will be opened by a later nni_plat_tcp_ep_listen.  When more than one
+// is requested, each is bound to the same address (SO_REUSEPORT) so the
+// kernel can spread incoming connections across them.  Platforms that
+// cannot do this return NNG_ENOTSUP for values larger than one.
+extern int nni_plat_tcp_ep_set_listeners(nni_plat_tcp_ep *, int);
+
+// NNI_PLAT_TCP_MAX_LISTENERS is the largest value accepted by
+// nni_plat_tcp_ep_set_listeners.
+#define NNI_PLAT_TCP_MAX_LISTENERS 64
+
 // nni_plat_tcp_ep_accept starts an accept to receive an incoming connection.
 // An accepted connection will be passed back in the a_pipe member.
 extern void nni_plat_tcp_ep_accept(nni_plat_tcp_ep *, nni_aio *);
@@ -307,13 +378,73 @@ extern void nni_plat_ipc_pipe_fini(nni_plat_ipc_pipe *);
 extern void nni_plat_ipc_pipe_close(nni_plat_ipc_pipe *);
 
 // nni_plat_ipc_pipe_send sends data in the iov buffers to the peer.
-// The platform may modify the iovs.
+// The platform may modify the iovs.  If input 0 of the aio is not NULL,
+// it points to an int holding a descriptor (from nni_plat_shm_memfd)
+// to pass to the peer along with the data; once that is done input 0
+// is reset to NULL.  The caller still owns, and must close, the
+// descriptor.
 extern void nni_plat_ipc_pipe_send(nni_plat_ipc_pipe *, nni_aio *);
 
 // nni_plat_ipc_pipe_recv recvs data into the buffers provided by the iovs.
-// The platform may modify the iovs.
+// The platform may modify the iovs.  If input 0 of the aio is not NULL,
+// it points to an int that receives any descriptor passed by the peer.
+// It is only written if it holds -1; a second descriptor arriving
+// before the first is collected is discarded.
 extern void nni_plat_ipc_pipe_recv(nni_plat_ipc_pipe *, nni_aio *);
 
+//
+// Shared Memory Support.  This is used to share a region of memory
+// with another process on the same host.  One side creates the region,
+// and passes its name (by some other means) to the other, which opens
+// it.  Once both have it mapped the name should be unlinked.
+//
+
+typedef struct nni_plat_shm nni_plat_shm;
+
+// NNI_PLAT_SHM_NAMELEN is the maximum length of a region name, including
+// the terminating NUL.
+#define NNI_PLAT_SHM_NAMELEN 32
+
+// nni_plat_shm_create creates a new, zero filled, region of the given
+// size and maps it.  A unique name is chosen for it.
+extern int nni_plat_shm_create(nni_plat_shm **, size_t);
+
+// nni_plat_shm_open maps an existing region created by another process.
+// The region must be at least as large as the size given.
+extern int nni_plat_shm_open(nni_plat_shm **, const char *, size_t);
+
+// nni_plat_shm_name returns the name of the region.
+extern const char *nni_plat_shm_name(nni_plat_shm *);
+
+// nni_plat_shm_addr returns the address where the region is mapped.
+extern void *nni_plat_shm_addr(nni_plat_shm *);
+
+// nni_plat_shm_unlink removes the name of the region, so that it can no
+// longer be opened.  Existing mappings are unaffected.
+extern void nni_plat_shm_unlink(nni_plat_shm *);
+
+// nni_plat_shm_fini unmaps the region and releases resources.  If the
+// name has not yet been unlinked by this side, it is unlinked as well.
+extern void nni_plat_shm_fini(nni_plat_shm *);
+
+// nni_plat_shm_memfd creates an anonymous shared memory object holding
+// a copy of the data in the iovs, and returns a descriptor for it that
+// can be passed to a peer with nni_plat_ipc_pipe_send.  Where possible
+// the object is sealed, so that its contents can no longer change.
+extern int nni_plat_shm_memfd(int *, const nni_iov *, unsigned);
+
+// nni_plat_shm_mapfd maps the first size bytes of an object received
+// from a peer, copy-on-write.  The descriptor is always closed, even on
+// failure.  The mapping is released with nni_plat_shm_unmap.
+extern int nni_plat_shm_mapfd(void **, int, size_t);
+
+// nni_plat_shm_unmap releases a mapping made by nni_plat_shm_mapfd.
+extern void nni_plat_shm_unmap(void *, size_t);
+
+// nni_plat_shm_closefd closes a descriptor from nni_plat_shm_memfd, or
+// one received from a peer that is not going to be mapped.
+extern void nni_plat_shm_closefd(int);
+
 //
 // UDP support. UDP is not connection oriented, and only has the notion
 // of being bound, sendto, and recvfrom.  (It is possible to set up a
@@ -341,6 +472,11 @@ extern void nni_plat_udp_send(nni_plat_udp *, nni_aio *);
 // nni_plat_udp_pipe_recv recvs a message, storing it in the iovs
 // from the UDP payload.  If the UDP payload will not fit, then
 // NNG_EMSGSIZE results.
+//
+// Callers may have many sends and receives outstanding on the same
+// socket; the platform is free to move queued datagrams in batches
+// (e.g. with sendmmsg/recvmmsg), so keeping several receives posted
+// is the way to get good throughput.
 extern void nni_plat_udp_recv(nni_plat_udp *, nni_aio *);
 
 //
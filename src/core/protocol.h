@@ -80,6 +80,15 @@ struct nni_proto_sock_ops {
 	// Receive a message.
 	void (*sock_recv)(void *, nni_aio *);
 
+	// Send a batch of messages, without waiting.  This may be NULL.
+	// It returns how many messages the protocol took, in order; the
+	// remainder are sent one at a time with sock_send.
+	size_t (*sock_sendv)(void *, nni_msg **, size_t);
+
+	// Receive up to the given number of messages that are available
+	// now, without waiting, returning the count.  This may be NULL.
+	size_t (*sock_recvv)(void *, nni_msg **, size_t);
+
 	// Message filter.  This may be NULL, but if it isn't, then
 	// messages coming into the system are routed here just before being
 	// delivered to the application.  To drop the message, the protocol
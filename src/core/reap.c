@@ -18,6 +18,7 @@ static nni_list nni_reap_list;
 static nni_mtx  nni_reap_mtx;
 static nni_cv   nni_reap_cv;
 static bool     nni_reap_exit = false;
+static bool     nni_reap_run  = false;
 static nni_thr  nni_reap_thr;
 
 static void
@@ -46,10 +47,26 @@ nni_reap_stuff(void *notused)
 	nni_mtx_unlock(&nni_reap_mtx);
 }
 
+// nni_reap_start starts the reap thread, if it is not running yet.  If
+// that fails, we will try again at the next reap.
+static void
+nni_reap_start(void)
+{
+	if (nni_reap_run) {
+		return;
+	}
+	if (nni_thr_init(&nni_reap_thr, nni_reap_stuff, NULL) != 0) {
+		return;
+	}
+	nni_reap_run = true;
+	nni_thr_run(&nni_reap_thr);
+}
+
 void
 nni_reap(nni_reap_item *item, nni_cb func, void *ptr)
 {
 	nni_mtx_lock(&nni_reap_mtx);
+	nni_reap_start();
 	item->r_func = func;
 	item->r_ptr  = ptr;
 	nni_list_append(&nni_reap_list, item);
@@ -60,21 +77,13 @@ nni_reap(nni_reap_item *item, nni_cb func, void *ptr)
 int
 nni_reap_sys_init(void)
 {
-	int rv;
-
 	NNI_LIST_INIT(&nni_reap_list, nni_reap_item, r_link);
 	nni_mtx_init(&nni_reap_mtx);
 	nni_cv_init(&nni_reap_cv, &nni_reap_mtx);
 	nni_reap_exit = false;
+	nni_reap_run  = false;
 
-	// If this fails, we don't fail init, instead we will try to
-	// start up at reap time.
-	if ((rv = nni_thr_init(&nni_reap_thr, nni_reap_stuff, NULL)) != 0) {
-		nni_cv_fini(&nni_reap_cv);
-		nni_mtx_fini(&nni_reap_mtx);
-		return (rv);
-	}
-	nni_thr_run(&nni_reap_thr);
+	// The thread is started at the first reap.
 	return (0);
 }
 
@@ -86,4 +95,5 @@ nni_reap_sys_fini(void)
 	nni_cv_wake(&nni_reap_cv);
 	nni_mtx_unlock(&nni_reap_mtx);
 	nni_thr_fini(&nni_reap_thr);
+	nni_reap_run = false;
 }
@@ -16,8 +16,8 @@
 // Socket implementation.
 
 static nni_list    nni_sock_list;
-static nni_idhash *nni_sock_hash;
-static nni_mtx     nni_sock_lk;
+static nni_handle_table *nni_sock_handles;
+static nni_mtx           nni_sock_lk;
 
 typedef struct nni_socket_option {
 	const char *so_name;
@@ -36,13 +36,11 @@ struct nni_socket {
 	nni_list_node s_node;
 	nni_mtx       s_mx;
 	nni_cv        s_cv;
-	nni_cv        s_close_cv;
 	int           s_raw;
 
-	uint64_t s_id;
+	uint32_t s_id;
 	uint32_t s_flags;
-	unsigned s_refcnt; // protected by global lock
-	void *   s_data;   // Protocol private
+	void *   s_data; // Protocol private
 
 	nni_msgq *s_uwq; // Upper write queue
 	nni_msgq *s_urq; // Upper read queue
@@ -54,14 +52,16 @@ struct nni_socket {
 	nni_proto_sock_ops s_sock_ops;
 
 	// options
-	nni_duration s_linger;    // linger time
-	nni_duration s_sndtimeo;  // send timeout
-	nni_duration s_rcvtimeo;  // receive timeout
-	nni_duration s_reconn;    // reconnect time
-	nni_duration s_reconnmax; // max reconnect time
-	size_t       s_rcvmaxsz;  // max receive size
-	nni_list     s_options;   // opts not handled by sock/proto
-	char         s_name[64];  // socket name (legacy compat)
+	nni_duration s_linger;     // linger time
+	nni_duration s_sndtimeo;   // send timeout
+	nni_duration s_rcvtimeo;   // receive timeout
+	nni_duration s_reconn;     // reconnect time
+	nni_duration s_reconnmax;  // max reconnect time
+	int          s_reconnpend; // max connects pending per destination
+	size_t       s_rcvmaxsz;   // max receive size
+	size_t       s_pipebufsz;  // byte limit for pipe send queues
+	nni_list     s_options;    // opts not handled by sock/proto
+	char         s_name[64];   // socket name (legacy compat)
 
 	nni_list s_eps;   // active endpoints
 	nni_list s_pipes; // active pipes
@@ -72,30 +72,38 @@ struct nni_socket {
 
 	nni_notifyfd s_send_fd;
 	nni_notifyfd s_recv_fd;
+
+	uint64_t s_expired; // messages dropped past their deadline
 };
 
+// nni_sock_notify only touches the descriptors when readiness actually
+// changes.  Queue state is reported after every operation, so raising
+// (or clearing) the event each time would cost a system call for every
+// message, even though the application only cares about the transitions.
 static void
-nni_sock_can_send_cb(void *arg, int flags)
+nni_sock_notify(nni_notifyfd *fd, bool ready)
 {
-	nni_notifyfd *fd = arg;
-
-	if ((flags & nni_msgq_f_can_put) == 0) {
-		nni_plat_pipe_clear(fd->sn_rfd);
+	if (ready) {
+		if (nni_plat_atomic_cas32(&fd->sn_ready, 0, 1)) {
+			nni_plat_pipe_raise(fd->sn_wfd);
+		}
 	} else {
-		nni_plat_pipe_raise(fd->sn_wfd);
+		if (nni_plat_atomic_cas32(&fd->sn_ready, 1, 0)) {
+			nni_plat_pipe_clear(fd->sn_rfd);
+		}
 	}
 }
 
 static void
-nni_sock_can_recv_cb(void *arg, int flags)
+nni_sock_can_send_cb(void *arg, int flags)
 {
-	nni_notifyfd *fd = arg;
+	nni_sock_notify(arg, (flags & nni_msgq_f_can_put) != 0);
+}
 
-	if ((flags & nni_msgq_f_can_get) == 0) {
-		nni_plat_pipe_clear(fd->sn_rfd);
-	} else {
-		nni_plat_pipe_raise(fd->sn_wfd);
-	}
+static void
+nni_sock_can_recv_cb(void *arg, int flags)
+{
+	nni_sock_notify(arg, (flags & nni_msgq_f_can_get) != 0);
 }
 
 static int
@@ -209,6 +217,18 @@ nni_sock_getopt_reconnmaxt(nni_sock *s, void *buf, size_t *szp)
 	return (nni_getopt_ms(s->s_reconnmax, buf, szp));
 }
 
+static int
+nni_sock_setopt_reconnpend(nni_sock *s, const void *buf, size_t sz)
+{
+	return (nni_setopt_int(&s->s_reconnpend, buf, sz, 0, 0x7fffffff));
+}
+
+static int
+nni_sock_getopt_reconnpend(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_int(s->s_reconnpend, buf, szp));
+}
+
 static int
 nni_sock_setopt_recvbuf(nni_sock *s, const void *buf, size_t sz)
 {
@@ -233,6 +253,54 @@ nni_sock_getopt_sendbuf(nni_sock *s, void *buf, size_t *szp)
 	return (nni_getopt_buf(s->s_uwq, buf, szp));
 }
 
+static int
+nni_sock_setopt_recvbufsz(nni_sock *s, const void *buf, size_t sz)
+{
+	size_t val;
+	int    rv;
+
+	if ((rv = nni_setopt_size(&val, buf, sz, 0, NNI_MAXSZ)) == 0) {
+		nni_msgq_set_maxbytes(s->s_urq, val);
+	}
+	return (rv);
+}
+
+static int
+nni_sock_getopt_recvbufsz(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_size(nni_msgq_maxbytes(s->s_urq), buf, szp));
+}
+
+static int
+nni_sock_setopt_sendbufsz(nni_sock *s, const void *buf, size_t sz)
+{
+	size_t val;
+	int    rv;
+
+	if ((rv = nni_setopt_size(&val, buf, sz, 0, NNI_MAXSZ)) == 0) {
+		nni_msgq_set_maxbytes(s->s_uwq, val);
+	}
+	return (rv);
+}
+
+static int
+nni_sock_getopt_sendbufsz(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_size(nni_msgq_maxbytes(s->s_uwq), buf, szp));
+}
+
+static int
+nni_sock_setopt_pipebufsz(nni_sock *s, const void *buf, size_t sz)
+{
+	return (nni_setopt_size(&s->s_pipebufsz, buf, sz, 0, NNI_MAXSZ));
+}
+
+static int
+nni_sock_getopt_pipebufsz(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_size(s->s_pipebufsz, buf, szp));
+}
+
 static int
 nni_sock_getopt_sockname(nni_sock *s, void *buf, size_t *szp)
 {
@@ -249,6 +317,13 @@ nni_sock_setopt_sockname(nni_sock *s, const void *buf, size_t sz)
 	return (0);
 }
 
+static int
+nni_sock_getopt_expired(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_u64(
+	    nni_plat_atomic_load64(&s->s_expired), buf, szp));
+}
+
 static int
 nni_sock_getopt_domain(nni_sock *s, void *buf, size_t *szp)
 {
@@ -286,6 +361,21 @@ static const nni_socket_option nni_sock_options[] = {
 	    .so_getopt = nni_sock_getopt_sendbuf,
 	    .so_setopt = nni_sock_setopt_sendbuf,
 	},
+	{
+	    .so_name   = NNG_OPT_RECVBUFSZ,
+	    .so_getopt = nni_sock_getopt_recvbufsz,
+	    .so_setopt = nni_sock_setopt_recvbufsz,
+	},
+	{
+	    .so_name   = NNG_OPT_SENDBUFSZ,
+	    .so_getopt = nni_sock_getopt_sendbufsz,
+	    .so_setopt = nni_sock_setopt_sendbufsz,
+	},
+	{
+	    .so_name   = NNG_OPT_PIPEBUFSZ,
+	    .so_getopt = nni_sock_getopt_pipebufsz,
+	    .so_setopt = nni_sock_setopt_pipebufsz,
+	},
 	{
 	    .so_name   = NNG_OPT_RECONNMINT,
 	    .so_getopt = nni_sock_getopt_reconnmint,
@@ -296,6 +386,11 @@ static const nni_socket_option nni_sock_options[] = {
 	    .so_getopt = nni_sock_getopt_reconnmaxt,
 	    .so_setopt = nni_sock_setopt_reconnmaxt,
 	},
+	{
+	    .so_name   = NNG_OPT_RECONNMAXPEND,
+	    .so_getopt = nni_sock_getopt_reconnpend,
+	    .so_setopt = nni_sock_setopt_reconnpend,
+	},
 	{
 	    .so_name   = NNG_OPT_SOCKNAME,
 	    .so_getopt = nni_sock_getopt_sockname,
@@ -306,6 +401,11 @@ static const nni_socket_option nni_sock_options[] = {
 	    .so_getopt = nni_sock_getopt_domain,
 	    .so_setopt = NULL,
 	},
+	{
+	    .so_name   = NNG_OPT_EXPIRED,
+	    .so_getopt = nni_sock_getopt_expired,
+	    .so_setopt = NULL,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
@@ -318,6 +418,23 @@ nni_free_opt(nni_sockopt *opt)
 	NNI_FREE_STRUCT(opt);
 }
 
+void
+nni_sock_add_expired(nni_sock *s, int n)
+{
+	nni_plat_atomic_add64(&s->s_expired, n);
+}
+
+size_t
+nni_sock_pipebufsz(nni_sock *s)
+{
+	size_t rv;
+
+	nni_mtx_lock(&s->s_mx);
+	rv = s->s_pipebufsz;
+	nni_mtx_unlock(&s->s_mx);
+	return (rv);
+}
+
 uint32_t
 nni_sock_id(nni_sock *s)
 {
@@ -347,18 +464,9 @@ nni_sock_find(nni_sock **sockp, uint32_t id)
 	if ((rv = nni_init()) != 0) {
 		return (rv);
 	}
-	nni_mtx_lock(&nni_sock_lk);
-	if ((rv = nni_idhash_find(nni_sock_hash, id, (void **) &s)) == 0) {
-		if (s->s_closed) {
-			rv = NNG_ECLOSED;
-		} else {
-			s->s_refcnt++;
-			*sockp = s;
-		}
-	}
-	nni_mtx_unlock(&nni_sock_lk);
-
-	if (rv == NNG_ENOENT) {
+	if ((rv = nni_handle_find(nni_sock_handles, id, (void **) &s)) == 0) {
+		*sockp = s;
+	} else if (rv == NNG_ENOENT) {
 		rv = NNG_ECLOSED;
 	}
 
@@ -368,12 +476,7 @@ nni_sock_find(nni_sock **sockp, uint32_t id)
 void
 nni_sock_rele(nni_sock *s)
 {
-	nni_mtx_lock(&nni_sock_lk);
-	s->s_refcnt--;
-	if (s->s_closed && (s->s_refcnt < 2)) {
-		nni_cv_wake(&s->s_close_cv);
-	}
-	nni_mtx_unlock(&nni_sock_lk);
+	nni_handle_rele(nni_sock_handles, s->s_id);
 }
 
 int
@@ -475,7 +578,6 @@ nni_sock_destroy(nni_sock *s)
 
 	nni_msgq_fini(s->s_urq);
 	nni_msgq_fini(s->s_uwq);
-	nni_cv_fini(&s->s_close_cv);
 	nni_cv_fini(&s->s_cv);
 	nni_mtx_fini(&s->s_mx);
 	NNI_FREE_STRUCT(s);
@@ -496,9 +598,10 @@ nni_sock_create(nni_sock **sp, const nni_proto *proto)
 	s->s_closing         = 0;
 	s->s_reconn          = NNI_SECOND;
 	s->s_reconnmax       = 0;
+	s->s_reconnpend      = 0;
 	s->s_rcvmaxsz        = 1024 * 1024; // 1 MB by default
+	s->s_pipebufsz       = 0;           // no byte limit by default
 	s->s_id              = 0;
-	s->s_refcnt          = 0;
 	s->s_send_fd.sn_init = 0;
 	s->s_recv_fd.sn_init = 0;
 	s->s_self_id         = proto->proto_self;
@@ -519,7 +622,6 @@ nni_sock_create(nni_sock **sp, const nni_proto *proto)
 	nni_ep_list_init(&s->s_eps);
 	nni_mtx_init(&s->s_mx);
 	nni_cv_init(&s->s_cv, &s->s_mx);
-	nni_cv_init(&s->s_close_cv, &nni_sock_lk);
 
 	if (((rv = nni_msgq_init(&s->s_uwq, 0)) != 0) ||
 	    ((rv = nni_msgq_init(&s->s_urq, 0)) != 0) ||
@@ -540,6 +642,9 @@ nni_sock_create(nni_sock **sp, const nni_proto *proto)
 		return (rv);
 	}
 
+	nni_msgq_set_sock(s->s_uwq, s);
+	nni_msgq_set_sock(s->s_urq, s);
+
 	if (s->s_sock_ops.sock_filter != NULL) {
 		nni_msgq_set_filter(
 		    s->s_urq, s->s_sock_ops.sock_filter, s->s_data);
@@ -557,10 +662,8 @@ nni_sock_sys_init(void)
 	NNI_LIST_INIT(&nni_sock_list, nni_sock, s_node);
 	nni_mtx_init(&nni_sock_lk);
 
-	if ((rv = nni_idhash_init(&nni_sock_hash)) != 0) {
+	if ((rv = nni_handle_table_init(&nni_sock_handles)) != 0) {
 		nni_sock_sys_fini();
-	} else {
-		nni_idhash_set_limits(nni_sock_hash, 1, 0x7fffffff, 1);
 	}
 	return (rv);
 }
@@ -568,8 +671,8 @@ nni_sock_sys_init(void)
 void
 nni_sock_sys_fini(void)
 {
-	nni_idhash_fini(nni_sock_hash);
-	nni_sock_hash = NULL;
+	nni_handle_table_fini(nni_sock_handles);
+	nni_sock_handles = NULL;
 	nni_mtx_fini(&nni_sock_lk);
 }
 
@@ -590,16 +693,16 @@ nni_sock_open(nni_sock **sockp, const nni_proto *proto)
 	}
 
 	nni_mtx_lock(&nni_sock_lk);
-	if ((rv = nni_idhash_alloc(nni_sock_hash, &s->s_id, s)) != 0) {
+	if ((rv = nni_handle_alloc(nni_sock_handles, &s->s_id, s, 0)) != 0) {
 		nni_sock_destroy(s);
 	} else {
+		// Set the sockname.
+		(void) snprintf(
+		    s->s_name, sizeof(s->s_name), "%u", (unsigned) s->s_id);
 		nni_list_append(&nni_sock_list, s);
 		s->s_sock_ops.sock_open(s->s_data);
 		*sockp = s;
 	}
-	// Set the sockname.
-	(void) snprintf(
-	    s->s_name, sizeof(s->s_name), "%u", (unsigned) s->s_id);
 	nni_mtx_unlock(&nni_sock_lk);
 
 	return (rv);
@@ -631,7 +734,7 @@ nni_sock_shutdown(nni_sock *sock)
 	if (nni_list_first(&sock->s_pipes) == NULL) {
 		linger = NNI_TIME_ZERO;
 	} else {
-		linger = nni_clock() + sock->s_linger;
+		linger = nni_clock_coarse() + sock->s_linger;
 	}
 
 	// Close the EPs. This prevents new connections from forming but
@@ -726,18 +829,17 @@ nni_sock_close(nni_sock *s)
 		return;
 	}
 	s->s_closed = 1;
-	nni_idhash_remove(nni_sock_hash, s->s_id);
+	nni_handle_close(nni_sock_handles, s->s_id);
 
 	// We might have been removed from the list already, e.g. by
 	// nni_sock_closeall.  This is idempotent.
 	nni_list_node_remove(&s->s_node);
 
+	nni_mtx_unlock(&nni_sock_lk);
+
 	// Wait for all other references to drop.  Note that we
 	// have a reference already (from our caller).
-	while (s->s_refcnt > 1) {
-		nni_cv_wait(&s->s_close_cv);
-	}
-	nni_mtx_unlock(&nni_sock_lk);
+	nni_handle_wait(nni_sock_handles, s->s_id, 1);
 
 	// Wait for pipe and eps to finish closing.
 	nni_mtx_lock(&s->s_mx);
@@ -747,6 +849,7 @@ nni_sock_close(nni_sock *s)
 	}
 	nni_mtx_unlock(&s->s_mx);
 
+	nni_handle_free(nni_sock_handles, s->s_id);
 	nni_sock_destroy(s);
 }
 
@@ -755,7 +858,7 @@ nni_sock_closeall(void)
 {
 	nni_sock *s;
 
-	if (nni_sock_hash == NULL) {
+	if (nni_sock_handles == NULL) {
 		return;
 	}
 	for (;;) {
@@ -765,8 +868,9 @@ nni_sock_closeall(void)
 			return;
 		}
 		// Bump the reference count.  The close call below will
-		// drop it.
-		s->s_refcnt++;
+		// drop it.  The socket cannot be closing yet, as it would
+		// no longer be on the list.
+		(void) nni_handle_find(nni_sock_handles, s->s_id, NULL);
 		nni_list_node_remove(&s->s_node);
 		nni_mtx_unlock(&nni_sock_lk);
 		nni_sock_close(s);
@@ -787,6 +891,24 @@ nni_sock_recv(nni_sock *sock, nni_aio *aio)
 	sock->s_sock_ops.sock_recv(sock->s_data, aio);
 }
 
+size_t
+nni_sock_sendv(nni_sock *sock, nni_msg **msgv, size_t n)
+{
+	if (sock->s_sock_ops.sock_sendv == NULL) {
+		return (0);
+	}
+	return (sock->s_sock_ops.sock_sendv(sock->s_data, msgv, n));
+}
+
+size_t
+nni_sock_recvv(nni_sock *sock, nni_msg **msgv, size_t n)
+{
+	if (sock->s_sock_ops.sock_recvv == NULL) {
+		return (0);
+	}
+	return (sock->s_sock_ops.sock_recvv(sock->s_data, msgv, n));
+}
+
 // nni_sock_protocol returns the socket's 16-bit protocol number.
 uint16_t
 nni_sock_proto(nni_sock *sock)
@@ -822,6 +944,17 @@ nni_sock_reconntimes(nni_sock *sock, nni_duration *rcur, nni_duration *rmax)
 	nni_mtx_unlock(&sock->s_mx);
 }
 
+int
+nni_sock_reconnpend(nni_sock *sock)
+{
+	int rv;
+
+	nni_mtx_lock(&sock->s_mx);
+	rv = sock->s_reconnpend;
+	nni_mtx_unlock(&sock->s_mx);
+	return (rv);
+}
+
 int
 nni_sock_ep_add(nni_sock *s, nni_ep *ep)
 {
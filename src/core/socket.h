@@ -30,6 +30,12 @@ extern int  nni_sock_recvmsg(nni_sock *, nni_msg **, int);
 extern int  nni_sock_sendmsg(nni_sock *, nni_msg *, int);
 extern void nni_sock_send(nni_sock *, nni_aio *);
 extern void nni_sock_recv(nni_sock *, nni_aio *);
+
+// nni_sock_sendv and nni_sock_recvv move a batch of messages without
+// waiting, if the protocol supports that, returning how many were moved.
+// They return zero otherwise, leaving the work to the aio based calls.
+extern size_t nni_sock_sendv(nni_sock *, nni_msg **, size_t);
+extern size_t nni_sock_recvv(nni_sock *, nni_msg **, size_t);
 extern uint32_t nni_sock_id(nni_sock *);
 
 // nni_sock_pipe_add adds the pipe to the socket. It is called by
@@ -58,7 +64,21 @@ extern nni_msgq *nni_sock_recvq(nni_sock *);
 
 extern void nni_sock_reconntimes(nni_sock *, nni_duration *, nni_duration *);
 
+// nni_sock_reconnpend returns the limit on concurrent connection attempts
+// to any one destination, or zero if there is no limit.
+extern int nni_sock_reconnpend(nni_sock *);
+
 // nni_sock_flags returns the socket flags, used to indicate whether read
 // and or write are appropriate for the protocol.
 extern uint32_t nni_sock_flags(nni_sock *);
+
+// nni_sock_add_expired counts messages that were dropped, instead of
+// being sent or delivered, because their deadline passed.  This is
+// reported by the NNG_OPT_EXPIRED option.
+extern void nni_sock_add_expired(nni_sock *, int);
+
+// nni_sock_pipebufsz returns the NNG_OPT_PIPEBUFSZ limit, in bytes, that
+// protocols apply (with nni_msgq_set_maxbytes) to the send queues of the
+// pipes they create.  Zero means no limit.
+extern size_t nni_sock_pipebufsz(nni_sock *);
 #endif // CORE_SOCKET_H
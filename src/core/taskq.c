@@ -17,13 +17,22 @@ struct nni_taskq_thr {
 	nni_task * tqt_running;
 	int        tqt_wait;
 };
+
+// Threads are not started up front, but as they are needed: whenever
+// there are more queued tasks than idle threads, another thread is
+// started, up to the limit given at init time.  So a taskq that never
+// sees work costs no threads at all, while one that does still gets
+// the same concurrency as if all of its threads had been started.
 struct nni_taskq {
 	nni_list       tq_tasks;
 	nni_mtx        tq_mtx;
 	nni_cv         tq_sched_cv;
 	nni_cv         tq_wait_cv;
 	nni_taskq_thr *tq_threads;
-	int            tq_nthreads;
+	int            tq_nthreads; // threads started
+	int            tq_maxthreads;
+	int            tq_nqueued; // tasks on tq_tasks
+	int            tq_idle;    // threads waiting for work
 	int            tq_run;
 	int            tq_waiting;
 };
@@ -41,6 +50,7 @@ nni_taskq_thread(void *self)
 	for (;;) {
 		if ((task = nni_list_first(&tq->tq_tasks)) != NULL) {
 			nni_list_remove(&tq->tq_tasks, task);
+			tq->tq_nqueued--;
 			thr->tqt_running = task;
 			nni_mtx_unlock(&tq->tq_mtx);
 			task->task_cb(task->task_arg);
@@ -62,18 +72,43 @@ nni_taskq_thread(void *self)
 		if (!tq->tq_run) {
 			break;
 		}
+		tq->tq_idle++;
 		nni_cv_wait(&tq->tq_sched_cv);
+		tq->tq_idle--;
 	}
 	nni_mtx_unlock(&tq->tq_mtx);
 }
 
+// nni_taskq_grow starts another thread, if we are below the limit.
+// Failure is not fatal; the work will be done by the threads we have,
+// or if there are none yet, we will try again on the next dispatch.
+static void
+nni_taskq_grow(nni_taskq *tq)
+{
+	nni_taskq_thr *thr;
+
+	if (tq->tq_nthreads >= tq->tq_maxthreads) {
+		return;
+	}
+	thr              = &tq->tq_threads[tq->tq_nthreads];
+	thr->tqt_tq      = tq;
+	thr->tqt_running = NULL;
+	thr->tqt_wait    = 0;
+	if (nni_thr_init(&thr->tqt_thread, nni_taskq_thread, thr) != 0) {
+		return;
+	}
+	tq->tq_nthreads++;
+	nni_thr_run(&thr->tqt_thread);
+}
+
 int
 nni_taskq_init(nni_taskq **tqp, int nthr)
 {
-	int        rv;
 	nni_taskq *tq;
-	int        i;
 
+	if (nthr < 1) {
+		nthr = 1;
+	}
 	if ((tq = NNI_ALLOC_STRUCT(tq)) == NULL) {
 		return (NNG_ENOMEM);
 	}
@@ -82,28 +117,16 @@ nni_taskq_init(nni_taskq **tqp, int nthr)
 		NNI_FREE_STRUCT(tq);
 		return (NNG_ENOMEM);
 	}
-	tq->tq_nthreads = nthr;
+	tq->tq_maxthreads = nthr;
+	tq->tq_nthreads   = 0;
 	NNI_LIST_INIT(&tq->tq_tasks, nni_task, task_node);
 
 	nni_mtx_init(&tq->tq_mtx);
 	nni_cv_init(&tq->tq_sched_cv, &tq->tq_mtx);
 	nni_cv_init(&tq->tq_wait_cv, &tq->tq_mtx);
 
-	for (i = 0; i < nthr; i++) {
-		tq->tq_threads[i].tqt_tq      = tq;
-		tq->tq_threads[i].tqt_running = NULL;
-		rv = nni_thr_init(&tq->tq_threads[i].tqt_thread,
-		    nni_taskq_thread, &tq->tq_threads[i]);
-		if (rv != 0) {
-			nni_taskq_fini(tq);
-			return (rv);
-		}
-	}
 	tq->tq_run = 1;
-	for (i = 0; i < tq->tq_nthreads; i++) {
-		nni_thr_run(&tq->tq_threads[i].tqt_thread);
-	}
-	*tqp = tq;
+	*tqp       = tq;
 	return (0);
 }
 
@@ -163,7 +186,7 @@ nni_taskq_fini(nni_taskq *tq)
 	nni_cv_fini(&tq->tq_wait_cv);
 	nni_cv_fini(&tq->tq_sched_cv);
 	nni_mtx_fini(&tq->tq_mtx);
-	NNI_FREE_STRUCTS(tq->tq_threads, tq->tq_nthreads);
+	NNI_FREE_STRUCTS(tq->tq_threads, tq->tq_maxthreads);
 	NNI_FREE_STRUCT(tq);
 }
 
@@ -181,6 +204,10 @@ nni_task_dispatch(nni_task *task)
 	// It might already be scheduled... if so don't redo it.
 	if (!nni_list_active(&tq->tq_tasks, task)) {
 		nni_list_append(&tq->tq_tasks, task);
+		tq->tq_nqueued++;
+	}
+	if (tq->tq_nqueued > tq->tq_idle) {
+		nni_taskq_grow(tq);
 	}
 	nni_cv_wake1(&tq->tq_sched_cv); // waking just one waiter is adequate
 	nni_mtx_unlock(&tq->tq_mtx);
@@ -245,6 +272,7 @@ nni_task_cancel(nni_task *task)
 
 	if (nni_list_active(&tq->tq_tasks, task)) {
 		nni_list_remove(&tq->tq_tasks, task);
+		tq->tq_nqueued--;
 	}
 	nni_mtx_unlock(&tq->tq_mtx);
 	return (0);
@@ -267,8 +295,8 @@ nni_taskq_sys_init(void)
 {
 	int rv;
 
-	// XXX: Make the "16" = NCPUs * 2
-	rv = nni_taskq_init(&nni_taskq_systq, 16);
+	rv = nni_taskq_init(&nni_taskq_systq,
+	    (int) nni_init_get_param(NNG_INIT_NUM_TASK_THREADS, 16));
 	return (rv);
 }
 
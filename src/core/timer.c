@@ -34,7 +34,6 @@ static nni_timer nni_global_timer;
 int
 nni_timer_sys_init(void)
 {
-	int        rv;
 	nni_timer *timer = &nni_global_timer;
 
 	memset(timer, 0, sizeof(*timer));
@@ -44,13 +43,23 @@ nni_timer_sys_init(void)
 	nni_cv_init(&timer->t_sched_cv, &timer->t_mx);
 	nni_cv_init(&timer->t_wait_cv, &timer->t_mx);
 
-	if ((rv = nni_thr_init(&timer->t_thr, nni_timer_loop, timer)) != 0) {
-		nni_timer_sys_fini();
-		return (rv);
+	// The thread is started when the first timer is scheduled.
+	return (0);
+}
+
+// nni_timer_start starts the timer thread, if it is not running yet.
+// If that fails, we will try again when the next timer is scheduled.
+static void
+nni_timer_start(nni_timer *timer)
+{
+	if (timer->t_run) {
+		return;
+	}
+	if (nni_thr_init(&timer->t_thr, nni_timer_loop, timer) != 0) {
+		return;
 	}
 	timer->t_run = 1;
 	nni_thr_run(&timer->t_thr);
-	return (0);
 }
 
 void
@@ -107,6 +116,7 @@ nni_timer_schedule(nni_timer_node *node, nni_time when)
 	nni_timer_node *srch;
 
 	nni_mtx_lock(&timer->t_mx);
+	nni_timer_start(timer);
 	node->t_expire = when;
 
 	if (nni_list_active(&timer->t_entries, node)) {
@@ -11,6 +11,7 @@
 #include "core/nng_impl.h"
 #include "transport/inproc/inproc.h"
 #include "transport/ipc/ipc.h"
+#include "transport/shm/shm.h"
 #include "transport/tcp/tcp.h"
 #include "transport/tls/tls.h"
 #include "transport/ws/websocket.h"
@@ -142,6 +143,9 @@ static nni_tran_ctor nni_tran_ctors[] = {
 #ifdef NNG_TRANSPORT_IPC
 	nng_ipc_register,
 #endif
+#ifdef NNG_TRANSPORT_SHM
+	nng_shm_register,
+#endif
 #ifdef NNG_TRANSPORT_TCP
 	nng_tcp_register,
 #endif
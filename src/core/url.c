@@ -101,7 +101,7 @@ url_canonify_uri(char **outp, const char *in)
 	if ((out = nni_strdup(in)) == NULL) {
 		return (NNG_ENOMEM);
 	}
-	len = strlen(out);
+	len = strlen(out) + 1;
 
 	// First pass, convert '%xx' for safe characters to unescaped forms.
 	src = dst = 0;
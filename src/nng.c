@@ -30,6 +30,18 @@ nng_fini(void)
 	nni_fini();
 }
 
+void
+nng_init_set_parameter(nng_init_parameter p, uint64_t val)
+{
+	nni_init_set_param(p, val);
+}
+
+int
+nng_init_set_allocator(const nng_allocator *a)
+{
+	return (nni_init_set_allocator(a));
+}
+
 int
 nng_close(nng_socket sid)
 {
@@ -179,6 +191,104 @@ nng_sendmsg(nng_socket sid, nng_msg *msg, int flags)
 	return (rv);
 }
 
+int
+nng_sendmsgv(
+    nng_socket sid, nng_msg **msgv, size_t n, size_t *cntp, int flags)
+{
+	nni_sock *sock;
+	nng_aio * ap  = NULL;
+	size_t    cnt = 0;
+	int       rv  = 0;
+
+	*cntp = 0;
+	if (n == 0) {
+		return (NNG_EINVAL);
+	}
+	if ((rv = nni_sock_find(&sock, sid)) != 0) {
+		return (rv);
+	}
+	while (cnt < n) {
+		// Whatever the protocol takes at once, and then the next
+		// one the ordinary way, which may have to wait for room.
+		if ((cnt += nni_sock_sendv(sock, msgv + cnt, n - cnt)) == n) {
+			break;
+		}
+		if ((ap == NULL) &&
+		    ((rv = nng_aio_alloc(&ap, NULL, NULL)) != 0)) {
+			break;
+		}
+		if (flags & NNG_FLAG_NONBLOCK) {
+			nng_aio_set_timeout(ap, NNG_DURATION_ZERO);
+		} else {
+			nng_aio_set_timeout(ap, NNG_DURATION_DEFAULT);
+		}
+		nng_aio_set_msg(ap, msgv[cnt]);
+		nni_sock_send(sock, ap);
+		nng_aio_wait(ap);
+		if ((rv = nng_aio_result(ap)) != 0) {
+			break;
+		}
+		cnt++;
+	}
+	if (ap != NULL) {
+		nng_aio_free(ap);
+	}
+	nni_sock_rele(sock);
+
+	*cntp = cnt;
+	if (cnt > 0) {
+		return (0);
+	}
+	if ((rv == NNG_ETIMEDOUT) && (flags == NNG_FLAG_NONBLOCK)) {
+		rv = NNG_EAGAIN;
+	}
+	return (rv);
+}
+
+int
+nng_recvmsgv(
+    nng_socket sid, nng_msg **msgv, size_t n, size_t *cntp, int flags)
+{
+	nni_sock *sock;
+	nng_aio * ap;
+	size_t    cnt;
+	int       rv;
+
+	*cntp = 0;
+	if (n == 0) {
+		return (NNG_EINVAL);
+	}
+	if ((rv = nni_sock_find(&sock, sid)) != 0) {
+		return (rv);
+	}
+	if ((cnt = nni_sock_recvv(sock, msgv, n)) == 0) {
+		// Nothing ready, so wait for one the ordinary way.
+		if ((rv = nng_aio_alloc(&ap, NULL, NULL)) != 0) {
+			nni_sock_rele(sock);
+			return (rv);
+		}
+		if (flags & NNG_FLAG_NONBLOCK) {
+			nng_aio_set_timeout(ap, NNG_DURATION_ZERO);
+		} else {
+			nng_aio_set_timeout(ap, NNG_DURATION_DEFAULT);
+		}
+		nni_sock_recv(sock, ap);
+		nng_aio_wait(ap);
+		if ((rv = nng_aio_result(ap)) == 0) {
+			msgv[cnt++] = nng_aio_get_msg(ap);
+			cnt += nni_sock_recvv(sock, msgv + cnt, n - cnt);
+		} else if ((rv == NNG_ETIMEDOUT) &&
+		    (flags == NNG_FLAG_NONBLOCK)) {
+			rv = NNG_EAGAIN;
+		}
+		nng_aio_free(ap);
+	}
+	nni_sock_rele(sock);
+
+	*cntp = cnt;
+	return (rv);
+}
+
 void
 nng_recv_aio(nng_socket sid, nng_aio *aio)
 {
@@ -827,9 +937,21 @@ nng_pipe_close(nng_pipe id)
 }
 
 // Message handling.
+void
+nng_bufpool_get_stats(nng_bufpool_stats *stats)
+{
+	nni_bufpool_stats(stats);
+}
+
 int
 nng_msg_alloc(nng_msg **msgp, size_t size)
 {
+	int rv;
+
+	// Initialize first, so that the message comes from the pool.
+	if ((rv = nni_init()) != 0) {
+		return (rv);
+	}
 	return (nni_msg_alloc(msgp, size));
 }
 
@@ -1011,6 +1133,25 @@ nng_msg_set_pipe(nng_msg *msg, nng_pipe p)
 	nni_msg_set_pipe(msg, p);
 }
 
+void
+nng_msg_set_timeout(nng_msg *msg, nng_duration dur)
+{
+	nni_msg_set_expire(msg, dur < 0 ? 0 : nni_clock() + dur);
+}
+
+nng_duration
+nng_msg_get_timeout(const nng_msg *msg)
+{
+	nni_time expire;
+	nni_time now;
+
+	if ((expire = nni_msg_get_expire(msg)) == 0) {
+		return (NNG_DURATION_INFINITE);
+	}
+	now = nni_clock();
+	return (now >= expire ? 0 : (nng_duration)(expire - now));
+}
+
 int
 nng_msg_getopt(nng_msg *msg, int opt, void *ptr, size_t *szp)
 {
@@ -84,6 +84,72 @@ typedef struct nng_iov {
 // as memory leaks.  In those cases, we recommend doing this with atexit().
 NNG_DECL void nng_fini(void);
 
+// Initialization parameters.  The library starts up on first use, and
+// starts its threads lazily as the subsystems that need them are used.
+// These parameters bound how many threads each subsystem may use.  They
+// are only consulted at startup, so nng_init_set_parameter must be called
+// before any other function in this library (or after nng_fini) to have
+// any effect.  It is not thread safe.
+typedef enum nng_init_parameter {
+	NNG_INIT_PARAMETER_NONE = 0,
+	// Maximum number of threads running completion callbacks.
+	// The default is 16.
+	NNG_INIT_NUM_TASK_THREADS,
+	// Number of I/O poller threads.  The default is the number of
+	// online processors, but not more than 8.  (POSIX only.)
+	NNG_INIT_NUM_POLLER_THREADS,
+	// Maximum number of threads doing name resolution.  The default
+	// is 4.  Zero disables the resolver: only numeric addresses can be
+	// used, and they are converted in the calling thread.
+	NNG_INIT_NUM_RESOLVER_THREADS,
+	// Maximum bytes of free message buffers each thread may cache.
+	// The default is 256 KB.  Zero disables the buffer pool.
+	NNG_INIT_BUFPOOL_THREAD_CACHE,
+	// Maximum bytes of free message buffers kept in the pool shared
+	// by all threads.  The default is 4 MB.
+	NNG_INIT_BUFPOOL_SHARED_CACHE,
+} nng_init_parameter;
+
+NNG_DECL void nng_init_set_parameter(nng_init_parameter, uint64_t);
+
+// Allocator hooks.  All memory the library allocates, including message
+// buffers and transport buffers, is obtained from na_alloc and returned
+// with na_free, which is given the same size that was allocated.  Message
+// buffers too large to be pooled (over 64 KB) use na_alloc_large and
+// na_free_large instead, when both are supplied.  Memory returned by the
+// hooks need not be zeroed.  The hooks may be called concurrently from
+// any thread, and must not call back into this library.
+typedef struct nng_allocator {
+	void *(*na_alloc)(size_t, void *);
+	void (*na_free)(void *, size_t, void *);
+	void *(*na_alloc_large)(size_t, void *);
+	void (*na_free_large)(void *, size_t, void *);
+	void *na_arg;
+} nng_allocator;
+
+// nng_init_set_allocator installs allocator hooks, or restores the
+// default (the C library) if NULL is passed.  Like the initialization
+// parameters, it must be called before any other function in this
+// library, or after nng_fini.  It is not thread safe.  The hooks are
+// copied.  Memory obtained from nng_alloc (or returned by the library,
+// such as strings) must be freed before the allocator is changed.
+NNG_DECL int nng_init_set_allocator(const nng_allocator *);
+
+// Message buffer pool statistics.  Message buffers up to 64 KB are
+// recycled through per-thread caches; these counters report how well
+// that is working.  They are updated in batches, and so may lag by a
+// few hundred operations per thread.
+typedef struct nng_bufpool_stats {
+	uint64_t s_allocs;  // buffer allocations eligible for pooling
+	uint64_t s_hits;    // allocations satisfied from the pool
+	uint64_t s_refills; // batches moved from the shared pool to a thread
+	uint64_t s_drains;  // batches moved from a thread to the shared pool
+	uint64_t s_cached;  // bytes of free buffers currently held
+} nng_bufpool_stats;
+
+// nng_bufpool_get_stats obtains the current buffer pool statistics.
+NNG_DECL void nng_bufpool_get_stats(nng_bufpool_stats *);
+
 // nng_close closes the socket, terminating all activity and
 // closing any underlying connections and releasing any associated
 // resources.
@@ -230,6 +296,20 @@ NNG_DECL int nng_sendmsg(nng_socket, nng_msg *, int);
 // can be passed off directly to nng_sendmsg.
 NNG_DECL int nng_recvmsg(nng_socket, nng_msg **, int);
 
+// nng_sendmsgv sends a batch of messages, in order, storing the number
+// sent in the last but one argument; the socket owns those, and the
+// caller keeps the rest.  Each message waits for room as nng_sendmsg
+// would, but protocols that support batches (PUSH and PUB) take as many
+// as their queue has room for in one step.  It fails only if no message
+// at all could be sent.
+NNG_DECL int nng_sendmsgv(nng_socket, nng_msg **, size_t, size_t *, int);
+
+// nng_recvmsgv waits, as nng_recvmsg would, for at least one message,
+// and then returns as many more as are already queued, up to the given
+// number, storing the count.  Protocols without batch support (all but
+// PULL and SUB) return a single message each time.
+NNG_DECL int nng_recvmsgv(nng_socket, nng_msg **, size_t, size_t *, int);
+
 // nng_send_aio sends data on the socket asynchronously.  As with nng_send,
 // the completion may be executed before the data has actually been delivered,
 // but only when it is accepted for delivery.  The supplied AIO must have
@@ -382,6 +462,16 @@ NNG_DECL void nng_msg_clear(nng_msg *);
 NNG_DECL void nng_msg_header_clear(nng_msg *);
 NNG_DECL void nng_msg_set_pipe(nng_msg *, nng_pipe);
 NNG_DECL nng_pipe nng_msg_get_pipe(const nng_msg *);
+
+// nng_msg_set_timeout gives the message a deadline, the given time from
+// now.  Once it passes, the message is stale: socket and pipe queues,
+// PUB and PUSH, and devices drop it rather than send or deliver it, and
+// count it in NNG_OPT_EXPIRED.  The deadline is local; it is not sent
+// to the peer.  A negative duration (NNG_DURATION_INFINITE) removes it.
+// nng_msg_get_timeout returns the time left, which is zero once the
+// deadline has passed, or NNG_DURATION_INFINITE if there is none.
+NNG_DECL void         nng_msg_set_timeout(nng_msg *, nng_duration);
+NNG_DECL nng_duration nng_msg_get_timeout(const nng_msg *);
 NNG_DECL int      nng_msg_getopt(nng_msg *, int, void *, size_t *);
 
 // Pipe API. Generally pipes are only "observable" to applications, but
@@ -421,6 +511,72 @@ enum nng_flag_enum {
 #define NNG_OPT_RECVMAXSZ "recv-size-max"
 #define NNG_OPT_RECONNMINT "reconnect-time-min"
 #define NNG_OPT_RECONNMAXT "reconnect-time-max"
+#define NNG_OPT_RECONNMAXPEND "reconnect-pending-max"
+
+// NNG_OPT_EXPIRED is a read-only uint64_t socket option, counting the
+// messages the socket has dropped because their deadline passed (see
+// nng_msg_set_timeout).
+#define NNG_OPT_EXPIRED "expired"
+
+// NNG_OPT_RECVBUFSZ and NNG_OPT_SENDBUFSZ are size_t socket options that
+// limit the socket's receive and send queues by the bytes (header and
+// body) of the messages held, in addition to the message counts set by
+// NNG_OPT_RECVBUF and NNG_OPT_SENDBUF.  NNG_OPT_PIPEBUFSZ does the same
+// for the send queue each pipe has (including the PUSH per-pipe queue,
+// and the PUB conflation queue), for pipes added after it is set.
+// A message that would exceed the limit is treated as if the queue were
+// full: a blocking send waits, while protocols that never block (PUB,
+// BUS, SURVEYOR) drop it.  An empty queue accepts any one message, so
+// a single message larger than the limit still gets through.  Zero, the
+// default, is no limit.
+#define NNG_OPT_RECVBUFSZ "recv-buffer-bytes"
+#define NNG_OPT_SENDBUFSZ "send-buffer-bytes"
+#define NNG_OPT_PIPEBUFSZ "pipe-buffer-bytes"
+
+// NNG_OPT_TCP_LISTENERS is an integer option for listeners on TCP based
+// transports (tcp, tls+tcp, ws, wss), setting the number of listening
+// sockets to open on the address.  When larger than one, the sockets
+// share the port using SO_REUSEPORT, letting the kernel spread new
+// connections across them, and each is serviced by a separate poller
+// thread.  It must be set before the listener is started.  The default
+// is one.  Platforms without SO_REUSEPORT only accept the value one.
+// Dialers reject it with NNG_ENOTSUP.
+#define NNG_OPT_TCP_LISTENERS "tcp-listeners"
+
+// NNG_OPT_SEND_BATCH is a size_t option for dialers and listeners on the
+// tcp and ipc transports, enabling send batching on their pipes.  Small
+// messages are copied, framed exactly as they would be sent, into a
+// buffer of this size, and written together, rather than each with a
+// write of its own.  A batch is written as soon as the previous write
+// finishes, so nothing waits while the connection is idle, unless
+// NNG_OPT_SEND_BATCH_TIME (an nng_duration) is set, in which case an
+// idle connection waits up to that long for the batch to fill.  Sends
+// complete as soon as the message is batched, so a failed write is
+// reported by the next send instead.  Messages too large for the buffer
+// are sent by themselves.  The wire format is unchanged.  Both default
+// to zero, which turns batching off; they affect pipes created later.
+#define NNG_OPT_SEND_BATCH "send-batch"
+#define NNG_OPT_SEND_BATCH_TIME "send-batch-time"
+
+// Load balancing options apply to protocols that send each message to
+// just one of their peers (PUSH, and REQ in cooked mode).  NNG_OPT_LB_POLICY
+// is an integer selecting one of the nng_lb_policy values below, and
+// NNG_OPT_LB_HASHLEN is a size_t giving the number of leading body bytes
+// used as the key for NNG_LB_HASH (zero means the whole body).
+// NNG_OPT_LB_WEIGHT is an integer option on dialers and listeners,
+// giving the relative weight (1-1000, default 1) of the pipes they
+// create, as used by NNG_LB_WEIGHTED.
+#define NNG_OPT_LB_POLICY "lb-policy"
+#define NNG_OPT_LB_HASHLEN "lb-hash-length"
+#define NNG_OPT_LB_WEIGHT "lb-weight"
+
+enum nng_lb_policy {
+	NNG_LB_ROUND_ROBIN   = 0, // Rotate over peers that can take a message.
+	NNG_LB_LEAST_PENDING = 1, // Peer with the fewest outstanding messages.
+	NNG_LB_TWO_CHOICES   = 2, // Better of two random peers, by latency.
+	NNG_LB_WEIGHTED      = 3, // Weighted round robin.
+	NNG_LB_HASH          = 4, // Consistent hashing on a message key.
+};
 
 // TLS options are only used when the underlying transport supports TLS.
 
@@ -15,13 +15,13 @@
 
 // POSIX memory allocation.  This is pretty much standard C.
 void *
-nni_alloc(size_t sz)
+nni_plat_alloc(size_t sz)
 {
 	return (calloc(1, sz));
 }
 
 void
-nni_free(void *ptr, size_t size)
+nni_plat_free(void *ptr, size_t size)
 {
 	NNI_ARG_UNUSED(size);
 	free(ptr);
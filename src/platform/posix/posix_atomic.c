@@ -0,0 +1,68 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+// POSIX atomics.  We rely on the GCC style builtins, which are also
+// provided by clang and the other compilers we care about on these
+// platforms.
+
+#include "core/nng_impl.h"
+
+#ifdef NNG_PLATFORM_POSIX
+
+uint32_t
+nni_plat_atomic_load32(uint32_t *v)
+{
+	return (__atomic_load_n(v, __ATOMIC_SEQ_CST));
+}
+
+void
+nni_plat_atomic_store32(uint32_t *v, uint32_t n)
+{
+	__atomic_store_n(v, n, __ATOMIC_SEQ_CST);
+}
+
+bool
+nni_plat_atomic_cas32(uint32_t *v, uint32_t old, uint32_t n)
+{
+	return (__atomic_compare_exchange_n(
+	    v, &old, n, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+}
+
+uint32_t
+nni_plat_atomic_add32(uint32_t *v, int32_t delta)
+{
+	return (__atomic_add_fetch(v, (uint32_t) delta, __ATOMIC_SEQ_CST));
+}
+
+uint64_t
+nni_plat_atomic_load64(uint64_t *v)
+{
+	return (__atomic_load_n(v, __ATOMIC_SEQ_CST));
+}
+
+uint64_t
+nni_plat_atomic_add64(uint64_t *v, int64_t delta)
+{
+	return (__atomic_add_fetch(v, (uint64_t) delta, __ATOMIC_SEQ_CST));
+}
+
+void *
+nni_plat_atomic_load_ptr(void **v)
+{
+	return (__atomic_load_n(v, __ATOMIC_SEQ_CST));
+}
+
+void
+nni_plat_atomic_store_ptr(void **v, void *n)
+{
+	__atomic_store_n(v, n, __ATOMIC_SEQ_CST);
+}
+
+#endif // NNG_PLATFORM_POSIX
@@ -37,6 +37,69 @@ nni_plat_clock(void)
 	return (msec);
 }
 
+// Linux has coarse versions of its clocks, which just read the time of
+// the last scheduler tick, and are several times cheaper than the
+// precise ones.  The coarse clock must be the counterpart of
+// NNG_USE_CLOCKID, as otherwise the two would not share a base.
+#if defined(CLOCK_REALTIME_COARSE) && (NNG_USE_CLOCKID == CLOCK_REALTIME)
+#define NNG_POSIX_CLOCK_COARSE CLOCK_REALTIME_COARSE
+#elif defined(CLOCK_MONOTONIC_COARSE) && defined(CLOCK_MONOTONIC) && \
+    (NNG_USE_CLOCKID == CLOCK_MONOTONIC)
+#define NNG_POSIX_CLOCK_COARSE CLOCK_MONOTONIC_COARSE
+#endif
+
+// Ticks longer than this are too coarse for deadlines to be useful.
+#ifndef NNG_POSIX_CLOCK_COARSE_MAX
+#define NNG_POSIX_CLOCK_COARSE_MAX 10
+#endif
+
+#ifdef NNG_POSIX_CLOCK_COARSE
+
+static int nni_posix_clock_coarse_ok = 0;
+
+void
+nni_posix_clock_sysinit(void)
+{
+	struct timespec ts;
+
+	if ((clock_getres(NNG_POSIX_CLOCK_COARSE, &ts) == 0) &&
+	    (ts.tv_sec == 0) &&
+	    (ts.tv_nsec <= NNG_POSIX_CLOCK_COARSE_MAX * 1000000)) {
+		nni_posix_clock_coarse_ok = 1;
+	}
+}
+
+nni_time
+nni_plat_clock_coarse(void)
+{
+	struct timespec ts;
+	nni_time        msec;
+
+	if ((!nni_posix_clock_coarse_ok) ||
+	    (clock_gettime(NNG_POSIX_CLOCK_COARSE, &ts) != 0)) {
+		return (nni_plat_clock());
+	}
+	msec = ts.tv_sec;
+	msec *= 1000;
+	msec += (ts.tv_nsec / 1000000);
+	return (msec);
+}
+
+#else // NNG_POSIX_CLOCK_COARSE
+
+void
+nni_posix_clock_sysinit(void)
+{
+}
+
+nni_time
+nni_plat_clock_coarse(void)
+{
+	return (nni_plat_clock());
+}
+
+#endif // NNG_POSIX_CLOCK_COARSE
+
 void
 nni_plat_sleep(nni_duration ms)
 {
@@ -85,6 +148,17 @@ nni_plat_clock(void)
 	return (ms);
 }
 
+void
+nni_posix_clock_sysinit(void)
+{
+}
+
+nni_time
+nni_plat_clock_coarse(void)
+{
+	return (nni_plat_clock());
+}
+
 void
 nni_plat_sleep(nni_duration ms)
 {
@@ -13,6 +13,7 @@
 #ifdef NNG_PLATFORM_POSIX
 #include "platform/posix/posix_aio.h"
 #include "platform/posix/posix_pollq.h"
+#include "platform/posix/posix_uring.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -33,6 +34,38 @@
 #define NNI_STREAM_SOCKTYPE SOCK_STREAM
 #endif
 
+// NNI_POSIX_ACCEPT_BATCH is the most connections we will accept from a
+// listener in response to a single readiness event.  Connections accepted
+// before anyone has asked for them are parked, and handed out directly by
+// later accept calls, without another trip through the poller.
+#define NNI_POSIX_ACCEPT_BATCH 16
+
+#ifdef NNG_HAVE_IO_URING
+// When io_uring is in use, accepts and connects are submitted to the
+// kernel, instead of waiting for readiness.  Each listening socket has an
+// operation of its own, as does the connection attempt.  An accepted
+// connection goes to the first waiting aio, or is parked as for a batch,
+// so an aio that is canceled never loses one.
+typedef struct {
+	nni_posix_uring_op op;
+	nni_posix_epdesc * ed;
+	int                fd;   // socket the operation is on
+	bool               busy; // operation submitted to the kernel
+} nni_posix_epdesc_io;
+#endif
+
+// nni_posix_epshard is an additional listening socket, bound to the same
+// address as the primary one with SO_REUSEPORT.  The kernel spreads new
+// connections across the shards, and each shard is serviced by its own
+// pollq, so accept work is not limited to a single thread.
+typedef struct nni_posix_epshard {
+	nni_posix_pollq_node node;
+	nni_posix_epdesc *   ed;
+#ifdef NNG_HAVE_IO_URING
+	nni_posix_epdesc_io io;
+#endif
+} nni_posix_epshard;
+
 struct nni_posix_epdesc {
 	nni_posix_pollq_node    node;
 	nni_list                connectq;
@@ -42,7 +75,19 @@ struct nni_posix_epdesc {
 	struct sockaddr_storage remaddr;
 	socklen_t               loclen;
 	socklen_t               remlen;
+	int                     nlisten; // requested listening sockets
+	nni_posix_epshard *     shards;  // listeners beyond the first
+	int                     nshards;
+	int                     pending[NNI_POSIX_ACCEPT_BATCH];
+	int                     pendhead;
+	int                     npending;
 	nni_mtx                 mtx;
+#ifdef NNG_HAVE_IO_URING
+	bool                uring; // use io_uring instead of the poller
+	nni_posix_epdesc_io lio;   // accept on the primary listener
+	nni_posix_epdesc_io cio;   // connect
+	nni_cv              cv;    // signaled when kernel operations finish
+#endif
 };
 
 static void
@@ -52,6 +97,13 @@ nni_posix_epdesc_cancel(nni_aio *aio, int rv)
 
 	NNI_ASSERT(rv != 0);
 	nni_mtx_lock(&ed->mtx);
+#ifdef NNG_HAVE_IO_URING
+	if (ed->cio.busy && (nni_list_first(&ed->connectq) == aio)) {
+		// The attempt in the kernel is for this one.  Its completion
+		// closes the socket, and starts the next one, if any.
+		nni_posix_uring_cancel(&ed->cio.op);
+	}
+#endif
 	if (nni_aio_list_active(aio)) {
 		nni_aio_list_remove(aio);
 		nni_aio_finish_error(aio, rv);
@@ -126,25 +178,76 @@ nni_posix_epdesc_doconnect(nni_posix_epdesc *ed)
 }
 
 static void
-nni_posix_epdesc_doaccept(nni_posix_epdesc *ed)
+nni_posix_epdesc_arm_accept(nni_posix_epdesc *ed)
+{
+	nni_posix_pollq_arm(&ed->node, POLLIN);
+	for (int i = 0; i < ed->nshards; i++) {
+		nni_posix_pollq_arm(&ed->shards[i].node, POLLIN);
+	}
+}
+
+static int
+nni_posix_epdesc_pending_get(nni_posix_epdesc *ed)
+{
+	int fd;
+
+	NNI_ASSERT(ed->npending > 0);
+	fd           = ed->pending[ed->pendhead];
+	ed->pendhead = (ed->pendhead + 1) % NNI_POSIX_ACCEPT_BATCH;
+	ed->npending--;
+	return (fd);
+}
+
+static void
+nni_posix_epdesc_pending_put(nni_posix_epdesc *ed, int fd)
+{
+	int idx;
+
+	NNI_ASSERT(ed->npending < NNI_POSIX_ACCEPT_BATCH);
+	idx = (ed->pendhead + ed->npending) % NNI_POSIX_ACCEPT_BATCH;
+	ed->pending[idx] = fd;
+	ed->npending++;
+}
+
+static void
+nni_posix_epdesc_doaccept(nni_posix_epdesc *ed, nni_posix_pollq_node *node)
 {
 	nni_aio *aio;
 	int      newfd;
 
-	while ((aio = nni_list_first(&ed->acceptq)) != NULL) {
+	// Connections parked by an earlier batch are handed out first.
+	while ((ed->npending > 0) &&
+	    ((aio = nni_list_first(&ed->acceptq)) != NULL)) {
+		newfd = nni_posix_epdesc_pending_get(ed);
+		nni_posix_epdesc_finish(aio, 0, newfd);
+	}
+
+	// Drain up to a batch worth of connections.  If there are more
+	// than that, the listener stays readable and we will be called
+	// again; this keeps one busy listener from starving the others.
+	for (int n = 0; n < NNI_POSIX_ACCEPT_BATCH; n++) {
+		aio = nni_list_first(&ed->acceptq);
+		if ((aio == NULL) &&
+		    (ed->npending == NNI_POSIX_ACCEPT_BATCH)) {
+			return;
+		}
 
 #ifdef NNG_USE_ACCEPT4
-		newfd = accept4(ed->node.fd, NULL, NULL, SOCK_CLOEXEC);
+		newfd = accept4(node->fd, NULL, NULL, SOCK_CLOEXEC);
 		if ((newfd < 0) && ((errno == ENOSYS) || (errno == ENOTSUP))) {
-			newfd = accept(ed->node.fd, NULL, NULL);
+			newfd = accept(node->fd, NULL, NULL);
 		}
 #else
-		newfd = accept(ed->node.fd, NULL, NULL);
+		newfd = accept(node->fd, NULL, NULL);
 #endif
 
 		if (newfd >= 0) {
 			// successful connection request!
-			nni_posix_epdesc_finish(aio, 0, newfd);
+			if (aio != NULL) {
+				nni_posix_epdesc_finish(aio, 0, newfd);
+			} else {
+				nni_posix_epdesc_pending_put(ed, newfd);
+			}
 			continue;
 		}
 
@@ -165,18 +268,22 @@ nni_posix_epdesc_doaccept(nni_posix_epdesc *ed)
 			continue;
 		}
 
+		if (aio == NULL) {
+			// Nobody to report it to; try again later.
+			return;
+		}
 		nni_posix_epdesc_finish(aio, nni_plat_errno(errno), 0);
 	}
 }
 
 static void
-nni_posix_epdesc_doerror(nni_posix_epdesc *ed)
+nni_posix_epdesc_doerror(nni_posix_epdesc *ed, nni_posix_pollq_node *node)
 {
 	nni_aio * aio;
 	int       rv = 1;
 	socklen_t sz = sizeof(rv);
 
-	if (getsockopt(ed->node.fd, SOL_SOCKET, SO_ERROR, &rv, &sz) < 0) {
+	if (getsockopt(node->fd, SOL_SOCKET, SO_ERROR, &rv, &sz) < 0) {
 		rv = errno;
 	}
 	if (rv == 0) {
@@ -192,6 +299,187 @@ nni_posix_epdesc_doerror(nni_posix_epdesc *ed)
 	}
 }
 
+// nni_posix_epdesc_socket opens a socket for a connection attempt, bound
+// to the local address if there is one.
+static int
+nni_posix_epdesc_socket(nni_posix_epdesc *ed, int *fdp)
+{
+	int fd;
+	int rv;
+
+	if ((fd = socket(ed->remaddr.ss_family, NNI_STREAM_SOCKTYPE, 0)) < 0) {
+		return (nni_plat_errno(errno));
+	}
+	if ((ed->loclen != 0) &&
+	    (bind(fd, (void *) &ed->locaddr, ed->loclen) != 0)) {
+		rv = nni_plat_errno(errno);
+		(void) close(fd);
+		return (rv);
+	}
+	*fdp = fd;
+	return (0);
+}
+
+#ifdef NNG_HAVE_IO_URING
+static bool
+nni_posix_epdesc_uring_busy(nni_posix_epdesc *ed)
+{
+	if (ed->lio.busy || ed->cio.busy) {
+		return (true);
+	}
+	for (int i = 0; i < ed->nshards; i++) {
+		if (ed->shards[i].io.busy) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+// nni_posix_epdesc_uring_accept1 submits an accept on one listening
+// socket, unless one is already in flight.  Every connection accepted
+// must have somewhere to go, so we never have more accepts in flight
+// than there is room to park them.
+static int
+nni_posix_epdesc_uring_accept1(
+    nni_posix_epdesc *ed, nni_posix_epdesc_io *io, int fd, int *nbusy)
+{
+	int rv;
+
+	if (io->busy) {
+		(*nbusy)++;
+		return (0);
+	}
+	if ((fd == -1) ||
+	    ((*nbusy + ed->npending) >= NNI_POSIX_ACCEPT_BATCH)) {
+		return (0);
+	}
+	if ((rv = nni_posix_uring_accept(&io->op, fd, SOCK_CLOEXEC)) != 0) {
+		return (rv);
+	}
+	io->fd   = fd;
+	io->busy = true;
+	(*nbusy)++;
+	return (0);
+}
+
+// nni_posix_epdesc_uring_accept makes sure an accept is in flight on
+// each listening socket, while anyone is waiting for a connection.
+static void
+nni_posix_epdesc_uring_accept(nni_posix_epdesc *ed)
+{
+	nni_aio *aio;
+	int      nbusy = 0;
+	int      rv;
+
+	if (ed->closed || nni_list_empty(&ed->acceptq)) {
+		return;
+	}
+	rv = nni_posix_epdesc_uring_accept1(ed, &ed->lio, ed->node.fd, &nbusy);
+	for (int i = 0; i < ed->nshards; i++) {
+		nni_posix_epshard *sh = &ed->shards[i];
+		int rv2 = nni_posix_epdesc_uring_accept1(
+		    ed, &sh->io, sh->node.fd, &nbusy);
+		if (rv2 != 0) {
+			rv = rv2;
+		}
+	}
+	if ((nbusy == 0) && (rv != 0) &&
+	    ((aio = nni_list_first(&ed->acceptq)) != NULL)) {
+		// Nothing will complete it otherwise.
+		nni_posix_epdesc_finish(aio, rv, 0);
+	}
+}
+
+static void
+nni_posix_epdesc_uring_accept_cb(void *arg, int res)
+{
+	nni_posix_epdesc_io *io = arg;
+	nni_posix_epdesc *   ed = io->ed;
+	nni_aio *            aio;
+
+	nni_mtx_lock(&ed->mtx);
+	io->busy = false;
+	if (res >= 0) {
+		if (ed->closed) {
+			(void) close(res);
+		} else if ((aio = nni_list_first(&ed->acceptq)) != NULL) {
+			nni_posix_epdesc_finish(aio, 0, res);
+		} else {
+			nni_posix_epdesc_pending_put(ed, res);
+		}
+	} else if ((!ed->closed) && (res != -ECANCELED) &&
+	    (res != -EAGAIN) && (res != -EINTR) && (res != -ECONNABORTED) &&
+	    (res != -ECONNRESET) &&
+	    ((aio = nni_list_first(&ed->acceptq)) != NULL)) {
+		// As with the poller, connections that went away before
+		// we got to them are not reported.
+		nni_posix_epdesc_finish(aio, nni_plat_errno(-res), 0);
+	}
+	nni_posix_epdesc_uring_accept(ed);
+	if (!nni_posix_epdesc_uring_busy(ed)) {
+		nni_cv_wake(&ed->cv);
+	}
+	nni_mtx_unlock(&ed->mtx);
+}
+
+// nni_posix_epdesc_uring_connect starts a connection attempt for the
+// first aio on the connect queue, unless one is already in flight.
+static void
+nni_posix_epdesc_uring_connect(nni_posix_epdesc *ed)
+{
+	nni_aio *aio;
+	int      fd;
+	int      rv;
+
+	while ((!ed->cio.busy) && (!ed->closed) &&
+	    ((aio = nni_list_first(&ed->connectq)) != NULL)) {
+		if ((rv = nni_posix_epdesc_socket(ed, &fd)) == 0) {
+			rv = nni_posix_uring_connect(&ed->cio.op, fd,
+			    (void *) &ed->remaddr, ed->remlen);
+			if (rv == 0) {
+				ed->cio.fd   = fd;
+				ed->cio.busy = true;
+				return;
+			}
+			(void) close(fd);
+		}
+		nni_posix_epdesc_finish(aio, rv, 0);
+	}
+}
+
+static void
+nni_posix_epdesc_uring_connect_cb(void *arg, int res)
+{
+	nni_posix_epdesc *ed = arg;
+	nni_aio *         aio;
+	int               fd;
+
+	nni_mtx_lock(&ed->mtx);
+	fd           = ed->cio.fd;
+	ed->cio.fd   = -1;
+	ed->cio.busy = false;
+	aio          = nni_list_first(&ed->connectq);
+	if ((res == 0) && (aio != NULL)) {
+		nni_posix_epdesc_finish(aio, 0, fd);
+	} else {
+		// If the attempt was canceled, it was for an aio that is
+		// gone, so the one now waiting (if any) gets a new one.
+		(void) close(fd);
+		if ((res != 0) && (res != -ECANCELED) && (aio != NULL)) {
+			if (res == -ENOENT) {
+				res = -ECONNREFUSED;
+			}
+			nni_posix_epdesc_finish(aio, nni_plat_errno(-res), 0);
+		}
+	}
+	nni_posix_epdesc_uring_connect(ed);
+	if (!nni_posix_epdesc_uring_busy(ed)) {
+		nni_cv_wake(&ed->cv);
+	}
+	nni_mtx_unlock(&ed->mtx);
+}
+#endif // NNG_HAVE_IO_URING
+
 static void
 nni_posix_epdesc_doclose(nni_posix_epdesc *ed)
 {
@@ -200,6 +488,21 @@ nni_posix_epdesc_doclose(nni_posix_epdesc *ed)
 	int                 fd;
 
 	ed->closed = true;
+#ifdef NNG_HAVE_IO_URING
+	// Operations in flight finish with their completions, which the
+	// cancellation (and for accepts, the shutdown below) hastens.
+	if (ed->lio.busy) {
+		nni_posix_uring_cancel(&ed->lio.op);
+	}
+	if (ed->cio.busy) {
+		nni_posix_uring_cancel(&ed->cio.op);
+	}
+	for (int i = 0; i < ed->nshards; i++) {
+		if (ed->shards[i].io.busy) {
+			nni_posix_uring_cancel(&ed->shards[i].io.op);
+		}
+	}
+#endif
 	while ((aio = nni_list_first(&ed->acceptq)) != NULL) {
 		nni_posix_epdesc_finish(aio, NNG_ECLOSED, 0);
 	}
@@ -209,6 +512,20 @@ nni_posix_epdesc_doclose(nni_posix_epdesc *ed)
 
 	nni_posix_pollq_remove(&ed->node);
 
+	while (ed->npending > 0) {
+		(void) close(nni_posix_epdesc_pending_get(ed));
+	}
+	for (int i = 0; i < ed->nshards; i++) {
+		nni_posix_epshard *sh = &ed->shards[i];
+
+		nni_posix_pollq_remove(&sh->node);
+		if ((fd = sh->node.fd) != -1) {
+			sh->node.fd = -1;
+			(void) shutdown(fd, SHUT_RDWR);
+			(void) close(fd);
+		}
+	}
+
 	if ((fd = ed->node.fd) != -1) {
 		ed->node.fd = -1;
 		(void) shutdown(fd, SHUT_RDWR);
@@ -229,13 +546,13 @@ nni_posix_epdesc_cb(void *arg)
 	nni_mtx_lock(&ed->mtx);
 
 	if (ed->node.revents & POLLIN) {
-		nni_posix_epdesc_doaccept(ed);
+		nni_posix_epdesc_doaccept(ed, &ed->node);
 	}
 	if (ed->node.revents & POLLOUT) {
 		nni_posix_epdesc_doconnect(ed);
 	}
 	if (ed->node.revents & (POLLERR | POLLHUP)) {
-		nni_posix_epdesc_doerror(ed);
+		nni_posix_epdesc_doerror(ed, &ed->node);
 	}
 	if (ed->node.revents & POLLNVAL) {
 		nni_posix_epdesc_doclose(ed);
@@ -245,12 +562,34 @@ nni_posix_epdesc_cb(void *arg)
 	if (!nni_list_empty(&ed->connectq)) {
 		events |= POLLOUT;
 	}
-	if (!nni_list_empty(&ed->acceptq)) {
-		events |= POLLIN;
-	}
 	if ((!ed->closed) && (events != 0)) {
 		nni_posix_pollq_arm(&ed->node, events);
 	}
+	if ((!ed->closed) && (!nni_list_empty(&ed->acceptq))) {
+		nni_posix_epdesc_arm_accept(ed);
+	}
+	nni_mtx_unlock(&ed->mtx);
+}
+
+static void
+nni_posix_epdesc_shard_cb(void *arg)
+{
+	nni_posix_epshard *sh = arg;
+	nni_posix_epdesc * ed = sh->ed;
+
+	nni_mtx_lock(&ed->mtx);
+	if (sh->node.revents & POLLIN) {
+		nni_posix_epdesc_doaccept(ed, &sh->node);
+	}
+	if (sh->node.revents & (POLLERR | POLLHUP)) {
+		nni_posix_epdesc_doerror(ed, &sh->node);
+	}
+	if (sh->node.revents & POLLNVAL) {
+		nni_posix_epdesc_doclose(ed);
+	}
+	if ((!ed->closed) && (!nni_list_empty(&ed->acceptq))) {
+		nni_posix_epdesc_arm_accept(ed);
+	}
 	nni_mtx_unlock(&ed->mtx);
 }
 
@@ -262,21 +601,18 @@ nni_posix_epdesc_close(nni_posix_epdesc *ed)
 	nni_mtx_unlock(&ed->mtx);
 }
 
-int
-nni_posix_epdesc_listen(nni_posix_epdesc *ed)
+static int
+nni_posix_epdesc_listen1(nni_posix_epdesc *ed, int *fdp)
 {
 	int                      len;
 	struct sockaddr_storage *ss;
 	int                      rv;
 	int                      fd;
 
-	nni_mtx_lock(&ed->mtx);
-
 	ss  = &ed->locaddr;
 	len = ed->loclen;
 
 	if ((fd = socket(ss->ss_family, NNI_STREAM_SOCKTYPE, 0)) < 0) {
-		nni_mtx_unlock(&ed->mtx);
 		return (nni_plat_errno(errno));
 	}
 	(void) fcntl(fd, F_SETFD, FD_CLOEXEC);
@@ -287,8 +623,19 @@ nni_posix_epdesc_listen(nni_posix_epdesc *ed)
 	(void) setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
 #endif
 
+#ifdef SO_REUSEPORT
+	if (ed->nlisten > 1) {
+		int on = 1;
+		rv = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+		if (rv != 0) {
+			rv = nni_plat_errno(errno);
+			(void) close(fd);
+			return (rv);
+		}
+	}
+#endif
+
 	if (bind(fd, (struct sockaddr *) ss, len) < 0) {
-		nni_mtx_unlock(&ed->mtx);
 		rv = nni_plat_errno(errno);
 		(void) close(fd);
 		return (rv);
@@ -297,7 +644,6 @@ nni_posix_epdesc_listen(nni_posix_epdesc *ed)
 	// Listen -- 128 depth is probably sufficient.  If it isn't, other
 	// bad things are going to happen.
 	if (listen(fd, 128) != 0) {
-		nni_mtx_unlock(&ed->mtx);
 		rv = nni_plat_errno(errno);
 		(void) close(fd);
 		return (rv);
@@ -305,6 +651,91 @@ nni_posix_epdesc_listen(nni_posix_epdesc *ed)
 
 	(void) fcntl(fd, F_SETFL, O_NONBLOCK);
 
+	*fdp = fd;
+	return (0);
+}
+
+static int
+nni_posix_epdesc_listen_shards(nni_posix_epdesc *ed)
+{
+	struct sockaddr_storage ss;
+	socklen_t               sslen = sizeof(ss);
+	int                     n     = ed->nlisten - 1;
+	int                     rv;
+
+	// The first listener may have been bound to an ephemeral port;
+	// the rest have to use the same one, so pick up the real address.
+	if (getsockname(ed->node.fd, (void *) &ss, &sslen) != 0) {
+		return (nni_plat_errno(errno));
+	}
+	memcpy(&ed->locaddr, &ss, sslen);
+	ed->loclen = sslen;
+
+	if ((ed->shards = NNI_ALLOC_STRUCTS(ed->shards, n)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	for (int i = 0; i < n; i++) {
+		nni_posix_epshard *sh = &ed->shards[i];
+		nni_posix_pollq *  pq;
+
+		sh->ed        = ed;
+		sh->node.fd   = -1;
+		sh->node.cb   = nni_posix_epdesc_shard_cb;
+		sh->node.data = sh;
+#ifdef NNG_HAVE_IO_URING
+		sh->io.ed        = ed;
+		sh->io.fd        = -1;
+		sh->io.op.op_cb  = nni_posix_epdesc_uring_accept_cb;
+		sh->io.op.op_arg = &sh->io;
+#endif
+		(void) nni_posix_pollq_init(&sh->node);
+		ed->nshards++;
+
+		if ((rv = nni_posix_epdesc_listen1(ed, &sh->node.fd)) != 0) {
+			return (rv);
+		}
+		// Spread the shards across the pollers, away from the
+		// one servicing the primary listener.
+		pq = nni_posix_pollq_get(ed->node.fd + i + 1);
+		if ((rv = nni_posix_pollq_add_to(&sh->node, pq)) != 0) {
+			return (rv);
+		}
+	}
+	return (0);
+}
+
+static void
+nni_posix_epdesc_free_shards(nni_posix_epdesc *ed)
+{
+	for (int i = 0; i < ed->nshards; i++) {
+		nni_posix_epshard *sh = &ed->shards[i];
+
+		nni_posix_pollq_fini(&sh->node);
+		if (sh->node.fd != -1) {
+			(void) close(sh->node.fd);
+			sh->node.fd = -1;
+		}
+	}
+	if (ed->shards != NULL) {
+		NNI_FREE_STRUCTS(ed->shards, ed->nlisten - 1);
+		ed->shards = NULL;
+	}
+	ed->nshards = 0;
+}
+
+int
+nni_posix_epdesc_listen(nni_posix_epdesc *ed)
+{
+	int rv;
+	int fd;
+
+	nni_mtx_lock(&ed->mtx);
+
+	if ((rv = nni_posix_epdesc_listen1(ed, &fd)) != 0) {
+		nni_mtx_unlock(&ed->mtx);
+		return (rv);
+	}
+
 	ed->node.fd = fd;
 	if ((rv = nni_posix_pollq_add(&ed->node)) != 0) {
 		(void) close(fd);
@@ -312,6 +743,40 @@ nni_posix_epdesc_listen(nni_posix_epdesc *ed)
 		nni_mtx_unlock(&ed->mtx);
 		return (rv);
 	}
+
+	if ((ed->nlisten > 1) &&
+	    ((rv = nni_posix_epdesc_listen_shards(ed)) != 0)) {
+		nni_posix_epdesc_free_shards(ed);
+		nni_posix_pollq_remove(&ed->node);
+		(void) close(fd);
+		ed->node.fd = -1;
+		nni_mtx_unlock(&ed->mtx);
+		return (rv);
+	}
+	nni_mtx_unlock(&ed->mtx);
+	return (0);
+}
+
+// nni_posix_epdesc_set_listeners sets the number of listening sockets
+// to open, each sharing the same address via SO_REUSEPORT.  This must be
+// done before listening.
+int
+nni_posix_epdesc_set_listeners(nni_posix_epdesc *ed, int n)
+{
+	if (n < 1) {
+		return (NNG_EINVAL);
+	}
+#ifndef SO_REUSEPORT
+	if (n > 1) {
+		return (NNG_ENOTSUP);
+	}
+#endif
+	nni_mtx_lock(&ed->mtx);
+	if ((ed->node.fd != -1) || (ed->closed)) {
+		nni_mtx_unlock(&ed->mtx);
+		return (NNG_EBUSY);
+	}
+	ed->nlisten = n;
 	nni_mtx_unlock(&ed->mtx);
 	return (0);
 }
@@ -338,8 +803,23 @@ nni_posix_epdesc_accept(nni_posix_epdesc *ed, nni_aio *aio)
 		return;
 	}
 
+	// Use up any connections left over from an earlier batch.
+	if (ed->npending > 0) {
+		int fd = nni_posix_epdesc_pending_get(ed);
+		nni_posix_epdesc_finish(aio, 0, fd);
+		nni_mtx_unlock(&ed->mtx);
+		return;
+	}
+
 	nni_aio_list_append(&ed->acceptq, aio);
-	nni_posix_pollq_arm(&ed->node, POLLIN);
+#ifdef NNG_HAVE_IO_URING
+	if (ed->uring) {
+		nni_posix_epdesc_uring_accept(ed);
+		nni_mtx_unlock(&ed->mtx);
+		return;
+	}
+#endif
+	nni_posix_epdesc_arm_accept(ed);
 	nni_mtx_unlock(&ed->mtx);
 }
 
@@ -369,22 +849,23 @@ nni_posix_epdesc_connect(nni_posix_epdesc *ed, nni_aio *aio)
 		return;
 	}
 
-	fd = socket(ed->remaddr.ss_family, NNI_STREAM_SOCKTYPE, 0);
-	if (fd < 0) {
-		nni_posix_epdesc_finish(aio, rv, 0);
+#ifdef NNG_HAVE_IO_URING
+	if (ed->uring) {
+		if (ed->closed) {
+			nni_posix_epdesc_finish(aio, NNG_ECLOSED, 0);
+		} else {
+			nni_aio_list_append(&ed->connectq, aio);
+			nni_posix_epdesc_uring_connect(ed);
+		}
 		nni_mtx_unlock(&ed->mtx);
 		return;
 	}
+#endif
 
-	// Possibly bind.
-	if (ed->loclen != 0) {
-		rv = bind(fd, (void *) &ed->locaddr, ed->loclen);
-		if (rv != 0) {
-			(void) close(fd);
-			nni_posix_epdesc_finish(aio, rv, 0);
-			nni_mtx_unlock(&ed->mtx);
-			return;
-		}
+	if ((rv = nni_posix_epdesc_socket(ed, &fd)) != 0) {
+		nni_posix_epdesc_finish(aio, rv, 0);
+		nni_mtx_unlock(&ed->mtx);
+		return;
 	}
 
 	(void) fcntl(fd, F_SETFL, O_NONBLOCK);
@@ -447,11 +928,27 @@ nni_posix_epdesc_init(nni_posix_epdesc **edp)
 	ed->node.data  = ed;
 	ed->node.fd    = -1;
 	ed->closed     = false;
+	ed->nlisten    = 1;
 
 	nni_aio_list_init(&ed->connectq);
 	nni_aio_list_init(&ed->acceptq);
+#ifdef NNG_HAVE_IO_URING
+	nni_cv_init(&ed->cv, &ed->mtx);
+	ed->uring         = nni_posix_uring_enabled();
+	ed->lio.ed        = ed;
+	ed->lio.fd        = -1;
+	ed->lio.op.op_cb  = nni_posix_epdesc_uring_accept_cb;
+	ed->lio.op.op_arg = &ed->lio;
+	ed->cio.ed        = ed;
+	ed->cio.fd        = -1;
+	ed->cio.op.op_cb  = nni_posix_epdesc_uring_connect_cb;
+	ed->cio.op.op_arg = ed;
+#endif
 
 	if ((rv = nni_posix_pollq_init(&ed->node)) != 0) {
+#ifdef NNG_HAVE_IO_URING
+		nni_cv_fini(&ed->cv);
+#endif
 		nni_mtx_fini(&ed->mtx);
 		NNI_FREE_STRUCT(ed);
 		return (rv);
@@ -493,8 +990,21 @@ nni_posix_epdesc_fini(nni_posix_epdesc *ed)
 		(void) close(ed->node.fd);
 		nni_posix_epdesc_doclose(ed);
 	}
+#ifdef NNG_HAVE_IO_URING
+	// Operations still in the kernel refer to us, and our shards.
+	if (!ed->closed) {
+		nni_posix_epdesc_doclose(ed);
+	}
+	while (nni_posix_epdesc_uring_busy(ed)) {
+		nni_cv_wait(&ed->cv);
+	}
+#endif
 	nni_mtx_unlock(&ed->mtx);
+	nni_posix_epdesc_free_shards(ed);
 	nni_posix_pollq_fini(&ed->node);
+#ifdef NNG_HAVE_IO_URING
+	nni_cv_fini(&ed->cv);
+#endif
 	nni_mtx_fini(&ed->mtx);
 	NNI_FREE_STRUCT(ed);
 }
@@ -76,6 +76,10 @@ struct nni_plat_thr {
 	void *arg;
 };
 
+struct nni_plat_tls {
+	pthread_key_t key;
+};
+
 struct nni_plat_flock {
 	int fd;
 };
@@ -84,9 +88,14 @@ struct nni_plat_flock {
 
 #endif
 
+extern void nni_posix_clock_sysinit(void);
 extern int  nni_posix_pollq_sysinit(void);
 extern void nni_posix_pollq_sysfini(void);
 extern int  nni_posix_resolv_sysinit(void);
 extern void nni_posix_resolv_sysfini(void);
+#ifdef NNG_HAVE_IO_URING
+extern int  nni_posix_uring_sysinit(void);
+extern void nni_posix_uring_sysfini(void);
+#endif
 
 #endif // PLATFORM_POSIX_IMPL_H
@@ -13,6 +13,7 @@
 #ifdef NNG_PLATFORM_POSIX
 #include "platform/posix/posix_aio.h"
 #include "platform/posix/posix_pollq.h"
+#include "platform/posix/posix_uring.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -25,6 +26,25 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#ifdef NNG_HAVE_IO_URING
+// When io_uring is in use, the aio at the head of each queue is handed
+// to the kernel, and this holds the state it needs for the operation.
+// The kernel owns that aio until the completion arrives, so it stays on
+// the queue (and cannot be completed by close or cancellation) until
+// then.
+typedef struct {
+	nni_posix_uring_op op;
+	bool               busy;   // operation submitted to the kernel
+	int                cancel; // error to report, if canceled
+	struct msghdr      mh;
+	struct iovec       iov[16];
+	union {
+		struct cmsghdr align;
+		char           buf[CMSG_SPACE(sizeof(int) * 4)];
+	} cmsg;
+} nni_posix_pipedesc_io;
+#endif
+
 // nni_posix_pipedesc is a descriptor kept one per transport pipe (i.e. open
 // file descriptor for TCP socket, etc.)  This contains the list of pending
 // aios for that underlying socket, as well as the socket itself.
@@ -34,6 +54,12 @@ struct nni_posix_pipedesc {
 	nni_list             writeq;
 	bool                 closed;
 	nni_mtx              mtx;
+#ifdef NNG_HAVE_IO_URING
+	bool                  uring; // use io_uring instead of the poller
+	nni_posix_pipedesc_io rio;
+	nni_posix_pipedesc_io wio;
+	nni_cv                cv; // signaled when kernel operations finish
+#endif
 };
 
 static void
@@ -43,19 +69,41 @@ nni_posix_pipedesc_finish(nni_aio *aio, int rv)
 	nni_aio_finish(aio, rv, nni_aio_count(aio));
 }
 
+// nni_posix_pipedesc_abort fails every aio on the queue, except for
+// the one the kernel still owns (if any), which is always first.
 static void
-nni_posix_pipedesc_doclose(nni_posix_pipedesc *pd)
+nni_posix_pipedesc_abort(nni_list *q, bool busy)
 {
 	nni_aio *aio;
-	int      fd;
 
-	pd->closed = true;
-	while ((aio = nni_list_first(&pd->readq)) != NULL) {
+	while ((aio = nni_list_last(q)) != NULL) {
+		if (busy && (aio == nni_list_first(q))) {
+			break;
+		}
 		nni_posix_pipedesc_finish(aio, NNG_ECLOSED);
 	}
-	while ((aio = nni_list_first(&pd->writeq)) != NULL) {
-		nni_posix_pipedesc_finish(aio, NNG_ECLOSED);
+}
+
+static void
+nni_posix_pipedesc_doclose(nni_posix_pipedesc *pd)
+{
+	bool rbusy = false;
+	bool wbusy = false;
+	int  fd;
+
+	pd->closed = true;
+#ifdef NNG_HAVE_IO_URING
+	// In flight operations are finished by their completions, which
+	// the shutdown below (or failing that, the cancel) will hasten.
+	if ((rbusy = pd->rio.busy) && !pd->rio.cancel) {
+		nni_posix_uring_cancel(&pd->rio.op);
+	}
+	if ((wbusy = pd->wio.busy) && !pd->wio.cancel) {
+		nni_posix_uring_cancel(&pd->wio.op);
 	}
+#endif
+	nni_posix_pipedesc_abort(&pd->readq, rbusy);
+	nni_posix_pipedesc_abort(&pd->writeq, wbusy);
 	if ((fd = pd->node.fd) != -1) {
 		// Let any peer know we are closing.
 		pd->node.fd = -1;
@@ -64,6 +112,102 @@ nni_posix_pipedesc_doclose(nni_posix_pipedesc *pd)
 	}
 }
 
+// nni_posix_pipedesc_putfd attaches the descriptor to the message as
+// SCM_RIGHTS ancillary data, using the supplied control buffer.  The
+// buffer must have room for CMSG_SPACE(sizeof(int)) bytes.
+static void
+nni_posix_pipedesc_putfd(struct msghdr *mh, void *buf, int passfd)
+{
+	struct cmsghdr *cm;
+
+	memset(buf, 0, CMSG_SPACE(sizeof(int)));
+	mh->msg_control    = buf;
+	mh->msg_controllen = CMSG_SPACE(sizeof(int));
+
+	cm             = CMSG_FIRSTHDR(mh);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type  = SCM_RIGHTS;
+	cm->cmsg_len   = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cm), &passfd, sizeof(int));
+}
+
+// nni_posix_pipedesc_takefd collects any descriptor passed in the
+// received message into *fdp.  If one is already waiting there, or more
+// than one arrives, the extras are closed.
+static void
+nni_posix_pipedesc_takefd(struct msghdr *mh, int *fdp)
+{
+	struct cmsghdr *cm;
+
+	for (cm = CMSG_FIRSTHDR(mh); cm != NULL; cm = CMSG_NXTHDR(mh, cm)) {
+		size_t nfd;
+
+		if ((cm->cmsg_level != SOL_SOCKET) ||
+		    (cm->cmsg_type != SCM_RIGHTS)) {
+			continue;
+		}
+		nfd = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t i = 0; i < nfd; i++) {
+			int rfd;
+			memcpy(&rfd, CMSG_DATA(cm) + (i * sizeof(int)),
+			    sizeof(int));
+			if (*fdp < 0) {
+				*fdp = rfd;
+			} else {
+				(void) close(rfd);
+			}
+		}
+	}
+}
+
+// nni_posix_pipedesc_sendfd writes the iovs with sendmsg, passing the
+// descriptor along as SCM_RIGHTS ancillary data.  This only works on
+// UNIX domain sockets.
+static int
+nni_posix_pipedesc_sendfd(int fd, struct iovec *iov, int niov, int passfd)
+{
+	struct msghdr mh;
+	union {
+		struct cmsghdr align;
+		char           buf[CMSG_SPACE(sizeof(int))];
+	} cmsg;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov    = iov;
+	mh.msg_iovlen = niov;
+	nni_posix_pipedesc_putfd(&mh, cmsg.buf, passfd);
+
+	return ((int) sendmsg(fd, &mh, 0));
+}
+
+// nni_posix_pipedesc_recvfd reads into the iovs with recvmsg, collecting
+// any descriptor passed by the peer into *fdp.
+static int
+nni_posix_pipedesc_recvfd(int fd, struct iovec *iov, int niov, int *fdp)
+{
+	struct msghdr mh;
+	int           n;
+	int           flags = 0;
+	union {
+		struct cmsghdr align;
+		char           buf[CMSG_SPACE(sizeof(int) * 4)];
+	} cmsg;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov        = iov;
+	mh.msg_iovlen     = niov;
+	mh.msg_control    = cmsg.buf;
+	mh.msg_controllen = sizeof(cmsg.buf);
+#ifdef MSG_CMSG_CLOEXEC
+	flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+	if ((n = (int) recvmsg(fd, &mh, flags)) >= 0) {
+		nni_posix_pipedesc_takefd(&mh, fdp);
+	}
+	return (n);
+}
+
 static void
 nni_posix_pipedesc_dowrite(nni_posix_pipedesc *pd)
 {
@@ -75,6 +219,7 @@ nni_posix_pipedesc_dowrite(nni_posix_pipedesc *pd)
 		int      niov;
 		unsigned naiov;
 		nni_iov *aiov;
+		int *    fdp;
 #ifdef NNG_HAVE_ALLOCA
 		struct iovec *iovec;
 #else
@@ -104,7 +249,12 @@ nni_posix_pipedesc_dowrite(nni_posix_pipedesc *pd)
 			}
 		}
 
-		n = writev(pd->node.fd, iovec, niov);
+		if ((fdp = nni_aio_get_input(aio, 0)) != NULL) {
+			n = nni_posix_pipedesc_sendfd(
+			    pd->node.fd, iovec, niov, *fdp);
+		} else {
+			n = writev(pd->node.fd, iovec, niov);
+		}
 		if (n < 0) {
 			if ((errno == EAGAIN) || (errno == EINTR)) {
 				// Can't write more right now.  We're done
@@ -116,6 +266,10 @@ nni_posix_pipedesc_dowrite(nni_posix_pipedesc *pd)
 			return;
 		}
 
+		if (fdp != NULL) {
+			// The descriptor went with the first byte.
+			nni_aio_set_input(aio, 0, NULL);
+		}
 		nni_aio_bump_count(aio, n);
 		// We completed the entire operation on this aioq.
 		nni_posix_pipedesc_finish(aio, 0);
@@ -136,6 +290,7 @@ nni_posix_pipedesc_doread(nni_posix_pipedesc *pd)
 		int      niov;
 		unsigned naiov;
 		nni_iov *aiov;
+		int *    fdp;
 #ifdef NNG_HAVE_ALLOCA
 		struct iovec *iovec;
 #else
@@ -163,7 +318,12 @@ nni_posix_pipedesc_doread(nni_posix_pipedesc *pd)
 			}
 		}
 
-		n = readv(pd->node.fd, iovec, niov);
+		if ((fdp = nni_aio_get_input(aio, 0)) != NULL) {
+			n = nni_posix_pipedesc_recvfd(
+			    pd->node.fd, iovec, niov, fdp);
+		} else {
+			n = readv(pd->node.fd, iovec, niov);
+		}
 		if (n < 0) {
 			if ((errno == EAGAIN) || (errno == EINTR)) {
 				// Can't write more right now.  We're done
@@ -192,6 +352,130 @@ nni_posix_pipedesc_doread(nni_posix_pipedesc *pd)
 	}
 }
 
+#ifdef NNG_HAVE_IO_URING
+// nni_posix_pipedesc_uring_start submits the aio at the head of the
+// queue to the kernel, unless one is already in flight.
+static void
+nni_posix_pipedesc_uring_start(
+    nni_posix_pipedesc *pd, nni_posix_pipedesc_io *io, nni_list *q, bool tx)
+{
+	nni_aio *aio;
+
+	while ((!io->busy) && (!pd->closed) &&
+	    ((aio = nni_list_first(q)) != NULL)) {
+		unsigned naiov;
+		nni_iov *aiov;
+		int      niov;
+		int *    fdp;
+		int      rv;
+
+		nni_aio_get_iov(aio, &naiov, &aiov);
+		if (naiov > NNI_NUM_ELEMENTS(io->iov)) {
+			nni_posix_pipedesc_finish(aio, NNG_EINVAL);
+			continue;
+		}
+		for (niov = 0; naiov > 0; naiov--, aiov++) {
+			if (aiov->iov_len > 0) {
+				io->iov[niov].iov_len  = aiov->iov_len;
+				io->iov[niov].iov_base = aiov->iov_buf;
+				niov++;
+			}
+		}
+		memset(&io->mh, 0, sizeof(io->mh));
+		io->mh.msg_iov    = io->iov;
+		io->mh.msg_iovlen = niov;
+		fdp               = nni_aio_get_input(aio, 0);
+
+		if (tx) {
+			if (fdp != NULL) {
+				nni_posix_pipedesc_putfd(
+				    &io->mh, io->cmsg.buf, *fdp);
+			}
+			rv = nni_posix_uring_sendmsg(
+			    &io->op, pd->node.fd, &io->mh, MSG_NOSIGNAL);
+		} else {
+			if (fdp != NULL) {
+				io->mh.msg_control    = io->cmsg.buf;
+				io->mh.msg_controllen = sizeof(io->cmsg.buf);
+			}
+			rv = nni_posix_uring_recvmsg(
+			    &io->op, pd->node.fd, &io->mh, MSG_CMSG_CLOEXEC);
+		}
+		if (rv != 0) {
+			nni_posix_pipedesc_finish(aio, rv);
+			continue;
+		}
+		io->busy   = true;
+		io->cancel = 0;
+	}
+}
+
+// nni_posix_pipedesc_uring_done completes the aio the kernel was working
+// on.  The semantics match the poller: any transfer at all completes
+// the aio, and the caller deals with short transfers.
+static void
+nni_posix_pipedesc_uring_done(nni_posix_pipedesc *pd,
+    nni_posix_pipedesc_io *io, nni_list *q, bool tx, int res)
+{
+	nni_aio *aio = nni_list_first(q);
+	int *    fdp = nni_aio_get_input(aio, 0);
+	int      rv;
+
+	io->busy = false;
+	if ((res > 0) || (tx && (res == 0))) {
+		if (tx) {
+			if (fdp != NULL) {
+				// The descriptor went with the first byte.
+				nni_aio_set_input(aio, 0, NULL);
+			}
+		} else if (fdp != NULL) {
+			nni_posix_pipedesc_takefd(&io->mh, fdp);
+		}
+		nni_aio_bump_count(aio, res);
+		nni_posix_pipedesc_finish(aio, 0);
+	} else if ((!pd->closed) && ((res == -EINTR) || (res == -EAGAIN))) {
+		// Just try again.
+	} else {
+		if (io->cancel != 0) {
+			rv = io->cancel;
+		} else if (pd->closed || (res == 0)) {
+			rv = NNG_ECLOSED;
+		} else {
+			rv = nni_plat_errno(-res);
+		}
+		nni_posix_pipedesc_finish(aio, rv);
+		if (!pd->closed) {
+			nni_posix_pipedesc_doclose(pd);
+		}
+	}
+
+	nni_posix_pipedesc_uring_start(pd, io, q, tx);
+	if ((!pd->rio.busy) && (!pd->wio.busy)) {
+		nni_cv_wake(&pd->cv);
+	}
+}
+
+static void
+nni_posix_pipedesc_uring_recv_cb(void *arg, int res)
+{
+	nni_posix_pipedesc *pd = arg;
+
+	nni_mtx_lock(&pd->mtx);
+	nni_posix_pipedesc_uring_done(pd, &pd->rio, &pd->readq, false, res);
+	nni_mtx_unlock(&pd->mtx);
+}
+
+static void
+nni_posix_pipedesc_uring_send_cb(void *arg, int res)
+{
+	nni_posix_pipedesc *pd = arg;
+
+	nni_mtx_lock(&pd->mtx);
+	nni_posix_pipedesc_uring_done(pd, &pd->wio, &pd->writeq, true, res);
+	nni_mtx_unlock(&pd->mtx);
+}
+#endif // NNG_HAVE_IO_URING
+
 static void
 nni_posix_pipedesc_cb(void *arg)
 {
@@ -235,8 +519,27 @@ static void
 nni_posix_pipedesc_cancel(nni_aio *aio, int rv)
 {
 	nni_posix_pipedesc *pd = nni_aio_get_prov_data(aio);
+#ifdef NNG_HAVE_IO_URING
+	nni_posix_pipedesc_io *io = NULL;
+#endif
 
 	nni_mtx_lock(&pd->mtx);
+#ifdef NNG_HAVE_IO_URING
+	if (pd->rio.busy && (nni_list_first(&pd->readq) == aio)) {
+		io = &pd->rio;
+	} else if (pd->wio.busy && (nni_list_first(&pd->writeq) == aio)) {
+		io = &pd->wio;
+	}
+	if (io != NULL) {
+		// The kernel owns this one; the completion will finish it.
+		if (io->cancel == 0) {
+			io->cancel = rv;
+			nni_posix_uring_cancel(&io->op);
+		}
+		nni_mtx_unlock(&pd->mtx);
+		return;
+	}
+#endif
 	if (nni_aio_list_active(aio)) {
 		nni_aio_list_remove(aio);
 		nni_aio_finish_error(aio, rv);
@@ -261,6 +564,14 @@ nni_posix_pipedesc_recv(nni_posix_pipedesc *pd, nni_aio *aio)
 	}
 
 	nni_aio_list_append(&pd->readq, aio);
+#ifdef NNG_HAVE_IO_URING
+	if (pd->uring) {
+		nni_posix_pipedesc_uring_start(
+		    pd, &pd->rio, &pd->readq, false);
+		nni_mtx_unlock(&pd->mtx);
+		return;
+	}
+#endif
 	// If we are only job on the list, go ahead and try to do an immediate
 	// transfer. This allows for faster completions in many cases.  We
 	// also need not arm a list if it was already armed.
@@ -292,6 +603,14 @@ nni_posix_pipedesc_send(nni_posix_pipedesc *pd, nni_aio *aio)
 	}
 
 	nni_aio_list_append(&pd->writeq, aio);
+#ifdef NNG_HAVE_IO_URING
+	if (pd->uring) {
+		nni_posix_pipedesc_uring_start(
+		    pd, &pd->wio, &pd->writeq, true);
+		nni_mtx_unlock(&pd->mtx);
+		return;
+	}
+#endif
 	if (nni_list_first(&pd->writeq) == aio) {
 		nni_posix_pipedesc_dowrite(pd);
 		// If we are still the first thing on the list, that means we
@@ -358,9 +677,20 @@ nni_posix_pipedesc_init(nni_posix_pipedesc **pdp, int fd)
 	nni_mtx_init(&pd->mtx);
 	nni_aio_list_init(&pd->readq);
 	nni_aio_list_init(&pd->writeq);
+#ifdef NNG_HAVE_IO_URING
+	nni_cv_init(&pd->cv, &pd->mtx);
+	pd->uring         = nni_posix_uring_enabled();
+	pd->rio.op.op_cb  = nni_posix_pipedesc_uring_recv_cb;
+	pd->rio.op.op_arg = pd;
+	pd->wio.op.op_cb  = nni_posix_pipedesc_uring_send_cb;
+	pd->wio.op.op_arg = pd;
+#endif
 
 	if (((rv = nni_posix_pollq_init(&pd->node)) != 0) ||
 	    ((rv = nni_posix_pollq_add(&pd->node)) != 0)) {
+#ifdef NNG_HAVE_IO_URING
+		nni_cv_fini(&pd->cv);
+#endif
 		nni_mtx_fini(&pd->mtx);
 		NNI_FREE_STRUCT(pd);
 		return (rv);
@@ -379,6 +709,15 @@ nni_posix_pipedesc_fini(nni_posix_pipedesc *pd)
 		(void) close(pd->node.fd);
 	}
 
+#ifdef NNG_HAVE_IO_URING
+	// The kernel may still be using our buffers.
+	nni_mtx_lock(&pd->mtx);
+	while (pd->rio.busy || pd->wio.busy) {
+		nni_cv_wait(&pd->cv);
+	}
+	nni_mtx_unlock(&pd->mtx);
+	nni_cv_fini(&pd->cv);
+#endif
 	nni_mtx_fini(&pd->mtx);
 
 	NNI_FREE_STRUCT(pd);
@@ -28,6 +28,7 @@ typedef struct nni_posix_pollq      nni_posix_pollq;
 struct nni_posix_pollq_node {
 	nni_list_node    node;    // linkage into the pollq list
 	nni_posix_pollq *pq;      // associated pollq
+	nni_posix_pollq *owner;   // last pollq added to, kept for fini
 	int              index;   // used by the poller impl
 	int              armed;   // used by the poller impl
 	int              fd;      // file descriptor to poll
@@ -38,12 +39,14 @@ struct nni_posix_pollq_node {
 };
 
 extern nni_posix_pollq *nni_posix_pollq_get(int);
+extern int              nni_posix_pollq_count(void);
 extern int              nni_posix_pollq_sysinit(void);
 extern void             nni_posix_pollq_sysfini(void);
 
 extern int  nni_posix_pollq_init(nni_posix_pollq_node *);
 extern void nni_posix_pollq_fini(nni_posix_pollq_node *);
 extern int  nni_posix_pollq_add(nni_posix_pollq_node *);
+extern int  nni_posix_pollq_add_to(nni_posix_pollq_node *, nni_posix_pollq *);
 extern void nni_posix_pollq_remove(nni_posix_pollq_node *);
 extern void nni_posix_pollq_arm(nni_posix_pollq_node *, int);
 extern void nni_posix_pollq_disarm(nni_posix_pollq_node *, int);
@@ -47,13 +47,20 @@ struct nni_posix_pollq {
 	nni_posix_pollq_node *active; // active node (in callback)
 };
 
+static int nni_posix_pollq_start(void);
+
 int
 nni_posix_pollq_add(nni_posix_pollq_node *node)
 {
-	nni_posix_pollq *pq;
-	struct kevent    kevents[2];
+	return (nni_posix_pollq_add_to(node, nni_posix_pollq_get(node->fd)));
+}
+
+int
+nni_posix_pollq_add_to(nni_posix_pollq_node *node, nni_posix_pollq *pq)
+{
+	struct kevent kevents[2];
+	int           rv;
 
-	pq = nni_posix_pollq_get(node->fd);
 	if (pq == NULL) {
 		return (NNG_EINVAL);
 	}
@@ -62,6 +69,9 @@ nni_posix_pollq_add(nni_posix_pollq_node *node)
 	if (node->pq != NULL) {
 		return (NNG_ESTATE);
 	}
+	if ((rv = nni_posix_pollq_start()) != 0) {
+		return (rv);
+	}
 
 	nni_mtx_lock(&pq->mtx);
 	if (pq->close) {
@@ -71,6 +81,7 @@ nni_posix_pollq_add(nni_posix_pollq_node *node)
 	}
 
 	node->pq     = pq;
+	node->owner  = pq;
 	node->events = 0;
 
 	EV_SET(&kevents[0], (uintptr_t) node->fd, EVFILT_READ,
@@ -145,10 +156,12 @@ nni_posix_pollq_init(nni_posix_pollq_node *node)
 // nni_posix_pollq_fini does everything that nni_posix_pollq_remove does,
 // but it also ensures that the callback is not active, so that the node
 // may be deallocated.  This function must not be called in a callback.
+// The node may already have been removed, with its callback still running,
+// so we wait on the pollq it was last added to.
 void
 nni_posix_pollq_fini(nni_posix_pollq_node *node)
 {
-	nni_posix_pollq *pq = node->pq;
+	nni_posix_pollq *pq = node->owner;
 	if (pq == NULL) {
 		return;
 	}
@@ -159,7 +172,10 @@ nni_posix_pollq_fini(nni_posix_pollq_node *node)
 		nni_cv_wait(&pq->cv);
 	}
 
-	nni_posix_pollq_remove_helper(pq, node);
+	if (node->pq != NULL) {
+		nni_posix_pollq_remove_helper(pq, node);
+	}
+	node->owner = NULL;
 
 	if (pq->close) {
 		nni_cv_wake(&pq->cv);
@@ -388,8 +404,24 @@ nni_posix_pollq_create(nni_posix_pollq *pq)
 	return (0);
 }
 
-// single global instance for now
+// single global instance for now, created when first used
 static nni_posix_pollq nni_posix_global_pollq;
+static bool            nni_posix_global_pollq_created;
+static nni_mtx         nni_posix_global_pollq_lk;
+
+static int
+nni_posix_pollq_start(void)
+{
+	int rv = 0;
+
+	nni_mtx_lock(&nni_posix_global_pollq_lk);
+	if ((!nni_posix_global_pollq_created) &&
+	    ((rv = nni_posix_pollq_create(&nni_posix_global_pollq)) == 0)) {
+		nni_posix_global_pollq_created = true;
+	}
+	nni_mtx_unlock(&nni_posix_global_pollq_lk);
+	return (rv);
+}
 
 nni_posix_pollq *
 nni_posix_pollq_get(int fd)
@@ -398,16 +430,28 @@ nni_posix_pollq_get(int fd)
 	return (&nni_posix_global_pollq);
 }
 
+int
+nni_posix_pollq_count(void)
+{
+	return (1);
+}
+
 int
 nni_posix_pollq_sysinit(void)
 {
-	return (nni_posix_pollq_create(&nni_posix_global_pollq));
+	nni_mtx_init(&nni_posix_global_pollq_lk);
+	nni_posix_global_pollq_created = false;
+	return (0);
 }
 
 void
 nni_posix_pollq_sysfini(void)
 {
-	nni_posix_pollq_destroy(&nni_posix_global_pollq);
+	if (nni_posix_global_pollq_created) {
+		nni_posix_pollq_destroy(&nni_posix_global_pollq);
+		nni_posix_global_pollq_created = false;
+	}
+	nni_mtx_fini(&nni_posix_global_pollq_lk);
 }
 
 #endif // NNG_HAVE_KQUEUE
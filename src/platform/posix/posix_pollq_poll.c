@@ -23,12 +23,12 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
-// POSIX AIO using poll().  We use a single poll thread to perform
-// I/O operations for the entire system.  This isn't entirely scalable,
-// and it might be a good idea to create a few threads and group the
-// I/O operations into separate pollers to limit the amount of work each
-// thread does, and to scale across multiple cores.  For now we don't
-// worry about it.
+// POSIX AIO using poll().  We use a small set of poll threads to perform
+// I/O operations for the entire system.  Each descriptor is assigned to
+// exactly one poller (normally based on the descriptor number), so that
+// callbacks for a given node are never run concurrently.  This keeps the
+// amount of work each thread does bounded, and lets us scale across
+// multiple cores.
 
 // nni_posix_pollq is a work structure used by the poller thread, that keeps
 // track of all the underlying pipe handles and so forth being used by poll().
@@ -37,10 +37,13 @@ struct nni_posix_pollq {
 	nni_cv                cv;
 	struct pollfd *       fds;
 	int                   nfds;
+	struct pollfd *       oldfds;  // retired, but maybe in use by thread
+	int                   noldfds; // size of oldfds
 	int                   wakewfd; // write side of waker pipe
 	int                   wakerfd; // read side of waker pipe
 	int                   close;   // request for worker to exit
 	int                   started;
+	int                   created; // under nni_posix_pollq_lk
 	nni_thr               thr;    // worker thread
 	nni_list              polled; // polled nodes
 	nni_list              armed;  // armed nodes
@@ -67,8 +70,17 @@ nni_posix_pollq_poll_grow(nni_posix_pollq *pq)
 		return (NNG_ENOMEM);
 	}
 
+	// The poller thread works on the array without the lock held, so
+	// the array it picked up at the top of its loop must stay around
+	// until it comes back around.  Any later array was never seen by
+	// the thread, and can go right away.
 	if (pq->nfds != 0) {
-		NNI_FREE_STRUCTS(pq->fds, pq->nfds);
+		if (pq->oldfds == NULL) {
+			pq->oldfds  = pq->fds;
+			pq->noldfds = pq->nfds;
+		} else {
+			NNI_FREE_STRUCTS(pq->fds, pq->nfds);
+		}
 	}
 	pq->fds  = newfds;
 	pq->nfds = grow;
@@ -91,6 +103,11 @@ nni_posix_poll_thr(void *arg)
 		if (pollq->close) {
 			break;
 		}
+		if (pollq->oldfds != NULL) {
+			NNI_FREE_STRUCTS(pollq->oldfds, pollq->noldfds);
+			pollq->oldfds  = NULL;
+			pollq->noldfds = 0;
+		}
 
 		fds  = pollq->fds;
 		nfds = 0;
@@ -188,18 +205,47 @@ nni_posix_poll_thr(void *arg)
 	nni_mtx_unlock(&pollq->mtx);
 }
 
+static int nni_posix_pollq_create(nni_posix_pollq *);
+
+// Pollqs are only created, and their threads started, when the first
+// descriptor is added to them.  Programs that only use inproc never
+// start any.
+static nni_mtx nni_posix_pollq_lk;
+
+static int
+nni_posix_pollq_start(nni_posix_pollq *pq)
+{
+	int rv = 0;
+
+	nni_mtx_lock(&nni_posix_pollq_lk);
+	if ((!pq->created) && ((rv = nni_posix_pollq_create(pq)) == 0)) {
+		pq->created = 1;
+	}
+	nni_mtx_unlock(&nni_posix_pollq_lk);
+	return (rv);
+}
+
 int
 nni_posix_pollq_add(nni_posix_pollq_node *node)
 {
-	int              rv;
-	nni_posix_pollq *pq;
+	return (nni_posix_pollq_add_to(node, nni_posix_pollq_get(node->fd)));
+}
+
+// nni_posix_pollq_add_to is like nni_posix_pollq_add, but lets the caller
+// pick the pollq (and hence the thread) that will service the node.
+int
+nni_posix_pollq_add_to(nni_posix_pollq_node *node, nni_posix_pollq *pq)
+{
+	int rv;
 
 	NNI_ASSERT(!nni_list_node_active(&node->node));
 
-	pq = nni_posix_pollq_get(node->fd);
 	if (node->pq != NULL) {
 		return (NNG_ESTATE);
 	}
+	if ((rv = nni_posix_pollq_start(pq)) != 0) {
+		return (rv);
+	}
 
 	nni_mtx_lock(&pq->mtx);
 	if (pq->close) {
@@ -207,11 +253,12 @@ nni_posix_pollq_add(nni_posix_pollq_node *node)
 		nni_mtx_unlock(&pq->mtx);
 		return (NNG_ECLOSED);
 	}
-	node->pq = pq;
 	if ((rv = nni_posix_pollq_poll_grow(pq)) != 0) {
 		nni_mtx_unlock(&pq->mtx);
 		return (rv);
 	}
+	node->pq    = pq;
+	node->owner = pq;
 	pq->nnodes++;
 	nni_list_append(&pq->idle, node);
 	nni_mtx_unlock(&pq->mtx);
@@ -253,15 +300,18 @@ nni_posix_pollq_init(nni_posix_pollq_node *node)
 // nni_posix_pollq_fini does everything that nni_posix_pollq_remove does,
 // but it also ensures that the callback is not active, so that the node
 // may be deallocated.  This function must not be called in a callback.
+// The node may already have been removed, with its callback still running,
+// so we wait on the pollq it was last added to.
 void
 nni_posix_pollq_fini(nni_posix_pollq_node *node)
 {
-	nni_posix_pollq *pq = node->pq;
+	nni_posix_pollq *pq = node->owner;
 
 	if (pq == NULL) {
 		return;
 	}
-	node->pq = NULL;
+	node->pq    = NULL;
+	node->owner = NULL;
 	nni_mtx_lock(&pq->mtx);
 	while (pq->active == node) {
 		pq->wait = node;
@@ -354,6 +404,11 @@ nni_posix_pollq_destroy(nni_posix_pollq *pq)
 		pq->fds  = NULL;
 		pq->nfds = 0;
 	}
+	if (pq->oldfds != NULL) {
+		NNI_FREE_STRUCTS(pq->oldfds, pq->noldfds);
+		pq->oldfds  = NULL;
+		pq->noldfds = 0;
+	}
 	nni_mtx_fini(&pq->mtx);
 }
 
@@ -383,35 +438,78 @@ nni_posix_pollq_create(nni_posix_pollq *pq)
 	return (0);
 }
 
-// We use a single pollq for the entire system, which means only a single
-// thread is polling.  This may be somewhat less than optimally efficient,
-// and it may be worth investigating having multiple threads to improve
-// efficiency and scalability.  (This would shorten the linked lists,
-// improving C10K scalability, and also allow us to engage multiple cores.)
-// It's not entirely clear how many threads are "optimal".
-static nni_posix_pollq nni_posix_global_pollq;
+// We use a handful of pollqs, one thread each, and spread descriptors
+// across them.  The count is sized to the number of online processors,
+// but capped, since past a certain point extra pollers just burn memory
+// and add context switches; the lists are already short at that point.
+// The application can choose the count with NNG_INIT_NUM_POLLER_THREADS.
+#ifndef NNG_POSIX_POLLQ_MAX
+#define NNG_POSIX_POLLQ_MAX 8
+#endif
+
+static nni_posix_pollq *nni_posix_pollqs;
+static int              nni_posix_npollqs;
 
 nni_posix_pollq *
 nni_posix_pollq_get(int fd)
 {
-	NNI_ARG_UNUSED(fd);
-	// This is the point where we could choose a pollq based on FD.
-	return (&nni_posix_global_pollq);
+	if (fd < 0) {
+		fd = 0;
+	}
+	return (&nni_posix_pollqs[fd % nni_posix_npollqs]);
 }
 
 int
-nni_posix_pollq_sysinit(void)
+nni_posix_pollq_count(void)
 {
-	int rv;
+	return (nni_posix_npollqs);
+}
 
-	rv = nni_posix_pollq_create(&nni_posix_global_pollq);
-	return (rv);
+int
+nni_posix_pollq_sysinit(void)
+{
+	long n;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	n = 1;
+#endif
+	if (n < 1) {
+		n = 1;
+	} else if (n > NNG_POSIX_POLLQ_MAX) {
+		n = NNG_POSIX_POLLQ_MAX;
+	}
+	n = (long) nni_init_get_param(NNG_INIT_NUM_POLLER_THREADS, n);
+	if (n < 1) {
+		n = 1;
+	} else if (n > 256) {
+		n = 256;
+	}
+	if ((nni_posix_pollqs = NNI_ALLOC_STRUCTS(nni_posix_pollqs, n)) ==
+	    NULL) {
+		return (NNG_ENOMEM);
+	}
+	nni_mtx_init(&nni_posix_pollq_lk);
+	nni_posix_npollqs = (int) n;
+	return (0);
 }
 
 void
 nni_posix_pollq_sysfini(void)
 {
-	nni_posix_pollq_destroy(&nni_posix_global_pollq);
+	if (nni_posix_pollqs == NULL) {
+		return;
+	}
+	for (int i = 0; i < nni_posix_npollqs; i++) {
+		if (nni_posix_pollqs[i].created) {
+			nni_posix_pollq_destroy(&nni_posix_pollqs[i]);
+		}
+	}
+	NNI_FREE_STRUCTS(nni_posix_pollqs, nni_posix_npollqs);
+	nni_mtx_fini(&nni_posix_pollq_lk);
+	nni_posix_pollqs  = NULL;
+	nni_posix_npollqs = 0;
 }
 
 #endif // NNG_USE_POSIX_POLLQ_POLL
@@ -30,8 +30,11 @@
 // as elegant or scaleable as a true asynchronous resolver would be, but
 // it has the advantage of being fairly portable, and concurrent enough for
 // the vast, vast majority of use cases.  The total thread count can be
-// changed with this define.  Note that some platforms may not have a
-// thread-safe getaddrinfo().  In that case they should set this to 1.
+// changed with this define, or at run time with the
+// NNG_INIT_NUM_RESOLVER_THREADS parameter.  Note that some platforms may
+// not have a thread-safe getaddrinfo().  In that case they should set
+// this to 1.  If it is set to zero, there is no resolver; only numeric
+// addresses work, and those are converted synchronously.
 
 #ifndef NNG_POSIX_RESOLV_CONCURRENCY
 #define NNG_POSIX_RESOLV_CONCURRENCY 4
@@ -112,21 +115,21 @@ nni_posix_gai_errno(int rv)
 	}
 }
 
-static void
-nni_posix_resolv_task(void *arg)
+static int
+nni_posix_resolv_lookup(
+    nni_posix_resolv_item *item, nng_sockaddr *sa, int flags)
 {
-	nni_posix_resolv_item *item = arg;
-	nni_aio *              aio  = item->aio;
-	struct addrinfo        hints;
-	struct addrinfo *      results;
-	struct addrinfo *      probe;
-	int                    rv;
+	struct addrinfo  hints;
+	struct addrinfo *results;
+	struct addrinfo *probe;
+	int              rv;
 
 	results = NULL;
 
 	// We treat these all as IP addresses.  The service and the
 	// host part are split.
 	memset(&hints, 0, sizeof(hints));
+	hints.ai_flags = flags;
 	if (item->passive) {
 		hints.ai_flags |= AI_PASSIVE;
 	}
@@ -167,7 +170,6 @@ nni_posix_resolv_task(void *arg)
 	if (probe != NULL) {
 		struct sockaddr_in * sin;
 		struct sockaddr_in6 *sin6;
-		nng_sockaddr *       sa = nni_aio_get_input(aio, 0);
 
 		switch (probe->ai_addr->sa_family) {
 		case AF_INET:
@@ -193,6 +195,16 @@ done:
 	if (results != NULL) {
 		freeaddrinfo(results);
 	}
+	return (rv);
+}
+
+static void
+nni_posix_resolv_task(void *arg)
+{
+	nni_posix_resolv_item *item = arg;
+	int                    rv;
+
+	rv = nni_posix_resolv_lookup(item, nni_aio_get_input(item->aio, 0), 0);
 
 	nni_mtx_lock(&nni_posix_resolv_mtx);
 	nni_posix_resolv_finish(item, rv);
@@ -222,6 +234,25 @@ nni_posix_resolv_ip(const char *host, const char *serv, int passive,
 		return;
 	}
 
+	if (nni_posix_resolv_tq == NULL) {
+		nni_posix_resolv_item numeric;
+		nng_sockaddr *        sa;
+
+		// No resolver; numeric lookups never block, so we can
+		// just do them here.
+		memset(&numeric, 0, sizeof(numeric));
+		numeric.passive = passive;
+		numeric.name    = host;
+		numeric.serv    = serv;
+		numeric.proto   = proto;
+		numeric.family  = fam;
+		sa = nni_aio_get_input(aio, 0);
+		rv = nni_posix_resolv_lookup(
+		    &numeric, sa, AI_NUMERICHOST | AI_NUMERICSERV);
+		nni_aio_finish(aio, rv, 0);
+		return;
+	}
+
 	if ((item = NNI_ALLOC_STRUCT(item)) == NULL) {
 		nni_aio_finish_error(aio, NNG_ENOMEM);
 		return;
@@ -267,10 +298,17 @@ int
 nni_posix_resolv_sysinit(void)
 {
 	int rv;
+	int n;
 
 	nni_mtx_init(&nni_posix_resolv_mtx);
 
-	if ((rv = nni_taskq_init(&nni_posix_resolv_tq, 4)) != 0) {
+	// The taskq does not start any threads until a lookup is made.
+	n = (int) nni_init_get_param(
+	    NNG_INIT_NUM_RESOLVER_THREADS, NNG_POSIX_RESOLV_CONCURRENCY);
+	if (n == 0) {
+		return (0);
+	}
+	if ((rv = nni_taskq_init(&nni_posix_resolv_tq, n)) != 0) {
 		nni_mtx_fini(&nni_posix_resolv_mtx);
 		return (rv);
 	}
@@ -0,0 +1,360 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+
+#ifdef NNG_PLATFORM_POSIX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Shared memory support.  We use POSIX named shared memory objects.
+// The name only needs to live long enough for the peer to open it;
+// callers are expected to unlink it as soon as that has happened.
+
+#if defined(NNG_HAVE_SHM_OPEN) || defined(NNG_HAVE_LIBRT_SHM_OPEN)
+
+struct nni_plat_shm {
+	void * addr;
+	size_t size;
+	bool   linked;
+	char   name[NNI_PLAT_SHM_NAMELEN];
+};
+
+static int
+nni_plat_shm_map(nni_plat_shm *shm, int fd)
+{
+	void *addr;
+
+	addr = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		return (nni_plat_errno(errno));
+	}
+	shm->addr = addr;
+	return (0);
+}
+
+int
+nni_plat_shm_create(nni_plat_shm **shmp, size_t size)
+{
+	nni_plat_shm *shm;
+	int           fd;
+	int           rv;
+
+	if ((shm = NNI_ALLOC_STRUCT(shm)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	shm->size = size;
+
+	// The name is random, and we insist on creating it, so collisions
+	// (which are very unlikely) are just retried.
+	for (;;) {
+		(void) snprintf(shm->name, sizeof(shm->name), "/nng-%u-%08x",
+		    (unsigned) getpid(), nni_random());
+		fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if ((fd >= 0) || (errno != EEXIST)) {
+			break;
+		}
+	}
+	if (fd < 0) {
+		rv = nni_plat_errno(errno);
+		NNI_FREE_STRUCT(shm);
+		return (rv);
+	}
+	shm->linked = true;
+	if (ftruncate(fd, (off_t) size) != 0) {
+		rv = nni_plat_errno(errno);
+		(void) close(fd);
+		nni_plat_shm_fini(shm);
+		return (rv);
+	}
+	rv = nni_plat_shm_map(shm, fd);
+	(void) close(fd);
+	if (rv != 0) {
+		nni_plat_shm_fini(shm);
+		return (rv);
+	}
+	*shmp = shm;
+	return (0);
+}
+
+int
+nni_plat_shm_open(nni_plat_shm **shmp, const char *name, size_t size)
+{
+	nni_plat_shm *shm;
+	struct stat   st;
+	int           fd;
+	int           rv;
+
+	if (nni_strnlen(name, NNI_PLAT_SHM_NAMELEN) >= NNI_PLAT_SHM_NAMELEN) {
+		return (NNG_EINVAL);
+	}
+	if ((shm = NNI_ALLOC_STRUCT(shm)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	(void) nni_strlcpy(shm->name, name, sizeof(shm->name));
+	shm->size = size;
+
+	if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+		rv = nni_plat_errno(errno);
+		NNI_FREE_STRUCT(shm);
+		return (rv);
+	}
+	shm->linked = true;
+
+	// Never map beyond the end of the object; touching those pages
+	// would get us a SIGBUS rather than an error.
+	if (fstat(fd, &st) != 0) {
+		rv = nni_plat_errno(errno);
+	} else if ((size_t) st.st_size < size) {
+		rv = NNG_EPROTO;
+	} else {
+		rv = nni_plat_shm_map(shm, fd);
+	}
+	(void) close(fd);
+	if (rv != 0) {
+		// Leave the name alone; the creator owns it.
+		shm->linked = false;
+		nni_plat_shm_fini(shm);
+		return (rv);
+	}
+	*shmp = shm;
+	return (0);
+}
+
+const char *
+nni_plat_shm_name(nni_plat_shm *shm)
+{
+	return (shm->name);
+}
+
+void *
+nni_plat_shm_addr(nni_plat_shm *shm)
+{
+	return (shm->addr);
+}
+
+void
+nni_plat_shm_unlink(nni_plat_shm *shm)
+{
+	if (shm->linked) {
+		(void) shm_unlink(shm->name);
+		shm->linked = false;
+	}
+}
+
+void
+nni_plat_shm_fini(nni_plat_shm *shm)
+{
+	nni_plat_shm_unlink(shm);
+	if (shm->addr != NULL) {
+		(void) munmap(shm->addr, shm->size);
+	}
+	NNI_FREE_STRUCT(shm);
+}
+
+#else // NNG_HAVE_SHM_OPEN
+
+int
+nni_plat_shm_create(nni_plat_shm **shmp, size_t size)
+{
+	NNI_ARG_UNUSED(shmp);
+	NNI_ARG_UNUSED(size);
+	return (NNG_ENOTSUP);
+}
+
+int
+nni_plat_shm_open(nni_plat_shm **shmp, const char *name, size_t size)
+{
+	NNI_ARG_UNUSED(shmp);
+	NNI_ARG_UNUSED(name);
+	NNI_ARG_UNUSED(size);
+	return (NNG_ENOTSUP);
+}
+
+const char *
+nni_plat_shm_name(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+	return (NULL);
+}
+
+void *
+nni_plat_shm_addr(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+	return (NULL);
+}
+
+void
+nni_plat_shm_unlink(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+}
+
+void
+nni_plat_shm_fini(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+}
+
+#endif // NNG_HAVE_SHM_OPEN
+
+// Anonymous objects, passed between processes as descriptors.  We
+// prefer memfd_create, which lets us seal the object once filled, so
+// that the receiver can rely on the contents not changing.  Otherwise
+// a named object is created and unlinked at once.
+
+#if defined(NNG_HAVE_MEMFD_CREATE) || defined(NNG_HAVE_SHM_OPEN) || \
+    defined(NNG_HAVE_LIBRT_SHM_OPEN)
+
+static int
+nni_plat_shm_anon(void)
+{
+#ifdef NNG_HAVE_MEMFD_CREATE
+	return (memfd_create("nng", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+#else
+	char name[NNI_PLAT_SHM_NAMELEN];
+	int  fd;
+
+	for (;;) {
+		(void) snprintf(name, sizeof(name), "/nng-%u-%08x",
+		    (unsigned) getpid(), nni_random());
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) {
+			(void) shm_unlink(name);
+			(void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+			return (fd);
+		}
+		if (errno != EEXIST) {
+			return (-1);
+		}
+	}
+#endif
+}
+
+int
+nni_plat_shm_memfd(int *fdp, const nni_iov *iov, unsigned niov)
+{
+	size_t   size = 0;
+	size_t   off  = 0;
+	uint8_t *addr;
+	int      fd;
+	int      rv;
+
+	for (unsigned i = 0; i < niov; i++) {
+		size += iov[i].iov_len;
+	}
+	if (size == 0) {
+		return (NNG_EINVAL);
+	}
+	if ((fd = nni_plat_shm_anon()) < 0) {
+		return (nni_plat_errno(errno));
+	}
+	if (ftruncate(fd, (off_t) size) != 0) {
+		rv = nni_plat_errno(errno);
+		(void) close(fd);
+		return (rv);
+	}
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		rv = nni_plat_errno(errno);
+		(void) close(fd);
+		return (rv);
+	}
+	for (unsigned i = 0; i < niov; i++) {
+		memcpy(addr + off, iov[i].iov_buf, iov[i].iov_len);
+		off += iov[i].iov_len;
+	}
+	(void) munmap(addr, size);
+
+#if defined(NNG_HAVE_MEMFD_CREATE) && defined(F_ADD_SEALS)
+	// Best effort; the receiver does not depend on it.
+	(void) fcntl(fd, F_ADD_SEALS,
+	    F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+
+	*fdp = fd;
+	return (0);
+}
+
+int
+nni_plat_shm_mapfd(void **addrp, int fd, size_t size)
+{
+	struct stat st;
+	void *      addr;
+	int         rv;
+
+	// As for named regions, never map past the end of the object.
+	// The mapping is private, so that the message body can be modified
+	// in place (as nng_msg_body allows); pages are only copied when
+	// written, and the changes are never seen by the sender.
+	if (fstat(fd, &st) != 0) {
+		rv = nni_plat_errno(errno);
+	} else if ((size == 0) || ((size_t) st.st_size < size)) {
+		rv = NNG_EPROTO;
+	} else if ((addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	                MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		rv = nni_plat_errno(errno);
+	} else {
+		*addrp = addr;
+		rv     = 0;
+	}
+	(void) close(fd);
+	return (rv);
+}
+
+void
+nni_plat_shm_unmap(void *addr, size_t size)
+{
+	(void) munmap(addr, size);
+}
+
+#else // NNG_HAVE_MEMFD_CREATE || NNG_HAVE_SHM_OPEN
+
+int
+nni_plat_shm_memfd(int *fdp, const nni_iov *iov, unsigned niov)
+{
+	NNI_ARG_UNUSED(fdp);
+	NNI_ARG_UNUSED(iov);
+	NNI_ARG_UNUSED(niov);
+	return (NNG_ENOTSUP);
+}
+
+int
+nni_plat_shm_mapfd(void **addrp, int fd, size_t size)
+{
+	NNI_ARG_UNUSED(addrp);
+	NNI_ARG_UNUSED(size);
+	(void) close(fd);
+	return (NNG_ENOTSUP);
+}
+
+void
+nni_plat_shm_unmap(void *addr, size_t size)
+{
+	NNI_ARG_UNUSED(addr);
+	NNI_ARG_UNUSED(size);
+}
+
+#endif // NNG_HAVE_MEMFD_CREATE || NNG_HAVE_SHM_OPEN
+
+void
+nni_plat_shm_closefd(int fd)
+{
+	(void) close(fd);
+}
+
+#endif // NNG_PLATFORM_POSIX
@@ -76,6 +76,12 @@ nni_plat_tcp_ep_listen(nni_plat_tcp_ep *ep, nng_sockaddr *bsa)
 	return (rv);
 }
 
+int
+nni_plat_tcp_ep_set_listeners(nni_plat_tcp_ep *ep, int n)
+{
+	return (nni_posix_epdesc_set_listeners((void *) ep, n));
+}
+
 void
 nni_plat_tcp_ep_connect(nni_plat_tcp_ep *ep, nni_aio *aio)
 {
@@ -422,6 +422,33 @@ nni_plat_thr_fini(nni_plat_thr *thr)
 	}
 }
 
+int
+nni_plat_tls_init(nni_plat_tls *tls, void (*dtor)(void *))
+{
+	if (pthread_key_create(&tls->key, dtor) != 0) {
+		return (NNG_ENOMEM);
+	}
+	return (0);
+}
+
+void
+nni_plat_tls_fini(nni_plat_tls *tls)
+{
+	(void) pthread_key_delete(tls->key);
+}
+
+void *
+nni_plat_tls_get(nni_plat_tls *tls)
+{
+	return (pthread_getspecific(tls->key));
+}
+
+void
+nni_plat_tls_set(nni_plat_tls *tls, void *val)
+{
+	(void) pthread_setspecific(tls->key, val);
+}
+
 void
 nni_atfork_child(void)
 {
@@ -462,6 +489,8 @@ nni_plat_init(int (*helper)(void))
 		return (NNG_ENOMEM);
 	}
 
+	nni_posix_clock_sysinit();
+
 	// if this one fails we don't care.
 	(void) pthread_mutexattr_settype(
 	    &nni_mxattr, PTHREAD_MUTEX_ERRORCHECK);
@@ -481,8 +510,16 @@ nni_plat_init(int (*helper)(void))
 		return (rv);
 	}
 
+#ifdef NNG_HAVE_IO_URING
+	// This never fails; we fall back to the pollers instead.
+	(void) nni_posix_uring_sysinit();
+#endif
+
 	if (pthread_atfork(NULL, NULL, nni_atfork_child) != 0) {
 		pthread_mutex_unlock(&nni_plat_init_lock);
+#ifdef NNG_HAVE_IO_URING
+		nni_posix_uring_sysfini();
+#endif
 		nni_posix_resolv_sysfini();
 		nni_posix_pollq_sysfini();
 		pthread_mutexattr_destroy(&nni_mxattr);
@@ -502,6 +539,9 @@ nni_plat_fini(void)
 {
 	pthread_mutex_lock(&nni_plat_init_lock);
 	if (nni_plat_inited) {
+#ifdef NNG_HAVE_IO_URING
+		nni_posix_uring_sysfini();
+#endif
 		nni_posix_resolv_sysfini();
 		nni_posix_pollq_sysfini();
 		pthread_mutexattr_destroy(&nni_mxattr);
@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,12 +35,52 @@
 #define NNI_MSG_NOSIGNAL 0
 #endif
 
+// Datagrams are moved in batches.  All the aios waiting on a socket are
+// gathered up, and handed to the kernel with a single recvmmsg or
+// sendmmsg, so that a busy socket costs one system call per batch rather
+// than one per datagram.  Users that want this just keep several aios
+// posted.  NNI_POSIX_UDP_BATCH is the most datagrams we move at once,
+// and NNI_POSIX_UDP_MAXIOV is the most iovs an aio may carry.  The iovs
+// of a batch are laid out one after another in a pool of
+// NNI_POSIX_UDP_IOVS; a batch ends early if the next aio does not fit.
+#ifndef NNI_POSIX_UDP_BATCH
+#define NNI_POSIX_UDP_BATCH 64
+#endif
+#define NNI_POSIX_UDP_MAXIOV 64
+#define NNI_POSIX_UDP_IOVS (NNI_POSIX_UDP_BATCH * 4)
+
+// For UDP generic segmentation offload, runs of equal sized datagrams
+// to the same peer are sent as one large buffer, which the kernel (or
+// NIC) splits up.  These are the limits Linux imposes on that.
+#define NNI_POSIX_UDP_GSO_SEGS 64
+#define NNI_POSIX_UDP_GSO_MAX 65000
+
+#if defined(NNG_HAVE_SENDMMSG) && defined(NNG_HAVE_RECVMMSG)
+typedef struct mmsghdr nni_posix_mmsg;
+#else
+typedef struct {
+	struct msghdr msg_hdr;
+	unsigned int  msg_len;
+} nni_posix_mmsg;
+#endif
+
+typedef struct {
+	struct iovec *          iov; // in the socket's pool
+	struct sockaddr_storage ss;
+	size_t                  len;
+	nni_aio *               aio;
+} nni_posix_udp_dgram;
+
 struct nni_plat_udp {
 	nni_posix_pollq_node udp_pitem;
 	int                  udp_fd;
 	nni_list             udp_recvq;
 	nni_list             udp_sendq;
 	nni_mtx              udp_mtx;
+	bool                 udp_nogso;
+	nni_posix_mmsg       udp_hdrs[NNI_POSIX_UDP_BATCH];
+	nni_posix_udp_dgram  udp_dgrams[NNI_POSIX_UDP_BATCH];
+	struct iovec         udp_iovs[NNI_POSIX_UDP_IOVS];
 };
 
 static void
@@ -55,118 +96,279 @@ nni_posix_udp_doclose(nni_plat_udp *udp)
 	// Underlying socket left open until close API called.
 }
 
+static int
+nni_posix_udp_recvmmsg(int fd, nni_posix_mmsg *hdrs, unsigned n)
+{
+#if defined(NNG_HAVE_SENDMMSG) && defined(NNG_HAVE_RECVMMSG)
+	return (recvmmsg(fd, hdrs, n, 0, NULL));
+#else
+	unsigned i;
+	for (i = 0; i < n; i++) {
+		int cnt;
+		if ((cnt = recvmsg(fd, &hdrs[i].msg_hdr, 0)) < 0) {
+			break;
+		}
+		hdrs[i].msg_len = (unsigned) cnt;
+	}
+	return ((i > 0) ? (int) i : -1);
+#endif
+}
+
+static int
+nni_posix_udp_sendmmsg(int fd, nni_posix_mmsg *hdrs, unsigned n)
+{
+#if defined(NNG_HAVE_SENDMMSG) && defined(NNG_HAVE_RECVMMSG)
+	return (sendmmsg(fd, hdrs, n, NNI_MSG_NOSIGNAL));
+#else
+	unsigned i;
+	for (i = 0; i < n; i++) {
+		int cnt;
+		cnt = sendmsg(fd, &hdrs[i].msg_hdr, NNI_MSG_NOSIGNAL);
+		if (cnt < 0) {
+			break;
+		}
+		hdrs[i].msg_len = (unsigned) cnt;
+	}
+	return ((i > 0) ? (int) i : -1);
+#endif
+}
+
+// nni_posix_udp_gather collects up to NNI_POSIX_UDP_BATCH aios from the
+// head of the queue, and prepares a message header for each.  Aios that
+// cannot be used are failed.  It returns the number gathered.
+static unsigned
+nni_posix_udp_gather(nni_plat_udp *udp, nni_list *q, bool send)
+{
+	nni_aio *aio;
+	unsigned n    = 0;
+	unsigned used = 0;
+
+	aio = nni_list_first(q);
+	while ((aio != NULL) && (n < NNI_POSIX_UDP_BATCH)) {
+		nni_posix_udp_dgram *dg   = &udp->udp_dgrams[n];
+		struct msghdr *      hdr  = &udp->udp_hdrs[n].msg_hdr;
+		nni_aio *            next = nni_list_next(q, aio);
+		unsigned             niov;
+		nni_iov *            aiov;
+		int                  len = sizeof(dg->ss);
+
+		nni_aio_get_iov(aio, &niov, &aiov);
+		if (send) {
+			len = nni_posix_nn2sockaddr(
+			    &dg->ss, nni_aio_get_input(aio, 0));
+		}
+		if ((niov > NNI_POSIX_UDP_MAXIOV) || (len < 1)) {
+			nni_list_remove(q, aio);
+			nni_aio_finish(aio,
+			    (len < 1) ? NNG_EADDRINVAL : NNG_EINVAL, 0);
+			aio = next;
+			continue;
+		}
+		if ((used + niov) > NNI_POSIX_UDP_IOVS) {
+			break; // Leave it for the next batch.
+		}
+
+		dg->len = 0;
+		dg->aio = aio;
+		dg->iov = &udp->udp_iovs[used];
+		used += niov;
+		for (unsigned i = 0; i < niov; i++) {
+			dg->iov[i].iov_base = aiov[i].iov_buf;
+			dg->iov[i].iov_len  = aiov[i].iov_len;
+			dg->len += aiov[i].iov_len;
+		}
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->msg_iov     = dg->iov;
+		hdr->msg_iovlen  = niov;
+		hdr->msg_name    = &dg->ss;
+		hdr->msg_namelen = len;
+
+		n++;
+		aio = next;
+	}
+	return (n);
+}
+
 static void
 nni_posix_udp_dorecv(nni_plat_udp *udp)
 {
-	nni_aio * aio;
 	nni_list *q = &udp->udp_recvq;
-	// While we're able to recv, do so.
-	while ((aio = nni_list_first(q)) != NULL) {
-		struct iovec            iov[4];
-		unsigned                niov;
-		nni_iov *               aiov;
-		struct sockaddr_storage ss;
-		nng_sockaddr *          sa;
-		struct msghdr           hdr;
-		int                     rv  = 0;
-		int                     cnt = 0;
 
-		nni_aio_get_iov(aio, &niov, &aiov);
+	// While we're able to recv, do so.
+	while (!nni_list_empty(q)) {
+		unsigned n;
+		int      cnt;
 
-		for (unsigned i = 0; i < niov; i++) {
-			iov[i].iov_base = aiov[i].iov_buf;
-			iov[i].iov_len  = aiov[i].iov_len;
+		if ((n = nni_posix_udp_gather(udp, q, false)) == 0) {
+			continue;
 		}
-		hdr.msg_iov        = iov;
-		hdr.msg_iovlen     = niov;
-		hdr.msg_name       = &ss;
-		hdr.msg_namelen    = sizeof(ss);
-		hdr.msg_flags      = 0;
-		hdr.msg_control    = NULL;
-		hdr.msg_controllen = 0;
-
-		if ((cnt = recvmsg(udp->udp_fd, &hdr, 0)) < 0) {
-			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+		cnt = nni_posix_udp_recvmmsg(udp->udp_fd, udp->udp_hdrs, n);
+		if (cnt < 0) {
+			nni_aio *aio = udp->udp_dgrams[0].aio;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+			    (errno == EINTR)) {
 				// No data available at socket.  Leave
-				// the AIO at the head of the queue.
+				// the AIOs on the queue.
 				return;
 			}
-			rv = nni_plat_errno(errno);
-		} else if ((sa = nni_aio_get_input(aio, 0)) != NULL) {
+			nni_list_remove(q, aio);
+			nni_aio_finish(aio, nni_plat_errno(errno), 0);
+			continue;
+		}
+		for (int i = 0; i < cnt; i++) {
+			nni_posix_udp_dgram *dg = &udp->udp_dgrams[i];
+			nng_sockaddr *       sa;
+
 			// We need to store the address information.
 			// It is incumbent on the AIO submitter to supply
 			// storage for the address.
-			nni_posix_sockaddr2nn(sa, (void *) &ss);
+			if ((sa = nni_aio_get_input(dg->aio, 0)) != NULL) {
+				nni_posix_sockaddr2nn(sa, (void *) &dg->ss);
+			}
+			nni_list_remove(q, dg->aio);
+			nni_aio_finish(dg->aio, 0, udp->udp_hdrs[i].msg_len);
+		}
+		if ((unsigned) cnt < n) {
+			// The socket has been drained.
+			return;
+		}
+	}
+}
+
+#ifdef UDP_SEGMENT
+// nni_posix_udp_gso tries to send a run of datagrams, starting with the
+// first gathered one, with a single segmentation offload send.  It
+// returns the number sent, zero if there was no suitable run, or -1 if
+// the send failed.
+static int
+nni_posix_udp_gso(nni_plat_udp *udp, unsigned n)
+{
+	nni_posix_udp_dgram *dgs = udp->udp_dgrams;
+	struct msghdr *      hdr = &udp->udp_hdrs[0].msg_hdr;
+	struct msghdr        mh;
+	struct cmsghdr *     cm;
+	uint16_t             seg;
+	size_t               tot  = 0;
+	unsigned             run  = 0;
+	unsigned             niov = 0;
+	union {
+		struct cmsghdr align;
+		char           buf[CMSG_SPACE(sizeof(uint16_t))];
+	} cmsg;
+
+	if (udp->udp_nogso || (n < 2) || (dgs[0].len == 0) ||
+	    (dgs[0].len > NNI_POSIX_UDP_GSO_MAX)) {
+		return (0);
+	}
+	seg = (uint16_t) dgs[0].len;
+	while ((run < n) && (run < NNI_POSIX_UDP_GSO_SEGS)) {
+		nni_posix_udp_dgram *dg = &dgs[run];
+		struct msghdr *      h  = &udp->udp_hdrs[run].msg_hdr;
+
+		// All must go to the same place, and all but the last must
+		// be the same size.  (The last may be shorter.)
+		if ((dg->len > seg) || (dg->len == 0) ||
+		    ((tot + dg->len) > NNI_POSIX_UDP_GSO_MAX) ||
+		    (h->msg_namelen != hdr->msg_namelen) ||
+		    (memcmp(&dg->ss, &dgs[0].ss, h->msg_namelen) != 0)) {
+			break;
+		}
+		niov += (unsigned) h->msg_iovlen;
+		tot += dg->len;
+		run++;
+		if (dg->len < seg) {
+			break;
 		}
-		nni_list_remove(q, aio);
-		nni_aio_finish(aio, rv, cnt);
 	}
+	if (run < 2) {
+		return (0);
+	}
+
+	memset(&cmsg, 0, sizeof(cmsg));
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_name       = hdr->msg_name;
+	mh.msg_namelen    = hdr->msg_namelen;
+	mh.msg_iov        = dgs[0].iov; // the run's iovs are contiguous
+	mh.msg_iovlen     = niov;
+	mh.msg_control    = cmsg.buf;
+	mh.msg_controllen = sizeof(cmsg.buf);
+	cm                = CMSG_FIRSTHDR(&mh);
+	cm->cmsg_level    = IPPROTO_UDP;
+	cm->cmsg_type     = UDP_SEGMENT;
+	cm->cmsg_len      = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+
+	if (sendmsg(udp->udp_fd, &mh, NNI_MSG_NOSIGNAL) < 0) {
+		switch (errno) {
+		case EINVAL:
+		case EIO:
+		case ENOTSUP:
+#if defined(EOPNOTSUPP) && (EOPNOTSUPP != ENOTSUP)
+		case EOPNOTSUPP:
+#endif
+			// Not supported here (or by this route); don't try
+			// again, and let the caller send these normally.
+			// Other errors, such as ECONNREFUSED, are transient
+			// and are reported as for any other send.
+			udp->udp_nogso = true;
+			return (0);
+		default:
+			return (-1);
+		}
+	}
+	for (unsigned i = 0; i < run; i++) {
+		udp->udp_hdrs[i].msg_len = (unsigned) dgs[i].len;
+	}
+	return ((int) run);
 }
+#else
+static int
+nni_posix_udp_gso(nni_plat_udp *udp, unsigned n)
+{
+	NNI_ARG_UNUSED(udp);
+	NNI_ARG_UNUSED(n);
+	return (0);
+}
+#endif
 
 static void
 nni_posix_udp_dosend(nni_plat_udp *udp)
 {
-	nni_aio * aio;
 	nni_list *q = &udp->udp_sendq;
 
 	// While we're able to send, do so.
-	while ((aio = nni_list_first(q)) != NULL) {
-		struct sockaddr_storage ss;
-
-		int len;
-		int rv  = 0;
-		int cnt = 0;
-
-		len = nni_posix_nn2sockaddr(&ss, nni_aio_get_input(aio, 0));
-		if (len < 1) {
-			rv = NNG_EADDRINVAL;
-		} else {
-			struct msghdr hdr;
-			unsigned      niov;
-			nni_iov *     aiov;
-#ifdef NNG_HAVE_ALLOCA
-			struct iovec *iov;
-#else
-			struct iovec iov[16];
-#endif
-
-			nni_aio_get_iov(aio, &niov, &aiov);
-#ifdef NNG_HAVE_ALLOCA
-			if (niov > 64) {
-				rv = NNG_EINVAL;
-			} else {
-				iov = alloca(niov * sizeof(*iov));
-			}
-#else
-			if (niov > NNI_NUM_ELEMENTS(iov)) {
-				rv = NNG_EINVAL;
-			}
-#endif
+	while (!nni_list_empty(q)) {
+		unsigned n;
+		int      cnt;
 
-			for (unsigned i = 0; i < niov; i++) {
-				iov[i].iov_base = aiov[i].iov_buf;
-				iov[i].iov_len  = aiov[i].iov_len;
-			}
-			hdr.msg_iov        = iov;
-			hdr.msg_iovlen     = niov;
-			hdr.msg_name       = &ss;
-			hdr.msg_namelen    = len;
-			hdr.msg_flags      = NNI_MSG_NOSIGNAL;
-			hdr.msg_control    = NULL;
-			hdr.msg_controllen = 0;
-
-			if ((cnt = sendmsg(udp->udp_fd, &hdr, 0)) < 0) {
-				if ((errno == EAGAIN) ||
-				    (errno == EWOULDBLOCK)) {
-					// Cannot send now, leave at head.
-					return;
-				}
-				rv = nni_plat_errno(errno);
+		if ((n = nni_posix_udp_gather(udp, q, true)) == 0) {
+			continue;
+		}
+		if ((cnt = nni_posix_udp_gso(udp, n)) == 0) {
+			cnt = nni_posix_udp_sendmmsg(
+			    udp->udp_fd, udp->udp_hdrs, n);
+		}
+		if (cnt < 0) {
+			nni_aio *aio = udp->udp_dgrams[0].aio;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+			    (errno == EINTR)) {
+				// Cannot send now, leave at head.
+				return;
 			}
+			nni_list_remove(q, aio);
+			nni_aio_finish(aio, nni_plat_errno(errno), 0);
+			continue;
 		}
+		for (int i = 0; i < cnt; i++) {
+			nni_posix_udp_dgram *dg = &udp->udp_dgrams[i];
 
-		nni_list_remove(q, aio);
-		nni_aio_finish(aio, rv, cnt);
+			nni_list_remove(q, dg->aio);
+			nni_aio_finish(dg->aio, 0, udp->udp_hdrs[i].msg_len);
+		}
+		if ((unsigned) cnt < n) {
+			// The socket buffer is full.
+			return;
+		}
 	}
 }
 
@@ -0,0 +1,448 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+#include "platform/posix/posix_uring.h"
+
+#ifdef NNG_HAVE_IO_URING
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+// We talk to the kernel directly, rather than using liburing, to avoid
+// another dependency.  The protocol is simple enough: submissions are
+// written into the SQ ring and the tail is published, completions are
+// read from the CQ ring and the head is advanced.  The ring head and tail
+// indices are shared with the kernel, so they are accessed atomically.
+//
+// There is one ring, with one completion thread.  Submissions are made
+// under the ring lock.  Completions are processed by the thread without
+// the lock, since it is the only consumer of the CQ ring.
+
+#ifndef NNG_POSIX_URING_ENTRIES
+#define NNG_POSIX_URING_ENTRIES 1024
+#endif
+
+typedef struct nni_posix_uring {
+	int                  fd;
+	nni_mtx              mtx;
+	nni_thr              thr;
+	pthread_t            tid;     // completion thread
+	bool                 started; // tid is valid
+	bool                 closing; // thread should exit
+	unsigned             pending; // queued, but not yet entered
+	unsigned *           sq_head;
+	unsigned *           sq_tail;
+	unsigned *           sq_mask;
+	unsigned *           sq_array;
+	unsigned             sq_entries;
+	struct io_uring_sqe *sqes;
+	unsigned *           cq_head;
+	unsigned *           cq_tail;
+	unsigned *           cq_mask;
+	struct io_uring_cqe *cqes;
+	void *               sq_ring;
+	size_t               sq_ring_sz;
+	void *               cq_ring;
+	size_t               cq_ring_sz;
+	size_t               sqes_sz;
+} nni_posix_uring;
+
+static nni_posix_uring nni_posix_uring_ring;
+static bool            nni_posix_uring_on;
+static bool            nni_posix_uring_tried;
+static nni_mtx         nni_posix_uring_lk;
+
+static int
+nni_posix_uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags)
+{
+	return ((int) syscall(
+	    __NR_io_uring_enter, fd, submit, wait, flags, NULL, 0));
+}
+
+// nni_posix_uring_flush hands any queued submissions to the kernel.
+// The ring lock must be held.
+static void
+nni_posix_uring_flush(nni_posix_uring *r)
+{
+	while (r->pending > 0) {
+		int n = nni_posix_uring_enter(r->fd, r->pending, 0, 0);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			// EAGAIN or EBUSY; the completion thread will
+			// retry these when it next waits.
+			return;
+		}
+		r->pending -= (unsigned) n;
+	}
+}
+
+static struct io_uring_sqe *
+nni_posix_uring_get_sqe(nni_posix_uring *r)
+{
+	unsigned head;
+	unsigned tail;
+
+	tail = *r->sq_tail;
+	head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+	if ((tail - head) >= r->sq_entries) {
+		nni_posix_uring_flush(r);
+		head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+		if ((tail - head) >= r->sq_entries) {
+			return (NULL);
+		}
+	}
+	return (&r->sqes[tail & *r->sq_mask]);
+}
+
+// nni_posix_uring_submit publishes the prepared entry.  From the
+// completion thread we just queue it, so that a burst of callbacks
+// results in a single system call.  Otherwise we enter it right away.
+static void
+nni_posix_uring_submit(nni_posix_uring *r)
+{
+	unsigned tail = *r->sq_tail;
+
+	r->sq_array[tail & *r->sq_mask] = tail & *r->sq_mask;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	r->pending++;
+	if ((!r->started) || (!pthread_equal(pthread_self(), r->tid))) {
+		nni_posix_uring_flush(r);
+	}
+}
+
+// nni_posix_uring_queue submits an operation.  The meaning of addr, len
+// and off depends on the opcode; flags are the per operation flags
+// (msg_flags for sendmsg and recvmsg, and accept_flags for accept).
+static int
+nni_posix_uring_queue(nni_posix_uring_op *op, int opcode, int fd,
+    void *addr, unsigned len, uint64_t off, int flags)
+{
+	nni_posix_uring *    r = &nni_posix_uring_ring;
+	struct io_uring_sqe *sqe;
+
+	nni_mtx_lock(&r->mtx);
+	if ((sqe = nni_posix_uring_get_sqe(r)) == NULL) {
+		nni_mtx_unlock(&r->mtx);
+		return (NNG_EAGAIN);
+	}
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode    = (uint8_t) opcode;
+	sqe->fd        = fd;
+	sqe->addr      = (uint64_t)(uintptr_t) addr;
+	sqe->len       = len;
+	sqe->off       = off;
+	sqe->msg_flags = (uint32_t) flags;
+	sqe->user_data = (uint64_t)(uintptr_t) op;
+	nni_posix_uring_submit(r);
+	nni_mtx_unlock(&r->mtx);
+	return (0);
+}
+
+int
+nni_posix_uring_recvmsg(
+    nni_posix_uring_op *op, int fd, struct msghdr *mh, int flags)
+{
+	return (nni_posix_uring_queue(
+	    op, IORING_OP_RECVMSG, fd, mh, 1, 0, flags));
+}
+
+int
+nni_posix_uring_sendmsg(
+    nni_posix_uring_op *op, int fd, struct msghdr *mh, int flags)
+{
+	return (nni_posix_uring_queue(
+	    op, IORING_OP_SENDMSG, fd, mh, 1, 0, flags));
+}
+
+int
+nni_posix_uring_accept(nni_posix_uring_op *op, int fd, int flags)
+{
+	return (nni_posix_uring_queue(
+	    op, IORING_OP_ACCEPT, fd, NULL, 0, 0, flags));
+}
+
+int
+nni_posix_uring_connect(
+    nni_posix_uring_op *op, int fd, const struct sockaddr *sa, socklen_t len)
+{
+	return (nni_posix_uring_queue(
+	    op, IORING_OP_CONNECT, fd, (void *) sa, 0, len, 0));
+}
+
+// Entries with no user data (cancellations, and the wake up used to stop
+// the thread) have completions that we just discard.
+static void
+nni_posix_uring_control(nni_posix_uring *r, int opcode, void *target)
+{
+	struct io_uring_sqe *sqe;
+
+	// If the ring is full, there is nothing better to do than wait
+	// for the completion thread to make room.
+	while ((sqe = nni_posix_uring_get_sqe(r)) == NULL) {
+		nni_mtx_unlock(&r->mtx);
+		nni_msleep(1);
+		nni_mtx_lock(&r->mtx);
+	}
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode    = (uint8_t) opcode;
+	sqe->fd        = -1;
+	sqe->addr      = (uint64_t)(uintptr_t) target;
+	sqe->user_data = 0;
+	nni_posix_uring_submit(r);
+}
+
+void
+nni_posix_uring_cancel(nni_posix_uring_op *op)
+{
+	nni_posix_uring *r = &nni_posix_uring_ring;
+
+	nni_mtx_lock(&r->mtx);
+	nni_posix_uring_control(r, IORING_OP_ASYNC_CANCEL, op);
+	nni_mtx_unlock(&r->mtx);
+}
+
+static void
+nni_posix_uring_thr(void *arg)
+{
+	nni_posix_uring *r = arg;
+
+	nni_mtx_lock(&r->mtx);
+	r->tid     = pthread_self();
+	r->started = true;
+	nni_mtx_unlock(&r->mtx);
+
+	for (;;) {
+		unsigned submit;
+		unsigned head;
+		unsigned tail;
+		int      n;
+
+		nni_mtx_lock(&r->mtx);
+		if (r->closing) {
+			nni_mtx_unlock(&r->mtx);
+			return;
+		}
+		submit = r->pending;
+		nni_mtx_unlock(&r->mtx);
+
+		n = nni_posix_uring_enter(
+		    r->fd, submit, 1, IORING_ENTER_GETEVENTS);
+		if (n < 0) {
+			if ((errno != EINTR) && (errno != EAGAIN) &&
+			    (errno != EBUSY)) {
+				nni_panic(
+				    "io_uring_enter: %s", strerror(errno));
+			}
+			n = 0;
+		}
+		// Only what the kernel took is gone.  The rest, after a
+		// short submit or EAGAIN or EBUSY, is tried again on the
+		// next pass; the kernel does not wait in those cases, so
+		// that comes right after we reap.  Other threads may have
+		// entered some of it meanwhile, but each entry is counted
+		// only once, by whoever entered it.
+		nni_mtx_lock(&r->mtx);
+		r->pending -= (unsigned) n;
+		nni_mtx_unlock(&r->mtx);
+
+		head = *r->cq_head;
+		tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail) {
+			struct io_uring_cqe *cqe;
+			nni_posix_uring_op * op;
+			int                  res;
+
+			cqe = &r->cqes[head & *r->cq_mask];
+			op  = (void *) (uintptr_t) cqe->user_data;
+			res = cqe->res;
+			head++;
+			// Release the slot before the callback, which may
+			// well submit more work.
+			__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+			if (op != NULL) {
+				op->op_cb(op->op_arg, res);
+			}
+			tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+		}
+	}
+}
+
+static void
+nni_posix_uring_destroy(nni_posix_uring *r)
+{
+	if (r->sqes != NULL) {
+		(void) munmap(r->sqes, r->sqes_sz);
+	}
+	if ((r->cq_ring != NULL) && (r->cq_ring != r->sq_ring)) {
+		(void) munmap(r->cq_ring, r->cq_ring_sz);
+	}
+	if (r->sq_ring != NULL) {
+		(void) munmap(r->sq_ring, r->sq_ring_sz);
+	}
+	if (r->fd >= 0) {
+		(void) close(r->fd);
+	}
+	nni_mtx_fini(&r->mtx);
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+static int
+nni_posix_uring_create(nni_posix_uring *r)
+{
+	struct io_uring_params p;
+	uint8_t *              sq;
+	uint8_t *              cq;
+
+	memset(&p, 0, sizeof(p));
+	memset(r, 0, sizeof(*r));
+	nni_mtx_init(&r->mtx);
+
+	r->fd = (int) syscall(
+	    __NR_io_uring_setup, NNG_POSIX_URING_ENTRIES, &p);
+	if (r->fd < 0) {
+		r->fd = -1;
+		return (nni_plat_errno(errno));
+	}
+
+	// We need socket send/recvmsg, accept, connect and cancellation,
+	// and we rely on the kernel not dropping completions.  Kernels that
+	// have internal poll support have all of that, and are also the
+	// only ones where this beats our own pollers.
+	if (((p.features & IORING_FEAT_NODROP) == 0) ||
+	    ((p.features & IORING_FEAT_FAST_POLL) == 0)) {
+		return (NNG_ENOTSUP);
+	}
+
+	r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_ring_sz =
+	    p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_ring_sz > r->sq_ring_sz) {
+			r->sq_ring_sz = r->cq_ring_sz;
+		}
+		r->cq_ring_sz = r->sq_ring_sz;
+	}
+	r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) {
+		r->sq_ring = NULL;
+		return (nni_plat_errno(errno));
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ring = r->sq_ring;
+	} else {
+		r->cq_ring = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED) {
+			r->cq_ring = NULL;
+			return (nni_plat_errno(errno));
+		}
+	}
+	r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes    = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		return (nni_plat_errno(errno));
+	}
+
+	sq            = r->sq_ring;
+	cq            = r->cq_ring;
+	r->sq_head    = (void *) (sq + p.sq_off.head);
+	r->sq_tail    = (void *) (sq + p.sq_off.tail);
+	r->sq_mask    = (void *) (sq + p.sq_off.ring_mask);
+	r->sq_array   = (void *) (sq + p.sq_off.array);
+	r->sq_entries = p.sq_entries;
+	r->cq_head    = (void *) (cq + p.cq_off.head);
+	r->cq_tail    = (void *) (cq + p.cq_off.tail);
+	r->cq_mask    = (void *) (cq + p.cq_off.ring_mask);
+	r->cqes       = (void *) (cq + p.cq_off.cqes);
+	return (0);
+}
+
+// The ring is set up when the first pipe or endpoint asks for it, so
+// that programs that never use TCP or IPC do not pay for it.
+static void
+nni_posix_uring_start(void)
+{
+	nni_posix_uring *r = &nni_posix_uring_ring;
+
+	nni_posix_uring_tried = true;
+	if (getenv("NNG_DISABLE_IO_URING") != NULL) {
+		return;
+	}
+
+	// Failure to set up the ring is not an error; the kernel may be
+	// too old, or io_uring may be disabled by policy.  We just use
+	// the pollers instead.
+	if ((nni_posix_uring_create(r) != 0) ||
+	    (nni_thr_init(&r->thr, nni_posix_uring_thr, r) != 0)) {
+		nni_posix_uring_destroy(r);
+		return;
+	}
+	nni_thr_run(&r->thr);
+	nni_posix_uring_on = true;
+}
+
+int
+nni_posix_uring_sysinit(void)
+{
+	nni_mtx_init(&nni_posix_uring_lk);
+	nni_posix_uring_on    = false;
+	nni_posix_uring_tried = false;
+	return (0);
+}
+
+void
+nni_posix_uring_sysfini(void)
+{
+	nni_posix_uring *r = &nni_posix_uring_ring;
+
+	if (!nni_posix_uring_on) {
+		nni_mtx_fini(&nni_posix_uring_lk);
+		return;
+	}
+	nni_mtx_lock(&r->mtx);
+	r->closing = true;
+	nni_posix_uring_control(r, IORING_OP_NOP, NULL);
+	nni_mtx_unlock(&r->mtx);
+
+	nni_thr_fini(&r->thr);
+	nni_posix_uring_destroy(r);
+	nni_posix_uring_on = false;
+	nni_mtx_fini(&nni_posix_uring_lk);
+}
+
+bool
+nni_posix_uring_enabled(void)
+{
+	bool on;
+
+	nni_mtx_lock(&nni_posix_uring_lk);
+	if (!nni_posix_uring_tried) {
+		nni_posix_uring_start();
+	}
+	on = nni_posix_uring_on;
+	nni_mtx_unlock(&nni_posix_uring_lk);
+	return (on);
+}
+
+#endif // NNG_HAVE_IO_URING
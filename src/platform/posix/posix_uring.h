@@ -0,0 +1,66 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef PLATFORM_POSIX_URING_H
+#define PLATFORM_POSIX_URING_H
+
+#ifdef NNG_HAVE_IO_URING
+
+// This is a completion based I/O backend using Linux io_uring.  Rather
+// than waiting for readiness and then doing the I/O, the operation itself
+// is submitted to the kernel, and its result is delivered on a single
+// completion thread.  Operations submitted from that thread (usually
+// to start the next transfer from a completion callback) are batched,
+// and handed to the kernel together when the thread next waits.
+//
+// The backend is optional at build time (NNG_ENABLE_IO_URING).  At run
+// time it is only used if the kernel supports it, and it can be turned
+// off by setting NNG_DISABLE_IO_URING in the environment.
+
+#include "core/nng_impl.h"
+
+#include <sys/socket.h>
+
+typedef struct nni_posix_uring_op nni_posix_uring_op;
+
+// nni_posix_uring_op tracks a single submitted operation.  The callback
+// is run on the completion thread, with the result (a byte count, or a
+// negated errno value).  Anything referenced by the operation, such as
+// the msghdr and buffers, must remain valid until then.
+struct nni_posix_uring_op {
+	void (*op_cb)(void *, int);
+	void *op_arg;
+};
+
+// nni_posix_uring_enabled is true if the ring was set up successfully.
+extern bool nni_posix_uring_enabled(void);
+
+extern int nni_posix_uring_recvmsg(
+    nni_posix_uring_op *, int, struct msghdr *, int);
+extern int nni_posix_uring_sendmsg(
+    nni_posix_uring_op *, int, struct msghdr *, int);
+
+// nni_posix_uring_accept accepts a connection on the listening socket.
+// The result is the new descriptor.  The flags are as for accept4.
+extern int nni_posix_uring_accept(nni_posix_uring_op *, int, int);
+
+// nni_posix_uring_connect connects the socket to the address, which must
+// remain valid until the callback runs.  The result is zero on success.
+extern int nni_posix_uring_connect(
+    nni_posix_uring_op *, int, const struct sockaddr *, socklen_t);
+
+// nni_posix_uring_cancel asks the kernel to cancel the operation.  The
+// callback still runs, either with -ECANCELED or with the real result
+// if the operation finished first.
+extern void nni_posix_uring_cancel(nni_posix_uring_op *);
+
+#endif // NNG_HAVE_IO_URING
+
+#endif // PLATFORM_POSIX_URING_H
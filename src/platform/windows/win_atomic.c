@@ -0,0 +1,70 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+
+#ifdef NNG_PLATFORM_WINDOWS
+
+// The Interlocked functions are all full barriers.  Plain loads are
+// made ordered by using a no-op compare and exchange.
+
+uint32_t
+nni_plat_atomic_load32(uint32_t *v)
+{
+	return ((uint32_t) InterlockedCompareExchange((LONG *) v, 0, 0));
+}
+
+void
+nni_plat_atomic_store32(uint32_t *v, uint32_t n)
+{
+	(void) InterlockedExchange((LONG *) v, (LONG) n);
+}
+
+bool
+nni_plat_atomic_cas32(uint32_t *v, uint32_t old, uint32_t n)
+{
+	return ((uint32_t) InterlockedCompareExchange(
+	            (LONG *) v, (LONG) n, (LONG) old) == old);
+}
+
+uint32_t
+nni_plat_atomic_add32(uint32_t *v, int32_t delta)
+{
+	return ((uint32_t) InterlockedExchangeAdd((LONG *) v, (LONG) delta) +
+	    (uint32_t) delta);
+}
+
+uint64_t
+nni_plat_atomic_load64(uint64_t *v)
+{
+	return ((uint64_t) InterlockedCompareExchange64((LONG64 *) v, 0, 0));
+}
+
+uint64_t
+nni_plat_atomic_add64(uint64_t *v, int64_t delta)
+{
+	return ((uint64_t) InterlockedExchangeAdd64(
+	            (LONG64 *) v, (LONG64) delta) +
+	    (uint64_t) delta);
+}
+
+void *
+nni_plat_atomic_load_ptr(void **v)
+{
+	return (InterlockedCompareExchangePointer(v, NULL, NULL));
+}
+
+void
+nni_plat_atomic_store_ptr(void **v, void *n)
+{
+	(void) InterlockedExchangePointer(v, n);
+}
+
+#endif // NNG_PLATFORM_WINDOWS
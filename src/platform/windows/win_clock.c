@@ -19,6 +19,13 @@ nni_plat_clock(void)
 	return (GetTickCount64());
 }
 
+nni_time
+nni_plat_clock_coarse(void)
+{
+	// The tick count is already as cheap as it gets.
+	return (GetTickCount64());
+}
+
 void
 nni_plat_sleep(nni_duration dur)
 {
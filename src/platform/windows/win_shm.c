@@ -0,0 +1,92 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+
+#ifdef NNG_PLATFORM_WINDOWS
+
+// Shared memory support.  Not implemented on Windows yet; the shm
+// transport is not built there.
+
+int
+nni_plat_shm_create(nni_plat_shm **shmp, size_t size)
+{
+	NNI_ARG_UNUSED(shmp);
+	NNI_ARG_UNUSED(size);
+	return (NNG_ENOTSUP);
+}
+
+int
+nni_plat_shm_open(nni_plat_shm **shmp, const char *name, size_t size)
+{
+	NNI_ARG_UNUSED(shmp);
+	NNI_ARG_UNUSED(name);
+	NNI_ARG_UNUSED(size);
+	return (NNG_ENOTSUP);
+}
+
+const char *
+nni_plat_shm_name(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+	return (NULL);
+}
+
+void *
+nni_plat_shm_addr(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+	return (NULL);
+}
+
+void
+nni_plat_shm_unlink(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+}
+
+void
+nni_plat_shm_fini(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+}
+
+int
+nni_plat_shm_memfd(int *fdp, const nni_iov *iov, unsigned niov)
+{
+	NNI_ARG_UNUSED(fdp);
+	NNI_ARG_UNUSED(iov);
+	NNI_ARG_UNUSED(niov);
+	return (NNG_ENOTSUP);
+}
+
+int
+nni_plat_shm_mapfd(void **addrp, int fd, size_t size)
+{
+	NNI_ARG_UNUSED(addrp);
+	NNI_ARG_UNUSED(fd);
+	NNI_ARG_UNUSED(size);
+	return (NNG_ENOTSUP);
+}
+
+void
+nni_plat_shm_unmap(void *addr, size_t size)
+{
+	NNI_ARG_UNUSED(addr);
+	NNI_ARG_UNUSED(size);
+}
+
+void
+nni_plat_shm_closefd(int fd)
+{
+	NNI_ARG_UNUSED(fd);
+}
+
+#endif // NNG_PLATFORM_WINDOWS
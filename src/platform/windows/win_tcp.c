@@ -431,6 +431,18 @@ nni_plat_tcp_ep_listen(nni_plat_tcp_ep *ep, nng_sockaddr *bsa)
 	return (rv);
 }
 
+int
+nni_plat_tcp_ep_set_listeners(nni_plat_tcp_ep *ep, int n)
+{
+	NNI_ARG_UNUSED(ep);
+
+	// Windows has no equivalent of SO_REUSEPORT load balancing.
+	if (n < 1) {
+		return (NNG_EINVAL);
+	}
+	return (n > 1 ? NNG_ENOTSUP : 0);
+}
+
 static void
 nni_win_tcp_acc_cancel(nni_win_event *evt)
 {
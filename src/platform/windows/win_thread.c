@@ -17,13 +17,13 @@
 #include <stdlib.h>
 
 void *
-nni_alloc(size_t sz)
+nni_plat_alloc(size_t sz)
 {
 	return (calloc(sz, 1));
 }
 
 void
-nni_free(void *b, size_t z)
+nni_plat_free(void *b, size_t z)
 {
 	NNI_ARG_UNUSED(z);
 	free(b);
@@ -138,6 +138,37 @@ nni_plat_thr_fini(nni_plat_thr *thr)
 	}
 }
 
+// Thread local storage.  We use TLS rather than FLS slots, so there is no
+// destructor; values left by exiting threads are reclaimed by the owner
+// of the slot.
+int
+nni_plat_tls_init(nni_plat_tls *tls, void (*dtor)(void *))
+{
+	NNI_ARG_UNUSED(dtor);
+	if ((tls->index = TlsAlloc()) == TLS_OUT_OF_INDEXES) {
+		return (NNG_ENOMEM);
+	}
+	return (0);
+}
+
+void
+nni_plat_tls_fini(nni_plat_tls *tls)
+{
+	(void) TlsFree(tls->index);
+}
+
+void *
+nni_plat_tls_get(nni_plat_tls *tls)
+{
+	return (TlsGetValue(tls->index));
+}
+
+void
+nni_plat_tls_set(nni_plat_tls *tls, void *val)
+{
+	(void) TlsSetValue(tls->index, val);
+}
+
 static LONG plat_inited = 0;
 
 int
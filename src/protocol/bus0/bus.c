@@ -148,7 +148,10 @@ bus0_pipe_init(void **pp, nni_pipe *npipe, void *s)
 
 	p->npipe = npipe;
 	p->psock = s;
-	*pp      = p;
+	nni_msgq_set_sock(p->sendq, nni_pipe_sock(npipe));
+	nni_msgq_set_maxbytes(
+	    p->sendq, nni_sock_pipebufsz(nni_pipe_sock(npipe)));
+	*pp = p;
 	return (0);
 }
 
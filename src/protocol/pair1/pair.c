@@ -136,7 +136,10 @@ pair1_pipe_init(void **pp, nni_pipe *npipe, void *psock)
 
 	p->npipe = npipe;
 	p->psock = psock;
-	*pp      = p;
+	nni_msgq_set_sock(p->sendq, nni_pipe_sock(npipe));
+	nni_msgq_set_maxbytes(
+	    p->sendq, nni_sock_pipebufsz(nni_pipe_sock(npipe)));
+	*pp = p;
 
 	return (rv);
 }
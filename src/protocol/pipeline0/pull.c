@@ -209,6 +209,14 @@ pull0_sock_recv(void *arg, nni_aio *aio)
 	nni_msgq_aio_get(s->urq, aio);
 }
 
+static size_t
+pull0_sock_recvv(void *arg, nni_msg **msgv, size_t n)
+{
+	pull0_sock *s = arg;
+
+	return (nni_msgq_getv(s->urq, msgv, n));
+}
+
 static nni_proto_pipe_ops pull0_pipe_ops = {
 	.pipe_init  = pull0_pipe_init,
 	.pipe_fini  = pull0_pipe_fini,
@@ -233,6 +241,7 @@ static nni_proto_sock_ops pull0_sock_ops = {
 	.sock_close   = pull0_sock_close,
 	.sock_send    = pull0_sock_send,
 	.sock_recv    = pull0_sock_recv,
+	.sock_recvv   = pull0_sock_recvv,
 	.sock_options = pull0_sock_options,
 };
 
@@ -15,8 +15,11 @@
 #include "protocol/pipeline0/push.h"
 
 // Push protocol.  The PUSH protocol is the "write" side of a pipeline.
-// Push distributes fairly, or tries to, by giving messages in round-robin
-// order.
+// Push distributes fairly, or tries to.  By default messages are given out
+// in round-robin order, but other policies can be selected with
+// NNG_OPT_LB_POLICY.  The socket pulls messages from the upper write
+// queue and chooses a pipe for each one; every pipe can hold a few
+// messages, so that the policies have outstanding work to compare.
 
 #ifndef NNI_PROTO_PULL_V0
 #define NNI_PROTO_PULL_V0 NNI_PROTO(5, 1)
@@ -26,6 +29,12 @@
 #define NNI_PROTO_PUSH_V0 NNI_PROTO(5, 0)
 #endif
 
+// Number of messages a pipe may hold, including the one being sent.  The
+// messages waiting behind it are also limited by NNG_OPT_PIPEBUFSZ.
+#ifndef NNI_PUSH0_DEPTH
+#define NNI_PUSH0_DEPTH 4
+#endif
+
 typedef struct push0_pipe push0_pipe;
 typedef struct push0_sock push0_sock;
 
@@ -35,47 +44,75 @@ static void push0_getq_cb(void *);
 
 // push0_sock is our per-socket protocol private structure.
 struct push0_sock {
+	nni_sock *sock;
 	nni_msgq *uwq;
 	int       raw;
+	nni_mtx   mtx;
+	nni_lb    lb;
+	nni_aio * aio_getq;
+	nni_msg * held; // waiting for a pipe; aio_getq is idle
 };
 
 // push0_pipe is our per-pipe protocol private structure.
 struct push0_pipe {
-	nni_pipe *    pipe;
-	push0_sock *  push;
-	nni_list_node node;
+	nni_pipe *  pipe;
+	push0_sock *push;
+	nni_lb_pipe lb;
+	int         closed;
+	int         busy; // aio_send in use
+	nni_time    sent;
+	nni_msg *   ring[NNI_PUSH0_DEPTH];
+	unsigned    head;
+	unsigned    count;
+	size_t      bytes;    // held in the ring
+	size_t      maxbytes; // zero for no limit
 
 	nni_aio *aio_recv;
 	nni_aio *aio_send;
-	nni_aio *aio_getq;
 };
 
+static void
+push0_sock_fini(void *arg)
+{
+	push0_sock *s = arg;
+
+	nni_aio_stop(s->aio_getq);
+	if (s->held != NULL) {
+		nni_msg_free(s->held);
+	}
+	nni_aio_fini(s->aio_getq);
+	nni_mtx_fini(&s->mtx);
+	NNI_FREE_STRUCT(s);
+}
+
 static int
 push0_sock_init(void **sp, nni_sock *sock)
 {
 	push0_sock *s;
+	int         rv;
 
 	if ((s = NNI_ALLOC_STRUCT(s)) == NULL) {
 		return (NNG_ENOMEM);
 	}
-	s->raw = 0;
-	s->uwq = nni_sock_sendq(sock);
-	*sp    = s;
+	nni_mtx_init(&s->mtx);
+	nni_lb_init(&s->lb);
+	if ((rv = nni_aio_init(&s->aio_getq, push0_getq_cb, s)) != 0) {
+		push0_sock_fini(s);
+		return (rv);
+	}
+	s->raw  = 0;
+	s->sock = sock;
+	s->uwq  = nni_sock_sendq(sock);
+	*sp     = s;
 	return (0);
 }
 
 static void
-push0_sock_fini(void *arg)
+push0_sock_open(void *arg)
 {
 	push0_sock *s = arg;
 
-	NNI_FREE_STRUCT(s);
-}
-
-static void
-push0_sock_open(void *arg)
-{
-	NNI_ARG_UNUSED(arg);
+	nni_msgq_aio_get(s->uwq, s->aio_getq);
 }
 
 static void
@@ -91,7 +128,6 @@ push0_pipe_fini(void *arg)
 
 	nni_aio_fini(p->aio_recv);
 	nni_aio_fini(p->aio_send);
-	nni_aio_fini(p->aio_getq);
 	NNI_FREE_STRUCT(p);
 }
 
@@ -105,18 +141,102 @@ push0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 		return (NNG_ENOMEM);
 	}
 	if (((rv = nni_aio_init(&p->aio_recv, push0_recv_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_send, push0_send_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_getq, push0_getq_cb, p)) != 0)) {
+	    ((rv = nni_aio_init(&p->aio_send, push0_send_cb, p)) != 0)) {
 		push0_pipe_fini(p);
 		return (rv);
 	}
-	NNI_LIST_NODE_INIT(&p->node);
-	p->pipe = pipe;
-	p->push = s;
-	*pp     = p;
+	NNI_LIST_NODE_INIT(&p->lb.lp_node);
+	p->pipe     = pipe;
+	p->push     = s;
+	p->maxbytes = nni_sock_pipebufsz(nni_pipe_sock(pipe));
+	*pp         = p;
 	return (0);
 }
 
+// push0_expired drops the message, returning true, if its deadline has
+// passed while it was waiting for a pipe.
+static bool
+push0_expired(push0_sock *s, nni_msg *msg)
+{
+	if (!nni_msg_expired(msg)) {
+		return (false);
+	}
+	nni_msg_free(msg);
+	nni_sock_add_expired(s->sock, 1);
+	return (true);
+}
+
+static size_t
+push0_msg_size(nni_msg *msg)
+{
+	return (nni_msg_len(msg) + nni_msg_header_len(msg));
+}
+
+// push0_pipe_update works out whether the pipe can take another message.
+// As for message queues, an empty ring always has room for one, even if
+// it is over the byte limit.
+static void
+push0_pipe_update(push0_pipe *p)
+{
+	p->lb.lp_ready = (p->lb.lp_pending < NNI_PUSH0_DEPTH) &&
+	    ((p->maxbytes == 0) || (p->count == 0) ||
+	        (p->bytes < p->maxbytes));
+}
+
+// push0_pipe_take removes the oldest message from the ring.
+static nni_msg *
+push0_pipe_take(push0_pipe *p)
+{
+	nni_msg *msg = p->ring[p->head];
+
+	p->head = (p->head + 1) % NNI_PUSH0_DEPTH;
+	p->count--;
+	p->bytes -= push0_msg_size(msg);
+	return (msg);
+}
+
+// push0_pipe_put gives the message to the pipe, sending it right away
+// if the pipe is idle.  The caller must hold the socket lock, and must
+// have seen that the pipe is ready.
+static void
+push0_pipe_put(push0_pipe *p, nni_msg *msg)
+{
+	if (!p->busy) {
+		p->busy = 1;
+		p->sent = nni_clock();
+		nni_aio_set_msg(p->aio_send, msg);
+		nni_pipe_send(p->pipe, p->aio_send);
+	} else {
+		p->ring[(p->head + p->count) % NNI_PUSH0_DEPTH] = msg;
+		p->count++;
+		p->bytes += push0_msg_size(msg);
+	}
+	p->lb.lp_pending++;
+	push0_pipe_update(p);
+}
+
+// push0_sock_kick places the held message, if a pipe will take it now,
+// and then resumes pulling from the write queue.  Socket lock held.
+static void
+push0_sock_kick(push0_sock *s)
+{
+	push0_pipe *p;
+
+	if (s->held == NULL) {
+		return;
+	}
+	if (push0_expired(s, s->held)) {
+		s->held = NULL;
+		nni_msgq_aio_get(s->uwq, s->aio_getq);
+		return;
+	}
+	if ((p = nni_lb_choose(&s->lb, s->held)) != NULL) {
+		push0_pipe_put(p, s->held);
+		s->held = NULL;
+		nni_msgq_aio_get(s->uwq, s->aio_getq);
+	}
+}
+
 static int
 push0_pipe_start(void *arg)
 {
@@ -127,13 +247,17 @@ push0_pipe_start(void *arg)
 		return (NNG_EPROTO);
 	}
 
+	nni_mtx_lock(&s->mtx);
+	nni_lb_add(&s->lb, &p->lb, p, nni_pipe_id(p->pipe),
+	    nni_pipe_weight(p->pipe));
+	p->lb.lp_ready = 1;
+	push0_sock_kick(s);
+	nni_mtx_unlock(&s->mtx);
+
 	// Schedule a receiver.  This is mostly so that we can detect
 	// a closed transport pipe.
 	nni_pipe_recv(p->pipe, p->aio_recv);
 
-	// Schedule a sender.
-	nni_msgq_aio_get(s->uwq, p->aio_getq);
-
 	return (0);
 }
 
@@ -141,10 +265,36 @@ static void
 push0_pipe_stop(void *arg)
 {
 	push0_pipe *p = arg;
+	push0_sock *s = p->push;
+	push0_pipe *other;
+	nni_msg *   msg;
+
+	// Unlink first, so that nothing new is given to us.
+	nni_mtx_lock(&s->mtx);
+	nni_lb_remove(&s->lb, &p->lb);
+	p->closed      = 1;
+	p->lb.lp_ready = 0;
+	nni_mtx_unlock(&s->mtx);
 
 	nni_aio_stop(p->aio_recv);
 	nni_aio_stop(p->aio_send);
-	nni_aio_stop(p->aio_getq);
+
+	// Anything still queued here is given to the other pipes, if they
+	// have room; what they cannot take is lost, as it would have been
+	// had it already been in flight.
+	nni_mtx_lock(&s->mtx);
+	while (p->count > 0) {
+		msg = push0_pipe_take(p);
+		if (push0_expired(s, msg)) {
+			continue;
+		}
+		if ((other = nni_lb_choose(&s->lb, msg)) != NULL) {
+			push0_pipe_put(other, msg);
+		} else {
+			nni_msg_free(msg);
+		}
+	}
+	nni_mtx_unlock(&s->mtx);
 }
 
 static void
@@ -168,6 +318,7 @@ push0_send_cb(void *arg)
 {
 	push0_pipe *p = arg;
 	push0_sock *s = p->push;
+	nni_msg *   msg;
 
 	if (nni_aio_result(p->aio_send) != 0) {
 		nni_msg_free(nni_aio_get_msg(p->aio_send));
@@ -176,25 +327,116 @@ push0_send_cb(void *arg)
 		return;
 	}
 
-	nni_msgq_aio_get(s->uwq, p->aio_getq);
+	nni_mtx_lock(&s->mtx);
+	nni_lb_sample(&p->lb, (nni_duration)(nni_clock() - p->sent));
+	p->lb.lp_pending--;
+	if (p->closed) {
+		p->busy = 0;
+		nni_mtx_unlock(&s->mtx);
+		return;
+	}
+	p->busy = 0;
+	while (p->count > 0) {
+		msg = push0_pipe_take(p);
+		if (push0_expired(s, msg)) {
+			p->lb.lp_pending--;
+			continue;
+		}
+		p->busy = 1;
+		p->sent = nni_clock();
+		nni_aio_set_msg(p->aio_send, msg);
+		nni_pipe_send(p->pipe, p->aio_send);
+		break;
+	}
+	push0_pipe_update(p);
+	push0_sock_kick(s);
+	nni_mtx_unlock(&s->mtx);
 }
 
 static void
 push0_getq_cb(void *arg)
 {
-	push0_pipe *p   = arg;
-	nni_aio *   aio = p->aio_getq;
+	push0_sock *s   = arg;
+	nni_aio *   aio = s->aio_getq;
+	push0_pipe *p;
+	nni_msg *   msg;
 
 	if (nni_aio_result(aio) != 0) {
-		// If the socket is closing, nothing else we can do.
-		nni_pipe_stop(p->pipe);
+		// The socket is closing, nothing else we can do.
 		return;
 	}
 
-	nni_aio_set_msg(p->aio_send, nni_aio_get_msg(aio));
+	msg = nni_aio_get_msg(aio);
 	nni_aio_set_msg(aio, NULL);
 
-	nni_pipe_send(p->pipe, p->aio_send);
+	nni_mtx_lock(&s->mtx);
+	for (;;) {
+		if ((p = nni_lb_choose(&s->lb, msg)) == NULL) {
+			// Nobody can take it; wait for a pipe to become ready.
+			s->held = msg;
+			break;
+		}
+		push0_pipe_put(p, msg);
+
+		// Take whatever else is already queued now, rather than
+		// paying for a callback per message.  The pipes only hold
+		// a few messages each, so this stops soon enough.
+		if (nni_msgq_getv(s->uwq, &msg, 1) == 0) {
+			nni_msgq_aio_get(s->uwq, aio);
+			break;
+		}
+	}
+	nni_mtx_unlock(&s->mtx);
+}
+
+static int
+push0_sock_setopt_policy(void *arg, const void *buf, size_t sz)
+{
+	push0_sock *s = arg;
+	int         rv;
+
+	nni_mtx_lock(&s->mtx);
+	if ((rv = nni_lb_setopt_policy(&s->lb, buf, sz)) == 0) {
+		push0_sock_kick(s);
+	}
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+push0_sock_getopt_policy(void *arg, void *buf, size_t *szp)
+{
+	push0_sock *s = arg;
+	int         rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_lb_getopt_policy(&s->lb, buf, szp);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+push0_sock_setopt_hashlen(void *arg, const void *buf, size_t sz)
+{
+	push0_sock *s = arg;
+	int         rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_lb_setopt_hashlen(&s->lb, buf, sz);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+push0_sock_getopt_hashlen(void *arg, void *buf, size_t *szp)
+{
+	push0_sock *s = arg;
+	int         rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_lb_getopt_hashlen(&s->lb, buf, szp);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
 }
 
 static int
@@ -219,6 +461,14 @@ push0_sock_send(void *arg, nni_aio *aio)
 	nni_msgq_aio_put(s->uwq, aio);
 }
 
+static size_t
+push0_sock_sendv(void *arg, nni_msg **msgv, size_t n)
+{
+	push0_sock *s = arg;
+
+	return (nni_msgq_putv(s->uwq, msgv, n));
+}
+
 static void
 push0_sock_recv(void *arg, nni_aio *aio)
 {
@@ -239,6 +489,16 @@ static nni_proto_sock_option push0_sock_options[] = {
 	    .pso_getopt = push0_sock_getopt_raw,
 	    .pso_setopt = push0_sock_setopt_raw,
 	},
+	{
+	    .pso_name   = NNG_OPT_LB_POLICY,
+	    .pso_getopt = push0_sock_getopt_policy,
+	    .pso_setopt = push0_sock_setopt_policy,
+	},
+	{
+	    .pso_name   = NNG_OPT_LB_HASHLEN,
+	    .pso_getopt = push0_sock_getopt_hashlen,
+	    .pso_setopt = push0_sock_setopt_hashlen,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
@@ -251,6 +511,7 @@ static nni_proto_sock_ops push0_sock_ops = {
 	.sock_options = push0_sock_options,
 	.sock_send    = push0_sock_send,
 	.sock_recv    = push0_sock_recv,
+	.sock_sendv   = push0_sock_sendv,
 };
 
 static nni_proto push0_proto = {
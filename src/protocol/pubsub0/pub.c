@@ -15,9 +15,28 @@
 #include "protocol/pubsub0/pub.h"
 
 // Publish protocol.  The PUB protocol simply sends messages out, as
-// a broadcast.  It has nothing more sophisticated because it does not
-// perform sender-side filtering.  Its best effort delivery, so anything
-// that can't receive the message won't get one.
+// a broadcast.  Its best effort delivery, so anything that can't receive
+// the message won't get one.
+//
+// Subscribers may optionally tell us which topics they want (see
+// NNG_OPT_SUB_FORWARD in sub.c).  Pipes that have done so get only the
+// messages matching one of their topics; we check this before we
+// duplicate the message for them.  Pipes that have not, which includes
+// all older subscribers, get everything, and filter for themselves.
+
+// Optionally (NNG_OPT_PUB_CONFLATE) messages are conflated by key, the
+// key being a fixed number of leading bytes of the body.  In that mode
+// each pipe holds at most one pending message per key, and a newer
+// message replaces the queued one in place, so that slow consumers skip
+// stale updates rather than losing fresh ones.  The socket can also keep
+// the newest message for every key (NNG_OPT_PUB_LVC), which is used to
+// prime newly connected subscribers with the current state.
+
+// These must match the values used in sub.c.
+enum pub0_fwd_ops {
+	pub0_fwd_off = 0, // send everything
+	pub0_fwd_set = 1, // followed by topics, each a 32-bit length + data
+};
 
 #ifndef NNI_PROTO_SUB_V0
 #define NNI_PROTO_SUB_V0 NNI_PROTO(2, 1)
@@ -27,8 +46,11 @@
 #define NNI_PROTO_PUB_V0 NNI_PROTO(2, 0)
 #endif
 
-typedef struct pub0_pipe pub0_pipe;
-typedef struct pub0_sock pub0_sock;
+typedef struct pub0_pipe  pub0_pipe;
+typedef struct pub0_sock  pub0_sock;
+typedef struct pub0_topic pub0_topic;
+typedef struct pub0_cq    pub0_cq;
+typedef struct pub0_cmsg  pub0_cmsg;
 
 static void pub0_pipe_recv_cb(void *);
 static void pub0_pipe_send_cb(void *);
@@ -36,6 +58,39 @@ static void pub0_pipe_getq_cb(void *);
 static void pub0_sock_getq_cb(void *);
 static void pub0_sock_fini(void *);
 static void pub0_pipe_fini(void *);
+static void pub0_pipe_kick(pub0_pipe *);
+
+// Most messages taken from the write queue in one go.
+#ifndef NNI_PUB0_BATCH
+#define NNI_PUB0_BATCH 16
+#endif
+
+// Most distinct keys we will hold pending for a single pipe when
+// conflating, or in the last-value cache.  Messages with new keys beyond
+// this are dropped (from the cache, they are still published).
+#ifndef NNI_PUB0_CONFLATE_MAX
+#define NNI_PUB0_CONFLATE_MAX 4096
+#endif
+
+// pub0_cmsg is a message in a conflation queue.
+struct pub0_cmsg {
+	nni_list_node node;
+	uint64_t      hash; // hash of the key, where probing starts
+	uint64_t      id;   // where it is in cq_index
+	nni_msg *     msg;
+};
+
+// pub0_cq is a conflation queue; messages are kept in arrival order of
+// their key, and indexed by a hash of the key.  Keys with the same hash
+// are found by linear probing, at the next free id.  Like a message
+// queue, it may be limited by the bytes it holds (header and body).
+struct pub0_cq {
+	nni_list    cq_msgs;
+	nni_idhash *cq_index;
+	size_t      cq_count;
+	size_t      cq_bytes;
+	size_t      cq_maxbytes; // zero for no limit
+};
 
 // pub0_sock is our per-socket protocol private structure.
 struct pub0_sock {
@@ -44,6 +99,18 @@ struct pub0_sock {
 	nni_aio * aio_getq;
 	nni_list  pipes;
 	nni_mtx   mtx;
+	size_t    keylen; // conflation key length, 0 if not conflating
+	int       lvc;    // keep a last-value cache
+	pub0_cq   cache;  // the last-value cache
+};
+
+// pub0_topic is a topic subscribed to by the peer.  The data lives in
+// the subscription message the peer sent us, which we hold on to.  Each
+// pipe keeps its topics sorted (see pub0_topic_cmp), so that a match can
+// be found with a binary search.
+struct pub0_topic {
+	size_t         len;
+	const uint8_t *buf;
 };
 
 // pub0_pipe is our per-pipe protocol private structure.
@@ -55,8 +122,165 @@ struct pub0_pipe {
 	nni_aio *     aio_send;
 	nni_aio *     aio_recv;
 	nni_list_node node;
+	int           filter;  // peer told us its subscriptions
+	int           match;   // scratch, used while distributing
+	nni_msg *     submsg;  // backing store for topics
+	pub0_topic *  topics;  // peer subscriptions, sorted
+	size_t        ntopics; // number of topics
+	int           conflate; // using cq instead of sendq
+	int           busy;     // aio_send in use (conflating only)
+	pub0_cq       cq;
 };
 
+static size_t
+pub0_msg_size(nni_msg *msg)
+{
+	return (nni_msg_len(msg) + nni_msg_header_len(msg));
+}
+
+// pub0_cq_room returns true if a message of the given size can be added,
+// once the given number of bytes are taken out.  As for message queues,
+// a queue that would otherwise be empty always has room.
+static bool
+pub0_cq_room(pub0_cq *cq, size_t add, size_t remove, size_t count)
+{
+	if ((cq->cq_maxbytes == 0) || (count == 0)) {
+		return (true);
+	}
+	return (cq->cq_bytes - remove + add <= cq->cq_maxbytes);
+}
+
+static int
+pub0_cq_init(pub0_cq *cq)
+{
+	NNI_LIST_INIT(&cq->cq_msgs, pub0_cmsg, node);
+	cq->cq_count    = 0;
+	cq->cq_bytes    = 0;
+	cq->cq_maxbytes = 0;
+	return (nni_idhash_init(&cq->cq_index));
+}
+
+// pub0_cq_unindex removes the message from the index.  Any entries
+// probed past it are shifted back, so that lookups, which stop at the
+// first free id, still find them.
+static void
+pub0_cq_unindex(pub0_cq *cq, pub0_cmsg *cm)
+{
+	uint64_t hole = cm->id;
+	void *   ptr;
+
+	for (uint64_t id = hole + 1;
+	     nni_idhash_find(cq->cq_index, id, &ptr) == 0; id++) {
+		pub0_cmsg *next = ptr;
+		if (next->hash <= hole) {
+			// Replacing an existing entry does not allocate.
+			(void) nni_idhash_insert(cq->cq_index, hole, next);
+			next->id = hole;
+			hole     = id;
+		}
+	}
+	nni_idhash_remove(cq->cq_index, hole);
+}
+
+static nni_msg *
+pub0_cq_get(pub0_cq *cq)
+{
+	pub0_cmsg *cm;
+	nni_msg *  msg;
+
+	if ((cm = nni_list_first(&cq->cq_msgs)) == NULL) {
+		return (NULL);
+	}
+	nni_list_remove(&cq->cq_msgs, cm);
+	pub0_cq_unindex(cq, cm);
+	cq->cq_count--;
+	msg = cm->msg;
+	cq->cq_bytes -= pub0_msg_size(msg);
+	NNI_FREE_STRUCT(cm);
+	return (msg);
+}
+
+static void
+pub0_cq_fini(pub0_cq *cq)
+{
+	nni_msg *msg;
+
+	if (cq->cq_index == NULL) {
+		return;
+	}
+	while ((msg = pub0_cq_get(cq)) != NULL) {
+		nni_msg_free(msg);
+	}
+	nni_idhash_fini(cq->cq_index);
+	cq->cq_index = NULL;
+}
+
+static size_t
+pub0_key_len(nni_msg *msg, size_t keylen)
+{
+	return (nni_msg_len(msg) < keylen ? nni_msg_len(msg) : keylen);
+}
+
+// pub0_cq_put queues the message, replacing any queued message with
+// the same key.  If max is not zero, it limits the number of different
+// keys we will hold.  A message that does not fit the byte limit is
+// refused, even if it would replace another, as for a full queue.  On
+// failure the caller still owns the message.
+static int
+pub0_cq_put(pub0_cq *cq, nni_msg *msg, size_t keylen, size_t max)
+{
+	pub0_cmsg *cm;
+	void *     ptr;
+	uint8_t *  key = nni_msg_body(msg);
+	size_t     len = pub0_key_len(msg, keylen);
+	size_t     sz  = pub0_msg_size(msg);
+	uint64_t   hash;
+	uint64_t   id;
+	int        rv;
+
+	// FNV-1a, folded to 63 bits and offset by one: the index treats
+	// zero specially, and probing never has to wrap around.
+	hash = 14695981039346656037ull;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= key[i];
+		hash *= 1099511628211ull;
+	}
+	hash = (hash >> 1) + 1;
+
+	for (id = hash; nni_idhash_find(cq->cq_index, id, &ptr) == 0; id++) {
+		cm = ptr;
+		if ((pub0_key_len(cm->msg, keylen) == len) &&
+		    (memcmp(nni_msg_body(cm->msg), key, len) == 0)) {
+			size_t old = pub0_msg_size(cm->msg);
+			if (!pub0_cq_room(cq, sz, old, cq->cq_count - 1)) {
+				return (NNG_EAGAIN);
+			}
+			nni_msg_free(cm->msg);
+			cm->msg      = msg;
+			cq->cq_bytes = cq->cq_bytes - old + sz;
+			return (0);
+		}
+	}
+	if (((max != 0) && (cq->cq_count >= max)) ||
+	    (!pub0_cq_room(cq, sz, 0, cq->cq_count))) {
+		return (NNG_EAGAIN);
+	}
+	if ((cm = NNI_ALLOC_STRUCT(cm)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	if ((rv = nni_idhash_insert(cq->cq_index, id, cm)) != 0) {
+		NNI_FREE_STRUCT(cm);
+		return (rv);
+	}
+	cm->msg  = msg;
+	cm->hash = hash;
+	cm->id   = id;
+	nni_list_append(&cq->cq_msgs, cm);
+	cq->cq_count++;
+	cq->cq_bytes += sz;
+	return (0);
+}
+
 static void
 pub0_sock_fini(void *arg)
 {
@@ -64,6 +288,7 @@ pub0_sock_fini(void *arg)
 
 	nni_aio_stop(s->aio_getq);
 	nni_aio_fini(s->aio_getq);
+	pub0_cq_fini(&s->cache);
 	nni_mtx_fini(&s->mtx);
 	NNI_FREE_STRUCT(s);
 }
@@ -78,12 +303,15 @@ pub0_sock_init(void **sp, nni_sock *sock)
 		return (NNG_ENOMEM);
 	}
 	nni_mtx_init(&s->mtx);
-	if ((rv = nni_aio_init(&s->aio_getq, pub0_sock_getq_cb, s)) != 0) {
+	if (((rv = nni_aio_init(&s->aio_getq, pub0_sock_getq_cb, s)) != 0) ||
+	    ((rv = pub0_cq_init(&s->cache)) != 0)) {
 		pub0_sock_fini(s);
 		return (rv);
 	}
 
-	s->raw = 0;
+	s->raw    = 0;
+	s->keylen = 0;
+	s->lvc    = 0;
 	NNI_LIST_INIT(&s->pipes, pub0_pipe, node);
 
 	s->uwq = nni_sock_sendq(sock);
@@ -116,6 +344,13 @@ pub0_pipe_fini(void *arg)
 	nni_aio_fini(p->aio_send);
 	nni_aio_fini(p->aio_recv);
 	nni_msgq_fini(p->sendq);
+	pub0_cq_fini(&p->cq);
+	if (p->topics != NULL) {
+		NNI_FREE_STRUCTS(p->topics, p->ntopics);
+	}
+	if (p->submsg != NULL) {
+		nni_msg_free(p->submsg);
+	}
 	NNI_FREE_STRUCT(p);
 }
 
@@ -133,7 +368,8 @@ pub0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 	if (((rv = nni_msgq_init(&p->sendq, 16)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_getq, pub0_pipe_getq_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_send, pub0_pipe_send_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_recv, pub0_pipe_recv_cb, p)) != 0)) {
+	    ((rv = nni_aio_init(&p->aio_recv, pub0_pipe_recv_cb, p)) != 0) ||
+	    ((rv = pub0_cq_init(&p->cq)) != 0)) {
 
 		pub0_pipe_fini(p);
 		return (rv);
@@ -141,7 +377,11 @@ pub0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 
 	p->pipe = pipe;
 	p->pub  = s;
-	*pp     = p;
+	nni_msgq_set_sock(p->sendq, nni_pipe_sock(pipe));
+	nni_msgq_set_maxbytes(
+	    p->sendq, nni_sock_pipebufsz(nni_pipe_sock(pipe)));
+	p->cq.cq_maxbytes = nni_sock_pipebufsz(nni_pipe_sock(pipe));
+	*pp               = p;
 	return (0);
 }
 
@@ -156,11 +396,30 @@ pub0_pipe_start(void *arg)
 	}
 	nni_mtx_lock(&s->mtx);
 	nni_list_append(&s->pipes, p);
+	if ((p->conflate = (s->keylen != 0)) != 0) {
+		pub0_cmsg *cm;
+
+		// Prime the new subscriber with the latest state.
+		NNI_LIST_FOREACH (&s->cache.cq_msgs, cm) {
+			nni_msg *dup;
+			if (nni_msg_expired(cm->msg) ||
+			    (nni_msg_dup(&dup, cm->msg) != 0)) {
+				continue;
+			}
+			if (pub0_cq_put(&p->cq, dup, s->keylen,
+			        NNI_PUB0_CONFLATE_MAX) != 0) {
+				nni_msg_free(dup);
+			}
+		}
+		pub0_pipe_kick(p);
+	}
 	nni_mtx_unlock(&s->mtx);
 
 	// Start the receiver and the queue reader.
 	nni_pipe_recv(p->pipe, p->aio_recv);
-	nni_msgq_aio_get(p->sendq, p->aio_getq);
+	if (!p->conflate) {
+		nni_msgq_aio_get(p->sendq, p->aio_getq);
+	}
 
 	return (0);
 }
@@ -171,40 +430,144 @@ pub0_pipe_stop(void *arg)
 	pub0_pipe *p = arg;
 	pub0_sock *s = p->pub;
 
+	// Take the pipe off the list first, so that we cannot start a
+	// new conflated send on it once we have stopped it.
+	nni_mtx_lock(&s->mtx);
+	if (nni_list_active(&s->pipes, p)) {
+		nni_list_remove(&s->pipes, p);
+	}
+	nni_mtx_unlock(&s->mtx);
+
 	nni_aio_stop(p->aio_getq);
 	nni_aio_stop(p->aio_send);
 	nni_aio_stop(p->aio_recv);
 
 	nni_msgq_close(p->sendq);
+}
 
-	nni_mtx_lock(&s->mtx);
-	if (nni_list_active(&s->pipes, p)) {
-		nni_list_remove(&s->pipes, p);
+// pub0_pipe_kick starts sending the next conflated message, if the
+// pipe is not already busy.  The socket lock must be held.
+static void
+pub0_pipe_kick(pub0_pipe *p)
+{
+	nni_msg *msg;
+
+	if (p->busy || (!nni_list_active(&p->pub->pipes, p))) {
+		return;
+	}
+	while ((msg = pub0_cq_get(&p->cq)) != NULL) {
+		if (!nni_msg_expired(msg)) {
+			p->busy = 1;
+			nni_aio_set_msg(p->aio_send, msg);
+			nni_pipe_send(p->pipe, p->aio_send);
+			return;
+		}
+		nni_msg_free(msg);
+		nni_sock_add_expired(nni_pipe_sock(p->pipe), 1);
 	}
-	nni_mtx_unlock(&s->mtx);
 }
 
-static void
-pub0_sock_getq_cb(void *arg)
+// pub0_topic_cmp orders topics bytewise, with a topic before any longer
+// ones that it is a prefix of.
+static int
+pub0_topic_cmp(const uint8_t *b1, size_t l1, const uint8_t *b2, size_t l2)
 {
-	pub0_sock *s   = arg;
-	nni_msgq * uwq = s->uwq;
-	nni_msg *  msg, *dup;
+	int rv;
+
+	if ((rv = memcmp(b1, b2, l1 < l2 ? l1 : l2)) != 0) {
+		return (rv);
+	}
+	return ((l1 > l2) - (l1 < l2));
+}
+
+static int
+pub0_topic_sort(const void *a, const void *b)
+{
+	const pub0_topic *t1 = a;
+	const pub0_topic *t2 = b;
+
+	return (pub0_topic_cmp(t1->buf, t1->len, t2->buf, t2->len));
+}
+
+// pub0_pipe_match returns true if the peer wants this message, that is if
+// one of its topics is a prefix of the body.  Such a topic sorts at or
+// before the body, as does every topic between it and the body, and
+// those all begin with it.  So we find the last topic that sorts at or
+// before the body.  If that is not a prefix, a topic that is must be no
+// longer than the bytes it has in common with the body, so we search
+// again for just those.  Each search is shorter, and there are usually
+// only one or two.
+static int
+pub0_pipe_match(pub0_pipe *p, const uint8_t *body, size_t len)
+{
+	if (!p->filter) {
+		return (1);
+	}
+	for (;;) {
+		pub0_topic *t;
+		size_t      lo = 0;
+		size_t      hi = p->ntopics;
+		size_t      n;
+
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+
+			t = &p->topics[mid];
+			if (pub0_topic_cmp(t->buf, t->len, body, len) <= 0) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		if (lo == 0) {
+			return (0);
+		}
+		t = &p->topics[lo - 1];
+		for (n = 0; (n < t->len) && (n < len); n++) {
+			if (t->buf[n] != body[n]) {
+				break;
+			}
+		}
+		if (n == t->len) {
+			return (1);
+		}
+		len = n;
+	}
+}
 
+// pub0_sock_publish gives the message to every pipe that wants it.  The
+// socket lock must be held.
+static void
+pub0_sock_publish(pub0_sock *s, nni_msg *msg)
+{
+	nni_msg *  dup;
 	pub0_pipe *p;
 	pub0_pipe *last;
+	uint8_t *  body = nni_msg_body(msg);
+	size_t     len  = nni_msg_len(msg);
 	int        rv;
 
-	if (nni_aio_result(s->aio_getq) != 0) {
-		return;
+	if ((s->keylen != 0) && s->lvc && (nni_msg_dup(&dup, msg) == 0)) {
+		rv = pub0_cq_put(
+		    &s->cache, dup, s->keylen, NNI_PUB0_CONFLATE_MAX);
+		if (rv != 0) {
+			nni_msg_free(dup);
+		}
 	}
 
-	msg = nni_aio_get_msg(s->aio_getq);
-	nni_aio_set_msg(s->aio_getq, NULL);
-
-	nni_mtx_lock(&s->mtx);
-	last = nni_list_last(&s->pipes);
+	// Work out who wants this first, so that we only make as many
+	// copies as we need, and can hand the original to the last one.
+	last = NULL;
+	NNI_LIST_FOREACH (&s->pipes, p) {
+		p->match = pub0_pipe_match(p, body, len);
+		if (p->match) {
+			last = p;
+		}
+	}
 	NNI_LIST_FOREACH (&s->pipes, p) {
+		if (!p->match) {
+			continue;
+		}
 		if (p != last) {
 			rv = nni_msg_dup(&dup, msg);
 			if (rv != 0) {
@@ -213,17 +576,126 @@ pub0_sock_getq_cb(void *arg)
 		} else {
 			dup = msg;
 		}
-		if ((rv = nni_msgq_tryput(p->sendq, dup)) != 0) {
+		if (p->conflate) {
+			rv = pub0_cq_put(
+			    &p->cq, dup, s->keylen, NNI_PUB0_CONFLATE_MAX);
+			pub0_pipe_kick(p);
+		} else {
+			rv = nni_msgq_tryput(p->sendq, dup);
+		}
+		if (rv != 0) {
 			nni_msg_free(dup);
 		}
 	}
+	if (last == NULL) {
+		nni_msg_free(msg);
+	}
+}
+
+static void
+pub0_sock_getq_cb(void *arg)
+{
+	pub0_sock *s = arg;
+	nni_msg *  msgs[NNI_PUB0_BATCH];
+	size_t     n;
+
+	if (nni_aio_result(s->aio_getq) != 0) {
+		return;
+	}
+
+	// Whatever else is already queued is published along with this
+	// one, under one acquisition of the lock.
+	msgs[0] = nni_aio_get_msg(s->aio_getq);
+	nni_aio_set_msg(s->aio_getq, NULL);
+	n = 1 + nni_msgq_getv(s->uwq, msgs + 1, NNI_PUB0_BATCH - 1);
+
+	nni_mtx_lock(&s->mtx);
+	for (size_t i = 0; i < n; i++) {
+		pub0_sock_publish(s, msgs[i]);
+	}
 	nni_mtx_unlock(&s->mtx);
 
-	if (last == NULL) {
+	nni_msgq_aio_get(s->uwq, s->aio_getq);
+}
+
+// pub0_pipe_subscribe handles a subscription update from the peer.
+// Anything we cannot make sense of just turns filtering off for the
+// pipe, which is always safe, since the subscriber filters too.
+static void
+pub0_pipe_subscribe(pub0_pipe *p, nni_msg *msg)
+{
+	pub0_sock *    s      = p->pub;
+	pub0_topic *   topics = NULL;
+	size_t         ntopics;
+	pub0_topic *   oldtopics;
+	size_t         oldn;
+	nni_msg *      oldmsg;
+	int            filter = 0;
+	const uint8_t *body   = nni_msg_body(msg);
+	size_t         len    = nni_msg_len(msg);
+	size_t         off;
+
+	if ((len > 0) && (body[0] == pub0_fwd_set)) {
+		// First pass validates and counts, second fills in.
+		filter  = 1;
+		ntopics = 0;
+		for (off = 1; off < len; ntopics++) {
+			uint32_t tlen;
+			if ((len - off) < sizeof(tlen)) {
+				filter = 0;
+				break;
+			}
+			NNI_GET32(body + off, tlen);
+			off += sizeof(tlen);
+			if ((len - off) < tlen) {
+				filter = 0;
+				break;
+			}
+			off += tlen;
+		}
+		if (filter && (ntopics > 0) &&
+		    ((topics = NNI_ALLOC_STRUCTS(topics, ntopics)) == NULL)) {
+			filter = 0;
+		}
+		if (filter) {
+			off = 1;
+			for (size_t i = 0; i < ntopics; i++) {
+				uint32_t tlen;
+				NNI_GET32(body + off, tlen);
+				off += sizeof(tlen);
+				topics[i].len = tlen;
+				topics[i].buf = body + off;
+				off += tlen;
+			}
+			if (ntopics > 1) {
+				qsort(topics, ntopics, sizeof(pub0_topic),
+				    pub0_topic_sort);
+			}
+		}
+	}
+	if (!filter) {
+		// Includes pub0_fwd_off.
 		nni_msg_free(msg);
+		msg     = NULL;
+		ntopics = 0;
 	}
 
-	nni_msgq_aio_get(uwq, s->aio_getq);
+	nni_mtx_lock(&s->mtx);
+	oldmsg     = p->submsg;
+	oldtopics  = p->topics;
+	oldn       = p->ntopics;
+	p->submsg  = msg;
+	p->topics  = topics;
+	p->ntopics = ntopics;
+	p->filter  = filter;
+	nni_mtx_unlock(&s->mtx);
+
+	if (oldtopics != NULL) {
+		NNI_FREE_STRUCTS(oldtopics, oldn);
+	}
+	if (oldmsg != NULL) {
+		nni_msg_free(oldmsg);
+	}
 }
 
 static void
@@ -236,7 +708,7 @@ pub0_pipe_recv_cb(void *arg)
 		return;
 	}
 
-	nni_msg_free(nni_aio_get_msg(p->aio_recv));
+	pub0_pipe_subscribe(p, nni_aio_get_msg(p->aio_recv));
 	nni_aio_set_msg(p->aio_recv, NULL);
 	nni_pipe_recv(p->pipe, p->aio_recv);
 }
@@ -270,6 +742,14 @@ pub0_pipe_send_cb(void *arg)
 	}
 
 	nni_aio_set_msg(p->aio_send, NULL);
+	if (p->conflate) {
+		pub0_sock *s = p->pub;
+		nni_mtx_lock(&s->mtx);
+		p->busy = 0;
+		pub0_pipe_kick(p);
+		nni_mtx_unlock(&s->mtx);
+		return;
+	}
 	nni_msgq_aio_get(p->sendq, p->aio_getq);
 }
 
@@ -287,6 +767,79 @@ pub0_sock_getopt_raw(void *arg, void *buf, size_t *szp)
 	return (nni_getopt_int(s->raw, buf, szp));
 }
 
+static int
+pub0_sock_setopt_conflate(void *arg, const void *buf, size_t sz)
+{
+	pub0_sock *s = arg;
+	size_t     keylen;
+	int        rv;
+
+	if ((rv = nni_setopt_size(&keylen, buf, sz, 0, 65536)) != 0) {
+		return (rv);
+	}
+	nni_mtx_lock(&s->mtx);
+	if (!nni_list_empty(&s->pipes)) {
+		// Pipes choose their queueing discipline when they start.
+		nni_mtx_unlock(&s->mtx);
+		return (NNG_EBUSY);
+	}
+	if (s->keylen != keylen) {
+		nni_msg *msg;
+		// Keys mean something else now.
+		while ((msg = pub0_cq_get(&s->cache)) != NULL) {
+			nni_msg_free(msg);
+		}
+		s->keylen = keylen;
+	}
+	nni_mtx_unlock(&s->mtx);
+	return (0);
+}
+
+static int
+pub0_sock_getopt_conflate(void *arg, void *buf, size_t *szp)
+{
+	pub0_sock *s = arg;
+	size_t     keylen;
+
+	nni_mtx_lock(&s->mtx);
+	keylen = s->keylen;
+	nni_mtx_unlock(&s->mtx);
+	return (nni_getopt_size(keylen, buf, szp));
+}
+
+static int
+pub0_sock_setopt_lvc(void *arg, const void *buf, size_t sz)
+{
+	pub0_sock *s = arg;
+	int        lvc;
+	int        rv;
+
+	if ((rv = nni_setopt_int(&lvc, buf, sz, 0, 1)) != 0) {
+		return (rv);
+	}
+	nni_mtx_lock(&s->mtx);
+	if ((s->lvc = lvc) == 0) {
+		nni_msg *msg;
+		while ((msg = pub0_cq_get(&s->cache)) != NULL) {
+			nni_msg_free(msg);
+		}
+	}
+	nni_mtx_unlock(&s->mtx);
+	return (0);
+}
+
+static int
+pub0_sock_getopt_lvc(void *arg, void *buf, size_t *szp)
+{
+	pub0_sock *s = arg;
+	int        lvc;
+
+	nni_mtx_lock(&s->mtx);
+	lvc = s->lvc;
+	nni_mtx_unlock(&s->mtx);
+	return (nni_getopt_int(lvc, buf, szp));
+}
+
 static void
 pub0_sock_recv(void *arg, nni_aio *aio)
 {
@@ -302,6 +855,14 @@ pub0_sock_send(void *arg, nni_aio *aio)
 	nni_msgq_aio_put(s->uwq, aio);
 }
 
+static size_t
+pub0_sock_sendv(void *arg, nni_msg **msgv, size_t n)
+{
+	pub0_sock *s = arg;
+
+	return (nni_msgq_putv(s->uwq, msgv, n));
+}
+
 static nni_proto_pipe_ops pub0_pipe_ops = {
 	.pipe_init  = pub0_pipe_init,
 	.pipe_fini  = pub0_pipe_fini,
@@ -315,6 +876,16 @@ static nni_proto_sock_option pub0_sock_options[] = {
 	    .pso_getopt = pub0_sock_getopt_raw,
 	    .pso_setopt = pub0_sock_setopt_raw,
 	},
+	{
+	    .pso_name   = NNG_OPT_PUB_CONFLATE,
+	    .pso_getopt = pub0_sock_getopt_conflate,
+	    .pso_setopt = pub0_sock_setopt_conflate,
+	},
+	{
+	    .pso_name   = NNG_OPT_PUB_LVC,
+	    .pso_getopt = pub0_sock_getopt_lvc,
+	    .pso_setopt = pub0_sock_setopt_lvc,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
@@ -326,6 +897,7 @@ static nni_proto_sock_ops pub0_sock_ops = {
 	.sock_close   = pub0_sock_close,
 	.sock_send    = pub0_sock_send,
 	.sock_recv    = pub0_sock_recv,
+	.sock_sendv   = pub0_sock_sendv,
 	.sock_options = pub0_sock_options,
 };
 
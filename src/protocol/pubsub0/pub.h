@@ -21,6 +21,9 @@ NNG_DECL int nng_pub0_open(nng_socket *);
 #define nng_pub_open nng_pub0_open
 #endif
 
+#define NNG_OPT_PUB_CONFLATE "pub:conflate"
+#define NNG_OPT_PUB_LVC "pub:last-value-cache"
+
 #ifdef __cplusplus
 }
 #endif
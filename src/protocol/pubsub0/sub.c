@@ -17,6 +17,21 @@
 // Subscriber protocol.  The SUB protocol receives messages sent to
 // it from publishers, and filters out those it is not interested in,
 // only passing up ones that match known subscriptions.
+//
+// Optionally (NNG_OPT_SUB_FORWARD) the subscriber also sends its set of
+// subscriptions to each connected publisher, so that the publisher can
+// avoid sending messages that would just be discarded here.  This is
+// done by sending the publisher a complete snapshot of the topics
+// whenever they change.  We only ever have a single snapshot in flight
+// per pipe; changes made while one is being sent are coalesced into
+// the next.  Publishers that do not understand this just discard what
+// we send, and we still filter locally, so nothing is lost either way.
+
+// These must match the values used in pub.c.
+enum sub0_fwd_ops {
+	sub0_fwd_off = 0, // publisher should send everything
+	sub0_fwd_set = 1, // followed by topics, each a 32-bit length + data
+};
 
 #ifndef NNI_PROTO_SUB_V0
 #define NNI_PROTO_SUB_V0 NNI_PROTO(2, 1)
@@ -32,6 +47,7 @@ typedef struct sub0_topic sub0_topic;
 
 static void sub0_recv_cb(void *);
 static void sub0_putq_cb(void *);
+static void sub0_send_cb(void *);
 static void sub0_pipe_fini(void *);
 
 struct sub0_topic {
@@ -43,17 +59,23 @@ struct sub0_topic {
 // sub0_sock is our per-socket protocol private structure.
 struct sub0_sock {
 	nni_list  topics;
+	nni_list  pipes;
 	nni_msgq *urq;
 	int       raw;
+	int       fwd;
 	nni_mtx   lk;
 };
 
 // sub0_pipe is our per-pipe protocol private structure.
 struct sub0_pipe {
-	nni_pipe * pipe;
-	sub0_sock *sub;
-	nni_aio *  aio_recv;
-	nni_aio *  aio_putq;
+	nni_pipe *    pipe;
+	sub0_sock *   sub;
+	nni_aio *     aio_recv;
+	nni_aio *     aio_putq;
+	nni_aio *     aio_send;
+	nni_list_node node;
+	int           sending; // snapshot in flight
+	int           dirty;   // topics changed while sending
 };
 
 static int
@@ -66,7 +88,9 @@ sub0_sock_init(void **sp, nni_sock *sock)
 	}
 	nni_mtx_init(&s->lk);
 	NNI_LIST_INIT(&s->topics, sub0_topic, node);
+	NNI_LIST_INIT(&s->pipes, sub0_pipe, node);
 	s->raw = 0;
+	s->fwd = 0;
 
 	s->urq = nni_sock_recvq(sock);
 	*sp    = s;
@@ -107,6 +131,7 @@ sub0_pipe_fini(void *arg)
 
 	nni_aio_fini(p->aio_putq);
 	nni_aio_fini(p->aio_recv);
+	nni_aio_fini(p->aio_send);
 	NNI_FREE_STRUCT(p);
 }
 
@@ -120,7 +145,8 @@ sub0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 		return (NNG_ENOMEM);
 	}
 	if (((rv = nni_aio_init(&p->aio_putq, sub0_putq_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_recv, sub0_recv_cb, p)) != 0)) {
+	    ((rv = nni_aio_init(&p->aio_recv, sub0_recv_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->aio_send, sub0_send_cb, p)) != 0)) {
 		sub0_pipe_fini(p);
 		return (rv);
 	}
@@ -131,10 +157,72 @@ sub0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 	return (0);
 }
 
+// sub0_pipe_fwd sends the publisher on this pipe our current set of
+// subscriptions, or tells it to stop filtering if forwarding is off.
+// The socket lock must be held.
+static void
+sub0_pipe_fwd(sub0_pipe *p)
+{
+	sub0_sock * s = p->sub;
+	sub0_topic *topic;
+	nni_msg *   msg;
+	uint8_t     op;
+
+	if (p->sending) {
+		p->dirty = 1;
+		return;
+	}
+	p->dirty = 0;
+	op       = s->fwd ? sub0_fwd_set : sub0_fwd_off;
+	if (nni_msg_alloc(&msg, 0) != 0) {
+		return;
+	}
+	if (nni_msg_append(msg, &op, 1) != 0) {
+		goto fail;
+	}
+	if (s->fwd) {
+		NNI_LIST_FOREACH (&s->topics, topic) {
+			uint32_t len = (uint32_t) topic->len;
+			if ((nni_msg_append_u32(msg, len) != 0) ||
+			    (nni_msg_append(msg, topic->buf, len) != 0)) {
+				goto fail;
+			}
+		}
+	}
+	p->sending = 1;
+	nni_aio_set_msg(p->aio_send, msg);
+	nni_pipe_send(p->pipe, p->aio_send);
+	return;
+
+fail:
+	// If we cannot tell the publisher, it will just keep sending
+	// according to whatever it knew before.  We try again on the
+	// next change.
+	nni_msg_free(msg);
+}
+
+static void
+sub0_sock_fwd(sub0_sock *s)
+{
+	sub0_pipe *p;
+
+	NNI_LIST_FOREACH (&s->pipes, p) {
+		sub0_pipe_fwd(p);
+	}
+}
+
 static int
 sub0_pipe_start(void *arg)
 {
 	sub0_pipe *p = arg;
+	sub0_sock *s = p->sub;
+
+	nni_mtx_lock(&s->lk);
+	nni_list_append(&s->pipes, p);
+	if (s->fwd) {
+		sub0_pipe_fwd(p);
+	}
+	nni_mtx_unlock(&s->lk);
 
 	nni_pipe_recv(p->pipe, p->aio_recv);
 	return (0);
@@ -144,9 +232,41 @@ static void
 sub0_pipe_stop(void *arg)
 {
 	sub0_pipe *p = arg;
+	sub0_sock *s = p->sub;
+
+	// Take the pipe off the list first, so that subscription changes
+	// cannot start a new send on it once we have stopped it.
+	nni_mtx_lock(&s->lk);
+	if (nni_list_active(&s->pipes, p)) {
+		nni_list_remove(&s->pipes, p);
+	}
+	nni_mtx_unlock(&s->lk);
 
 	nni_aio_stop(p->aio_putq);
 	nni_aio_stop(p->aio_recv);
+	nni_aio_stop(p->aio_send);
+}
+
+static void
+sub0_send_cb(void *arg)
+{
+	sub0_pipe *p = arg;
+	sub0_sock *s = p->sub;
+
+	if (nni_aio_result(p->aio_send) != 0) {
+		nni_msg_free(nni_aio_get_msg(p->aio_send));
+		nni_aio_set_msg(p->aio_send, NULL);
+		nni_pipe_stop(p->pipe);
+		return;
+	}
+	nni_aio_set_msg(p->aio_send, NULL);
+
+	nni_mtx_lock(&s->lk);
+	p->sending = 0;
+	if (p->dirty && nni_list_active(&s->pipes, p)) {
+		sub0_pipe_fwd(p);
+	}
+	nni_mtx_unlock(&s->lk);
 }
 
 static void
@@ -235,6 +355,9 @@ sub0_subscribe(void *arg, const void *buf, size_t sz)
 	} else {
 		nni_list_append(&s->topics, newtopic);
 	}
+	if (s->fwd) {
+		sub0_sock_fwd(s);
+	}
 	nni_mtx_unlock(&s->lk);
 	return (0);
 }
@@ -256,6 +379,9 @@ sub0_unsubscribe(void *arg, const void *buf, size_t sz)
 		if (rv == 0) {
 			if (topic->len == sz) {
 				nni_list_remove(&s->topics, topic);
+				if (s->fwd) {
+					sub0_sock_fwd(s);
+				}
 				nni_mtx_unlock(&s->lk);
 				nni_free(topic->buf, topic->len);
 				NNI_FREE_STRUCT(topic);
@@ -289,6 +415,37 @@ sub0_sock_getopt_raw(void *arg, void *buf, size_t *szp)
 	return (nni_getopt_int(s->raw, buf, szp));
 }
 
+static int
+sub0_sock_setopt_fwd(void *arg, const void *buf, size_t sz)
+{
+	sub0_sock *s = arg;
+	int        fwd;
+	int        rv;
+
+	if ((rv = nni_setopt_int(&fwd, buf, sz, 0, 1)) != 0) {
+		return (rv);
+	}
+	nni_mtx_lock(&s->lk);
+	if (s->fwd != fwd) {
+		s->fwd = fwd;
+		sub0_sock_fwd(s);
+	}
+	nni_mtx_unlock(&s->lk);
+	return (0);
+}
+
+static int
+sub0_sock_getopt_fwd(void *arg, void *buf, size_t *szp)
+{
+	sub0_sock *s = arg;
+	int        fwd;
+
+	nni_mtx_lock(&s->lk);
+	fwd = s->fwd;
+	nni_mtx_unlock(&s->lk);
+	return (nni_getopt_int(fwd, buf, szp));
+}
+
 static void
 sub0_sock_send(void *arg, nni_aio *aio)
 {
@@ -304,6 +461,14 @@ sub0_sock_recv(void *arg, nni_aio *aio)
 	nni_msgq_aio_get(s->urq, aio);
 }
 
+static size_t
+sub0_sock_recvv(void *arg, nni_msg **msgv, size_t n)
+{
+	sub0_sock *s = arg;
+
+	return (nni_msgq_getv(s->urq, msgv, n));
+}
+
 static nni_msg *
 sub0_sock_filter(void *arg, nni_msg *msg)
 {
@@ -374,6 +539,11 @@ static nni_proto_sock_option sub0_sock_options[] = {
 	    .pso_getopt = NULL,
 	    .pso_setopt = sub0_unsubscribe,
 	},
+	{
+	    .pso_name   = NNG_OPT_SUB_FORWARD,
+	    .pso_getopt = sub0_sock_getopt_fwd,
+	    .pso_setopt = sub0_sock_setopt_fwd,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
@@ -385,6 +555,7 @@ static nni_proto_sock_ops sub0_sock_ops = {
 	.sock_close   = sub0_sock_close,
 	.sock_send    = sub0_sock_send,
 	.sock_recv    = sub0_sock_recv,
+	.sock_recvv   = sub0_sock_recvv,
 	.sock_filter  = sub0_sock_filter,
 	.sock_options = sub0_sock_options,
 };
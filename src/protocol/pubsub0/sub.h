@@ -23,6 +23,7 @@ NNG_DECL int nng_sub0_open(nng_socket *);
 
 #define NNG_OPT_SUB_SUBSCRIBE "sub:subscribe"
 #define NNG_OPT_SUB_UNSUBSCRIBE "sub:unsubscribe"
+#define NNG_OPT_SUB_FORWARD "sub:forward"
 
 #ifdef __cplusplus
 }
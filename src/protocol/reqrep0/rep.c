@@ -152,7 +152,10 @@ rep0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 
 	p->pipe = pipe;
 	p->rep  = s;
-	*pp     = p;
+	nni_msgq_set_sock(p->sendq, nni_pipe_sock(pipe));
+	nni_msgq_set_maxbytes(
+	    p->sendq, nni_sock_pipebufsz(nni_pipe_sock(pipe)));
+	*pp = p;
 	return (0);
 }
 
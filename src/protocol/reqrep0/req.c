@@ -30,9 +30,26 @@ typedef struct req0_pipe req0_pipe;
 typedef struct req0_sock req0_sock;
 
 static void req0_resend(req0_sock *);
+static nni_duration req0_hedge_delay(req0_sock *);
 static void req0_timeout(void *);
 static void req0_pipe_fini(void *);
 
+// Hedging.  If a request has not been answered by the time most requests
+// are, a copy is sent to another pipe, and whichever reply comes first is
+// taken.  "Most" is a percentile of the reply latencies seen recently,
+// which we keep in a histogram with four buckets per power of two
+// milliseconds.  Counts are halved now and then, so that it follows
+// changes in the service.
+#define NNI_REQ0_HEDGE_MAX 8 // most copies of a request we will hedge
+#define NNI_REQ0_HIST_BUCKETS 128
+#define NNI_REQ0_HIST_MIN 16   // samples needed before we trust it
+#define NNI_REQ0_HIST_MAX 1024 // halve the counts when we reach this
+
+typedef struct {
+	uint32_t counts[NNI_REQ0_HIST_BUCKETS];
+	uint32_t total;
+} req0_hist;
+
 // A req0_sock is our per-socket protocol private structure.
 struct req0_sock {
 	nni_msgq *   uwq;
@@ -44,8 +61,16 @@ struct req0_sock {
 	int          closed;
 	int          ttl;
 	nni_msg *    reqmsg;
+	nni_lb       lb; // cooked mode only
+	int          hedge;     // most hedged copies of a request
+	int          hedgepct;  // percentile of latency to hedge at
+	nni_duration hedgetime; // hedge delay, until we have samples
+	int          nhedge;    // hedged copies of current request
+	nni_time     hedgeat;   // when to send the next one
+	req0_hist    hist;
 
-	req0_pipe *pendpipe;
+	req0_pipe *pendpipe; // pipe the request was last sent (not hedged) on
+	int        ncopies;  // pipes with a copy of the request
 
 	nni_list readypipes;
 	nni_list busypipes;
@@ -63,6 +88,9 @@ struct req0_pipe {
 	nni_pipe *    pipe;
 	req0_sock *   req;
 	nni_list_node node;
+	nni_lb_pipe   lb;
+	int           copy; // has the current request
+	nni_time      sent; // when it was sent here
 	nni_aio *     aio_getq;       // raw mode only
 	nni_aio *     aio_sendraw;    // raw mode only
 	nni_aio *     aio_sendcooked; // cooked mode only
@@ -90,6 +118,7 @@ req0_sock_init(void **sp, nni_sock *sock)
 
 	NNI_LIST_INIT(&s->readypipes, req0_pipe, node);
 	NNI_LIST_INIT(&s->busypipes, req0_pipe, node);
+	nni_lb_init(&s->lb);
 	nni_timer_init(&s->timer, req0_timeout, s);
 
 	// this is "semi random" start for request IDs.
@@ -100,9 +129,13 @@ req0_sock_init(void **sp, nni_sock *sock)
 	s->wantw  = 0;
 	s->resend = NNI_TIME_ZERO;
 	s->ttl    = 8;
-	s->uwq    = nni_sock_sendq(sock);
-	s->urq    = nni_sock_recvq(sock);
-	*sp       = s;
+
+	s->hedge     = 0;
+	s->hedgepct  = 95;
+	s->hedgetime = 10;
+	s->uwq       = nni_sock_sendq(sock);
+	s->urq       = nni_sock_recvq(sock);
+	*sp          = s;
 
 	return (0);
 }
@@ -179,6 +212,7 @@ req0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 	}
 
 	NNI_LIST_NODE_INIT(&p->node);
+	NNI_LIST_NODE_INIT(&p->lb.lp_node);
 	p->pipe = pipe;
 	p->req  = s;
 	*pp     = p;
@@ -201,6 +235,9 @@ req0_pipe_start(void *arg)
 		return (NNG_ECLOSED);
 	}
 	nni_list_append(&s->readypipes, p);
+	nni_lb_add(&s->lb, &p->lb, p, nni_pipe_id(p->pipe),
+	    nni_pipe_weight(p->pipe));
+	p->lb.lp_ready = 1;
 	// If sock was waiting for somewhere to send data, go ahead and
 	// send it to this pipe.
 	if (s->wantw) {
@@ -229,6 +266,7 @@ req0_pipe_stop(void *arg)
 	// Further, any completion tasks have completed.
 
 	nni_mtx_lock(&s->mtx);
+	nni_lb_remove(&s->lb, &p->lb);
 	// This removes the node from either busypipes or readypipes.
 	// It doesn't much matter which.
 	if (nni_list_node_active(&p->node)) {
@@ -238,13 +276,20 @@ req0_pipe_stop(void *arg)
 		}
 	}
 
-	if ((p == s->pendpipe) && (s->reqmsg != NULL)) {
-		// removing the pipe we sent the last request on...
-		// schedule immediate resend.
+	if (p == s->pendpipe) {
 		s->pendpipe = NULL;
-		s->resend   = NNI_TIME_ZERO;
-		s->wantw    = 1;
-		req0_resend(s);
+	}
+	if (p->copy) {
+		p->copy = 0;
+		p->lb.lp_pending--;
+		s->ncopies--;
+		if ((s->ncopies == 0) && (s->reqmsg != NULL)) {
+			// removing the last pipe with a copy of the
+			// request... schedule immediate resend.
+			s->resend = NNI_TIME_ZERO;
+			s->wantw  = 1;
+			req0_resend(s);
+		}
 	}
 	nni_mtx_unlock(&s->mtx);
 }
@@ -263,6 +308,123 @@ req0_sock_getopt_raw(void *arg, void *buf, size_t *szp)
 	return (nni_getopt_int(s->raw, buf, szp));
 }
 
+static int
+req0_sock_setopt_policy(void *arg, const void *buf, size_t sz)
+{
+	req0_sock *s = arg;
+	int        rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_lb_setopt_policy(&s->lb, buf, sz);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+req0_sock_getopt_policy(void *arg, void *buf, size_t *szp)
+{
+	req0_sock *s = arg;
+	int        rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_lb_getopt_policy(&s->lb, buf, szp);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+req0_sock_setopt_hashlen(void *arg, const void *buf, size_t sz)
+{
+	req0_sock *s = arg;
+	int        rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_lb_setopt_hashlen(&s->lb, buf, sz);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+req0_sock_getopt_hashlen(void *arg, void *buf, size_t *szp)
+{
+	req0_sock *s = arg;
+	int        rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_lb_getopt_hashlen(&s->lb, buf, szp);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+req0_sock_setopt_hedge(void *arg, const void *buf, size_t sz)
+{
+	req0_sock *s = arg;
+	int        rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_setopt_int(&s->hedge, buf, sz, 0, NNI_REQ0_HEDGE_MAX);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+req0_sock_getopt_hedge(void *arg, void *buf, size_t *szp)
+{
+	req0_sock *s = arg;
+	return (nni_getopt_int(s->hedge, buf, szp));
+}
+
+static int
+req0_sock_setopt_hedgepct(void *arg, const void *buf, size_t sz)
+{
+	req0_sock *s = arg;
+	int        rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_setopt_int(&s->hedgepct, buf, sz, 1, 100);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+req0_sock_getopt_hedgepct(void *arg, void *buf, size_t *szp)
+{
+	req0_sock *s = arg;
+	return (nni_getopt_int(s->hedgepct, buf, szp));
+}
+
+static int
+req0_sock_setopt_hedgetime(void *arg, const void *buf, size_t sz)
+{
+	req0_sock *s = arg;
+	int        rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_setopt_ms(&s->hedgetime, buf, sz);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+req0_sock_getopt_hedgetime(void *arg, void *buf, size_t *szp)
+{
+	req0_sock *s = arg;
+	return (nni_getopt_ms(s->hedgetime, buf, szp));
+}
+
+static int
+req0_sock_getopt_hedgedelay(void *arg, void *buf, size_t *szp)
+{
+	req0_sock *  s = arg;
+	nni_duration delay;
+
+	nni_mtx_lock(&s->mtx);
+	delay = req0_hedge_delay(s);
+	nni_mtx_unlock(&s->mtx);
+	return (nni_getopt_ms(delay, buf, szp));
+}
+
 static int
 req0_sock_setopt_maxttl(void *arg, const void *buf, size_t sz)
 {
@@ -370,6 +532,7 @@ req0_sendcooked_cb(void *arg)
 	if (nni_list_active(&s->busypipes, p)) {
 		nni_list_remove(&s->busypipes, p);
 		nni_list_append(&s->readypipes, p);
+		p->lb.lp_ready = 1;
 		req0_resend(s);
 	} else {
 		// We wind up here if stop was called from the reader
@@ -435,15 +598,185 @@ malformed:
 	nni_pipe_stop(p->pipe);
 }
 
+static unsigned
+req0_hist_bucket(nni_duration v)
+{
+	unsigned e;
+
+	if (v < 4) {
+		return (v < 0 ? 0 : (unsigned) v);
+	}
+	for (e = 2; (v >> (e + 1)) != 0; e++) {
+	}
+	return (4 * (e - 1) + (((unsigned) v >> (e - 2)) & 3));
+}
+
+// req0_hist_upper returns the largest value in bucket b.
+static nni_duration
+req0_hist_upper(unsigned b)
+{
+	unsigned e;
+
+	if (b < 4) {
+		return ((nni_duration) b);
+	}
+	e = b / 4 + 1;
+	return ((nni_duration)(((5 + b % 4) << (e - 2)) - 1));
+}
+
+static void
+req0_hist_add(req0_hist *h, nni_duration v)
+{
+	if (h->total >= NNI_REQ0_HIST_MAX) {
+		h->total = 0;
+		for (unsigned i = 0; i < NNI_REQ0_HIST_BUCKETS; i++) {
+			h->counts[i] /= 2;
+			h->total += h->counts[i];
+		}
+	}
+	h->counts[req0_hist_bucket(v)]++;
+	h->total++;
+}
+
+// req0_hedge_delay returns how long to wait for a reply before hedging.
+static nni_duration
+req0_hedge_delay(req0_sock *s)
+{
+	req0_hist *h = &s->hist;
+	uint32_t   want;
+	uint32_t   seen = 0;
+
+	if (h->total < NNI_REQ0_HIST_MIN) {
+		return (s->hedgetime);
+	}
+	want = (uint32_t)(((uint64_t) h->total * s->hedgepct + 99) / 100);
+	for (unsigned i = 0; i < NNI_REQ0_HIST_BUCKETS; i++) {
+		if ((seen += h->counts[i]) >= want) {
+			// Zero would hedge every request at once.
+			return (i == 0 ? 1 : req0_hist_upper(i));
+		}
+	}
+	return (s->hedgetime); // not reached
+}
+
+// req0_schedule arms the timer for the next resend or hedge.
+static void
+req0_schedule(req0_sock *s)
+{
+	nni_time when = s->resend;
+
+	if ((s->nhedge < s->hedge) && (s->hedgeat < when)) {
+		when = s->hedgeat;
+	}
+	nni_timer_schedule(&s->timer, when);
+}
+
+// req0_give sends a copy of the request on the pipe, which must be
+// ready.  Socket lock held.
+static void
+req0_give(req0_sock *s, req0_pipe *p, nni_msg *msg)
+{
+	nni_list_remove(&s->readypipes, p);
+	nni_list_append(&s->busypipes, p);
+	p->lb.lp_ready = 0;
+
+	// The load balancer sees each pipe with a copy of the request as
+	// having it pending, so resends and hedges go elsewhere if the
+	// policy allows it.
+	if (!p->copy) {
+		p->copy = 1;
+		p->lb.lp_pending++;
+		s->ncopies++;
+	}
+	// The send time is for latency samples, so it is precise; the
+	// hedge deadline is on the coarse clock, like the resend one.
+	p->sent    = nni_clock();
+	s->hedgeat = nni_clock_coarse() + req0_hedge_delay(s);
+	nni_aio_set_msg(p->aio_sendcooked, msg);
+
+	// Note that because we were ready rather than busy, we
+	// should not have any I/O oustanding and hence the aio
+	// object will be available for our use.
+	nni_pipe_send(p->pipe, p->aio_sendcooked);
+}
+
+// req0_clear forgets which pipes have the request; it has been answered
+// or abandoned.
+static void
+req0_clear(req0_sock *s)
+{
+	nni_list * lists[2] = { &s->readypipes, &s->busypipes };
+	req0_pipe *p;
+
+	for (int i = 0; i < 2; i++) {
+		NNI_LIST_FOREACH (lists[i], p) {
+			if (p->copy) {
+				p->copy = 0;
+				p->lb.lp_pending--;
+			}
+		}
+	}
+	s->pendpipe = NULL;
+	s->ncopies  = 0;
+	s->nhedge   = 0;
+}
+
+// req0_hedge sends another copy of the request, to a ready pipe that
+// does not have one yet.  Socket lock held.
+static void
+req0_hedge(req0_sock *s)
+{
+	req0_pipe *p;
+	req0_pipe *best;
+	nni_msg *  msg;
+
+	s->nhedge++;
+
+	// Hide the pipes that already have a copy from the load balancer.
+	NNI_LIST_FOREACH (&s->readypipes, p) {
+		if (p->copy) {
+			p->lb.lp_ready = 0;
+		}
+	}
+	best = nni_lb_choose(&s->lb, s->reqmsg);
+	NNI_LIST_FOREACH (&s->readypipes, p) {
+		p->lb.lp_ready = 1;
+	}
+	if ((best != NULL) && (nni_msg_dup(&msg, s->reqmsg) == 0)) {
+		req0_give(s, best, msg);
+	} else {
+		s->hedgeat = nni_clock_coarse() + req0_hedge_delay(s);
+	}
+	req0_schedule(s);
+}
+
 static void
 req0_timeout(void *arg)
 {
 	req0_sock *s = arg;
+	nni_time   now;
 
 	nni_mtx_lock(&s->mtx);
-	if (s->reqmsg != NULL) {
+	if (s->reqmsg == NULL) {
+		nni_mtx_unlock(&s->mtx);
+		return;
+	}
+	// The deadlines were set from the coarse clock, which never runs
+	// ahead of this one, so the timer firing means one of them passed.
+	now = nni_clock();
+	if (now >= s->resend) {
+		// The pipe we used did not answer in time.  Charge it
+		// the full retry time, so that latency aware policies
+		// steer away from it.
+		if (s->pendpipe != NULL) {
+			nni_lb_sample(&s->pendpipe->lb, s->retry);
+		}
 		s->wantw = 1;
 		req0_resend(s);
+	} else if ((s->nhedge < s->hedge) && (now >= s->hedgeat)) {
+		req0_hedge(s);
+	} else {
+		req0_schedule(s);
 	}
 	nni_mtx_unlock(&s->mtx);
 }
@@ -474,13 +807,14 @@ req0_resend(req0_sock *s)
 			// mark that we have a message we want to resend,
 			// in case something comes available.
 			s->wantw = 1;
-			nni_timer_schedule(&s->timer, nni_clock() + s->retry);
+			nni_timer_schedule(
+			    &s->timer, nni_clock_coarse() + s->retry);
 			return;
 		}
 
-		// Now we iterate across all possible outpipes, until
-		// one accepts it.
-		if ((p = nni_list_first(&s->readypipes)) == NULL) {
+		// Let the load balancing policy choose among the ready
+		// pipes.
+		if ((p = nni_lb_choose(&s->lb, s->reqmsg)) == NULL) {
 			// No pipes ready to process us.  Note that we have
 			// something to send, and schedule it.
 			nni_msg_free(msg);
@@ -488,18 +822,10 @@ req0_resend(req0_sock *s)
 			return;
 		}
 
-		nni_list_remove(&s->readypipes, p);
-		nni_list_append(&s->busypipes, p);
-
+		req0_give(s, p, msg);
 		s->pendpipe = p;
-		s->resend   = nni_clock() + s->retry;
-		nni_aio_set_msg(p->aio_sendcooked, msg);
-
-		// Note that because we were ready rather than busy, we
-		// should not have any I/O oustanding and hence the aio
-		// object will be available for our use.
-		nni_pipe_send(p->pipe, p->aio_sendcooked);
-		nni_timer_schedule(&s->timer, s->resend);
+		s->resend   = nni_clock_coarse() + s->retry;
+		req0_schedule(s);
 	}
 }
 
@@ -542,6 +868,7 @@ req0_sock_send(void *arg, nni_aio *aio)
 	if (s->reqmsg != NULL) {
 		nni_msg_free(s->reqmsg);
 		s->reqmsg = NULL;
+		req0_clear(s);
 	}
 
 	nni_aio_set_msg(aio, NULL);
@@ -559,10 +886,29 @@ req0_sock_send(void *arg, nni_aio *aio)
 	nni_aio_finish(aio, 0, len);
 }
 
+// req0_find_copy finds the pipe with the given id, if it has a copy of
+// the current request.
+static req0_pipe *
+req0_find_copy(req0_sock *s, uint32_t id)
+{
+	nni_list * lists[2] = { &s->readypipes, &s->busypipes };
+	req0_pipe *p;
+
+	for (int i = 0; i < 2; i++) {
+		NNI_LIST_FOREACH (lists[i], p) {
+			if (p->copy && (nni_pipe_id(p->pipe) == id)) {
+				return (p);
+			}
+		}
+	}
+	return (NULL);
+}
+
 static nni_msg *
 req0_sock_filter(void *arg, nni_msg *msg)
 {
 	req0_sock *s = arg;
+	req0_pipe *p;
 	nni_msg *  rmsg;
 
 	nni_mtx_lock(&s->mtx);
@@ -593,8 +939,15 @@ req0_sock_filter(void *arg, nni_msg *msg)
 		return (NULL);
 	}
 
-	s->reqmsg   = NULL;
-	s->pendpipe = NULL;
+	// The first reply wins; any others will have a stale request ID.
+	// Record how long the pipe that answered took.
+	if ((p = req0_find_copy(s, nni_msg_get_pipe(msg))) != NULL) {
+		nni_duration lat = (nni_duration)(nni_clock() - p->sent);
+		nni_lb_sample(&p->lb, lat);
+		req0_hist_add(&s->hist, lat);
+	}
+	s->reqmsg = NULL;
+	req0_clear(s);
 	nni_mtx_unlock(&s->mtx);
 
 	nni_msg_free(rmsg);
@@ -642,6 +995,36 @@ static nni_proto_sock_option req0_sock_options[] = {
 	    .pso_getopt = req0_sock_getopt_resendtime,
 	    .pso_setopt = req0_sock_setopt_resendtime,
 	},
+	{
+	    .pso_name   = NNG_OPT_REQ_HEDGE,
+	    .pso_getopt = req0_sock_getopt_hedge,
+	    .pso_setopt = req0_sock_setopt_hedge,
+	},
+	{
+	    .pso_name   = NNG_OPT_REQ_HEDGEPCT,
+	    .pso_getopt = req0_sock_getopt_hedgepct,
+	    .pso_setopt = req0_sock_setopt_hedgepct,
+	},
+	{
+	    .pso_name   = NNG_OPT_REQ_HEDGETIME,
+	    .pso_getopt = req0_sock_getopt_hedgetime,
+	    .pso_setopt = req0_sock_setopt_hedgetime,
+	},
+	{
+	    .pso_name   = NNG_OPT_REQ_HEDGEDELAY,
+	    .pso_getopt = req0_sock_getopt_hedgedelay,
+	    .pso_setopt = NULL,
+	},
+	{
+	    .pso_name   = NNG_OPT_LB_POLICY,
+	    .pso_getopt = req0_sock_getopt_policy,
+	    .pso_setopt = req0_sock_setopt_policy,
+	},
+	{
+	    .pso_name   = NNG_OPT_LB_HASHLEN,
+	    .pso_getopt = req0_sock_getopt_hashlen,
+	    .pso_setopt = req0_sock_setopt_hashlen,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
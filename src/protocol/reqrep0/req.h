@@ -22,6 +22,10 @@ NNG_DECL int nng_req0_open(nng_socket *);
 #endif
 
 #define NNG_OPT_REQ_RESENDTIME "req:resend-time"
+#define NNG_OPT_REQ_HEDGE "req:hedge"
+#define NNG_OPT_REQ_HEDGEPCT "req:hedge-percentile"
+#define NNG_OPT_REQ_HEDGETIME "req:hedge-time"
+#define NNG_OPT_REQ_HEDGEDELAY "req:hedge-delay"
 
 #ifdef __cplusplus
 }
@@ -44,6 +44,12 @@ struct surv0_sock {
 	int            closing;
 	uint32_t       nextid; // next id
 	uint32_t       survid; // outstanding request ID (big endian)
+	int            quorum; // complete after this many responses
+	int            all;    // complete when every pipe asked answered
+	int            nrecv;  // responses received for this survey
+	int            nasked; // pipes asked that have not answered
+	int            asked;  // survey has been given to the pipes
+	int            done;   // survey completed early
 	nni_list       pipes;
 	nni_aio *      aio_getq;
 	nni_timer_node timer;
@@ -58,6 +64,7 @@ struct surv0_pipe {
 	surv0_sock *  psock;
 	nni_msgq *    sendq;
 	nni_list_node node;
+	uint32_t      asked; // survey ID we are waiting on an answer for
 	nni_aio *     aio_getq;
 	nni_aio *     aio_putq;
 	nni_aio *     aio_send;
@@ -155,7 +162,10 @@ surv0_pipe_init(void **pp, nni_pipe *npipe, void *s)
 
 	p->npipe = npipe;
 	p->psock = s;
-	*pp      = p;
+	nni_msgq_set_sock(p->sendq, nni_pipe_sock(npipe));
+	nni_msgq_set_maxbytes(
+	    p->sendq, nni_sock_pipebufsz(nni_pipe_sock(npipe)));
+	*pp = p;
 	return (0);
 }
 
@@ -174,6 +184,24 @@ surv0_pipe_start(void *arg)
 	return (0);
 }
 
+// surv0_check completes the survey early, once the configured quorum
+// of responses has been received, or every pipe asked has answered.
+// The timer does the work, as we can be called from the receive queue
+// filter, and the survey ends just as if it had timed out.  Lock held.
+static void
+surv0_check(surv0_sock *s)
+{
+	if (s->done || (s->survid == 0)) {
+		return;
+	}
+	if (((s->quorum > 0) && (s->nrecv >= s->quorum)) ||
+	    (s->all && s->asked && (s->nasked == 0))) {
+		s->done   = 1;
+		s->expire = nni_clock();
+		nni_timer_schedule(&s->timer, s->expire);
+	}
+}
+
 static void
 surv0_pipe_stop(void *arg)
 {
@@ -191,6 +219,12 @@ surv0_pipe_stop(void *arg)
 	if (nni_list_active(&s->pipes, p)) {
 		nni_list_remove(&s->pipes, p);
 	}
+	if ((p->asked != 0) && (p->asked == s->survid)) {
+		// It will never answer now.
+		p->asked = 0;
+		s->nasked--;
+		surv0_check(s);
+	}
 	nni_mtx_unlock(&s->mtx);
 }
 
@@ -284,6 +318,7 @@ surv0_sock_setopt_raw(void *arg, const void *buf, size_t sz)
 	nni_mtx_lock(&s->mtx);
 	if ((rv = nni_setopt_int(&s->raw, buf, sz, 0, 1)) == 0) {
 		s->survid = 0;
+		s->done   = 0;
 		nni_timer_cancel(&s->timer);
 	}
 	nni_mtx_unlock(&s->mtx);
@@ -297,6 +332,44 @@ surv0_sock_getopt_raw(void *arg, void *buf, size_t *szp)
 	return (nni_getopt_int(s->raw, buf, szp));
 }
 
+static int
+surv0_sock_setopt_quorum(void *arg, const void *buf, size_t sz)
+{
+	surv0_sock *s = arg;
+	int         rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_setopt_int(&s->quorum, buf, sz, 0, 1000000);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+surv0_sock_getopt_quorum(void *arg, void *buf, size_t *szp)
+{
+	surv0_sock *s = arg;
+	return (nni_getopt_int(s->quorum, buf, szp));
+}
+
+static int
+surv0_sock_setopt_all(void *arg, const void *buf, size_t sz)
+{
+	surv0_sock *s = arg;
+	int         rv;
+
+	nni_mtx_lock(&s->mtx);
+	rv = nni_setopt_int(&s->all, buf, sz, 0, 1);
+	nni_mtx_unlock(&s->mtx);
+	return (rv);
+}
+
+static int
+surv0_sock_getopt_all(void *arg, void *buf, size_t *szp)
+{
+	surv0_sock *s = arg;
+	return (nni_getopt_int(s->all, buf, szp));
+}
+
 static int
 surv0_sock_setopt_maxttl(void *arg, const void *buf, size_t sz)
 {
@@ -332,6 +405,7 @@ surv0_sock_getq_cb(void *arg)
 	surv0_pipe *p;
 	surv0_pipe *last;
 	nni_msg *   msg, *dup;
+	uint32_t    id = 0;
 
 	if (nni_aio_result(s->aio_getq) != 0) {
 		// Should be NNG_ECLOSED.
@@ -341,6 +415,16 @@ surv0_sock_getq_cb(void *arg)
 	nni_aio_set_msg(s->aio_getq, NULL);
 
 	nni_mtx_lock(&s->mtx);
+	// Note which pipes are asked the current survey, so that we
+	// know when they have all answered.
+	if ((!s->raw) && (nni_msg_header_len(msg) == sizeof(uint32_t))) {
+		NNI_GET32((uint8_t *) nni_msg_header(msg), id);
+		if (id == s->survid) {
+			s->asked = 1;
+		} else {
+			id = 0;
+		}
+	}
 	last = nni_list_last(&s->pipes);
 	NNI_LIST_FOREACH (&s->pipes, p) {
 		if (p != last) {
@@ -352,8 +436,14 @@ surv0_sock_getq_cb(void *arg)
 		}
 		if (nni_msgq_tryput(p->sendq, dup) != 0) {
 			nni_msg_free(dup);
+		} else if (id != 0) {
+			p->asked = id;
+			s->nasked++;
 		}
 	}
+	if (id != 0) {
+		surv0_check(s);
+	}
 
 	nni_msgq_aio_get(s->uwq, s->aio_getq);
 	nni_mtx_unlock(&s->mtx);
@@ -370,6 +460,11 @@ surv0_timeout(void *arg)
 	surv0_sock *s = arg;
 
 	nni_mtx_lock(&s->mtx);
+	if ((s->survid == 0) || (nni_clock() < s->expire)) {
+		// A new survey was started since we were scheduled.
+		nni_mtx_unlock(&s->mtx);
+		return;
+	}
 	s->survid = 0;
 	nni_mtx_unlock(&s->mtx);
 
@@ -382,6 +477,13 @@ surv0_sock_recv(void *arg, nni_aio *aio)
 	surv0_sock *s = arg;
 
 	nni_mtx_lock(&s->mtx);
+	if (s->done) {
+		// Completed early; report it the same way as a timeout,
+		// without racing against the timer.
+		nni_mtx_unlock(&s->mtx);
+		nni_aio_finish_error(aio, NNG_ETIMEDOUT);
+		return;
+	}
 	if (s->survid == 0) {
 		nni_mtx_unlock(&s->mtx);
 		nni_aio_finish_error(aio, NNG_ESTATE);
@@ -411,6 +513,10 @@ surv0_sock_send(void *arg, nni_aio *aio)
 	// order bit so that the peer can locate the end of the
 	// backtrace.  (Pipe IDs have the high order bit clear.)
 	s->survid = (s->nextid++) | 0x80000000u;
+	s->nrecv  = 0;
+	s->nasked = 0;
+	s->asked  = 0;
+	s->done   = 0;
 
 	msg = nni_aio_get_msg(aio);
 	nni_msg_header_clear(msg);
@@ -436,6 +542,7 @@ static nni_msg *
 surv0_sock_filter(void *arg, nni_msg *msg)
 {
 	surv0_sock *s = arg;
+	surv0_pipe *p;
 
 	nni_mtx_lock(&s->mtx);
 	if (s->raw) {
@@ -445,12 +552,23 @@ surv0_sock_filter(void *arg, nni_msg *msg)
 	}
 
 	if ((nni_msg_header_len(msg) < sizeof(uint32_t)) ||
-	    (nni_msg_header_trim_u32(msg) != s->survid)) {
-		// Wrong request id
+	    (nni_msg_header_trim_u32(msg) != s->survid) || s->done) {
+		// Wrong request id, or the survey is already complete.
 		nni_mtx_unlock(&s->mtx);
 		nni_msg_free(msg);
 		return (NULL);
 	}
+	s->nrecv++;
+	NNI_LIST_FOREACH (&s->pipes, p) {
+		if (nni_pipe_id(p->npipe) == nni_msg_get_pipe(msg)) {
+			if (p->asked == s->survid) {
+				p->asked = 0;
+				s->nasked--;
+			}
+			break;
+		}
+	}
+	surv0_check(s);
 	nni_mtx_unlock(&s->mtx);
 
 	return (msg);
@@ -479,6 +597,16 @@ static nni_proto_sock_option surv0_sock_options[] = {
 	    .pso_getopt = surv0_sock_getopt_maxttl,
 	    .pso_setopt = surv0_sock_setopt_maxttl,
 	},
+	{
+	    .pso_name   = NNG_OPT_SURVEYOR_QUORUM,
+	    .pso_getopt = surv0_sock_getopt_quorum,
+	    .pso_setopt = surv0_sock_setopt_quorum,
+	},
+	{
+	    .pso_name   = NNG_OPT_SURVEYOR_ALL,
+	    .pso_getopt = surv0_sock_getopt_all,
+	    .pso_setopt = surv0_sock_setopt_all,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
@@ -22,6 +22,8 @@ NNG_DECL int nng_surveyor0_open(nng_socket *);
 #endif
 
 #define NNG_OPT_SURVEYOR_SURVEYTIME "surveyor:survey-time"
+#define NNG_OPT_SURVEYOR_QUORUM "surveyor:quorum"
+#define NNG_OPT_SURVEYOR_ALL "surveyor:all-respond"
 
 #ifdef __cplusplus
 }
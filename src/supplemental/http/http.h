@@ -245,6 +245,22 @@ NNG_DECL void nng_http_conn_write(nng_http_conn *, nng_aio *);
 // finish until either all the requested data is written, or an error occurs.
 NNG_DECL void nng_http_conn_write_all(nng_http_conn *, nng_aio *);
 
+// nng_http_conn_read_chunk reads entity data that was sent with the
+// "chunked" Transfer-Encoding, with the chunk framing removed.  Like
+// nng_http_conn_read, it completes as soon as at least one byte is read.
+// It completes with a count of zero once the end of the entity has been
+// reached.  This allows an entity of any size to be received without
+// holding all of it in memory.
+NNG_DECL void nng_http_conn_read_chunk(nng_http_conn *, nng_aio *);
+
+// nng_http_conn_write_chunk writes the data in the aio as one chunk of an
+// entity sent with the "chunked" Transfer-Encoding.  The request or
+// response must have been written already, with a Transfer-Encoding:
+// chunked header and no data attached.  A chunk with no data (an aio
+// with no iovs) ends the entity.  The data may be scattered across at
+// most 8 iovs.
+NNG_DECL void nng_http_conn_write_chunk(nng_http_conn *, nng_aio *);
+
 // nng_http_conn_write_req writes the entire request.  It will also write any
 // data that has been attached.
 NNG_DECL void nng_http_conn_write_req(
@@ -114,6 +114,13 @@ extern void nni_http_read(nni_http_conn *, nni_aio *);
 extern void nni_http_read_full(nni_http_conn *, nni_aio *);
 extern void nni_http_write(nni_http_conn *, nni_aio *);
 extern void nni_http_write_full(nni_http_conn *, nni_aio *);
+
+// nni_http_read_chunk reads data from a chunked entity, without the chunk
+// framing.  It completes when at least one byte is read, or with a count
+// of zero at the end of the entity.  nni_http_write_chunk writes the data
+// of the aio as a single chunk; a chunk with no data ends the entity.
+extern void nni_http_read_chunk(nni_http_conn *, nni_aio *);
+extern void nni_http_write_chunk(nni_http_conn *, nni_aio *);
 extern int  nni_http_sock_addr(nni_http_conn *, nni_sockaddr *);
 extern int  nni_http_peer_addr(nni_http_conn *, nni_sockaddr *);
 
@@ -160,6 +167,11 @@ extern int nni_http_server_set_tls(nni_http_server *, nng_tls_config *);
 // nni_http_server_set_tls function is called, so be careful.
 extern int nni_http_server_get_tls(nni_http_server *, nng_tls_config **);
 
+// nni_http_server_set_listeners sets the number of listening sockets
+// the server will open, sharing the port with SO_REUSEPORT.  This returns
+// NNG_EBUSY if the server is already started.
+extern int nni_http_server_set_listeners(nni_http_server *, int);
+
 // nni_http_server_start starts listening on the supplied port.
 extern int nni_http_server_start(nni_http_server *);
 
@@ -9,6 +9,7 @@
 //
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "core/nng_impl.h"
@@ -27,6 +28,7 @@ enum read_flavor {
 	HTTP_RD_FULL,
 	HTTP_RD_REQ,
 	HTTP_RD_RES,
+	HTTP_RD_CHUNK,
 };
 
 enum write_flavor {
@@ -34,8 +36,22 @@ enum write_flavor {
 	HTTP_WR_FULL,
 	HTTP_WR_REQ,
 	HTTP_WR_RES,
+	HTTP_WR_CHUNK,
 };
 
+// states of the chunked entity reader
+enum chunk_state {
+	HTTP_CHUNK_SIZE,    // expecting a chunk size line
+	HTTP_CHUNK_DATA,    // within the data of a chunk
+	HTTP_CHUNK_CRLF,    // expecting the line end after chunk data
+	HTTP_CHUNK_TRAILER, // skipping trailer lines, up to a blank one
+	HTTP_CHUNK_DONE,    // the last chunk has been read
+};
+
+// A chunk written with nni_http_write_chunk may be scattered over at
+// most this many iovs.  We add the chunk framing around them.
+#define HTTP_CHUNK_IOV 8
+
 typedef struct nni_http_tran {
 	void (*h_read)(void *, nni_aio *);
 	void (*h_write)(void *, nni_aio *);
@@ -80,6 +96,10 @@ struct nng_http_conn {
 	size_t   rd_get;
 	size_t   rd_put;
 	size_t   rd_bufsz;
+
+	int    rd_chunk;      // chunk_state, reset by each message read
+	size_t rd_chunk_left; // bytes left in the current chunk
+	char   wr_chunk[24];  // size line of the chunk being written
 };
 
 void
@@ -136,6 +156,164 @@ nni_http_conn_close(nni_http_conn *conn)
 	nni_mtx_unlock(&conn->mtx);
 }
 
+// http_rd_line takes a line from the read buffer, for the chunk reader.
+// The line is terminated in place.  Returns NULL if no complete line is
+// buffered.
+static char *
+http_rd_line(nni_http_conn *conn)
+{
+	char * line = (char *) conn->rd_buf + conn->rd_get;
+	char * end;
+	size_t cnt = conn->rd_put - conn->rd_get;
+
+	if ((end = memchr(line, '\n', cnt)) == NULL) {
+		return (NULL);
+	}
+	conn->rd_get += (size_t)(end - line) + 1;
+	if ((end > line) && (end[-1] == '\r')) {
+		end--;
+	}
+	*end = '\0';
+	return (line);
+}
+
+static int
+http_rd_chunk_line(nni_http_conn *conn, char *line)
+{
+	size_t size = 0;
+	char * s    = line;
+	int    c;
+
+	switch (conn->rd_chunk) {
+	case HTTP_CHUNK_SIZE:
+		for (;;) {
+			c = *s;
+			if ((c >= '0') && (c <= '9')) {
+				c -= '0';
+			} else if ((c >= 'a') && (c <= 'f')) {
+				c -= 'a' - 10;
+			} else if ((c >= 'A') && (c <= 'F')) {
+				c -= 'A' - 10;
+			} else {
+				break;
+			}
+			if (size > (((size_t) -1) >> 4)) {
+				return (NNG_EPROTO);
+			}
+			size = (size << 4) + (size_t) c;
+			s++;
+		}
+		while ((*s == ' ') || (*s == '\t')) {
+			s++;
+		}
+		// Chunk extensions (after ';') are ignored.
+		if ((s == line) || ((*s != '\0') && (*s != ';'))) {
+			return (NNG_EPROTO);
+		}
+		if (size == 0) {
+			conn->rd_chunk = HTTP_CHUNK_TRAILER;
+		} else {
+			conn->rd_chunk      = HTTP_CHUNK_DATA;
+			conn->rd_chunk_left = size;
+		}
+		return (0);
+
+	case HTTP_CHUNK_CRLF:
+		if (*line != '\0') {
+			return (NNG_EPROTO);
+		}
+		conn->rd_chunk = HTTP_CHUNK_SIZE;
+		return (0);
+
+	case HTTP_CHUNK_TRAILER:
+		// Trailer fields are discarded.
+		if (*line == '\0') {
+			conn->rd_chunk = HTTP_CHUNK_DONE;
+		}
+		return (0);
+	}
+	return (NNG_EINVAL);
+}
+
+// http_rd_chunk reads chunked entity data, stripping off the framing.
+// Everything passes through the read buffer, so that the chunk framing
+// can be found.  The read completes once at least one byte of data is
+// read, or with no data at all when the end of the entity is reached.
+static int
+http_rd_chunk(nni_http_conn *conn, nni_aio *aio)
+{
+	nni_iov *iov;
+	unsigned niov;
+	nni_iov  iov1;
+	size_t   n;
+	char *   line;
+	int      rv;
+
+	nni_aio_get_iov(aio, &niov, &iov);
+	while (conn->rd_chunk != HTTP_CHUNK_DONE) {
+		if (conn->rd_chunk == HTTP_CHUNK_DATA) {
+			if (niov == 0) {
+				break;
+			}
+			if ((n = conn->rd_put - conn->rd_get) == 0) {
+				goto more;
+			}
+			if (n > conn->rd_chunk_left) {
+				n = conn->rd_chunk_left;
+			}
+			if (n > iov[0].iov_len) {
+				n = iov[0].iov_len;
+			}
+			memcpy(iov[0].iov_buf, conn->rd_buf + conn->rd_get, n);
+			iov[0].iov_len -= n;
+			NNI_INCPTR(iov[0].iov_buf, n);
+			nni_aio_bump_count(aio, n);
+			conn->rd_get += n;
+			if ((conn->rd_chunk_left -= n) == 0) {
+				conn->rd_chunk = HTTP_CHUNK_CRLF;
+			}
+			if (iov[0].iov_len == 0) {
+				niov--;
+				iov = &iov[1];
+			}
+			continue;
+		}
+		if ((line = http_rd_line(conn)) == NULL) {
+			goto more;
+		}
+		if ((rv = http_rd_chunk_line(conn, line)) != 0) {
+			return (rv);
+		}
+	}
+	nni_aio_set_iov(aio, niov, iov);
+	return (0);
+
+more:
+	nni_aio_set_iov(aio, niov, iov);
+	if (nni_aio_count(aio) != 0) {
+		return (0);
+	}
+	// Make room at the end of the buffer for more data.  A line that
+	// does not fit in the whole buffer is bogus.
+	if (conn->rd_get == conn->rd_put) {
+		conn->rd_get = conn->rd_put = 0;
+	} else if (conn->rd_put == conn->rd_bufsz) {
+		if (conn->rd_get == 0) {
+			return (NNG_EPROTO);
+		}
+		memmove(conn->rd_buf, conn->rd_buf + conn->rd_get,
+		    conn->rd_put - conn->rd_get);
+		conn->rd_put -= conn->rd_get;
+		conn->rd_get = 0;
+	}
+	iov1.iov_buf = conn->rd_buf + conn->rd_put;
+	iov1.iov_len = conn->rd_bufsz - conn->rd_put;
+	nni_aio_set_iov(conn->rd_aio, 1, &iov1);
+	nni_aio_set_data(conn->rd_aio, 1, aio);
+	conn->rd(conn->sock, conn->rd_aio);
+	return (NNG_EAGAIN);
+}
+
 // http_rd_buf attempts to satisfy the read from data in the buffer.
 static int
 http_rd_buf(nni_http_conn *conn, nni_aio *aio)
@@ -200,6 +378,10 @@ http_rd_buf(nni_http_conn *conn, nni_aio *aio)
 		if (conn->rd_get == conn->rd_put) {
 			conn->rd_get = conn->rd_put = 0;
 		}
+		if (rv == 0) {
+			// Any chunked entity that follows starts afresh.
+			conn->rd_chunk = HTTP_CHUNK_SIZE;
+		}
 		if (rv == NNG_EAGAIN) {
 			nni_iov iov1;
 			iov1.iov_buf = conn->rd_buf + conn->rd_put;
@@ -217,6 +399,10 @@ http_rd_buf(nni_http_conn *conn, nni_aio *aio)
 		if (conn->rd_get == conn->rd_put) {
 			conn->rd_get = conn->rd_put = 0;
 		}
+		if (rv == 0) {
+			// Any chunked entity that follows starts afresh.
+			conn->rd_chunk = HTTP_CHUNK_SIZE;
+		}
 		if (rv == NNG_EAGAIN) {
 			nni_iov iov1;
 			iov1.iov_buf = conn->rd_buf + conn->rd_put;
@@ -226,6 +412,9 @@ http_rd_buf(nni_http_conn *conn, nni_aio *aio)
 			conn->rd(conn->sock, conn->rd_aio);
 		}
 		return (rv);
+
+	case HTTP_RD_CHUNK:
+		return (http_rd_chunk(conn, aio));
 	}
 	return (NNG_EINVAL);
 }
@@ -373,12 +562,46 @@ http_rd_submit(nni_http_conn *conn, nni_aio *aio)
 	}
 }
 
+// http_wr_chunk_iov frames the data of the aio as a single chunk.  An
+// empty chunk is the last one, which ends the entity.
+static int
+http_wr_chunk_iov(nni_http_conn *conn, unsigned niov, nni_iov *iov)
+{
+	nni_iov  wiov[HTTP_CHUNK_IOV + 2];
+	unsigned n   = 0;
+	size_t   len = 0;
+
+	for (unsigned i = 0; i < niov; i++) {
+		len += iov[i].iov_len;
+	}
+	if (len == 0) {
+		(void) snprintf(
+		    conn->wr_chunk, sizeof(conn->wr_chunk), "0\r\n\r\n");
+	} else {
+		(void) snprintf(conn->wr_chunk, sizeof(conn->wr_chunk),
+		    "%llx\r\n", (unsigned long long) len);
+	}
+	wiov[n].iov_buf   = conn->wr_chunk;
+	wiov[n++].iov_len = strlen(conn->wr_chunk);
+	if (len != 0) {
+		for (unsigned i = 0; i < niov; i++) {
+			if (iov[i].iov_len != 0) {
+				wiov[n++] = iov[i];
+			}
+		}
+		wiov[n].iov_buf   = (void *) "\r\n";
+		wiov[n++].iov_len = 2;
+	}
+	return (nni_aio_set_iov(conn->wr_aio, n, wiov));
+}
+
 static void
 http_wr_start(nni_http_conn *conn)
 {
 	nni_aio *aio;
 	nni_iov *iov;
 	unsigned niov;
+	int      rv;
 
 	if ((aio = conn->wr_uaio) == NULL) {
 		if ((aio = nni_list_first(&conn->wrq)) == NULL) {
@@ -390,7 +613,17 @@ http_wr_start(nni_http_conn *conn)
 	}
 
 	nni_aio_get_iov(aio, &niov, &iov);
-	nni_aio_set_iov(conn->wr_aio, niov, iov);
+	if (GET_WR_FLAVOR(aio) == HTTP_WR_CHUNK) {
+		rv = http_wr_chunk_iov(conn, niov, iov);
+	} else {
+		rv = nni_aio_set_iov(conn->wr_aio, niov, iov);
+	}
+	if (rv != 0) {
+		conn->wr_uaio = NULL;
+		nni_aio_finish_error(aio, rv);
+		http_close(conn);
+		return;
+	}
 	conn->wr(conn->sock, conn->wr_aio);
 }
 
@@ -445,7 +678,12 @@ http_wr_cb(void *arg)
 
 done:
 	conn->wr_uaio = NULL;
-	nni_aio_finish(uaio, 0, nni_aio_count(uaio));
+	if (GET_WR_FLAVOR(uaio) == HTTP_WR_CHUNK) {
+		// Report only the data, not the framing.
+		nni_aio_finish(uaio, 0, nni_aio_iov_count(uaio));
+	} else {
+		nni_aio_finish(uaio, 0, nni_aio_count(uaio));
+	}
 
 	// Start next write if another is ready.
 	http_wr_start(conn);
@@ -519,6 +757,17 @@ nni_http_read_full(nni_http_conn *conn, nni_aio *aio)
 	nni_mtx_unlock(&conn->mtx);
 }
 
+void
+nni_http_read_chunk(nni_http_conn *conn, nni_aio *aio)
+{
+	SET_RD_FLAVOR(aio, HTTP_RD_CHUNK);
+	nni_aio_set_prov_extra(aio, 1, NULL);
+
+	nni_mtx_lock(&conn->mtx);
+	http_rd_submit(conn, aio);
+	nni_mtx_unlock(&conn->mtx);
+}
+
 void
 nni_http_read(nni_http_conn *conn, nni_aio *aio)
 {
@@ -616,6 +865,26 @@ nni_http_write_full(nni_http_conn *conn, nni_aio *aio)
 	nni_mtx_unlock(&conn->mtx);
 }
 
+void
+nni_http_write_chunk(nni_http_conn *conn, nni_aio *aio)
+{
+	unsigned niov;
+	nni_iov *iov;
+
+	nni_aio_get_iov(aio, &niov, &iov);
+	if (niov > HTTP_CHUNK_IOV) {
+		if (nni_aio_start(aio, NULL, NULL) == 0) {
+			nni_aio_finish_error(aio, NNG_EINVAL);
+		}
+		return;
+	}
+	SET_WR_FLAVOR(aio, HTTP_WR_CHUNK);
+
+	nni_mtx_lock(&conn->mtx);
+	http_wr_submit(conn, aio);
+	nni_mtx_unlock(&conn->mtx);
+}
+
 int
 nni_http_sock_addr(nni_http_conn *conn, nni_sockaddr *sa)
 {
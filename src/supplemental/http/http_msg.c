@@ -8,7 +8,6 @@
 // found online at https://opensource.org/licenses/MIT.
 //
 
-#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,16 +16,65 @@
 #include "core/nng_impl.h"
 #include "http_api.h"
 
+// All the strings of a message (the parts of the start line, and the
+// header names and values) are carved out of an arena of blocks that
+// belongs to the message.  Blocks never move, so the strings stay put
+// until the message is reset or freed.  A reset keeps the newest (and
+// largest) block, so a message that is reused for request after
+// request, as the server does, stops allocating once it has seen its
+// largest header.  Strings replaced by the setters are only reclaimed
+// by the reset.  Header values may be replaced or merged any number of
+// times, which would grow without bound that way, so a value that
+// outgrows its place moves to a buffer of the header's own instead.
+typedef struct http_block {
+	struct http_block *next;
+	size_t             size;
+} http_block;
+
+typedef struct http_arena {
+	http_block *blk; // newest first
+	size_t      len; // used in the newest block
+} http_arena;
+
+#define HTTP_ARENA_SIZE 1024
+
 // Note that as we parse headers, the rule is that if a header is already
 // present, then we can append it to the existing header, separated by
 // a comma.  From experience, for example, Firefox uses a Connection:
 // header with two values, "keepalive", and "upgrade".
 typedef struct http_header {
-	char *        name;
-	char *        value;
-	nni_list_node node;
+	char *   name;
+	char *   value;
+	size_t   namelen;
+	size_t   vallen;
+	size_t   valsz; // room at value, including the terminator
+	char *   buf;   // value that outgrew the arena, if any
+	size_t   bufsz;
+	uint32_t hash;
 } http_header;
 
+// Headers are kept in order in an array.  The first HTTP_HDR_INDEX / 2
+// of them, which in practice is all of them, are also in a small open
+// addressed hash table.  Slots hold the position of the header plus one,
+// so that zero means empty.
+#define HTTP_HDR_INDEX 32
+
+// Limits on the headers we will parse from a peer, counting every header
+// line (even those merged into an earlier one) and the bytes of their
+// names and values.
+#define HTTP_MAX_HEADERS 100
+#define HTTP_MAX_HEADER_SIZE (64 * 1024)
+
+typedef struct http_head {
+	http_header *hdrs;
+	size_t       nhdrs;
+	size_t       hdrsz;
+	size_t       nparsed; // header lines parsed
+	size_t       parsedsz;
+	uint8_t      index[HTTP_HDR_INDEX];
+	http_arena   arena;
+} http_head;
+
 typedef struct nni_http_entity {
 	char * data;
 	size_t size; // allocated/expected size
@@ -35,54 +83,191 @@ typedef struct nni_http_entity {
 } nni_http_entity;
 
 struct nng_http_req {
-	nni_list        hdrs;
+	http_head       head;
 	nni_http_entity data;
 	char *          meth;
 	char *          uri;
 	char *          vers;
 	char *          buf;
 	size_t          bufsz;
+	size_t          buflen;
 	bool            parsed;
 };
 
 struct nng_http_res {
-	nni_list        hdrs;
+	http_head       head;
 	nni_http_entity data;
 	uint16_t        code;
 	char *          rsn;
 	char *          vers;
 	char *          buf;
 	size_t          bufsz;
+	size_t          buflen;
 	bool            parsed;
 };
 
+static void *
+http_arena_alloc(http_arena *arena, size_t n)
+{
+	http_block *blk;
+	char *      p;
+
+	if (((blk = arena->blk) == NULL) || (n > blk->size - arena->len)) {
+		size_t size = (blk != NULL) ? blk->size * 2 : HTTP_ARENA_SIZE;
+		while (size < n) {
+			size *= 2;
+		}
+		if ((blk = nni_alloc(sizeof(*blk) + size)) == NULL) {
+			return (NULL);
+		}
+		blk->size  = size;
+		blk->next  = arena->blk;
+		arena->blk = blk;
+		arena->len = 0;
+	}
+	p = (char *) (blk + 1);
+	p += arena->len;
+	arena->len += n;
+	return (p);
+}
+
+static char *
+http_arena_strdup(http_arena *arena, const char *s, size_t len)
+{
+	char *p;
+
+	if ((p = http_arena_alloc(arena, len + 1)) != NULL) {
+		memcpy(p, s, len);
+		p[len] = '\0';
+	}
+	return (p);
+}
+
+static void
+http_arena_reset(http_arena *arena)
+{
+	http_block *blk;
+
+	if ((blk = arena->blk) != NULL) {
+		http_block *old;
+		while ((old = blk->next) != NULL) {
+			blk->next = old->next;
+			nni_free(old, sizeof(*old) + old->size);
+		}
+	}
+	arena->len = 0;
+}
+
+static void
+http_arena_fini(http_arena *arena)
+{
+	http_arena_reset(arena);
+	if (arena->blk != NULL) {
+		nni_free(arena->blk, sizeof(*arena->blk) + arena->blk->size);
+		arena->blk = NULL;
+	}
+}
+
 static int
-http_set_string(char **strp, const char *val)
+http_set_string(http_arena *arena, char **strp, const char *val)
 {
 	char *news;
 	if (val == NULL) {
 		news = NULL;
-	} else if ((news = nni_strdup(val)) == NULL) {
+	} else if ((news = http_arena_strdup(arena, val, strlen(val))) ==
+	    NULL) {
 		return (NNG_ENOMEM);
 	}
-	nni_strfree(*strp);
 	*strp = news;
 	return (0);
 }
 
+// http_hash is FNV-1a, folding case as header names are case insensitive.
+static uint32_t
+http_hash(const char *s)
+{
+	uint32_t hash = 2166136261u;
+	char     c;
+
+	while ((c = *s++) != '\0') {
+		if ((c >= 'A') && (c <= 'Z')) {
+			c += 'a' - 'A';
+		}
+		hash ^= (uint8_t) c;
+		hash *= 16777619u;
+	}
+	return (hash);
+}
+
 static void
-http_headers_reset(nni_list *hdrs)
+http_index_add(http_head *head, size_t i)
+{
+	size_t slot;
+
+	if (i >= HTTP_HDR_INDEX / 2) {
+		return;
+	}
+	slot = head->hdrs[i].hash % HTTP_HDR_INDEX;
+	while (head->index[slot] != 0) {
+		slot = (slot + 1) % HTTP_HDR_INDEX;
+	}
+	head->index[slot] = (uint8_t)(i + 1);
+}
+
+static http_header *
+http_find_header(http_head *head, const char *key)
 {
+	uint32_t     hash = http_hash(key);
+	size_t       slot = hash % HTTP_HDR_INDEX;
+	size_t       i;
 	http_header *h;
-	while ((h = nni_list_first(hdrs)) != NULL) {
-		nni_list_remove(hdrs, h);
-		if (h->name != NULL) {
-			nni_strfree(h->name);
+
+	// The table is never more than half full, so this terminates.
+	while ((i = head->index[slot]) != 0) {
+		h = &head->hdrs[i - 1];
+		if ((h->hash == hash) && (nni_strcasecmp(h->name, key) == 0)) {
+			return (h);
 		}
-		if (h->value != NULL) {
-			nni_free(h->value, strlen(h->value) + 1);
+		slot = (slot + 1) % HTTP_HDR_INDEX;
+	}
+	for (i = HTTP_HDR_INDEX / 2; i < head->nhdrs; i++) {
+		h = &head->hdrs[i];
+		if ((h->hash == hash) && (nni_strcasecmp(h->name, key) == 0)) {
+			return (h);
 		}
-		NNI_FREE_STRUCT(h);
+	}
+	return (NULL);
+}
+
+static void
+http_header_fini(http_header *h)
+{
+	if (h->bufsz != 0) {
+		nni_free(h->buf, h->bufsz);
+		h->buf   = NULL;
+		h->bufsz = 0;
+	}
+}
+
+static void
+http_head_reset(http_head *head)
+{
+	for (size_t i = 0; i < head->nhdrs; i++) {
+		http_header_fini(&head->hdrs[i]);
+	}
+	head->nhdrs    = 0;
+	head->nparsed  = 0;
+	head->parsedsz = 0;
+	memset(head->index, 0, sizeof(head->index));
+	http_arena_reset(&head->arena);
+}
+
+static void
+http_head_fini(http_head *head)
+{
+	http_arena_fini(&head->arena);
+	if (head->hdrsz != 0) {
+		NNI_FREE_STRUCTS(head->hdrs, head->hdrsz);
 	}
 }
 
@@ -100,36 +285,30 @@ http_entity_reset(nni_http_entity *entity)
 void
 nni_http_req_reset(nni_http_req *req)
 {
-	http_headers_reset(&req->hdrs);
+	http_head_reset(&req->head);
 	http_entity_reset(&req->data);
-	nni_strfree(req->vers);
-	nni_strfree(req->meth);
-	nni_strfree(req->uri);
 	req->vers = req->meth = req->uri = NULL;
-	if (req->bufsz) {
-		req->buf[0] = '\0';
-	}
+	req->buflen                      = 0;
+	req->parsed                      = false;
 }
 
 void
 nni_http_res_reset(nni_http_res *res)
 {
-	http_headers_reset(&res->hdrs);
+	http_head_reset(&res->head);
 	http_entity_reset(&res->data);
-	nni_strfree(res->rsn);
-	nni_strfree(res->vers);
-	res->vers = NULL;
-	res->rsn  = NULL;
-	res->code = 0;
-	if (res->bufsz) {
-		res->buf[0] = '\0';
-	}
+	res->vers   = NULL;
+	res->rsn    = NULL;
+	res->code   = 0;
+	res->buflen = 0;
+	res->parsed = false;
 }
 
 void
 nni_http_req_free(nni_http_req *req)
 {
 	nni_http_req_reset(req);
+	http_head_fini(&req->head);
 	if (req->bufsz) {
 		nni_free(req->buf, req->bufsz);
 	}
@@ -140,6 +319,7 @@ void
 nni_http_res_free(nni_http_res *res)
 {
 	nni_http_res_reset(res);
+	http_head_fini(&res->head);
 	if (res->bufsz) {
 		nni_free(res->buf, res->bufsz);
 	}
@@ -147,149 +327,198 @@ nni_http_res_free(nni_http_res *res)
 }
 
 static int
-http_del_header(nni_list *hdrs, const char *key)
+http_del_header(http_head *head, const char *key)
 {
 	http_header *h;
-	NNI_LIST_FOREACH (hdrs, h) {
-		if (nni_strcasecmp(key, h->name) == 0) {
-			nni_list_remove(hdrs, h);
-			nni_strfree(h->name);
-			nni_free(h->value, strlen(h->value) + 1);
-			NNI_FREE_STRUCT(h);
-			return (0);
-		}
+	size_t       i;
+
+	if ((h = http_find_header(head, key)) == NULL) {
+		return (NNG_ENOENT);
+	}
+	i = (size_t)(h - head->hdrs);
+	http_header_fini(h);
+	head->nhdrs--;
+	memmove(h, h + 1, (head->nhdrs - i) * sizeof(*h));
+	memset(head->index, 0, sizeof(head->index));
+	for (i = 0; i < head->nhdrs; i++) {
+		http_index_add(head, i);
 	}
-	return (NNG_ENOENT);
+	return (0);
 }
 
 int
 nni_http_req_del_header(nni_http_req *req, const char *key)
 {
-	return (http_del_header(&req->hdrs, key));
+	return (http_del_header(&req->head, key));
 }
 
 int
 nni_http_res_del_header(nni_http_res *res, const char *key)
 {
-	return (http_del_header(&res->hdrs, key));
+	return (http_del_header(&res->head, key));
 }
 
 static int
-http_set_header(nni_list *hdrs, const char *key, const char *val)
+http_new_header(http_head *head, const char *key, const char *val)
 {
 	http_header *h;
-	NNI_LIST_FOREACH (hdrs, h) {
-		if (nni_strcasecmp(key, h->name) == 0) {
-			char * news;
-			size_t len = strlen(val) + 1;
-			if ((news = nni_alloc(len)) == NULL) {
-				return (NNG_ENOMEM);
-			}
-			snprintf(news, len, "%s", val);
-			nni_free(h->value, strlen(h->value) + 1);
-			h->value = news;
-			return (0);
+
+	if (head->nhdrs == head->hdrsz) {
+		http_header *hdrs;
+		size_t       sz = head->hdrsz ? head->hdrsz * 2 : 16;
+		if ((hdrs = NNI_ALLOC_STRUCTS(hdrs, sz)) == NULL) {
+			return (NNG_ENOMEM);
+		}
+		if (head->hdrsz != 0) {
+			memcpy(hdrs, head->hdrs, head->nhdrs * sizeof(*hdrs));
+			NNI_FREE_STRUCTS(head->hdrs, head->hdrsz);
 		}
+		head->hdrs  = hdrs;
+		head->hdrsz = sz;
 	}
-
-	if ((h = NNI_ALLOC_STRUCT(h)) == NULL) {
+	h          = &head->hdrs[head->nhdrs];
+	h->namelen = strlen(key);
+	h->vallen  = strlen(val);
+	h->valsz   = h->vallen + 1;
+	h->buf     = NULL;
+	h->bufsz   = 0;
+	if (((h->name = http_arena_strdup(&head->arena, key, h->namelen)) ==
+	        NULL) ||
+	    ((h->value = http_arena_strdup(&head->arena, val, h->vallen)) ==
+	        NULL)) {
 		return (NNG_ENOMEM);
 	}
-	if ((h->name = nni_strdup(key)) == NULL) {
-		NNI_FREE_STRUCT(h);
-		return (NNG_ENOMEM);
+	h->hash = http_hash(key);
+	http_index_add(head, head->nhdrs);
+	head->nhdrs++;
+	return (0);
+}
+
+// http_set_header replaces the value in place when it fits, and
+// otherwise moves it to the header's own buffer, which grows by doubling.
+static int
+http_set_header(http_head *head, const char *key, const char *val)
+{
+	http_header *h;
+	char *       buf;
+	size_t       len;
+	size_t       sz;
+
+	if ((h = http_find_header(head, key)) == NULL) {
+		return (http_new_header(head, key, val));
 	}
-	if ((h->value = nni_alloc(strlen(val) + 1)) == NULL) {
-		nni_strfree(h->name);
-		NNI_FREE_STRUCT(h);
-		return (NNG_ENOMEM);
+	len = strlen(val);
+	if (len + 1 <= h->valsz) {
+		// The value may be the old one, or part of it.
+		memmove(h->value, val, len + 1);
+	} else {
+		sz = (h->bufsz != 0) ? h->bufsz : 64;
+		while (sz < len + 1) {
+			sz *= 2;
+		}
+		if ((buf = nni_alloc(sz)) == NULL) {
+			return (NNG_ENOMEM);
+		}
+		memcpy(buf, val, len + 1);
+		http_header_fini(h);
+		h->buf   = buf;
+		h->bufsz = sz;
+		h->value = buf;
+		h->valsz = sz;
 	}
-	strncpy(h->value, val, strlen(val) + 1);
-	nni_list_append(hdrs, h);
+	h->vallen = len;
 	return (0);
 }
 
 int
 nni_http_req_set_header(nni_http_req *req, const char *key, const char *val)
 {
-	return (http_set_header(&req->hdrs, key, val));
+	return (http_set_header(&req->head, key, val));
 }
 
 int
 nni_http_res_set_header(nni_http_res *res, const char *key, const char *val)
 {
-	return (http_set_header(&res->hdrs, key, val));
+	return (http_set_header(&res->head, key, val));
 }
 
+// http_add_header appends to an existing value in the header's own
+// buffer, which grows by doubling, so that a header repeated many times
+// costs memory in proportion to its final length.
 static int
-http_add_header(nni_list *hdrs, const char *key, const char *val)
+http_add_header(http_head *head, const char *key, const char *val)
 {
 	http_header *h;
-	NNI_LIST_FOREACH (hdrs, h) {
-		if (nni_strcasecmp(key, h->name) == 0) {
-			char * news;
-			size_t len = strlen(h->value) + strlen(val) + 3;
-			if ((news = nni_alloc(len)) == NULL) {
-				return (NNG_ENOMEM);
-			}
-			snprintf(news, len, "%s, %s", h->value, val);
-			nni_free(h->value, strlen(h->value) + 1);
-			h->value = news;
-			return (0);
-		}
-	}
+	char *       buf;
+	size_t       len;
+	size_t       need;
+	size_t       sz;
 
-	if ((h = NNI_ALLOC_STRUCT(h)) == NULL) {
-		return (NNG_ENOMEM);
+	if ((h = http_find_header(head, key)) == NULL) {
+		return (http_new_header(head, key, val));
 	}
-	if ((h->name = nni_strdup(key)) == NULL) {
-		NNI_FREE_STRUCT(h);
-		return (NNG_ENOMEM);
+	len  = strlen(val);
+	need = h->vallen + len + 3;
+	buf  = h->buf;
+	sz   = h->bufsz;
+	if (need > sz) {
+		sz = (sz != 0) ? sz : 64;
+		while (sz < need) {
+			sz *= 2;
+		}
+		if ((buf = nni_alloc(sz)) == NULL) {
+			return (NNG_ENOMEM);
+		}
 	}
-	if ((h->value = nni_alloc(strlen(val) + 1)) == NULL) {
-		nni_strfree(h->name);
-		NNI_FREE_STRUCT(h);
-		return (NNG_ENOMEM);
+	if (h->value != buf) {
+		memcpy(buf, h->value, h->vallen);
 	}
-	strncpy(h->value, val, strlen(val) + 1);
-	nni_list_append(hdrs, h);
+	memcpy(buf + h->vallen, ", ", 2);
+	memcpy(buf + h->vallen + 2, val, len + 1);
+	if (buf != h->buf) {
+		http_header_fini(h);
+		h->buf   = buf;
+		h->bufsz = sz;
+	}
+	h->value = buf;
+	h->valsz = sz;
+	h->vallen += len + 2;
 	return (0);
 }
 
 int
 nni_http_req_add_header(nni_http_req *req, const char *key, const char *val)
 {
-	return (http_add_header(&req->hdrs, key, val));
+	return (http_add_header(&req->head, key, val));
 }
 
 int
 nni_http_res_add_header(nni_http_res *res, const char *key, const char *val)
 {
-	return (http_add_header(&res->hdrs, key, val));
+	return (http_add_header(&res->head, key, val));
 }
 
 static const char *
-http_get_header(nni_list *hdrs, const char *key)
+http_get_header(http_head *head, const char *key)
 {
 	http_header *h;
-	NNI_LIST_FOREACH (hdrs, h) {
-		if (nni_strcasecmp(h->name, key) == 0) {
-			return (h->value);
-		}
+
+	if ((h = http_find_header(head, key)) == NULL) {
+		return (NULL);
 	}
-	return (NULL);
+	return (h->value);
 }
 
 const char *
 nni_http_req_get_header(nni_http_req *req, const char *key)
 {
-	return (http_get_header(&req->hdrs, key));
+	return (http_get_header(&req->head, key));
 }
 
 const char *
 nni_http_res_get_header(nni_http_res *res, const char *key)
 {
-	return (http_get_header(&res->hdrs, key));
+	return (http_get_header(&res->head, key));
 }
 
 // http_entity_set_data sets the entity, but does not update the
@@ -328,11 +557,11 @@ http_entity_copy_data(nni_http_entity *entity, const void *data, size_t size)
 }
 
 static int
-http_set_content_length(nni_http_entity *entity, nni_list *hdrs)
+http_set_content_length(nni_http_entity *entity, http_head *head)
 {
 	char buf[16];
 	(void) snprintf(buf, sizeof(buf), "%u", (unsigned) entity->size);
-	return (http_set_header(hdrs, "Content-Length", buf));
+	return (http_set_header(head, "Content-Length", buf));
 }
 
 static void
@@ -360,7 +589,7 @@ nni_http_req_set_data(nni_http_req *req, const void *data, size_t size)
 	int rv;
 
 	http_entity_set_data(&req->data, data, size);
-	if ((rv = http_set_content_length(&req->data, &req->hdrs)) != 0) {
+	if ((rv = http_set_content_length(&req->data, &req->head)) != 0) {
 		http_entity_set_data(&req->data, NULL, 0);
 	}
 	return (rv);
@@ -372,7 +601,7 @@ nni_http_res_set_data(nni_http_res *res, const void *data, size_t size)
 	int rv;
 
 	http_entity_set_data(&res->data, data, size);
-	if ((rv = http_set_content_length(&res->data, &res->hdrs)) != 0) {
+	if ((rv = http_set_content_length(&res->data, &res->head)) != 0) {
 		http_entity_set_data(&res->data, NULL, 0);
 	}
 	return (rv);
@@ -384,7 +613,7 @@ nni_http_req_copy_data(nni_http_req *req, const void *data, size_t size)
 	int rv;
 
 	if (((rv = http_entity_copy_data(&req->data, data, size)) != 0) ||
-	    ((rv = http_set_content_length(&req->data, &req->hdrs)) != 0)) {
+	    ((rv = http_set_content_length(&req->data, &req->head)) != 0)) {
 		http_entity_set_data(&req->data, NULL, 0);
 		return (rv);
 	}
@@ -397,15 +626,18 @@ nni_http_res_copy_data(nni_http_res *res, const void *data, size_t size)
 	int rv;
 
 	if (((rv = http_entity_copy_data(&res->data, data, size)) != 0) ||
-	    ((rv = http_set_content_length(&res->data, &res->hdrs)) != 0)) {
+	    ((rv = http_set_content_length(&res->data, &res->head)) != 0)) {
 		http_entity_set_data(&res->data, NULL, 0);
 		return (rv);
 	}
 	return (0);
 }
 
+// http_parse_header splits a header line, which has been terminated in
+// place in the connection's read buffer, and copies the name and value
+// into the arena.
 static int
-http_parse_header(nni_list *hdrs, void *line)
+http_parse_header(http_head *head, void *line)
 {
 	char *key = line;
 	char *val;
@@ -429,121 +661,136 @@ http_parse_header(nni_list *hdrs, void *line)
 		end--;
 	}
 
-	return (http_add_header(hdrs, key, val));
+	head->nparsed++;
+	head->parsedsz += strlen(key) + (size_t)(end - val) + 1;
+	if ((head->nparsed > HTTP_MAX_HEADERS) ||
+	    (head->parsedsz > HTTP_MAX_HEADER_SIZE)) {
+		return (NNG_EMSGSIZE);
+	}
+	return (http_add_header(head, key, val));
 }
 
-// http_sprintf_headers makes headers for an HTTP request or an HTTP response
-// object.  Each header is dumped from the list. If the buf is NULL,
-// or the sz is 0, then a dryrun is done, in order to allow the caller to
-// determine how much space is needed. Returns the size of the space needed,
-// not including the terminating NULL byte.  Truncation occurs if the size
-// returned is >= the requested size.
+// http_headers_len returns the length of the header block, not including
+// the blank line that ends it.
 static size_t
-http_sprintf_headers(char *buf, size_t sz, nni_list *list)
+http_headers_len(http_head *head)
 {
-	size_t       rv = 0;
-	http_header *h;
+	size_t len = 0;
 
-	if (buf == NULL) {
-		sz = 0;
+	for (size_t i = 0; i < head->nhdrs; i++) {
+		len += head->hdrs[i].namelen + head->hdrs[i].vallen + 4;
 	}
+	return (len);
+}
 
-	NNI_LIST_FOREACH (list, h) {
-		size_t l;
-		l = snprintf(buf, sz, "%s: %s\r\n", h->name, h->value);
-		if (buf != NULL) {
-			buf += l;
-		}
-		sz = (sz > l) ? sz - l : 0;
-		rv += l;
+static char *
+http_put(char *buf, const char *s, size_t len)
+{
+	memcpy(buf, s, len);
+	return (buf + len);
+}
+
+static char *
+http_put_headers(char *buf, http_head *head)
+{
+	for (size_t i = 0; i < head->nhdrs; i++) {
+		http_header *h = &head->hdrs[i];
+		buf            = http_put(buf, h->name, h->namelen);
+		buf            = http_put(buf, ": ", 2);
+		buf            = http_put(buf, h->value, h->vallen);
+		buf            = http_put(buf, "\r\n", 2);
 	}
-	return (rv);
+	return (buf);
 }
 
+// http_serialize writes the start line, made of the three words given,
+// and the headers into the message's buffer.  The buffer is kept from
+// one message to the next, and only grows, so that a message that is
+// reused does not allocate here once it has seen its largest header.
 static int
-http_asprintf(char **bufp, size_t *szp, nni_list *hdrs, const char *fmt, ...)
+http_serialize(char **bufp, size_t *szp, size_t *lenp, http_head *head,
+    const char *w1, const char *w2, const char *w3)
 {
-	va_list ap;
-	size_t  len;
-	size_t  n;
-	char *  buf;
-
-	va_start(ap, fmt);
-	len = vsnprintf(NULL, 0, fmt, ap);
-	va_end(ap);
-
-	len += http_sprintf_headers(NULL, 0, hdrs);
-	len += 5; // \r\n\r\n\0
-
-	if (len <= *szp) {
-		buf = *bufp;
-	} else {
-		if ((buf = nni_alloc(len)) == NULL) {
+	size_t l1  = strlen(w1);
+	size_t l2  = strlen(w2);
+	size_t l3  = strlen(w3);
+	size_t len = l1 + l2 + l3 + 4 + http_headers_len(head) + 2;
+	char * buf;
+
+	if (len >= *szp) {
+		size_t sz = (*szp != 0) ? *szp * 2 : HTTP_ARENA_SIZE;
+		while (sz <= len) {
+			sz *= 2;
+		}
+		if ((buf = nni_alloc(sz)) == NULL) {
 			return (NNG_ENOMEM);
 		}
-		nni_free(*bufp, *szp);
+		if (*szp != 0) {
+			nni_free(*bufp, *szp);
+		}
 		*bufp = buf;
-		*szp  = len;
-	}
-	va_start(ap, fmt);
-	n = vsnprintf(buf, len, fmt, ap);
-	va_end(ap);
-	buf += n;
-	len -= n;
-	n = http_sprintf_headers(buf, len, hdrs);
-	buf += n;
-	len -= n;
-	snprintf(buf, len, "\r\n");
+		*szp  = sz;
+	}
+	buf = *bufp;
+	buf = http_put(buf, w1, l1);
+	buf = http_put(buf, " ", 1);
+	buf = http_put(buf, w2, l2);
+	buf = http_put(buf, " ", 1);
+	buf = http_put(buf, w3, l3);
+	buf = http_put(buf, "\r\n", 2);
+	buf = http_put_headers(buf, head);
+	buf = http_put(buf, "\r\n", 2);
+	*buf  = '\0';
+	*lenp = len;
 	return (0);
 }
 
 static int
 http_req_prepare(nni_http_req *req)
 {
-	int rv;
 	if (req->uri == NULL) {
 		return (NNG_EINVAL);
 	}
-	rv = http_asprintf(&req->buf, &req->bufsz, &req->hdrs, "%s %s %s\r\n",
-	    req->meth != NULL ? req->meth : "GET", req->uri,
-	    req->vers != NULL ? req->vers : "HTTP/1.1");
-	return (rv);
+	return (http_serialize(&req->buf, &req->bufsz, &req->buflen,
+	    &req->head, nni_http_req_get_method(req), req->uri,
+	    nni_http_req_get_version(req)));
 }
 
 static int
 http_res_prepare(nni_http_res *res)
 {
-	int rv;
-	rv = http_asprintf(&res->buf, &res->bufsz, &res->hdrs, "%s %d %s\r\n",
-	    nni_http_res_get_version(res), nni_http_res_get_status(res),
-	    nni_http_res_get_reason(res));
-	return (rv);
+	char code[8];
+
+	(void) snprintf(
+	    code, sizeof(code), "%d", nni_http_res_get_status(res));
+	return (http_serialize(&res->buf, &res->bufsz, &res->buflen,
+	    &res->head, nni_http_res_get_version(res), code,
+	    nni_http_res_get_reason(res)));
 }
 
-char *
-nni_http_req_headers(nni_http_req *req)
+static char *
+http_headers(http_head *head)
 {
 	char * s;
 	size_t len;
 
-	len = http_sprintf_headers(NULL, 0, &req->hdrs) + 1;
-	if ((s = nni_alloc(len)) != NULL) {
-		http_sprintf_headers(s, len, &req->hdrs);
+	len = http_headers_len(head);
+	if ((s = nni_alloc(len + 1)) != NULL) {
+		*http_put_headers(s, head) = '\0';
 	}
 	return (s);
 }
 
 char *
-nni_http_res_headers(nni_http_res *res)
+nni_http_req_headers(nni_http_req *req)
 {
-	char * s;
-	size_t len;
+	return (http_headers(&req->head));
+}
 
-	len = http_sprintf_headers(NULL, 0, &res->hdrs) + 1;
-	if ((s = nni_alloc(len)) != NULL) {
-		http_sprintf_headers(s, len, &res->hdrs);
-	}
-	return (s);
+char *
+nni_http_res_headers(nni_http_res *res)
+{
+	return (http_headers(&res->head));
 }
 
 int
@@ -551,11 +798,11 @@ nni_http_req_get_buf(nni_http_req *req, void **data, size_t *szp)
 {
 	int rv;
 
-	if ((req->buf == NULL) && (rv = http_req_prepare(req)) != 0) {
+	if ((rv = http_req_prepare(req)) != 0) {
 		return (rv);
 	}
 	*data = req->buf;
-	*szp  = strlen(req->buf);
+	*szp  = req->buflen;
 	return (0);
 }
 
@@ -564,11 +811,11 @@ nni_http_res_get_buf(nni_http_res *res, void **data, size_t *szp)
 {
 	int rv;
 
-	if ((res->buf == NULL) && (rv = http_res_prepare(res)) != 0) {
+	if ((rv = http_res_prepare(res)) != 0) {
 		return (rv);
 	}
 	*data = res->buf;
-	*szp  = strlen(res->buf);
+	*szp  = res->buflen;
 	return (0);
 }
 
@@ -579,21 +826,12 @@ nni_http_req_alloc(nni_http_req **reqp, const nni_url *url)
 	if ((req = NNI_ALLOC_STRUCT(req)) == NULL) {
 		return (NNG_ENOMEM);
 	}
-	NNI_LIST_INIT(&req->hdrs, http_header, node);
-	req->buf       = NULL;
-	req->bufsz     = 0;
-	req->data.data = NULL;
-	req->data.size = 0;
-	req->data.own  = false;
-	req->vers      = NULL;
-	req->meth      = NULL;
-	req->uri       = NULL;
 	if (url != NULL) {
 		const char *host;
 		int         rv;
-		if ((req->uri = nni_strdup(url->u_requri)) == NULL) {
-			NNI_FREE_STRUCT(req);
-			return (NNG_ENOMEM);
+		if ((rv = nni_http_req_set_uri(req, url->u_requri)) != 0) {
+			nni_http_req_free(req);
+			return (rv);
 		}
 
 		// Add a Host: header since we know that from the URL. Also,
@@ -620,16 +858,8 @@ nni_http_res_alloc(nni_http_res **resp)
 	if ((res = NNI_ALLOC_STRUCT(res)) == NULL) {
 		return (NNG_ENOMEM);
 	}
-	NNI_LIST_INIT(&res->hdrs, http_header, node);
-	res->buf       = NULL;
-	res->bufsz     = 0;
-	res->data.data = NULL;
-	res->data.size = 0;
-	res->data.own  = false;
-	res->vers      = NULL;
-	res->rsn       = NULL;
-	res->code      = 0;
-	*resp          = res;
+	res->code = NNG_HTTP_STATUS_OK;
+	*resp     = res;
 	return (0);
 }
 
@@ -663,7 +893,7 @@ nni_http_req_set_version(nni_http_req *req, const char *vers)
 	if (strcmp(vers, "HTTP/1.1") == 0) {
 		vers = NULL;
 	}
-	return (http_set_string(&req->vers, vers));
+	return (http_set_string(&req->head.arena, &req->vers, vers));
 }
 
 int
@@ -672,13 +902,13 @@ nni_http_res_set_version(nni_http_res *res, const char *vers)
 	if (strcmp(vers, "HTTP/1.1") == 0) {
 		vers = NULL;
 	}
-	return (http_set_string(&res->vers, vers));
+	return (http_set_string(&res->head.arena, &res->vers, vers));
 }
 
 int
 nni_http_req_set_uri(nni_http_req *req, const char *uri)
 {
-	return (http_set_string(&req->uri, uri));
+	return (http_set_string(&req->head.arena, &req->uri, uri));
 }
 
 int
@@ -687,7 +917,7 @@ nni_http_req_set_method(nni_http_req *req, const char *meth)
 	if (strcmp(meth, "GET") == 0) {
 		meth = NULL;
 	}
-	return (http_set_string(&req->meth, meth));
+	return (http_set_string(&req->head.arena, &req->meth, meth));
 }
 
 int
@@ -803,11 +1033,14 @@ http_res_parse_line(nni_http_res *res, uint8_t *line)
 }
 
 // nni_http_req_parse parses a request (but not any attached entity data).
-// The amount of data consumed is returned in lenp.  Returns zero on
-// success, NNG_EPROTO on parse failure, NNG_EAGAIN if more data is
-// required, or NNG_ENOMEM on memory exhaustion.  Note that lenp may
-// be updated even in the face of errors (esp. NNG_EAGAIN, which is
-// not an error so much as a request for more data.)
+// The lines are split in place in the buffer, which is modified, and the
+// pieces are copied into the request's arena.  The amount of data
+// consumed is returned in lenp.  Returns zero on success, NNG_EPROTO on
+// parse failure, NNG_EAGAIN if more data is required, NNG_EMSGSIZE if
+// the headers are too many or too large, or NNG_ENOMEM on memory
+// exhaustion.  Note that lenp may be updated even in the face of
+// errors (esp. NNG_EAGAIN, which is not an error so much as a request for
+// more data.)
 int
 nni_http_req_parse(nni_http_req *req, void *buf, size_t n, size_t *lenp)
 {
@@ -832,7 +1065,7 @@ nni_http_req_parse(nni_http_req *req, void *buf, size_t n, size_t *lenp)
 		}
 
 		if (req->parsed) {
-			rv = http_parse_header(&req->hdrs, line);
+			rv = http_parse_header(&req->head, line);
 		} else {
 			rv = http_req_parse_line(req, line);
 		}
@@ -869,7 +1102,7 @@ nni_http_res_parse(nni_http_res *res, void *buf, size_t n, size_t *lenp)
 		}
 
 		if (res->parsed) {
-			rv = http_parse_header(&res->hdrs, line);
+			rv = http_parse_header(&res->head, line);
 		} else {
 			rv = http_res_parse_line(res, line);
 		}
@@ -984,7 +1217,7 @@ nni_http_res_set_reason(nni_http_res *res, const char *reason)
 	if (strcmp(reason, http_reason(res->code)) == 0) {
 		reason = NULL;
 	}
-	return (http_set_string(&res->rsn, reason));
+	return (http_set_string(&res->head.arena, &res->rsn, reason));
 }
 
 int
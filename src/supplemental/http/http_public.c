@@ -401,6 +401,19 @@ nng_http_conn_read_all(nng_http_conn *conn, nng_aio *aio)
 #endif
 }
 
+void
+nng_http_conn_read_chunk(nng_http_conn *conn, nng_aio *aio)
+{
+#ifdef NNG_SUPP_HTTP
+	nni_http_read_chunk(conn, aio);
+#else
+	NNI_ARG_UNUSED(conn);
+	if (nni_aio_start(aio, NULL, NULL) == 0) {
+		nni_aio_finish_error(aio, NNG_ENOTSUP);
+	}
+#endif
+}
+
 void
 nng_http_conn_write(nng_http_conn *conn, nng_aio *aio)
 {
@@ -425,6 +438,19 @@ nng_http_conn_write_all(nng_http_conn *conn, nng_aio *aio)
 #endif
 }
 
+void
+nng_http_conn_write_chunk(nng_http_conn *conn, nng_aio *aio)
+{
+#ifdef NNG_SUPP_HTTP
+	nni_http_write_chunk(conn, aio);
+#else
+	NNI_ARG_UNUSED(conn);
+	if (nni_aio_start(aio, NULL, NULL) == 0) {
+		nni_aio_finish_error(aio, NNG_ENOTSUP);
+	}
+#endif
+}
+
 void
 nng_http_conn_write_req(nng_http_conn *conn, nng_http_req *req, nng_aio *aio)
 {
@@ -574,6 +600,17 @@ nng_http_handler_set_host(nng_http_handler *h, const char *host)
 #endif
 }
 
+int
+nng_http_handler_set_tree(nng_http_handler *h)
+{
+#ifdef NNG_SUPP_HTTP
+	return (nni_http_handler_set_tree(h));
+#else
+	NNI_ARG_UNUSED(h);
+	return (NNG_ENOTSUP);
+#endif
+}
+
 int
 nng_http_handler_set_data(nng_http_handler *h, void *dat, void (*dtor)(void *))
 {
@@ -588,7 +625,7 @@ nng_http_handler_set_data(nng_http_handler *h, void *dat, void (*dtor)(void *))
 }
 
 void *
-nng_handler_get_data(nng_http_handler *h)
+nng_http_handler_get_data(nng_http_handler *h)
 {
 #ifdef NNG_SUPP_HTTP
 	return (nni_http_handler_get_data(h));
@@ -29,17 +29,622 @@ static nni_initializer http_server_initializer = {
 };
 
 struct nng_http_handler {
-	nni_list_node node;
-	char *        path;
-	char *        method;
-	char *        host;
-	bool          tree;
-	int           refcnt;
-	void *        data;
-	nni_cb        dtor;
+	char *   path;
+	char *   method;
+	char *   host;
+	bool     tree;
+	uint32_t refcnt; // atomic, owner, routers and requests
+	void *   data;
+	nni_cb   dtor;
 	void (*cb)(nni_aio *);
 };
 
+// Handlers are found with a tree of path segments.  Each node carries
+// the handlers registered for its path, which make a small map from
+// method to handler.  There is a tree for each virtual host, and one
+// for handlers without a host, which is searched when the host's own
+// tree has nothing for the request.
+//
+// The trees are never modified once published.  Adding or removing a
+// handler copies the nodes on the way to the handler's node, sharing
+// the rest, and publishes a new router.  Requests are routed without
+// the server lock, so routers that lookups might still be using are
+// only freed once those lookups are done (see http_server_reclaim).
+// Nodes, and the reference counts on them, are only touched with the
+// server lock held.
+typedef struct http_route http_route;
+struct http_route {
+	char *             seg;    // path segment, NULL for the root
+	int                refcnt; // parents sharing this node
+	size_t             nchild;
+	http_route **      child; // sorted by segment
+	size_t             nhandler;
+	nni_http_handler **handler;
+};
+
+typedef struct http_router {
+	nni_list_node node;  // on the server's retired list
+	uint32_t      epoch; // when it was retired
+	size_t        nhost; // virtual hosts
+	char **       hosts; // sorted, ignoring case
+	http_route ** roots;
+	http_route *  any; // handlers for any host
+} http_router;
+
+static void
+http_handler_hold(nni_http_handler *h)
+{
+	nni_plat_atomic_add32(&h->refcnt, 1);
+}
+
+// http_handler_rele drops a reference.  A handler belongs to the server
+// while it is registered, and to the caller otherwise, and the owner's
+// reference is normally the last one, so that it is what frees it.
+static void
+http_handler_rele(nni_http_handler *h)
+{
+	nni_http_handler_fini(h);
+}
+
+static bool
+http_handler_samemeth(nni_http_handler *h1, nni_http_handler *h2)
+{
+	if ((h1->method == NULL) || (h2->method == NULL)) {
+		return (h1->method == h2->method);
+	}
+	return (strcmp(h1->method, h2->method) == 0);
+}
+
+// http_route_seg returns the next segment of the path, skipping empty
+// ones, and advances the path past it.  It returns NULL at the end.
+static const char *
+http_route_seg(const char **pathp, size_t *lenp)
+{
+	const char *seg = *pathp;
+
+	while (*seg == '/') {
+		seg++;
+	}
+	if (*seg == '\0') {
+		return (NULL);
+	}
+	*lenp  = strcspn(seg, "/");
+	*pathp = seg + *lenp;
+	return (seg);
+}
+
+// http_route_find looks for the child with the segment.  If there is
+// none, *idxp is where it belongs.
+static http_route *
+http_route_find(http_route *r, const char *seg, size_t len, size_t *idxp)
+{
+	size_t lo = 0;
+	size_t hi = r->nchild;
+
+	while (lo < hi) {
+		size_t      mid = (lo + hi) / 2;
+		const char *s   = r->child[mid]->seg;
+		int         rv;
+
+		if ((rv = strncmp(s, seg, len)) == 0) {
+			if (s[len] == '\0') {
+				*idxp = mid;
+				return (r->child[mid]);
+			}
+			rv = 1;
+		}
+		if (rv < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*idxp = lo;
+	return (NULL);
+}
+
+static void
+http_route_rele(http_route *r)
+{
+	if ((r == NULL) || (--r->refcnt != 0)) {
+		return;
+	}
+	for (size_t i = 0; i < r->nchild; i++) {
+		http_route_rele(r->child[i]);
+	}
+	for (size_t i = 0; i < r->nhandler; i++) {
+		http_handler_rele(r->handler[i]);
+	}
+	NNI_FREE_STRUCTS(r->child, r->nchild);
+	NNI_FREE_STRUCTS(r->handler, r->nhandler);
+	nni_strfree(r->seg);
+	NNI_FREE_STRUCT(r);
+}
+
+// http_route_copy makes a private copy of the node, sharing its children
+// and handlers.  If there is no node yet, an empty one is made for the
+// segment.
+static http_route *
+http_route_copy(http_route *old, const char *seg, size_t len)
+{
+	http_route *r;
+
+	if ((r = NNI_ALLOC_STRUCT(r)) == NULL) {
+		return (NULL);
+	}
+	r->refcnt = 1;
+	if ((seg != NULL) && ((r->seg = nni_alloc(len + 1)) == NULL)) {
+		http_route_rele(r);
+		return (NULL);
+	}
+	if (seg != NULL) {
+		memcpy(r->seg, seg, len);
+	}
+	if (old == NULL) {
+		return (r);
+	}
+	if (((old->nchild != 0) &&
+	        ((r->child = NNI_ALLOC_STRUCTS(r->child, old->nchild)) ==
+	            NULL)) ||
+	    ((old->nhandler != 0) &&
+	        ((r->handler = NNI_ALLOC_STRUCTS(
+	              r->handler, old->nhandler)) == NULL))) {
+		NNI_FREE_STRUCTS(r->child, old->nchild);
+		r->child = NULL;
+		http_route_rele(r);
+		return (NULL);
+	}
+	r->nchild   = old->nchild;
+	r->nhandler = old->nhandler;
+	for (size_t i = 0; i < r->nchild; i++) {
+		r->child[i] = old->child[i];
+		r->child[i]->refcnt++;
+	}
+	for (size_t i = 0; i < r->nhandler; i++) {
+		r->handler[i] = old->handler[i];
+		http_handler_hold(r->handler[i]);
+	}
+	return (r);
+}
+
+// http_route_set_child replaces the child at the index with c, inserts
+// c there if ins is set, or removes the child there if c is NULL.  The
+// reference on c is consumed either way.
+static int
+http_route_set_child(http_route *r, size_t idx, bool ins, http_route *c)
+{
+	http_route **child = NULL;
+	size_t       n;
+
+	if ((!ins) && (c != NULL)) {
+		http_route_rele(r->child[idx]);
+		r->child[idx] = c;
+		return (0);
+	}
+	n = ins ? r->nchild + 1 : r->nchild - 1;
+	if ((n != 0) && ((child = NNI_ALLOC_STRUCTS(child, n)) == NULL)) {
+		http_route_rele(c);
+		return (NNG_ENOMEM);
+	}
+	if (ins) {
+		for (size_t i = 0; i < idx; i++) {
+			child[i] = r->child[i];
+		}
+		child[idx] = c;
+		for (size_t i = idx; i < r->nchild; i++) {
+			child[i + 1] = r->child[i];
+		}
+	} else {
+		http_route_rele(r->child[idx]);
+		for (size_t i = 0, j = 0; i < r->nchild; i++) {
+			if (i != idx) {
+				child[j++] = r->child[i];
+			}
+		}
+	}
+	NNI_FREE_STRUCTS(r->child, r->nchild);
+	r->child  = child;
+	r->nchild = n;
+	return (0);
+}
+
+// http_route_set_handler is the same for the handlers of the node,
+// except that it only inserts (at the end) or removes.
+static int
+http_route_set_handler(http_route *r, size_t idx, nni_http_handler *h)
+{
+	nni_http_handler **hv = NULL;
+	size_t             n  = h != NULL ? r->nhandler + 1 : r->nhandler - 1;
+
+	if ((n != 0) && ((hv = NNI_ALLOC_STRUCTS(hv, n)) == NULL)) {
+		return (NNG_ENOMEM);
+	}
+	for (size_t i = 0, j = 0; i < r->nhandler; i++) {
+		if (i != idx) {
+			hv[j++] = r->handler[i];
+		}
+	}
+	if (h != NULL) {
+		hv[n - 1] = h;
+		http_handler_hold(h);
+	} else {
+		http_handler_rele(r->handler[idx]);
+	}
+	NNI_FREE_STRUCTS(r->handler, r->nhandler);
+	r->handler  = hv;
+	r->nhandler = n;
+	return (0);
+}
+
+// http_route_add returns a copy of the tree below old, with the handler
+// added at the node the rest of the path leads to.
+static int
+http_route_add(http_route **rp, http_route *old, const char *seg,
+    size_t len, const char *path, nni_http_handler *h)
+{
+	http_route *r;
+	http_route *c;
+	http_route *oldc;
+	size_t      idx;
+	int         rv;
+
+	if ((r = http_route_copy(old, seg, len)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	if ((seg = http_route_seg(&path, &len)) != NULL) {
+		oldc = http_route_find(r, seg, len, &idx);
+		if ((rv = http_route_add(&c, oldc, seg, len, path, h)) == 0) {
+			rv = http_route_set_child(r, idx, oldc == NULL, c);
+		}
+	} else {
+		rv = http_route_set_handler(r, r->nhandler, h);
+	}
+	if (rv != 0) {
+		http_route_rele(r);
+		return (rv);
+	}
+	*rp = r;
+	return (0);
+}
+
+// http_route_del returns a copy of the tree below old, without the
+// handler.  Nodes left empty are pruned, so the copy may be NULL.
+static int
+http_route_del(
+    http_route **rp, http_route *old, const char *path, nni_http_handler *h)
+{
+	http_route *r;
+	http_route *c;
+	const char *seg;
+	size_t      len;
+	size_t      idx;
+	int         rv;
+
+	if (old == NULL) {
+		return (NNG_ENOENT);
+	}
+	len = (old->seg != NULL) ? strlen(old->seg) : 0;
+	if ((r = http_route_copy(old, old->seg, len)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	if ((seg = http_route_seg(&path, &len)) != NULL) {
+		c = http_route_find(r, seg, len, &idx);
+		if ((rv = http_route_del(&c, c, path, h)) == 0) {
+			rv = http_route_set_child(r, idx, false, c);
+		}
+	} else {
+		rv = NNG_ENOENT;
+		for (idx = 0; idx < r->nhandler; idx++) {
+			if (r->handler[idx] == h) {
+				rv = http_route_set_handler(r, idx, NULL);
+				break;
+			}
+		}
+	}
+	if (rv != 0) {
+		http_route_rele(r);
+		return (rv);
+	}
+	if ((r->nchild == 0) && (r->nhandler == 0)) {
+		http_route_rele(r);
+		r = NULL;
+	}
+	*rp = r;
+	return (0);
+}
+
+// http_route_conflict checks for a handler that would collide with h,
+// which is to go at the end of the path below r.  Handlers collide if
+// their methods are the same, and either they are for the same path,
+// or one is a tree that the other is inside of.
+static bool
+http_route_conflict(http_route *r, const char *path, nni_http_handler *h)
+{
+	const char *seg;
+	size_t      len;
+	size_t      idx;
+
+	while (r != NULL) {
+		bool end = ((seg = http_route_seg(&path, &len)) == NULL);
+		for (size_t i = 0; i < r->nhandler; i++) {
+			nni_http_handler *h2 = r->handler[i];
+			if (((end) || (h2->tree)) &&
+			    (http_handler_samemeth(h, h2))) {
+				return (true);
+			}
+		}
+		if (end) {
+			break;
+		}
+		r = http_route_find(r, seg, len, &idx);
+	}
+	if ((r == NULL) || (!h->tree)) {
+		return (false);
+	}
+	for (size_t i = 0; i < r->nchild; i++) {
+		if (http_route_conflict(r->child[i], "/", h)) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+// http_route_pick chooses from the handlers of a node on the path of the
+// request, which must be trees unless the node is the end of the path.
+// The method has to match, but handlers without one take any method,
+// and GET handlers take HEAD requests too.
+static nni_http_handler *
+http_route_pick(http_route *r, bool end, const char *meth, bool *badmeth)
+{
+	nni_http_handler *any  = NULL;
+	nni_http_handler *head = NULL;
+
+	for (size_t i = 0; i < r->nhandler; i++) {
+		nni_http_handler *h = r->handler[i];
+		if ((!end) && (!h->tree)) {
+			continue;
+		}
+		if ((h->method == NULL) || (h->method[0] == '\0')) {
+			any = h;
+		} else if (strcmp(h->method, meth) == 0) {
+			return (h);
+		} else if ((strcmp(meth, "HEAD") == 0) &&
+		    (strcmp(h->method, "GET") == 0)) {
+			head = h;
+		} else {
+			*badmeth = true;
+		}
+	}
+	return (any != NULL ? any : head);
+}
+
+// http_route_match finds the handler for the path.  The deepest node
+// with a suitable handler wins.
+static nni_http_handler *
+http_route_match(http_route *r, const char *path, const char *meth,
+    bool *badmeth)
+{
+	nni_http_handler *best = NULL;
+	nni_http_handler *h;
+	const char *      seg;
+	size_t            len;
+	size_t            idx;
+
+	while (r != NULL) {
+		bool end = ((seg = http_route_seg(&path, &len)) == NULL);
+		if ((h = http_route_pick(r, end, meth, badmeth)) != NULL) {
+			best = h;
+		}
+		if (end) {
+			break;
+		}
+		r = http_route_find(r, seg, len, &idx);
+	}
+	return (best);
+}
+
+// http_router_host finds the tree for the host, or where it belongs.
+// The host may have a port number, or a trailing dot, which are
+// ignored.  (IPv6 addresses need not match, but should not be used
+// for virtual hosts anyway.)
+static http_route **
+http_router_host(http_router *rt, const char *host, size_t *idxp)
+{
+	size_t len = strcspn(host, ":");
+	size_t lo  = 0;
+	size_t hi  = rt->nhost;
+
+	if ((len > 0) && (host[len - 1] == '.')) {
+		len--;
+	}
+	while (lo < hi) {
+		size_t      mid = (lo + hi) / 2;
+		const char *s   = rt->hosts[mid];
+		int         rv;
+
+		if ((rv = nni_strncasecmp(s, host, len)) == 0) {
+			if (s[len] == '\0') {
+				*idxp = mid;
+				return (&rt->roots[mid]);
+			}
+			rv = 1;
+		}
+		if (rv < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*idxp = lo;
+	return (NULL);
+}
+
+// http_router_root returns the tree for the host, or for any host.
+static http_route *
+http_router_root(http_router *rt, const char *host)
+{
+	http_route **rp;
+	size_t       idx;
+
+	if (rt == NULL) {
+		return (NULL);
+	}
+	if (host == NULL) {
+		return (rt->any);
+	}
+	rp = http_router_host(rt, host, &idx);
+	return (rp != NULL ? *rp : NULL);
+}
+
+static nni_http_handler *
+http_router_match(http_router *rt, const char *host, const char *path,
+    const char *meth, bool *badmeth)
+{
+	nni_http_handler *h = NULL;
+	http_route **     rp;
+	size_t            idx;
+
+	if (rt == NULL) {
+		return (NULL);
+	}
+	// HTTP/1.0 cannot access virtual hosts.
+	if ((host != NULL) &&
+	    ((rp = http_router_host(rt, host, &idx)) != NULL)) {
+		h = http_route_match(*rp, path, meth, badmeth);
+	}
+	if (h == NULL) {
+		h = http_route_match(rt->any, path, meth, badmeth);
+	}
+	return (h);
+}
+
+// http_route_disown drops the server's ownership of the handlers in the
+// tree, when the server is going away.
+static void
+http_route_disown(http_route *r)
+{
+	if (r == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < r->nchild; i++) {
+		http_route_disown(r->child[i]);
+	}
+	for (size_t i = 0; i < r->nhandler; i++) {
+		http_handler_rele(r->handler[i]);
+	}
+}
+
+static void
+http_router_free(http_router *rt)
+{
+	if (rt == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < rt->nhost; i++) {
+		nni_strfree(rt->hosts[i]);
+		http_route_rele(rt->roots[i]);
+	}
+	NNI_FREE_STRUCTS(rt->hosts, rt->nhost);
+	NNI_FREE_STRUCTS(rt->roots, rt->nhost);
+	http_route_rele(rt->any);
+	NNI_FREE_STRUCT(rt);
+}
+
+// http_router_update returns a new router, with the handler added, or
+// removed.  The old router is left as it was.
+static int
+http_router_update(
+    http_router **rtp, http_router *old, nni_http_handler *h, bool add)
+{
+	http_router *rt;
+	http_route * r;
+	http_route * oldr  = NULL;
+	http_route **rp    = NULL;
+	size_t       nold  = 0;
+	size_t       idx   = 0;
+	size_t       n     = 0;
+	bool         fail  = false;
+	int          rv;
+
+	if (old != NULL) {
+		nold = old->nhost;
+		if (h->host == NULL) {
+			oldr = old->any;
+		} else if ((rp = http_router_host(old, h->host, &idx)) !=
+		    NULL) {
+			oldr = *rp;
+		}
+	}
+	if (add) {
+		rv = http_route_add(&r, oldr, NULL, 0, h->path, h);
+	} else {
+		rv = http_route_del(&r, oldr, h->path, h);
+	}
+	if (rv != 0) {
+		return (rv);
+	}
+	if ((rt = NNI_ALLOC_STRUCT(rt)) == NULL) {
+		http_route_rele(r);
+		return (NNG_ENOMEM);
+	}
+	NNI_LIST_NODE_INIT(&rt->node);
+	if (h->host == NULL) {
+		rt->any = r;
+	} else if ((old != NULL) && ((rt->any = old->any) != NULL)) {
+		rt->any->refcnt++;
+	}
+
+	// Copy the virtual hosts, adding the handler's host if it is new,
+	// and dropping it if nothing is left in it.
+	rt->nhost = nold;
+	if (h->host != NULL) {
+		if (rp == NULL) {
+			rt->nhost++;
+		} else if (r == NULL) {
+			rt->nhost--;
+		}
+	}
+	if ((rt->nhost != 0) &&
+	    (((rt->hosts = NNI_ALLOC_STRUCTS(rt->hosts, rt->nhost)) ==
+	         NULL) ||
+	        ((rt->roots = NNI_ALLOC_STRUCTS(rt->roots, rt->nhost)) ==
+	            NULL))) {
+		NNI_FREE_STRUCTS(rt->hosts, rt->nhost);
+		rt->hosts = NULL;
+		rt->nhost = 0;
+		fail      = true;
+	}
+	for (size_t i = 0; (i <= nold) && (n < rt->nhost); i++) {
+		if ((h->host != NULL) && (i == idx)) {
+			// This is where the handler's host goes.
+			if (r != NULL) {
+				rt->hosts[n] = nni_strdup(h->host);
+				rt->roots[n] = r;
+				fail |= (rt->hosts[n++] == NULL);
+				r = NULL;
+			}
+			if (rp != NULL) {
+				continue; // replaced the old one
+			}
+		}
+		if (i < nold) {
+			rt->hosts[n] = nni_strdup(old->hosts[i]);
+			rt->roots[n] = old->roots[i];
+			rt->roots[n]->refcnt++;
+			fail |= (rt->hosts[n++] == NULL);
+		}
+	}
+	if (h->host != NULL) {
+		http_route_rele(r); // only left over if we failed
+	}
+	if (fail) {
+		http_router_free(rt);
+		return (NNG_ENOMEM);
+	}
+	*rtp = rt;
+	return (0);
+}
+
 typedef struct nni_http_ctx {
 	nni_list_node    node;
 	nni_http_conn *  conn;
@@ -61,7 +666,11 @@ struct nng_http_server {
 	nni_list_node    node;
 	int              refcnt;
 	int              starts;
-	nni_list         handlers;
+	http_router *    router;     // atomic, see above
+	nni_list         retired;    // routers lookups may be using
+	uint32_t         nretired;   // atomic
+	uint32_t         epoch;      // atomic, advanced with the lock held
+	uint32_t         lookups[2]; // atomic, in progress, by epoch
 	nni_list         conns;
 	nni_mtx          mtx;
 	nni_cv           cv;
@@ -69,10 +678,44 @@ struct nng_http_server {
 	nng_tls_config * tls;
 	nni_aio *        accaio;
 	nni_plat_tcp_ep *tep;
+	int              listeners;
 	char *           port;
 	char *           hostname;
 };
 
+// http_server_reclaim frees the routers that have been replaced, once
+// the lookups that might have found them are done.  Each lookup counts
+// itself against the epoch it started in, and routers are retired in
+// the current epoch.  A router retired in an earlier epoch can only be
+// in use by lookups counted against the previous one, as the epoch only
+// advances once the counter it reuses has drained.  New lookups use the
+// other counter, so it drains even under constant load.  The lock must
+// be held.
+static void
+http_server_reclaim(nni_http_server *s)
+{
+	http_router *rt;
+	uint32_t     epoch;
+
+	while (!nni_list_empty(&s->retired)) {
+		epoch = nni_plat_atomic_load32(&s->epoch);
+		if (nni_plat_atomic_load32(&s->lookups[~epoch & 1]) != 0) {
+			return;
+		}
+		while (((rt = nni_list_first(&s->retired)) != NULL) &&
+		    (rt->epoch != epoch)) {
+			nni_list_remove(&s->retired, rt);
+			http_router_free(rt);
+			nni_plat_atomic_add32(&s->nretired, -1);
+		}
+		if (rt != NULL) {
+			// Those retired now can go when lookups counted
+			// against this epoch are done.
+			nni_plat_atomic_store32(&s->epoch, epoch + 1);
+		}
+	}
+}
+
 int
 nni_http_handler_init(
     nni_http_handler **hp, const char *path, void (*cb)(nni_aio *))
@@ -82,18 +725,17 @@ nni_http_handler_init(
 	if ((h = NNI_ALLOC_STRUCT(h)) == NULL) {
 		return (NNG_ENOMEM);
 	}
+	h->refcnt = 1; // the caller's
 	if (((h->path = nni_strdup(path)) == NULL) ||
 	    ((h->method = nni_strdup("GET")) == NULL)) {
 		nni_http_handler_fini(h);
 		return (NNG_ENOMEM);
 	}
-	NNI_LIST_NODE_INIT(&h->node);
 	h->cb     = cb;
 	h->data   = NULL;
 	h->dtor   = NULL;
 	h->host   = NULL;
 	h->tree   = false;
-	h->refcnt = 0;
 	*hp       = h;
 	return (0);
 }
@@ -101,7 +743,9 @@ nni_http_handler_init(
 void
 nni_http_handler_fini(nni_http_handler *h)
 {
-	if (h->refcnt != 0) {
+	// This drops the owner's reference, but routers, and requests in
+	// progress, may still have their own.
+	if (nni_plat_atomic_add32(&h->refcnt, -1) != 0) {
 		return;
 	}
 	if (h->dtor != NULL) {
@@ -116,7 +760,7 @@ nni_http_handler_fini(nni_http_handler *h)
 int
 nni_http_handler_set_data(nni_http_handler *h, void *data, nni_cb dtor)
 {
-	if (h->refcnt != 0) {
+	if (nni_plat_atomic_load32(&h->refcnt) != 1) {
 		return (NNG_EBUSY);
 	}
 	h->data = data;
@@ -139,7 +783,7 @@ nni_http_handler_get_uri(nni_http_handler *h)
 int
 nni_http_handler_set_tree(nni_http_handler *h)
 {
-	if (h->refcnt != 0) {
+	if (nni_plat_atomic_load32(&h->refcnt) != 1) {
 		return (NNG_EBUSY);
 	}
 	h->tree = true;
@@ -150,7 +794,7 @@ int
 nni_http_handler_set_host(nni_http_handler *h, const char *host)
 {
 	char *duphost;
-	if (h->refcnt != 0) {
+	if (nni_plat_atomic_load32(&h->refcnt) != 1) {
 		return (NNG_EBUSY);
 	}
 	if (host == NULL) {
@@ -170,7 +814,7 @@ int
 nni_http_handler_set_method(nni_http_handler *h, const char *method)
 {
 	char *dupmeth;
-	if (h->refcnt != 0) {
+	if (nni_plat_atomic_load32(&h->refcnt) != 1) {
 		return (NNG_EBUSY);
 	}
 	if (method == NULL) {
@@ -437,8 +1081,7 @@ http_sconn_rxdone(void *arg)
 	nni_http_server * s   = sc->server;
 	nni_aio *         aio = sc->rxaio;
 	int               rv;
-	nni_http_handler *h    = NULL;
-	nni_http_handler *head = NULL;
+	nni_http_handler *h   = NULL;
 	const char *      val;
 	nni_http_req *    req = sc->req;
 	char *            uri;
@@ -447,6 +1090,7 @@ http_sconn_rxdone(void *arg)
 	bool              badmeth  = false;
 	bool              needhost = false;
 	const char *      host;
+	uint32_t          epoch;
 
 	if ((rv = nni_aio_result(aio)) != 0) {
 		http_sconn_close(sc);
@@ -505,76 +1149,24 @@ http_sconn_rxdone(void *arg)
 		return;
 	}
 
-	nni_mtx_lock(&s->mtx);
-	NNI_LIST_FOREACH (&s->handlers, h) {
-		size_t len;
-		if (h->host != NULL) {
-			if (host == NULL) {
-				// HTTP/1.0 cannot access virtual hosts.
-				continue;
-			}
-
-			len = strlen(h->host);
-			if ((nni_strncasecmp(host, h->host, len) != 0)) {
-				continue;
-			}
-
-			// At least the first part matches.  If the ending
-			// part is a lone "." (legal in DNS), or a port
-			// number, we match it.  (We do not validate the
-			// port number.)  Note that there may be false matches
-			// with IPv6 addresses, but addresses shouldn't be
-			// used with virtual hosts anyway.  With both addresses
-			// and ports, a false match would be unlikely since
-			// they'd still have to *connect* using that info.
-			if ((host[len] != '\0') && (host[len] != ':') &&
-			    ((host[len] != '.') || (host[len + 1] != '\0'))) {
-				continue;
-			}
-		}
-
-		len = strlen(h->path);
-		if (strncmp(path, h->path, len) != 0) {
-			continue;
-		}
-		switch (path[len]) {
-		case '\0':
-			break;
-		case '/':
-			if ((path[len + 1] != '\0') && (!h->tree)) {
-				// Trailing component and not a directory.
-				continue;
-			}
-			break;
-		default:
-			continue; // Some other substring, not matched.
-		}
-
-		if ((h->method == NULL) || (h->method[0] == '\0')) {
-			// Handler wants to process *all* methods.
-			break;
-		}
-		// So, what about the method?
-		val = nni_http_req_get_method(req);
-		if (strcmp(val, h->method) == 0) {
-			break;
-		}
-		// HEAD is remapped to GET, but only if no HEAD specific
-		// handler registered.
-		if ((strcmp(val, "HEAD") == 0) &&
-		    (strcmp(h->method, "GET") == 0)) {
-			head = h;
-			continue;
-		}
-		badmeth = 1;
+	// Find the handler, and take a hold on it, without the server lock.
+	// The router cannot be freed while we are counted as looking.
+	epoch = nni_plat_atomic_load32(&s->epoch) & 1;
+	nni_plat_atomic_add32(&s->lookups[epoch], 1);
+	h = http_router_match(nni_plat_atomic_load_ptr((void **) &s->router),
+	    host, path, nni_http_req_get_method(req), &badmeth);
+	if (h != NULL) {
+		http_handler_hold(h);
 	}
-
-	if ((h == NULL) && (head != NULL)) {
-		h = head;
+	if ((nni_plat_atomic_add32(&s->lookups[epoch], -1) == 0) &&
+	    (nni_plat_atomic_load32(&s->nretired) != 0)) {
+		nni_mtx_lock(&s->mtx);
+		http_server_reclaim(s);
+		nni_mtx_unlock(&s->mtx);
 	}
 	nni_free(uri, urisz);
+
 	if (h == NULL) {
-		nni_mtx_unlock(&s->mtx);
 		if (badmeth) {
 			http_sconn_error(
 			    sc, NNG_HTTP_STATUS_METHOD_NOT_ALLOWED);
@@ -592,12 +1184,10 @@ http_sconn_rxdone(void *arg)
 	// start, but we do it instead.
 
 	if (nni_aio_start(sc->cbaio, NULL, NULL) != 0) {
-		nni_mtx_unlock(&s->mtx);
+		http_handler_rele(h);
 		return;
 	}
 	nni_aio_set_data(sc->cbaio, 1, h);
-	h->refcnt++;
-	nni_mtx_unlock(&s->mtx);
 	h->cb(sc->cbaio);
 }
 
@@ -608,7 +1198,9 @@ http_sconn_cbdone(void *arg)
 	nni_aio *         aio = sc->cbaio;
 	nni_http_res *    res;
 	nni_http_handler *h;
-	nni_http_server * s = sc->server;
+
+	h = nni_aio_get_data(aio, 1);
+	http_handler_rele(h);
 
 	if (nni_aio_result(aio) != 0) {
 		// Hard close, no further feedback.
@@ -616,16 +1208,8 @@ http_sconn_cbdone(void *arg)
 		return;
 	}
 
-	h   = nni_aio_get_data(aio, 1);
 	res = nni_aio_get_output(aio, 0);
 
-	nni_mtx_lock(&s->mtx);
-	h->refcnt--;
-	if (h->refcnt == 0) {
-		nni_http_handler_fini(h);
-	}
-	nni_mtx_unlock(&s->mtx);
-
 	// If its an upgrader, and they didn't give us back a response,
 	// it means that they took over, and we should just discard
 	// this session, without closing the underlying channel.
@@ -745,8 +1329,6 @@ http_server_acccb(void *arg)
 static void
 http_server_fini(nni_http_server *s)
 {
-	nni_http_handler *h;
-
 	nni_aio_stop(s->accaio);
 
 	nni_mtx_lock(&s->mtx);
@@ -756,11 +1338,16 @@ http_server_fini(nni_http_server *s)
 	if (s->tep != NULL) {
 		nni_plat_tcp_ep_fini(s->tep);
 	}
-	while ((h = nni_list_first(&s->handlers)) != NULL) {
-		nni_list_remove(&s->handlers, h);
-		h->refcnt--;
-		nni_http_handler_fini(h);
+	// Handlers still registered belong to us, so they go too.
+	if (s->router != NULL) {
+		for (size_t i = 0; i < s->router->nhost; i++) {
+			http_route_disown(s->router->roots[i]);
+		}
+		http_route_disown(s->router->any);
 	}
+	http_router_free(s->router);
+	s->router = NULL;
+	http_server_reclaim(s);
 	nni_mtx_unlock(&s->mtx);
 #ifdef NNG_SUPP_TLS
 	if (s->tls != NULL) {
@@ -807,8 +1394,9 @@ http_server_init(nni_http_server **serverp, const nni_url *url)
 	}
 	nni_mtx_init(&s->mtx);
 	nni_cv_init(&s->cv, &s->mtx);
-	NNI_LIST_INIT(&s->handlers, nni_http_handler, node);
+	NNI_LIST_INIT(&s->retired, http_router, node);
 	NNI_LIST_INIT(&s->conns, http_sconn, node);
+	s->listeners = 1;
 	if ((rv = nni_aio_init(&s->accaio, http_server_acccb, s)) != 0) {
 		http_server_fini(s);
 		return (rv);
@@ -895,7 +1483,8 @@ http_server_start(nni_http_server *s)
 	if (rv != 0) {
 		return (rv);
 	}
-	if ((rv = nni_plat_tcp_ep_listen(s->tep, NULL)) != 0) {
+	rv = nni_plat_tcp_ep_set_listeners(s->tep, s->listeners);
+	if ((rv != 0) || ((rv = nni_plat_tcp_ep_listen(s->tep, NULL)) != 0)) {
 		nni_plat_tcp_ep_fini(s->tep);
 		s->tep = NULL;
 		return (rv);
@@ -954,96 +1543,54 @@ nni_http_server_stop(nni_http_server *s)
 	nni_mtx_unlock(&s->mtx);
 }
 
-int
-nni_http_server_add_handler(nni_http_server *s, nni_http_handler *h)
+// http_server_route publishes a new router with the handler added or
+// removed.  The old one is retired, since lookups may be using it.
+static int
+http_server_route(nni_http_server *s, nni_http_handler *h, bool add)
 {
-	nni_http_handler *h2;
-	size_t            len;
+	http_router *old;
+	http_router *rt;
+	int          rv;
 
-	// Must have a legal method (and not one that is HEAD), path,
-	// and handler.  (The reason HEAD is verboten is that we supply
-	// it automatically as part of GET support.)
-	if (((len = strlen(h->path)) == 0) || (h->path[0] != '/') ||
-	    (h->cb == NULL)) {
-		return (NNG_EINVAL);
+	nni_mtx_lock(&s->mtx);
+	old = s->router;
+	if (add && http_route_conflict(http_router_root(old, h->host), h->path,
+	               h)) {
+		nni_mtx_unlock(&s->mtx);
+		return (NNG_EADDRINUSE);
 	}
-	while ((len > 0) && (h->path[len - 1] == '/')) {
-		len--; // ignore trailing '/' (this collapses them)
+	if ((rv = http_router_update(&rt, old, h, add)) != 0) {
+		nni_mtx_unlock(&s->mtx);
+		return (rv);
 	}
-
-	nni_mtx_lock(&s->mtx);
-	// General rule for finding a conflict is that if either string
-	// is a strict substring of the other, then we have a
-	// collision.  (But only if the methods match, and the host
-	// matches.)  Note that a wild card host matches both.
-	NNI_LIST_FOREACH (&s->handlers, h2) {
-		size_t len2;
-
-		if ((h2->host != NULL) && (h->host != NULL) &&
-		    (nni_strcasecmp(h2->host, h->host) != 0)) {
-			// Hosts don't match, so we are safe.
-			continue;
-		}
-		if (((h2->host == NULL) && (h->host != NULL)) ||
-		    ((h->host == NULL) && (h2->host != NULL))) {
-			continue; // Host specified for just one.
-		}
-		if (((h->method == NULL) && (h2->method != NULL)) ||
-		    ((h2->method == NULL) && (h->method != NULL))) {
-			continue; // Method specified for just one.
-		}
-		if ((h->method != NULL) &&
-		    (strcmp(h2->method, h->method) != 0)) {
-			// Different methods, so again we are fine.
-			continue;
-		}
-
-		len2 = strlen(h2->path);
-
-		while ((len2 > 0) && (h2->path[len2 - 1] == '/')) {
-			len2--; // ignore trailing '/'
-		}
-		if (strncmp(h->path, h2->path, len > len2 ? len2 : len) != 0) {
-			continue; // prefixes don't match.
-		}
-
-		if (len2 > len) {
-			if ((h2->path[len] == '/') && (h->tree)) {
-				nni_mtx_unlock(&s->mtx);
-				return (NNG_EADDRINUSE);
-			}
-		} else if (len > len2) {
-			if ((h->path[len2] == '/') && (h2->tree)) {
-				nni_mtx_unlock(&s->mtx);
-				return (NNG_EADDRINUSE);
-			}
-		} else {
-			nni_mtx_unlock(&s->mtx);
-			return (NNG_EADDRINUSE);
-		}
+	nni_plat_atomic_store_ptr((void **) &s->router, rt);
+	if (old != NULL) {
+		old->epoch = s->epoch;
+		nni_list_append(&s->retired, old);
+		nni_plat_atomic_add32(&s->nretired, 1);
 	}
-	h->refcnt = 1;
-	nni_list_append(&s->handlers, h);
+	http_server_reclaim(s);
 	nni_mtx_unlock(&s->mtx);
 	return (0);
 }
 
 int
-nni_http_server_del_handler(nni_http_server *s, nni_http_handler *h)
+nni_http_server_add_handler(nni_http_server *s, nni_http_handler *h)
 {
-	int               rv = NNG_ENOENT;
-	nni_http_handler *srch;
-	nni_mtx_lock(&s->mtx);
-	NNI_LIST_FOREACH (&s->handlers, srch) {
-		if (srch == h) {
-			nni_list_remove(&s->handlers, h);
-			h->refcnt--;
-			rv = 0;
-			break;
-		}
+	// Must have a legal path, and handler.  Handlers collide if they
+	// are for the same host (or both for any host) and method, and
+	// either the same path, or one is a tree containing the other.
+	// Trailing and repeated '/' characters are not significant.
+	if ((strlen(h->path) == 0) || (h->path[0] != '/') || (h->cb == NULL)) {
+		return (NNG_EINVAL);
 	}
-	nni_mtx_unlock(&s->mtx);
-	return (rv);
+	return (http_server_route(s, h, true));
+}
+
+int
+nni_http_server_del_handler(nni_http_server *s, nni_http_handler *h)
+{
+	return (http_server_route(s, h, false));
 }
 
 // Very limited MIME type map.  Used only if the handler does not
@@ -1474,6 +2021,22 @@ nni_http_handler_init_static(nni_http_handler **hpp, const char *uri,
 	return (0);
 }
 
+int
+nni_http_server_set_listeners(nni_http_server *s, int n)
+{
+	if ((n < 1) || (n > NNI_PLAT_TCP_MAX_LISTENERS)) {
+		return (NNG_EINVAL);
+	}
+	nni_mtx_lock(&s->mtx);
+	if (s->starts) {
+		nni_mtx_unlock(&s->mtx);
+		return (NNG_EBUSY);
+	}
+	s->listeners = n;
+	nni_mtx_unlock(&s->mtx);
+	return (0);
+}
+
 int
 nni_http_server_set_tls(nni_http_server *s, nng_tls_config *tcfg)
 {
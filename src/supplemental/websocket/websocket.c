@@ -1711,6 +1711,16 @@ nni_ws_listener_set_tls(nni_ws_listener *l, nng_tls_config *tls)
 	return (rv);
 }
 
+int
+nni_ws_listener_set_listeners(nni_ws_listener *l, int n)
+{
+	int rv;
+	nni_mtx_lock(&l->mtx);
+	rv = nni_http_server_set_listeners(l->server, n);
+	nni_mtx_unlock(&l->mtx);
+	return (rv);
+}
+
 int
 nni_ws_listener_get_tls(nni_ws_listener *l, nng_tls_config **tlsp)
 {
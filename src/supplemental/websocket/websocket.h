@@ -35,6 +35,7 @@ extern void nni_ws_listener_hook(
     nni_ws_listener *, nni_ws_listen_hook, void *);
 extern int nni_ws_listener_set_tls(nni_ws_listener *, nng_tls_config *);
 extern int nni_ws_listener_get_tls(nni_ws_listener *, nng_tls_config **s);
+extern int nni_ws_listener_set_listeners(nni_ws_listener *, int);
 
 extern int  nni_ws_dialer_init(nni_ws_dialer **, nni_url *);
 extern void nni_ws_dialer_fini(nni_ws_dialer *);
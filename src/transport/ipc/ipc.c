@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include "core/nng_impl.h"
+#include "transport/ipc/ipc.h"
 
 // IPC transport.   Platform specific IPC operations must be
 // supplied as well.  Normally the IPC is UNIX domain sockets or
@@ -28,6 +29,10 @@ struct nni_ipc_pipe {
 	uint16_t           peer;
 	uint16_t           proto;
 	size_t             rcvmax;
+	size_t             fdmin;
+	int                txfd;
+	int                rxfd;
+	bool               peerfd; // peer accepts message type 2
 	nni_sockaddr       sa;
 
 	uint8_t txhead[1 + sizeof(uint64_t)];
@@ -45,6 +50,19 @@ struct nni_ipc_pipe {
 	nni_aio *negaio;
 	nni_msg *rxmsg;
 	nni_mtx  mtx;
+
+	// Send batching (NNG_OPT_SEND_BATCH), as for TCP.  Messages passed
+	// as descriptors are never batched.
+	size_t       batchmax;
+	nni_duration batchtime;
+	uint8_t *    batchbuf;
+	size_t       batchlen;
+	uint8_t *    txbuf;   // batch being written
+	bool         txbusy;  // txaio is in use
+	bool         txbatch; // txaio is writing txbuf
+	int          txerr;   // a batch failed to write
+	nni_aio *    tmaio;
+	bool         tmbusy;
 };
 
 struct nni_ipc_ep {
@@ -52,12 +70,16 @@ struct nni_ipc_ep {
 	nni_plat_ipc_ep *iep;
 	uint16_t         proto;
 	size_t           rcvmax;
+	size_t           fdmin;
+	size_t           batchmax;
+	nni_duration     batchtime;
 	nni_aio *        aio;
 	nni_aio *        user_aio;
 	nni_mtx          mtx;
 };
 
 static void nni_ipc_pipe_send_cb(void *);
+static void nni_ipc_pipe_timer_cb(void *);
 static void nni_ipc_pipe_recv_cb(void *);
 static void nni_ipc_pipe_nego_cb(void *);
 static void nni_ipc_ep_cb(void *);
@@ -87,10 +109,12 @@ nni_ipc_pipe_fini(void *arg)
 	nni_ipc_pipe *pipe = arg;
 
 	nni_aio_stop(pipe->rxaio);
+	nni_aio_stop(pipe->tmaio);
 	nni_aio_stop(pipe->txaio);
 	nni_aio_stop(pipe->negaio);
 
 	nni_aio_fini(pipe->rxaio);
+	nni_aio_fini(pipe->tmaio);
 	nni_aio_fini(pipe->txaio);
 	nni_aio_fini(pipe->negaio);
 	if (pipe->ipp != NULL) {
@@ -99,6 +123,14 @@ nni_ipc_pipe_fini(void *arg)
 	if (pipe->rxmsg) {
 		nni_msg_free(pipe->rxmsg);
 	}
+	if (pipe->txfd >= 0) {
+		nni_plat_shm_closefd(pipe->txfd);
+	}
+	if (pipe->rxfd >= 0) {
+		nni_plat_shm_closefd(pipe->rxfd);
+	}
+	nni_free(pipe->batchbuf, pipe->batchmax);
+	nni_free(pipe->txbuf, pipe->batchmax);
 	nni_mtx_fini(&pipe->mtx);
 	NNI_FREE_STRUCT(pipe);
 }
@@ -113,8 +145,11 @@ nni_ipc_pipe_init(nni_ipc_pipe **pipep, nni_ipc_ep *ep, void *ipp)
 		return (NNG_ENOMEM);
 	}
 	nni_mtx_init(&p->mtx);
+	p->txfd = -1;
+	p->rxfd = -1;
 	if (((rv = nni_aio_init(&p->txaio, nni_ipc_pipe_send_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->rxaio, nni_ipc_pipe_recv_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->tmaio, nni_ipc_pipe_timer_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->negaio, nni_ipc_pipe_nego_cb, p)) != 0)) {
 		nni_ipc_pipe_fini(p);
 		return (rv);
@@ -122,10 +157,25 @@ nni_ipc_pipe_init(nni_ipc_pipe **pipep, nni_ipc_ep *ep, void *ipp)
 
 	p->proto                    = ep->proto;
 	p->rcvmax                   = ep->rcvmax;
+	p->fdmin                    = ep->fdmin;
 	p->ipp                      = ipp;
 	p->sa.s_un.s_path.sa_family = NNG_AF_IPC;
 	p->sa                       = ep->sa;
 
+	if (ep->batchmax != 0) {
+		p->batchmax = ep->batchmax;
+		if (((p->batchbuf = nni_alloc(p->batchmax)) == NULL) ||
+		    ((p->txbuf = nni_alloc(p->batchmax)) == NULL)) {
+			nni_ipc_pipe_fini(p);
+			return (NNG_ENOMEM);
+		}
+		p->batchtime = ep->batchtime;
+		nni_aio_set_timeout(p->tmaio, p->batchtime);
+	}
+
+	// Collect any descriptor the peer passes us, for message type 2.
+	nni_aio_set_input(p->rxaio, 0, &p->rxfd);
+
 	*pipep = p;
 	return (0);
 }
@@ -176,17 +226,31 @@ nni_ipc_pipe_nego_cb(void *arg)
 		nni_mtx_unlock(&pipe->mtx);
 		return;
 	}
+	if (pipe->txfd >= 0) {
+		// Our token went with the header.
+		nni_plat_shm_closefd(pipe->txfd);
+		pipe->txfd = -1;
+	}
 	if (pipe->gotrxhead < pipe->wantrxhead) {
 		nni_iov iov;
 		iov.iov_len = pipe->wantrxhead - pipe->gotrxhead;
 		iov.iov_buf = &pipe->rxhead[pipe->gotrxhead];
 		nni_aio_set_iov(aio, 1, &iov);
+		nni_aio_set_input(aio, 0, &pipe->rxfd);
 		nni_plat_ipc_pipe_recv(pipe->ipp, aio);
 		nni_mtx_unlock(&pipe->mtx);
 		return;
 	}
-	// We have both sent and received the headers.  Lets check the
-	// receive side header.
+	// We have both sent and received the headers.  If the peer passed
+	// a token with its header, it can take messages by descriptor.
+	nni_aio_set_input(aio, 0, NULL);
+	if (pipe->rxfd >= 0) {
+		nni_plat_shm_closefd(pipe->rxfd);
+		pipe->rxfd   = -1;
+		pipe->peerfd = true;
+	}
+
+	// Lets check the receive side header.
 	if ((pipe->rxhead[0] != 0) || (pipe->rxhead[1] != 'S') ||
 	    (pipe->rxhead[2] != 'P') || (pipe->rxhead[3] != 0) ||
 	    (pipe->rxhead[6] != 0) || (pipe->rxhead[7] != 0)) {
@@ -204,6 +268,98 @@ done:
 	nni_mtx_unlock(&pipe->mtx);
 }
 
+// nni_ipc_pipe_send_msg starts writing the message of the user's aio,
+// along with its descriptor if it has one.  The lock must be held.
+static void
+nni_ipc_pipe_send_msg(nni_ipc_pipe *pipe)
+{
+	nni_msg *msg   = nni_aio_get_msg(pipe->user_txaio);
+	nni_aio *txaio = pipe->txaio;
+	uint64_t len;
+	int      niov;
+	nni_iov  iov[3];
+
+	len = nni_msg_len(msg) + nni_msg_header_len(msg);
+
+	pipe->txhead[0] = 1; // message type, 1.
+	NNI_PUT64(pipe->txhead + 1, len);
+
+	niov           = 0;
+	iov[0].iov_buf = pipe->txhead;
+	iov[0].iov_len = sizeof(pipe->txhead);
+	niov++;
+	if (pipe->txfd >= 0) {
+		// Message type 2, the data goes with the descriptor.
+		pipe->txhead[0] = 2;
+		nni_aio_set_input(txaio, 0, &pipe->txfd);
+	} else {
+		if (nni_msg_header_len(msg) > 0) {
+			iov[niov].iov_buf = nni_msg_header(msg);
+			iov[niov].iov_len = nni_msg_header_len(msg);
+			niov++;
+		}
+		if (nni_msg_len(msg) > 0) {
+			iov[niov].iov_buf = nni_msg_body(msg);
+			iov[niov].iov_len = nni_msg_len(msg);
+			niov++;
+		}
+	}
+	nni_aio_set_iov(txaio, niov, iov);
+
+	pipe->txbusy  = true;
+	pipe->txbatch = false;
+	nni_plat_ipc_pipe_send(pipe->ipp, txaio);
+}
+
+// nni_ipc_pipe_send_batch starts writing the messages batched so far,
+// switching buffers so that more can be batched meanwhile.  Lock held.
+static void
+nni_ipc_pipe_send_batch(nni_ipc_pipe *pipe)
+{
+	uint8_t *buf = pipe->txbuf;
+	nni_iov  iov;
+
+	pipe->txbuf    = pipe->batchbuf;
+	pipe->batchbuf = buf;
+	iov.iov_buf    = pipe->txbuf;
+	iov.iov_len    = pipe->batchlen;
+	pipe->batchlen = 0;
+	nni_aio_set_iov(pipe->txaio, 1, &iov);
+
+	pipe->txbusy  = true;
+	pipe->txbatch = true;
+	nni_plat_ipc_pipe_send(pipe->ipp, pipe->txaio);
+}
+
+// nni_ipc_pipe_send_next starts the next write, if there is anything to
+// write and the last one is done.  Batched messages were accepted before
+// a waiting one, so they go first.  Lock held.
+static void
+nni_ipc_pipe_send_next(nni_ipc_pipe *pipe)
+{
+	if (pipe->txbusy || (pipe->txerr != 0)) {
+		return;
+	}
+	if (pipe->batchlen != 0) {
+		nni_ipc_pipe_send_batch(pipe);
+	} else if (pipe->user_txaio != NULL) {
+		nni_ipc_pipe_send_msg(pipe);
+	}
+}
+
+// nni_ipc_pipe_drop_txfd closes the descriptor of a message that will
+// not be sent after all, or that the peer has its own reference to now.
+// Lock held.
+static void
+nni_ipc_pipe_drop_txfd(nni_ipc_pipe *pipe)
+{
+	if (pipe->txfd >= 0) {
+		nni_plat_shm_closefd(pipe->txfd);
+		pipe->txfd = -1;
+		nni_aio_set_input(pipe->txaio, 0, NULL);
+	}
+}
+
 static void
 nni_ipc_pipe_send_cb(void *arg)
 {
@@ -215,35 +371,85 @@ nni_ipc_pipe_send_cb(void *arg)
 	size_t        n;
 
 	nni_mtx_lock(&pipe->mtx);
-	if ((aio = pipe->user_txaio) == NULL) {
-		nni_mtx_unlock(&pipe->mtx);
-		return;
+	if (!pipe->txbatch) {
+		// Either the peer has its own reference now, or we failed.
+		nni_ipc_pipe_drop_txfd(pipe);
 	}
-
-	if ((rv = nni_aio_result(txaio)) != 0) {
-		pipe->user_txaio = NULL;
-		nni_mtx_unlock(&pipe->mtx);
-		msg = nni_aio_get_msg(aio);
-		nni_aio_set_msg(aio, NULL);
-		nni_msg_free(msg);
-		nni_aio_finish_error(aio, rv);
-		return;
+	if ((rv = nni_aio_result(txaio)) == 0) {
+		n = nni_aio_count(txaio);
+		nni_aio_iov_advance(txaio, n);
+		if (nni_aio_iov_count(txaio) != 0) {
+			nni_plat_ipc_pipe_send(pipe->ipp, txaio);
+			nni_mtx_unlock(&pipe->mtx);
+			return;
+		}
 	}
+	pipe->txbusy = false;
 
-	n = nni_aio_count(txaio);
-	nni_aio_iov_advance(txaio, n);
-	if (nni_aio_iov_count(txaio) != 0) {
-		nni_plat_ipc_pipe_send(pipe->ipp, txaio);
+	if (pipe->txbatch) {
+		// The sends of the batched messages have completed already,
+		// so a failure is reported to the next send instead.
+		if (rv != 0) {
+			pipe->txerr = rv;
+		}
+		nni_ipc_pipe_send_next(pipe);
+		if ((pipe->txerr == 0) || ((aio = pipe->user_txaio) == NULL)) {
+			nni_mtx_unlock(&pipe->mtx);
+			return;
+		}
+		nni_ipc_pipe_drop_txfd(pipe);
+		rv = pipe->txerr;
+	} else if ((aio = pipe->user_txaio) == NULL) {
+		// Canceled.  Anything batched meanwhile still goes out.
+		nni_ipc_pipe_send_next(pipe);
 		nni_mtx_unlock(&pipe->mtx);
 		return;
 	}
 
+	// Clear this before we drop the lock, so that a racing cancel
+	// cannot complete the user aio a second time.
+	pipe->user_txaio = NULL;
+
+	// Messages batched while this one was being written may have
+	// missed their timer, so they must be written now.
+	nni_ipc_pipe_send_next(pipe);
 	nni_mtx_unlock(&pipe->mtx);
 	msg = nni_aio_get_msg(aio);
 	n   = nni_msg_len(msg);
 	nni_aio_set_msg(aio, NULL);
 	nni_msg_free(msg);
-	nni_aio_finish(aio, 0, n);
+	if (rv != 0) {
+		nni_aio_finish_error(aio, rv);
+	} else {
+		nni_aio_finish(aio, 0, n);
+	}
+}
+
+static void
+nni_ipc_pipe_timer_cb(void *arg)
+{
+	nni_ipc_pipe *pipe = arg;
+
+	nni_mtx_lock(&pipe->mtx);
+	if (nni_aio_result(pipe->tmaio) == NNG_ETIMEDOUT) {
+		nni_ipc_pipe_send_next(pipe);
+	}
+	nni_mtx_unlock(&pipe->mtx);
+}
+
+static void
+nni_ipc_cancel_timer(nni_aio *aio, int rv)
+{
+	nni_ipc_pipe *pipe = nni_aio_get_prov_data(aio);
+
+	nni_mtx_lock(&pipe->mtx);
+	if (!pipe->tmbusy) {
+		nni_mtx_unlock(&pipe->mtx);
+		return;
+	}
+	pipe->tmbusy = false;
+	nni_mtx_unlock(&pipe->mtx);
+	nni_aio_finish_error(aio, rv);
 }
 
 static void
@@ -285,8 +491,10 @@ nni_ipc_pipe_recv_cb(void *arg)
 	if (pipe->rxmsg == NULL) {
 		uint64_t len;
 
-		// Check to make sure we got msg type 1.
-		if (pipe->rxhead[0] != 1) {
+		// Check to make sure we got msg type 1, or type 2 with
+		// a descriptor for the message, and nothing else.
+		if (((pipe->rxhead[0] != 1) || (pipe->rxfd >= 0)) &&
+		    ((pipe->rxhead[0] != 2) || (pipe->rxfd < 0))) {
 			rv = NNG_EPROTO;
 			goto recv_error;
 		}
@@ -301,12 +509,32 @@ nni_ipc_pipe_recv_cb(void *arg)
 			goto recv_error;
 		}
 
+		// For type 2 the message is in a shared memory object, which
+		// we map and use in place, without copying it.
+		if (pipe->rxhead[0] == 2) {
+			void * buf;
+			size_t sz = (size_t) len;
+
+			rv         = nni_plat_shm_mapfd(&buf, pipe->rxfd, sz);
+			pipe->rxfd = -1;
+			if (rv != 0) {
+				goto recv_error;
+			}
+			if ((rv = nni_msg_alloc_ext(&pipe->rxmsg, buf, sz,
+			         nni_plat_shm_unmap)) != 0) {
+				nni_plat_shm_unmap(buf, sz);
+				goto recv_error;
+			}
+			len = 0;
+		}
+
 		// Note that all IO on this pipe is blocked behind this
 		// allocation.  We could possibly look at using a separate
 		// lock for the read side in the future, so that we allow
 		// transmits to proceed normally.  In practice this is
 		// unlikely to be much of an issue though.
-		if ((rv = nni_msg_alloc(&pipe->rxmsg, (size_t) len)) != 0) {
+		if ((pipe->rxmsg == NULL) &&
+		    ((rv = nni_msg_alloc(&pipe->rxmsg, (size_t) len)) != 0)) {
 			goto recv_error;
 		}
 
@@ -334,6 +562,10 @@ nni_ipc_pipe_recv_cb(void *arg)
 	return;
 
 recv_error:
+	if (pipe->rxfd >= 0) {
+		nni_plat_shm_closefd(pipe->rxfd);
+		pipe->rxfd = -1;
+	}
 	pipe->user_rxaio = NULL;
 	msg              = pipe->rxmsg;
 	pipe->rxmsg      = NULL;
@@ -353,9 +585,14 @@ nni_ipc_cancel_tx(nni_aio *aio, int rv)
 		return;
 	}
 	pipe->user_txaio = NULL;
-	nni_mtx_unlock(&pipe->mtx);
-
-	nni_aio_abort(pipe->txaio, rv);
+	if (pipe->txbusy && !pipe->txbatch) {
+		nni_mtx_unlock(&pipe->mtx);
+		nni_aio_abort(pipe->txaio, rv);
+	} else {
+		// Not started, or behind a batch that must still go out.
+		nni_ipc_pipe_drop_txfd(pipe);
+		nni_mtx_unlock(&pipe->mtx);
+	}
 	nni_aio_finish_error(aio, rv);
 }
 
@@ -364,43 +601,87 @@ nni_ipc_pipe_send(void *arg, nni_aio *aio)
 {
 	nni_ipc_pipe *pipe = arg;
 	nni_msg *     msg  = nni_aio_get_msg(aio);
-	uint64_t      len;
-	nni_aio *     txaio;
-	int           niov;
-	nni_iov       iov[3];
+	size_t        hlen;
+	size_t        blen;
+	uint8_t *     ptr;
+	nni_iov       iov[2];
+	int           fd = -1;
+	int           rv;
 
-	len = nni_msg_len(msg) + nni_msg_header_len(msg);
+	hlen = nni_msg_header_len(msg);
+	blen = nni_msg_len(msg);
+
+	// Large messages can be copied once into a shared memory object,
+	// and passed to the peer as a descriptor, rather than through the
+	// socket, if the peer told us it accepts them.  If that fails for
+	// any reason we just send normally.
+	// We do this before taking the lock, as the copy may take a while.
+	if ((pipe->fdmin != 0) && (pipe->peerfd) &&
+	    (hlen + blen >= pipe->fdmin)) {
+		iov[0].iov_buf = nni_msg_header(msg);
+		iov[0].iov_len = hlen;
+		iov[1].iov_buf = nni_msg_body(msg);
+		iov[1].iov_len = blen;
+		if (nni_plat_shm_memfd(&fd, iov, 2) != 0) {
+			fd = -1;
+		}
+	}
 
 	nni_mtx_lock(&pipe->mtx);
 	if (nni_aio_start(aio, nni_ipc_cancel_tx, pipe) != 0) {
 		nni_mtx_unlock(&pipe->mtx);
+		if (fd >= 0) {
+			nni_plat_shm_closefd(fd);
+		}
+		return;
+	}
+	if ((rv = pipe->txerr) != 0) {
+		nni_mtx_unlock(&pipe->mtx);
+		if (fd >= 0) {
+			nni_plat_shm_closefd(fd);
+		}
+		nni_aio_finish_error(aio, rv);
 		return;
 	}
 
-	pipe->user_txaio = aio;
-
-	pipe->txhead[0] = 1; // message type, 1.
-	NNI_PUT64(pipe->txhead + 1, len);
+	if ((fd >= 0) || (pipe->batchmax == 0) ||
+	    (sizeof(pipe->txhead) + hlen + blen >
+	        pipe->batchmax - pipe->batchlen)) {
+		// Sent by itself, after any batch already waiting.
+		pipe->user_txaio = aio;
+		pipe->txfd       = fd;
+		nni_ipc_pipe_send_next(pipe);
+		nni_mtx_unlock(&pipe->mtx);
+		return;
+	}
 
-	txaio          = pipe->txaio;
-	niov           = 0;
-	iov[0].iov_buf = pipe->txhead;
-	iov[0].iov_len = sizeof(pipe->txhead);
-	niov++;
-	if (nni_msg_header_len(msg) > 0) {
-		iov[niov].iov_buf = nni_msg_header(msg);
-		iov[niov].iov_len = nni_msg_header_len(msg);
-		niov++;
+	// Frame it into the batch, exactly as it would go on the wire.
+	ptr    = pipe->batchbuf + pipe->batchlen;
+	ptr[0] = 1; // message type, 1.
+	NNI_PUT64(ptr + 1, (uint64_t)(hlen + blen));
+	ptr += sizeof(pipe->txhead);
+	if (hlen > 0) {
+		memcpy(ptr, nni_msg_header(msg), hlen);
 	}
-	if (nni_msg_len(msg) > 0) {
-		iov[niov].iov_buf = nni_msg_body(msg);
-		iov[niov].iov_len = nni_msg_len(msg);
-		niov++;
+	if (blen > 0) {
+		memcpy(ptr + hlen, nni_msg_body(msg), blen);
+	}
+	pipe->batchlen += sizeof(pipe->txhead) + hlen + blen;
+
+	if (!pipe->txbusy) {
+		if (pipe->batchtime <= 0) {
+			nni_ipc_pipe_send_batch(pipe);
+		} else if (!pipe->tmbusy &&
+		    (nni_aio_start(pipe->tmaio, nni_ipc_cancel_timer, pipe) ==
+		        0)) {
+			pipe->tmbusy = true;
+		}
 	}
-	nni_aio_set_iov(txaio, niov, iov);
-
-	nni_plat_ipc_pipe_send(pipe->ipp, txaio);
 	nni_mtx_unlock(&pipe->mtx);
+
+	nni_aio_set_msg(aio, NULL);
+	nni_msg_free(msg);
+	nni_aio_finish(aio, 0, blen);
 }
 
 static void
@@ -454,6 +735,7 @@ nni_ipc_pipe_start(void *arg, nni_aio *aio)
 	int           rv;
 	nni_aio *     negaio;
 	nni_iov       iov;
+	nni_iov       tok;
 
 	nni_mtx_lock(&pipe->mtx);
 	pipe->txhead[0] = 0;
@@ -472,6 +754,16 @@ nni_ipc_pipe_start(void *arg, nni_aio *aio)
 	iov.iov_len       = 8;
 	iov.iov_buf       = &pipe->txhead[0];
 	nni_aio_set_iov(negaio, 1, &iov);
+
+	// We accept messages by descriptor (type 2), and tell the peer so
+	// by passing a token descriptor with our header.  Peers that do
+	// not know about this read the header normally, which discards the
+	// token, and so never advertise it to us in turn.
+	tok.iov_buf = &pipe->txhead[0];
+	tok.iov_len = 1;
+	if (nni_plat_shm_memfd(&pipe->txfd, &tok, 1) == 0) {
+		nni_aio_set_input(negaio, 0, &pipe->txfd);
+	}
 	rv = nni_aio_start(aio, nni_ipc_cancel_start, pipe);
 	if (rv != 0) {
 		nni_mtx_unlock(&pipe->mtx);
@@ -695,6 +987,62 @@ nni_ipc_ep_getopt_recvmaxsz(void *arg, void *data, size_t *szp)
 	return (nni_getopt_size(ep->rcvmax, data, szp));
 }
 
+static int
+nni_ipc_ep_setopt_memfd_threshold(void *arg, const void *data, size_t sz)
+{
+	nni_ipc_ep *ep = arg;
+
+	if (ep == NULL) {
+		return (nni_chkopt_size(data, sz, 0, NNI_MAXSZ));
+	}
+	return (nni_setopt_size(&ep->fdmin, data, sz, 0, NNI_MAXSZ));
+}
+
+static int
+nni_ipc_ep_getopt_memfd_threshold(void *arg, void *data, size_t *szp)
+{
+	nni_ipc_ep *ep = arg;
+	return (nni_getopt_size(ep->fdmin, data, szp));
+}
+
+// Batches are copied twice over, so there is no point in large ones.
+#define NNI_IPC_BATCH_MAX (1024 * 1024)
+
+static int
+nni_ipc_ep_setopt_batch(void *arg, const void *data, size_t sz)
+{
+	nni_ipc_ep *ep = arg;
+	if (ep == NULL) {
+		return (nni_chkopt_size(data, sz, 0, NNI_IPC_BATCH_MAX));
+	}
+	return (
+	    nni_setopt_size(&ep->batchmax, data, sz, 0, NNI_IPC_BATCH_MAX));
+}
+
+static int
+nni_ipc_ep_getopt_batch(void *arg, void *data, size_t *szp)
+{
+	nni_ipc_ep *ep = arg;
+	return (nni_getopt_size(ep->batchmax, data, szp));
+}
+
+static int
+nni_ipc_ep_setopt_batchtime(void *arg, const void *data, size_t sz)
+{
+	nni_ipc_ep *ep = arg;
+	if (ep == NULL) {
+		return (nni_chkopt_ms(data, sz));
+	}
+	return (nni_setopt_ms(&ep->batchtime, data, sz));
+}
+
+static int
+nni_ipc_ep_getopt_batchtime(void *arg, void *data, size_t *szp)
+{
+	nni_ipc_ep *ep = arg;
+	return (nni_getopt_ms(ep->batchtime, data, szp));
+}
+
 static int
 nni_ipc_ep_get_addr(void *arg, void *data, size_t *szp)
 {
@@ -730,6 +1078,21 @@ static nni_tran_ep_option nni_ipc_ep_options[] = {
 	    .eo_getopt = nni_ipc_ep_get_addr,
 	    .eo_setopt = NULL,
 	},
+	{
+	    .eo_name   = NNG_OPT_IPC_MEMFD_THRESHOLD,
+	    .eo_getopt = nni_ipc_ep_getopt_memfd_threshold,
+	    .eo_setopt = nni_ipc_ep_setopt_memfd_threshold,
+	},
+	{
+	    .eo_name   = NNG_OPT_SEND_BATCH,
+	    .eo_getopt = nni_ipc_ep_getopt_batch,
+	    .eo_setopt = nni_ipc_ep_setopt_batch,
+	},
+	{
+	    .eo_name   = NNG_OPT_SEND_BATCH_TIME,
+	    .eo_getopt = nni_ipc_ep_getopt_batchtime,
+	    .eo_setopt = nni_ipc_ep_setopt_batchtime,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
@@ -14,6 +14,14 @@
 // ipc transport.  This is used for inter-process communication on
 // the same host computer.
 
+// NNG_OPT_IPC_MEMFD_THRESHOLD is the size (size_t) at or above which
+// messages are not written to the socket, but are instead copied into a
+// shared memory object whose descriptor is passed to the peer.  The peer
+// maps it and uses it in place.  Zero, the default, disables this.  It is
+// only available on platforms that can pass descriptors.  Peers that do
+// not accept descriptors are sent such messages normally.
+#define NNG_OPT_IPC_MEMFD_THRESHOLD "ipc:memfd-threshold"
+
 NNG_DECL int nng_ipc_register(void);
 
 #endif // NNG_TRANSPORT_IPC_IPC_H
@@ -0,0 +1,1125 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/nng_impl.h"
+#include "transport/shm/shm.h"
+
+// Shared memory transport.  Connections are established over the
+// platform IPC mechanism, exactly as for ipc://.  The dialer then creates
+// a shared region holding two single producer, single consumer byte
+// rings, one for each direction, and passes the region's name to the
+// listener.  From then on messages are copied straight into the ring by
+// the sender, and out of it by the receiver.
+//
+// The IPC connection stays open for the life of the pipe, and is used as
+// a doorbell.  A sender only writes to it when the receiver has flagged
+// (in the ring) that it ran out of data and is going to sleep, and a
+// receiver only writes to it when the sender is waiting for space.  While
+// both sides are busy no system calls are made at all.  The connection
+// also tells us when the peer has gone away.
+
+typedef struct nni_shm_pipe   nni_shm_pipe;
+typedef struct nni_shm_ep     nni_shm_ep;
+typedef struct nni_shm_ring   nni_shm_ring;
+typedef struct nni_shm_region nni_shm_region;
+
+#define NNI_SHM_MAGIC 0x4e4e4753u // "NNGS"
+#define NNI_SHM_VERSION 1
+#define NNI_SHM_RINGSZ_DEFAULT (1u << 20)
+#define NNI_SHM_RINGSZ_MIN (1u << 12)
+#define NNI_SHM_RINGSZ_MAX (1u << 30)
+
+// Negotiation.  Both sides send the usual 8 byte SP header.  The dialer
+// follows it with the ring size and the name of the region.
+#define NNI_SHM_NEGO_LISTEN 8
+#define NNI_SHM_NEGO_DIAL (8 + 8 + NNI_PLAT_SHM_NAMELEN)
+
+// The ring indices are shared with another process, so we cannot use
+// our own locks to order access.  The writer publishes the tail with
+// release semantics, and the reader the head; each loads the other's
+// index with acquire semantics.  The wait flags use a full fence on
+// both sides, so that a sleeper never misses its doorbell.
+#define NNI_SHM_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define NNI_SHM_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define NNI_SHM_XCHG(p, v) __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST)
+#define NNI_SHM_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// nni_shm_ring holds the control words for one direction.  Each index
+// is written by only one side, and is kept on its own cache line.
+struct nni_shm_ring {
+	uint64_t head; // bytes consumed, written by the reader
+	uint8_t  pad0[56];
+	uint64_t tail; // bytes produced, written by the writer
+	uint8_t  pad1[56];
+	uint32_t rwait; // reader is asleep, wants a doorbell
+	uint32_t wwait; // writer is asleep, wants a doorbell
+	uint8_t  pad2[56];
+};
+
+// nni_shm_region is the start of the shared region; the ring data
+// for rings[0] and then rings[1] follows immediately after.
+struct nni_shm_region {
+	uint32_t     magic;
+	uint32_t     version;
+	uint64_t     ringsz;
+	uint8_t      pad[48];
+	nni_shm_ring rings[2]; // [0] is dialer to listener
+};
+
+// nni_shm_pipe is one end of a shared memory connection.
+struct nni_shm_pipe {
+	nni_plat_ipc_pipe *ipp;
+	nni_plat_shm *     shm;
+	uint16_t           peer;
+	uint16_t           proto;
+	size_t             rcvmax;
+	size_t             ringsz;
+	int                mode;
+	bool               closed;
+	nni_sockaddr       sa;
+
+	nni_shm_ring *txring;
+	uint8_t *     txdata;
+	nni_shm_ring *rxring;
+	uint8_t *     rxdata;
+
+	uint8_t txhead[NNI_SHM_NEGO_DIAL];
+	uint8_t rxhead[NNI_SHM_NEGO_DIAL];
+	size_t  gottxhead;
+	size_t  gotrxhead;
+	size_t  wanttxhead;
+	size_t  wantrxhead;
+
+	// Each message goes through the ring as a 64-bit length followed
+	// by the header and body.  The offsets count the length as well.
+	uint8_t  txlen[sizeof(uint64_t)];
+	size_t   txoff;
+	uint8_t  rxlen[sizeof(uint64_t)];
+	size_t   rxoff;
+	nni_msg *rxmsg;
+
+	uint8_t dbtxbuf[1];
+	uint8_t dbrxbuf[64];
+	bool    dbbusy;  // doorbell write in flight
+	bool    dbagain; // ring again once it completes
+
+	nni_aio *user_txaio;
+	nni_aio *user_rxaio;
+	nni_aio *user_negaio;
+	nni_aio *negaio;
+	nni_aio *dbtxaio;
+	nni_aio *dbrxaio;
+	nni_mtx  mtx;
+};
+
+struct nni_shm_ep {
+	nni_sockaddr     sa;
+	nni_plat_ipc_ep *iep;
+	uint16_t         proto;
+	size_t           rcvmax;
+	size_t           ringsz;
+	int              mode;
+	nni_aio *        aio;
+	nni_aio *        user_aio;
+	nni_mtx          mtx;
+};
+
+static void nni_shm_pipe_nego_cb(void *);
+static void nni_shm_pipe_dbtx_cb(void *);
+static void nni_shm_pipe_dbrx_cb(void *);
+static void nni_shm_ep_cb(void *);
+
+static int
+nni_shm_tran_init(void)
+{
+	return (0);
+}
+
+static void
+nni_shm_tran_fini(void)
+{
+}
+
+static size_t
+nni_shm_region_size(size_t ringsz)
+{
+	return (sizeof(nni_shm_region) + (2 * ringsz));
+}
+
+static void
+nni_shm_copy_in(nni_shm_pipe *p, uint64_t pos, const uint8_t *buf, size_t n)
+{
+	size_t off   = (size_t)(pos & (p->ringsz - 1));
+	size_t first = p->ringsz - off;
+
+	if (first > n) {
+		first = n;
+	}
+	memcpy(p->txdata + off, buf, first);
+	memcpy(p->txdata, buf + first, n - first);
+}
+
+static void
+nni_shm_copy_out(nni_shm_pipe *p, uint64_t pos, uint8_t *buf, size_t n)
+{
+	size_t off   = (size_t)(pos & (p->ringsz - 1));
+	size_t first = p->ringsz - off;
+
+	if (first > n) {
+		first = n;
+	}
+	memcpy(buf, p->rxdata + off, first);
+	memcpy(buf + first, p->rxdata, n - first);
+}
+
+// nni_shm_pipe_ring writes a byte to the peer, waking it up.
+static void
+nni_shm_pipe_ring(nni_shm_pipe *p)
+{
+	nni_iov iov;
+
+	if (p->closed) {
+		return;
+	}
+	if (p->dbbusy) {
+		p->dbagain = true;
+		return;
+	}
+	p->dbbusy   = true;
+	iov.iov_buf = p->dbtxbuf;
+	iov.iov_len = sizeof(p->dbtxbuf);
+	nni_aio_set_iov(p->dbtxaio, 1, &iov);
+	nni_plat_ipc_pipe_send(p->ipp, p->dbtxaio);
+}
+
+// nni_shm_pipe_wake is called after moving an index; if the peer said it
+// was going to sleep waiting for that, ring the doorbell.
+static void
+nni_shm_pipe_wake(nni_shm_pipe *p, uint32_t *waitp)
+{
+	NNI_SHM_FENCE();
+	if ((__atomic_load_n(waitp, __ATOMIC_RELAXED) != 0) &&
+	    (NNI_SHM_XCHG(waitp, 0) != 0)) {
+		nni_shm_pipe_ring(p);
+	}
+}
+
+// nni_shm_pipe_sleep flags that we are waiting on the peer, then looks
+// at its index again, in case it moved before it could see the flag.
+// It returns the latest value of the index.
+static uint64_t
+nni_shm_pipe_sleep(uint32_t *waitp, uint64_t *idxp)
+{
+	uint64_t idx;
+
+	__atomic_store_n(waitp, 1, __ATOMIC_SEQ_CST);
+	NNI_SHM_FENCE();
+	idx = NNI_SHM_LOAD(idxp);
+	return (idx);
+}
+
+// nni_shm_ring_valid checks a pair of ring indices.  The peer can write
+// anywhere in the region, including our own index, so we never trust
+// that the amount in the ring is within its size.
+static bool
+nni_shm_ring_valid(nni_shm_pipe *p, uint64_t head, uint64_t tail)
+{
+	return ((tail - head) <= p->ringsz);
+}
+
+static void
+nni_shm_pipe_fail(nni_shm_pipe *p, int rv)
+{
+	nni_aio *aio;
+
+	p->closed = true;
+	if ((aio = p->user_txaio) != NULL) {
+		nni_msg *msg = nni_aio_get_msg(aio);
+
+		p->user_txaio = NULL;
+		nni_aio_set_msg(aio, NULL);
+		nni_msg_free(msg);
+		nni_aio_finish_error(aio, rv);
+	}
+	if ((aio = p->user_rxaio) != NULL) {
+		p->user_rxaio = NULL;
+		nni_aio_finish_error(aio, rv);
+	}
+}
+
+static void
+nni_shm_pipe_dosend(nni_shm_pipe *p)
+{
+	nni_shm_ring *r = p->txring;
+	nni_aio *     aio;
+
+	while ((aio = p->user_txaio) != NULL) {
+		nni_msg *msg = nni_aio_get_msg(aio);
+		uint64_t tail;
+		uint64_t head;
+		size_t   space;
+		size_t   total;
+		size_t   off;
+		size_t   n;
+		nni_iov  iov[3];
+
+		// We are the only writer of the tail.
+		tail = r->tail;
+		head = NNI_SHM_LOAD(&r->head);
+		if ((tail - head) == p->ringsz) {
+			head = nni_shm_pipe_sleep(&r->wwait, &r->head);
+			if ((tail - head) == p->ringsz) {
+				return; // The reader will ring us.
+			}
+			(void) NNI_SHM_XCHG(&r->wwait, 0);
+		}
+		if (!nni_shm_ring_valid(p, head, tail)) {
+			nni_shm_pipe_fail(p, NNG_EPROTO);
+			nni_plat_ipc_pipe_close(p->ipp);
+			return;
+		}
+		space = p->ringsz - (size_t)(tail - head);
+
+		iov[0].iov_buf = p->txlen;
+		iov[0].iov_len = sizeof(p->txlen);
+		iov[1].iov_buf = nni_msg_header(msg);
+		iov[1].iov_len = nni_msg_header_len(msg);
+		iov[2].iov_buf = nni_msg_body(msg);
+		iov[2].iov_len = nni_msg_len(msg);
+		total = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+		n   = 0;
+		off = p->txoff;
+		for (int i = 0; (i < 3) && (n < space); i++) {
+			size_t len;
+
+			if (off >= iov[i].iov_len) {
+				off -= iov[i].iov_len;
+				continue;
+			}
+			len = iov[i].iov_len - off;
+			if (len > (space - n)) {
+				len = space - n;
+			}
+			nni_shm_copy_in(
+			    p, tail + n, (uint8_t *) iov[i].iov_buf + off, len);
+			n += len;
+			off = 0;
+		}
+		NNI_SHM_STORE(&r->tail, tail + n);
+		p->txoff += n;
+		nni_shm_pipe_wake(p, &r->rwait);
+
+		if (p->txoff == total) {
+			p->user_txaio = NULL;
+			p->txoff      = 0;
+			n             = nni_msg_len(msg);
+			nni_aio_set_msg(aio, NULL);
+			nni_msg_free(msg);
+			nni_aio_finish(aio, 0, n);
+		}
+	}
+}
+
+static void
+nni_shm_pipe_dorecv(nni_shm_pipe *p)
+{
+	nni_shm_ring *r = p->rxring;
+	nni_aio *     aio;
+	int           rv;
+
+	while ((aio = p->user_rxaio) != NULL) {
+		uint64_t head;
+		uint64_t tail;
+		size_t   avail;
+		size_t   n;
+		size_t   len;
+
+		// We are the only writer of the head.
+		head = r->head;
+		tail = NNI_SHM_LOAD(&r->tail);
+		if (tail == head) {
+			tail = nni_shm_pipe_sleep(&r->rwait, &r->tail);
+			if (tail == head) {
+				return; // The writer will ring us.
+			}
+			(void) NNI_SHM_XCHG(&r->rwait, 0);
+		}
+		if (!nni_shm_ring_valid(p, head, tail)) {
+			rv = NNG_EPROTO;
+			goto recv_error;
+		}
+		avail = (size_t)(tail - head);
+
+		n = 0;
+		if (p->rxoff < sizeof(p->rxlen)) {
+			uint64_t msglen;
+
+			len = sizeof(p->rxlen) - p->rxoff;
+			if (len > avail) {
+				len = avail;
+			}
+			nni_shm_copy_out(p, head, p->rxlen + p->rxoff, len);
+			n += len;
+			p->rxoff += len;
+
+			if (p->rxoff == sizeof(p->rxlen)) {
+				NNI_GET64(p->rxlen, msglen);
+
+				// Make sure the message payload is not too
+				// big.  If it is the caller will shut down
+				// the pipe.
+				if (msglen > p->rcvmax) {
+					rv = NNG_EMSGSIZE;
+					goto recv_error;
+				}
+				rv = nni_msg_alloc(&p->rxmsg, (size_t) msglen);
+				if (rv != 0) {
+					goto recv_error;
+				}
+			}
+		}
+		if (p->rxmsg != NULL) {
+			size_t got = p->rxoff - sizeof(p->rxlen);
+
+			len = nni_msg_len(p->rxmsg) - got;
+			if (len > (avail - n)) {
+				len = avail - n;
+			}
+			nni_shm_copy_out(p, head + n,
+			    (uint8_t *) nni_msg_body(p->rxmsg) + got, len);
+			n += len;
+			p->rxoff += len;
+		}
+		NNI_SHM_STORE(&r->head, head + n);
+		nni_shm_pipe_wake(p, &r->wwait);
+
+		if ((p->rxmsg != NULL) &&
+		    (p->rxoff == (sizeof(p->rxlen) + nni_msg_len(p->rxmsg)))) {
+			nni_msg *msg  = p->rxmsg;
+			p->rxmsg      = NULL;
+			p->rxoff      = 0;
+			p->user_rxaio = NULL;
+			nni_aio_finish_msg(aio, msg);
+		}
+	}
+	return;
+
+recv_error:
+	// The stream is unusable past this point.
+	p->user_rxaio = NULL;
+	p->closed     = true;
+	nni_plat_ipc_pipe_close(p->ipp);
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_pipe_close(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	nni_mtx_lock(&p->mtx);
+	p->closed = true;
+	nni_plat_ipc_pipe_close(p->ipp);
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_pipe_fini(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	nni_aio_stop(p->negaio);
+	nni_aio_stop(p->dbtxaio);
+	nni_aio_stop(p->dbrxaio);
+
+	nni_aio_fini(p->negaio);
+	nni_aio_fini(p->dbtxaio);
+	nni_aio_fini(p->dbrxaio);
+	if (p->ipp != NULL) {
+		nni_plat_ipc_pipe_fini(p->ipp);
+	}
+	if (p->shm != NULL) {
+		nni_plat_shm_fini(p->shm);
+	}
+	if (p->rxmsg) {
+		nni_msg_free(p->rxmsg);
+	}
+	nni_mtx_fini(&p->mtx);
+	NNI_FREE_STRUCT(p);
+}
+
+static void
+nni_shm_pipe_map(nni_shm_pipe *p)
+{
+	nni_shm_region *reg  = nni_plat_shm_addr(p->shm);
+	uint8_t *       data = (uint8_t *) (reg + 1);
+	int             tx   = (p->mode == NNI_EP_MODE_DIAL) ? 0 : 1;
+
+	p->txring = &reg->rings[tx];
+	p->txdata = data + (tx * p->ringsz);
+	p->rxring = &reg->rings[1 - tx];
+	p->rxdata = data + ((1 - tx) * p->ringsz);
+}
+
+static int
+nni_shm_pipe_init(nni_shm_pipe **pipep, nni_shm_ep *ep, void *ipp)
+{
+	nni_shm_pipe *p;
+	int           rv;
+
+	if ((p = NNI_ALLOC_STRUCT(p)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	nni_mtx_init(&p->mtx);
+	p->ipp = ipp;
+	if (((rv = nni_aio_init(&p->negaio, nni_shm_pipe_nego_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->dbtxaio, nni_shm_pipe_dbtx_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->dbrxaio, nni_shm_pipe_dbrx_cb, p)) != 0)) {
+		nni_shm_pipe_fini(p);
+		return (rv);
+	}
+
+	p->proto  = ep->proto;
+	p->rcvmax = ep->rcvmax;
+	p->mode   = ep->mode;
+	p->sa     = ep->sa;
+
+	// The dialer owns the shared region.  The listener maps it once
+	// it learns the name during negotiation.
+	if (p->mode == NNI_EP_MODE_DIAL) {
+		nni_shm_region *reg;
+
+		p->ringsz = ep->ringsz;
+		if ((rv = nni_plat_shm_create(
+		         &p->shm, nni_shm_region_size(p->ringsz))) != 0) {
+			nni_shm_pipe_fini(p);
+			return (rv);
+		}
+		reg          = nni_plat_shm_addr(p->shm);
+		reg->magic   = NNI_SHM_MAGIC;
+		reg->version = NNI_SHM_VERSION;
+		reg->ringsz  = p->ringsz;
+		nni_shm_pipe_map(p);
+	}
+
+	*pipep = p;
+	return (0);
+}
+
+// nni_shm_pipe_attach is called on the listener once negotiation is
+// done, to map the region the dialer told us about.
+static int
+nni_shm_pipe_attach(nni_shm_pipe *p)
+{
+	nni_shm_region *reg;
+	uint64_t        ringsz;
+	const char *    name;
+	int             rv;
+
+	NNI_GET64(&p->rxhead[8], ringsz);
+	name = (const char *) &p->rxhead[16];
+	if ((ringsz < NNI_SHM_RINGSZ_MIN) || (ringsz > NNI_SHM_RINGSZ_MAX) ||
+	    ((ringsz & (ringsz - 1)) != 0) ||
+	    (nni_strnlen(name, NNI_PLAT_SHM_NAMELEN) >= NNI_PLAT_SHM_NAMELEN)) {
+		return (NNG_EPROTO);
+	}
+	p->ringsz = (size_t) ringsz;
+	rv = nni_plat_shm_open(&p->shm, name, nni_shm_region_size(p->ringsz));
+	if (rv != 0) {
+		return (rv);
+	}
+	// Nobody else needs to find it now.
+	nni_plat_shm_unlink(p->shm);
+
+	reg = nni_plat_shm_addr(p->shm);
+	if ((reg->magic != NNI_SHM_MAGIC) ||
+	    (reg->version != NNI_SHM_VERSION) || (reg->ringsz != ringsz)) {
+		return (NNG_EPROTO);
+	}
+	nni_shm_pipe_map(p);
+	return (0);
+}
+
+static void
+nni_shm_cancel_start(nni_aio *aio, int rv)
+{
+	nni_shm_pipe *p = nni_aio_get_prov_data(aio);
+
+	nni_mtx_lock(&p->mtx);
+	if (p->user_negaio != aio) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_negaio = NULL;
+	nni_mtx_unlock(&p->mtx);
+
+	nni_aio_abort(p->negaio, rv);
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_pipe_nego_cb(void *arg)
+{
+	nni_shm_pipe *p   = arg;
+	nni_aio *     aio = p->negaio;
+	int           rv;
+
+	nni_mtx_lock(&p->mtx);
+	if ((rv = nni_aio_result(aio)) != 0) {
+		goto done;
+	}
+
+	// We start transmitting before we receive.
+	if (p->gottxhead < p->wanttxhead) {
+		p->gottxhead += nni_aio_count(aio);
+	} else if (p->gotrxhead < p->wantrxhead) {
+		p->gotrxhead += nni_aio_count(aio);
+	}
+
+	if (p->gottxhead < p->wanttxhead) {
+		nni_iov iov;
+		iov.iov_len = p->wanttxhead - p->gottxhead;
+		iov.iov_buf = &p->txhead[p->gottxhead];
+		nni_aio_set_iov(aio, 1, &iov);
+		// send it down...
+		nni_plat_ipc_pipe_send(p->ipp, aio);
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	if (p->gotrxhead < p->wantrxhead) {
+		nni_iov iov;
+		iov.iov_len = p->wantrxhead - p->gotrxhead;
+		iov.iov_buf = &p->rxhead[p->gotrxhead];
+		nni_aio_set_iov(aio, 1, &iov);
+		nni_plat_ipc_pipe_recv(p->ipp, aio);
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	// We have both sent and received the headers.  Lets check the
+	// receive side header.
+	if ((p->rxhead[0] != 0) || (p->rxhead[1] != 'S') ||
+	    (p->rxhead[2] != 'P') || (p->rxhead[3] != 0) ||
+	    (p->rxhead[6] != 0) || (p->rxhead[7] != 0)) {
+		rv = NNG_EPROTO;
+		goto done;
+	}
+
+	NNI_GET16(&p->rxhead[4], p->peer);
+
+	if ((p->mode != NNI_EP_MODE_DIAL) &&
+	    ((rv = nni_shm_pipe_attach(p)) != 0)) {
+		goto done;
+	}
+
+	// Start listening for doorbells (and for the peer going away).
+	{
+		nni_iov iov;
+		iov.iov_buf = p->dbrxbuf;
+		iov.iov_len = sizeof(p->dbrxbuf);
+		nni_aio_set_iov(p->dbrxaio, 1, &iov);
+		nni_plat_ipc_pipe_recv(p->ipp, p->dbrxaio);
+	}
+
+done:
+	if ((aio = p->user_negaio) != NULL) {
+		p->user_negaio = NULL;
+		nni_aio_finish(aio, rv, 0);
+	}
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_pipe_dbtx_cb(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	nni_mtx_lock(&p->mtx);
+	p->dbbusy = false;
+	// Errors are noticed by the doorbell receive side.
+	if ((nni_aio_result(p->dbtxaio) == 0) && p->dbagain) {
+		p->dbagain = false;
+		nni_shm_pipe_ring(p);
+	}
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_pipe_dbrx_cb(void *arg)
+{
+	nni_shm_pipe *p = arg;
+	nni_iov       iov;
+	int           rv;
+
+	nni_mtx_lock(&p->mtx);
+	if (((rv = nni_aio_result(p->dbrxaio)) == 0) && p->closed) {
+		rv = NNG_ECLOSED;
+	}
+	if (rv != 0) {
+		nni_shm_pipe_fail(p, rv);
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+
+	// The content does not matter, the peer moved an index.
+	nni_shm_pipe_dosend(p);
+	nni_shm_pipe_dorecv(p);
+
+	iov.iov_buf = p->dbrxbuf;
+	iov.iov_len = sizeof(p->dbrxbuf);
+	nni_aio_set_iov(p->dbrxaio, 1, &iov);
+	nni_plat_ipc_pipe_recv(p->ipp, p->dbrxaio);
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_cancel_tx(nni_aio *aio, int rv)
+{
+	nni_shm_pipe *p = nni_aio_get_prov_data(aio);
+
+	nni_mtx_lock(&p->mtx);
+	if (p->user_txaio != aio) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_txaio = NULL;
+	if (p->txoff != 0) {
+		// Part of the message is already in the ring, so the
+		// stream cannot be recovered.
+		p->txoff  = 0;
+		p->closed = true;
+		nni_plat_ipc_pipe_close(p->ipp);
+	}
+	nni_mtx_unlock(&p->mtx);
+
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_pipe_send(void *arg, nni_aio *aio)
+{
+	nni_shm_pipe *p   = arg;
+	nni_msg *     msg = nni_aio_get_msg(aio);
+
+	nni_mtx_lock(&p->mtx);
+	if (nni_aio_start(aio, nni_shm_cancel_tx, p) != 0) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	if (p->closed) {
+		nni_aio_finish_error(aio, NNG_ECLOSED);
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_txaio = aio;
+	p->txoff      = 0;
+	NNI_PUT64(p->txlen, nni_msg_header_len(msg) + nni_msg_len(msg));
+	nni_shm_pipe_dosend(p);
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_cancel_rx(nni_aio *aio, int rv)
+{
+	nni_shm_pipe *p = nni_aio_get_prov_data(aio);
+
+	nni_mtx_lock(&p->mtx);
+	if (p->user_rxaio != aio) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	// Any partially received message is kept for the next receive.
+	p->user_rxaio = NULL;
+	nni_mtx_unlock(&p->mtx);
+
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_pipe_recv(void *arg, nni_aio *aio)
+{
+	nni_shm_pipe *p = arg;
+
+	nni_mtx_lock(&p->mtx);
+	if (nni_aio_start(aio, nni_shm_cancel_rx, p) != 0) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	if (p->closed) {
+		nni_aio_finish_error(aio, NNG_ECLOSED);
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_rxaio = aio;
+	nni_shm_pipe_dorecv(p);
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_pipe_start(void *arg, nni_aio *aio)
+{
+	nni_shm_pipe *p = arg;
+	int           rv;
+	nni_iov       iov;
+
+	nni_mtx_lock(&p->mtx);
+	memset(p->txhead, 0, sizeof(p->txhead));
+	p->txhead[0] = 0;
+	p->txhead[1] = 'S';
+	p->txhead[2] = 'P';
+	p->txhead[3] = 0;
+	NNI_PUT16(&p->txhead[4], p->proto);
+	NNI_PUT16(&p->txhead[6], 0);
+
+	if (p->mode == NNI_EP_MODE_DIAL) {
+		NNI_PUT64(&p->txhead[8], (uint64_t) p->ringsz);
+		(void) nni_strlcpy((char *) &p->txhead[16],
+		    nni_plat_shm_name(p->shm), NNI_PLAT_SHM_NAMELEN);
+		p->wanttxhead = NNI_SHM_NEGO_DIAL;
+		p->wantrxhead = NNI_SHM_NEGO_LISTEN;
+	} else {
+		p->wanttxhead = NNI_SHM_NEGO_LISTEN;
+		p->wantrxhead = NNI_SHM_NEGO_DIAL;
+	}
+
+	p->user_negaio = aio;
+	p->gotrxhead   = 0;
+	p->gottxhead   = 0;
+	iov.iov_len    = p->wanttxhead;
+	iov.iov_buf    = &p->txhead[0];
+	nni_aio_set_iov(p->negaio, 1, &iov);
+	rv = nni_aio_start(aio, nni_shm_cancel_start, p);
+	if (rv != 0) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	nni_plat_ipc_pipe_send(p->ipp, p->negaio);
+	nni_mtx_unlock(&p->mtx);
+}
+
+static uint16_t
+nni_shm_pipe_peer(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	return (p->peer);
+}
+
+static int
+nni_shm_pipe_get_addr(void *arg, void *buf, size_t *szp)
+{
+	nni_shm_pipe *p = arg;
+	return (nni_getopt_sockaddr(&p->sa, buf, szp));
+}
+
+static void
+nni_shm_ep_fini(void *arg)
+{
+	nni_shm_ep *ep = arg;
+
+	nni_aio_stop(ep->aio);
+	nni_plat_ipc_ep_fini(ep->iep);
+	nni_aio_fini(ep->aio);
+	nni_mtx_fini(&ep->mtx);
+	NNI_FREE_STRUCT(ep);
+}
+
+static int
+nni_shm_ep_init(void **epp, nni_url *url, nni_sock *sock, int mode)
+{
+	nni_shm_ep *ep;
+	int         rv;
+	size_t      sz;
+
+	if (((url->u_host != NULL) && (strlen(url->u_host) > 0)) ||
+	    (url->u_userinfo != NULL)) {
+		return (NNG_EINVAL);
+	}
+	if ((ep = NNI_ALLOC_STRUCT(ep)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	nni_mtx_init(&ep->mtx);
+
+	sz                           = sizeof(ep->sa.s_un.s_path.sa_path);
+	ep->sa.s_un.s_path.sa_family = NNG_AF_IPC;
+
+	if (nni_strlcpy(ep->sa.s_un.s_path.sa_path, url->u_path, sz) >= sz) {
+		nni_shm_ep_fini(ep);
+		return (NNG_EADDRINVAL);
+	}
+
+	if ((rv = nni_plat_ipc_ep_init(&ep->iep, &ep->sa, mode)) != 0) {
+		nni_shm_ep_fini(ep);
+		return (rv);
+	}
+
+	if ((rv = nni_aio_init(&ep->aio, nni_shm_ep_cb, ep)) != 0) {
+		nni_shm_ep_fini(ep);
+		return (rv);
+	}
+	ep->proto  = nni_sock_proto(sock);
+	ep->mode   = mode;
+	ep->ringsz = NNI_SHM_RINGSZ_DEFAULT;
+
+	*epp = ep;
+	return (0);
+}
+
+static void
+nni_shm_ep_close(void *arg)
+{
+	nni_shm_ep *ep = arg;
+
+	nni_mtx_lock(&ep->mtx);
+	nni_plat_ipc_ep_close(ep->iep);
+	nni_mtx_unlock(&ep->mtx);
+
+	nni_aio_stop(ep->aio);
+}
+
+static int
+nni_shm_ep_bind(void *arg)
+{
+	nni_shm_ep *ep = arg;
+	int         rv;
+
+	nni_mtx_lock(&ep->mtx);
+	rv = nni_plat_ipc_ep_listen(ep->iep);
+	nni_mtx_unlock(&ep->mtx);
+	return (rv);
+}
+
+static void
+nni_shm_ep_finish(nni_shm_ep *ep)
+{
+	nni_aio *     aio;
+	int           rv;
+	nni_shm_pipe *pipe = NULL;
+
+	if ((rv = nni_aio_result(ep->aio)) != 0) {
+		goto done;
+	}
+	NNI_ASSERT(nni_aio_get_output(ep->aio, 0) != NULL);
+
+	// Attempt to allocate the parent pipe.  If this fails we'll
+	// drop the connection (ENOMEM probably).
+	if ((rv = nni_shm_pipe_init(
+	         &pipe, ep, nni_aio_get_output(ep->aio, 0))) != 0) {
+		pipe = NULL;
+	}
+
+done:
+	aio          = ep->user_aio;
+	ep->user_aio = NULL;
+
+	if ((aio != NULL) && (rv == 0)) {
+		NNI_ASSERT(pipe != NULL);
+		nni_aio_set_output(aio, 0, pipe);
+		nni_aio_finish(aio, 0, 0);
+		return;
+	}
+
+	if (pipe != NULL) {
+		nni_shm_pipe_fini(pipe);
+	}
+	if (aio != NULL) {
+		NNI_ASSERT(rv != 0);
+		nni_aio_finish_error(aio, rv);
+	}
+}
+
+static void
+nni_shm_ep_cb(void *arg)
+{
+	nni_shm_ep *ep = arg;
+
+	nni_mtx_lock(&ep->mtx);
+	nni_shm_ep_finish(ep);
+	nni_mtx_unlock(&ep->mtx);
+}
+
+static void
+nni_shm_cancel_ep(nni_aio *aio, int rv)
+{
+	nni_shm_ep *ep = nni_aio_get_prov_data(aio);
+
+	NNI_ASSERT(rv != 0);
+	nni_mtx_lock(&ep->mtx);
+	if (ep->user_aio != aio) {
+		nni_mtx_unlock(&ep->mtx);
+		return;
+	}
+	ep->user_aio = NULL;
+	nni_mtx_unlock(&ep->mtx);
+
+	nni_aio_abort(ep->aio, rv);
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_ep_accept(void *arg, nni_aio *aio)
+{
+	nni_shm_ep *ep = arg;
+	int         rv;
+
+	nni_mtx_lock(&ep->mtx);
+	NNI_ASSERT(ep->user_aio == NULL);
+
+	if ((rv = nni_aio_start(aio, nni_shm_cancel_ep, ep)) != 0) {
+		nni_mtx_unlock(&ep->mtx);
+		return;
+	}
+
+	ep->user_aio = aio;
+
+	nni_plat_ipc_ep_accept(ep->iep, ep->aio);
+	nni_mtx_unlock(&ep->mtx);
+}
+
+static void
+nni_shm_ep_connect(void *arg, nni_aio *aio)
+{
+	nni_shm_ep *ep = arg;
+	int         rv;
+
+	nni_mtx_lock(&ep->mtx);
+	NNI_ASSERT(ep->user_aio == NULL);
+
+	// If we can't start, then its dying and we can't report
+	// either.
+	if ((rv = nni_aio_start(aio, nni_shm_cancel_ep, ep)) != 0) {
+		nni_mtx_unlock(&ep->mtx);
+		return;
+	}
+
+	ep->user_aio = aio;
+
+	nni_plat_ipc_ep_connect(ep->iep, ep->aio);
+	nni_mtx_unlock(&ep->mtx);
+}
+
+static int
+nni_shm_ep_setopt_recvmaxsz(void *arg, const void *data, size_t sz)
+{
+	nni_shm_ep *ep = arg;
+
+	if (ep == NULL) {
+		return (nni_chkopt_size(data, sz, 0, NNI_MAXSZ));
+	}
+	return (nni_setopt_size(&ep->rcvmax, data, sz, 0, NNI_MAXSZ));
+}
+
+static int
+nni_shm_ep_getopt_recvmaxsz(void *arg, void *data, size_t *szp)
+{
+	nni_shm_ep *ep = arg;
+	return (nni_getopt_size(ep->rcvmax, data, szp));
+}
+
+static int
+nni_shm_ep_setopt_ringsz(void *arg, const void *data, size_t sz)
+{
+	nni_shm_ep *ep = arg;
+	size_t      val;
+	int         rv;
+
+	rv = nni_setopt_size(
+	    &val, data, sz, NNI_SHM_RINGSZ_MIN, NNI_SHM_RINGSZ_MAX);
+	if (rv != 0) {
+		return (rv);
+	}
+	if ((val & (val - 1)) != 0) {
+		return (NNG_EINVAL);
+	}
+	if (ep != NULL) {
+		ep->ringsz = val;
+	}
+	return (0);
+}
+
+static int
+nni_shm_ep_getopt_ringsz(void *arg, void *data, size_t *szp)
+{
+	nni_shm_ep *ep = arg;
+	return (nni_getopt_size(ep->ringsz, data, szp));
+}
+
+static int
+nni_shm_ep_get_addr(void *arg, void *data, size_t *szp)
+{
+	nni_shm_ep *ep = arg;
+	return (nni_getopt_sockaddr(&ep->sa, data, szp));
+}
+
+static nni_tran_pipe_option nni_shm_pipe_options[] = {
+	{ NNG_OPT_REMADDR, nni_shm_pipe_get_addr },
+	{ NNG_OPT_LOCADDR, nni_shm_pipe_get_addr },
+	// terminate list
+	{ NULL, NULL },
+};
+
+static nni_tran_pipe nni_shm_pipe_ops = {
+	.p_fini    = nni_shm_pipe_fini,
+	.p_start   = nni_shm_pipe_start,
+	.p_send    = nni_shm_pipe_send,
+	.p_recv    = nni_shm_pipe_recv,
+	.p_close   = nni_shm_pipe_close,
+	.p_peer    = nni_shm_pipe_peer,
+	.p_options = nni_shm_pipe_options,
+};
+
+static nni_tran_ep_option nni_shm_ep_options[] = {
+	{
+	    .eo_name   = NNG_OPT_RECVMAXSZ,
+	    .eo_getopt = nni_shm_ep_getopt_recvmaxsz,
+	    .eo_setopt = nni_shm_ep_setopt_recvmaxsz,
+	},
+	{
+	    .eo_name   = NNG_OPT_LOCADDR,
+	    .eo_getopt = nni_shm_ep_get_addr,
+	    .eo_setopt = NULL,
+	},
+	{
+	    .eo_name   = NNG_OPT_SHM_RINGSZ,
+	    .eo_getopt = nni_shm_ep_getopt_ringsz,
+	    .eo_setopt = nni_shm_ep_setopt_ringsz,
+	},
+	// terminate list
+	{ NULL, NULL, NULL },
+};
+
+static nni_tran_ep nni_shm_ep_ops = {
+	.ep_init    = nni_shm_ep_init,
+	.ep_fini    = nni_shm_ep_fini,
+	.ep_connect = nni_shm_ep_connect,
+	.ep_bind    = nni_shm_ep_bind,
+	.ep_accept  = nni_shm_ep_accept,
+	.ep_close   = nni_shm_ep_close,
+	.ep_options = nni_shm_ep_options,
+};
+
+static nni_tran nni_shm_tran = {
+	.tran_version = NNI_TRANSPORT_VERSION,
+	.tran_scheme  = "shm",
+	.tran_ep      = &nni_shm_ep_ops,
+	.tran_pipe    = &nni_shm_pipe_ops,
+	.tran_init    = nni_shm_tran_init,
+	.tran_fini    = nni_shm_tran_fini,
+};
+
+int
+nng_shm_register(void)
+{
+	return (nni_tran_register(&nni_shm_tran));
+}
@@ -0,0 +1,25 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef NNG_TRANSPORT_SHM_SHM_H
+#define NNG_TRANSPORT_SHM_SHM_H
+
+// shm transport.  This is used for inter-process communication on
+// the same host computer, moving message data through shared memory
+// rather than through the kernel.
+
+// NNG_OPT_SHM_RINGSZ is the size (size_t) of each of the two rings,
+// one per direction, in the shared region.  It must be a power of two.
+// The value on the dialer is the one used for the connection.
+#define NNG_OPT_SHM_RINGSZ "shm:ring-size"
+
+NNG_DECL int nng_shm_register(void);
+
+#endif // NNG_TRANSPORT_SHM_SHM_H
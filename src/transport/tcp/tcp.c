@@ -42,14 +42,33 @@ struct nni_tcp_pipe {
 	nni_aio *negaio;
 	nni_msg *rxmsg;
 	nni_mtx  mtx;
+
+	// Send batching (NNG_OPT_SEND_BATCH), off when batchmax is zero.
+	// Small messages are framed back to back in batchbuf, and their
+	// sends completed at once.  The batch is written when the write
+	// before it finishes, when a message does not fit, or when
+	// batchtime passes, whichever is first.
+	size_t       batchmax;
+	nni_duration batchtime;
+	uint8_t *    batchbuf;
+	size_t       batchlen;
+	uint8_t *    txbuf;   // batch being written
+	bool         txbusy;  // txaio is in use
+	bool         txbatch; // txaio is writing txbuf
+	int          txerr;   // a batch failed to write
+	nni_aio *    tmaio;
+	bool         tmbusy;
 };
 
 struct nni_tcp_ep {
 	nni_plat_tcp_ep *tep;
 	uint16_t         proto;
 	size_t           rcvmax;
+	size_t           batchmax;
+	nni_duration     batchtime;
 	nni_duration     linger;
 	int              ipv4only;
+	int              listeners;
 	nni_aio *        aio;
 	nni_aio *        user_aio;
 	nni_url *        url;
@@ -59,6 +78,7 @@ struct nni_tcp_ep {
 };
 
 static void nni_tcp_pipe_send_cb(void *);
+static void nni_tcp_pipe_timer_cb(void *);
 static void nni_tcp_pipe_recv_cb(void *);
 static void nni_tcp_pipe_nego_cb(void *);
 static void nni_tcp_ep_cb(void *arg);
@@ -88,11 +108,13 @@ nni_tcp_pipe_fini(void *arg)
 	nni_tcp_pipe *p = arg;
 
 	nni_aio_stop(p->rxaio);
+	nni_aio_stop(p->tmaio);
 	nni_aio_stop(p->txaio);
 	nni_aio_stop(p->negaio);
 
 	nni_aio_fini(p->rxaio);
 	nni_aio_fini(p->txaio);
+	nni_aio_fini(p->tmaio);
 	nni_aio_fini(p->negaio);
 	if (p->tpp != NULL) {
 		nni_plat_tcp_pipe_fini(p->tpp);
@@ -100,6 +122,8 @@ nni_tcp_pipe_fini(void *arg)
 	if (p->rxmsg) {
 		nni_msg_free(p->rxmsg);
 	}
+	nni_free(p->batchbuf, p->batchmax);
+	nni_free(p->txbuf, p->batchmax);
 
 	NNI_FREE_STRUCT(p);
 }
@@ -116,6 +140,7 @@ nni_tcp_pipe_init(nni_tcp_pipe **pipep, nni_tcp_ep *ep, void *tpp)
 	nni_mtx_init(&p->mtx);
 	if (((rv = nni_aio_init(&p->txaio, nni_tcp_pipe_send_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->rxaio, nni_tcp_pipe_recv_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->tmaio, nni_tcp_pipe_timer_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->negaio, nni_tcp_pipe_nego_cb, p)) != 0)) {
 		nni_tcp_pipe_fini(p);
 		return (rv);
@@ -125,6 +150,17 @@ nni_tcp_pipe_init(nni_tcp_pipe **pipep, nni_tcp_ep *ep, void *tpp)
 	p->rcvmax = ep->rcvmax;
 	p->tpp    = tpp;
 
+	if (ep->batchmax != 0) {
+		p->batchmax = ep->batchmax;
+		if (((p->batchbuf = nni_alloc(p->batchmax)) == NULL) ||
+		    ((p->txbuf = nni_alloc(p->batchmax)) == NULL)) {
+			nni_tcp_pipe_fini(p);
+			return (NNG_ENOMEM);
+		}
+		p->batchtime = ep->batchtime;
+		nni_aio_set_timeout(p->tmaio, p->batchtime);
+	}
+
 	*pipep = p;
 	return (0);
 }
@@ -203,6 +239,77 @@ done:
 	nni_mtx_unlock(&p->mtx);
 }
 
+// nni_tcp_pipe_send_msg starts writing the message of the user's aio.
+// The lock must be held.
+static void
+nni_tcp_pipe_send_msg(nni_tcp_pipe *p)
+{
+	nni_msg *msg   = nni_aio_get_msg(p->user_txaio);
+	nni_aio *txaio = p->txaio;
+	uint64_t len;
+	int      niov;
+	nni_iov  iov[3];
+
+	len = nni_msg_len(msg) + nni_msg_header_len(msg);
+	NNI_PUT64(p->txlen, len);
+
+	niov              = 0;
+	iov[niov].iov_buf = p->txlen;
+	iov[niov].iov_len = sizeof(p->txlen);
+	niov++;
+	if (nni_msg_header_len(msg) > 0) {
+		iov[niov].iov_buf = nni_msg_header(msg);
+		iov[niov].iov_len = nni_msg_header_len(msg);
+		niov++;
+	}
+	if (nni_msg_len(msg) > 0) {
+		iov[niov].iov_buf = nni_msg_body(msg);
+		iov[niov].iov_len = nni_msg_len(msg);
+		niov++;
+	}
+	nni_aio_set_iov(txaio, niov, iov);
+
+	p->txbusy  = true;
+	p->txbatch = false;
+	nni_plat_tcp_pipe_send(p->tpp, txaio);
+}
+
+// nni_tcp_pipe_send_batch starts writing the messages batched so far,
+// switching buffers so that more can be batched meanwhile.  Lock held.
+static void
+nni_tcp_pipe_send_batch(nni_tcp_pipe *p)
+{
+	uint8_t *buf = p->txbuf;
+	nni_iov  iov;
+
+	p->txbuf    = p->batchbuf;
+	p->batchbuf = buf;
+	iov.iov_buf = p->txbuf;
+	iov.iov_len = p->batchlen;
+	p->batchlen = 0;
+	nni_aio_set_iov(p->txaio, 1, &iov);
+
+	p->txbusy  = true;
+	p->txbatch = true;
+	nni_plat_tcp_pipe_send(p->tpp, p->txaio);
+}
+
+// nni_tcp_pipe_send_next starts the next write, if there is anything to
+// write and the last one is done.  Batched messages were accepted before
+// a waiting one, so they go first.  Lock held.
+static void
+nni_tcp_pipe_send_next(nni_tcp_pipe *p)
+{
+	if (p->txbusy || (p->txerr != 0)) {
+		return;
+	}
+	if (p->batchlen != 0) {
+		nni_tcp_pipe_send_batch(p);
+	} else if (p->user_txaio != NULL) {
+		nni_tcp_pipe_send_msg(p);
+	}
+}
+
 static void
 nni_tcp_pipe_send_cb(void *arg)
 {
@@ -214,35 +321,78 @@ nni_tcp_pipe_send_cb(void *arg)
 	nni_aio *     txaio = p->txaio;
 
 	nni_mtx_lock(&p->mtx);
-	if ((aio = p->user_txaio) == NULL) {
-		nni_mtx_unlock(&p->mtx);
-		return;
-	}
-
-	if ((rv = nni_aio_result(txaio)) != 0) {
-		p->user_txaio = NULL;
-		nni_mtx_unlock(&p->mtx);
-		msg = nni_aio_get_msg(aio);
-		nni_aio_set_msg(aio, NULL);
-		nni_msg_free(msg);
-		nni_aio_finish_error(aio, rv);
-		return;
+	if ((rv = nni_aio_result(txaio)) == 0) {
+		n = nni_aio_count(txaio);
+		nni_aio_iov_advance(txaio, n);
+		if (nni_aio_iov_count(txaio) > 0) {
+			nni_plat_tcp_pipe_send(p->tpp, txaio);
+			nni_mtx_unlock(&p->mtx);
+			return;
+		}
 	}
+	p->txbusy = false;
 
-	n = nni_aio_count(txaio);
-	nni_aio_iov_advance(txaio, n);
-	if (nni_aio_iov_count(txaio) > 0) {
-		nni_plat_tcp_pipe_send(p->tpp, txaio);
+	if (p->txbatch) {
+		// The sends of the batched messages have completed already,
+		// so a failure is reported to the next send instead.
+		if (rv != 0) {
+			p->txerr = rv;
+		}
+		nni_tcp_pipe_send_next(p);
+		if ((p->txerr == 0) || ((aio = p->user_txaio) == NULL)) {
+			nni_mtx_unlock(&p->mtx);
+			return;
+		}
+		rv = p->txerr;
+	} else if ((aio = p->user_txaio) == NULL) {
+		// Canceled.  Anything batched meanwhile still goes out.
+		nni_tcp_pipe_send_next(p);
 		nni_mtx_unlock(&p->mtx);
 		return;
 	}
+	p->user_txaio = NULL;
 
+	// Messages batched while this one was being written may have
+	// missed their timer, so they must be written now.
+	nni_tcp_pipe_send_next(p);
 	nni_mtx_unlock(&p->mtx);
+
 	msg = nni_aio_get_msg(aio);
 	n   = nni_msg_len(msg);
 	nni_aio_set_msg(aio, NULL);
 	nni_msg_free(msg);
-	nni_aio_finish(aio, 0, n);
+	if (rv != 0) {
+		nni_aio_finish_error(aio, rv);
+	} else {
+		nni_aio_finish(aio, 0, n);
+	}
+}
+
+static void
+nni_tcp_pipe_timer_cb(void *arg)
+{
+	nni_tcp_pipe *p = arg;
+
+	nni_mtx_lock(&p->mtx);
+	if (nni_aio_result(p->tmaio) == NNG_ETIMEDOUT) {
+		nni_tcp_pipe_send_next(p);
+	}
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_tcp_cancel_timer(nni_aio *aio, int rv)
+{
+	nni_tcp_pipe *p = nni_aio_get_prov_data(aio);
+
+	nni_mtx_lock(&p->mtx);
+	if (!p->tmbusy) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->tmbusy = false;
+	nni_mtx_unlock(&p->mtx);
+	nni_aio_finish_error(aio, rv);
 }
 
 static void
@@ -338,10 +488,14 @@ nni_tcp_cancel_tx(nni_aio *aio, int rv)
 		return;
 	}
 	p->user_txaio = NULL;
-	nni_mtx_unlock(&p->mtx);
-
-	// cancel the underlying operation.
-	nni_aio_abort(p->txaio, rv);
+	if (p->txbusy && !p->txbatch) {
+		nni_mtx_unlock(&p->mtx);
+		// cancel the underlying operation.
+		nni_aio_abort(p->txaio, rv);
+	} else {
+		// Not started, or behind a batch that must still go out.
+		nni_mtx_unlock(&p->mtx);
+	}
 	nni_aio_finish_error(aio, rv);
 }
 
@@ -350,12 +504,13 @@ nni_tcp_pipe_send(void *arg, nni_aio *aio)
 {
 	nni_tcp_pipe *p   = arg;
 	nni_msg *     msg = nni_aio_get_msg(aio);
-	uint64_t      len;
-	nni_aio *     txaio;
-	int           niov;
-	nni_iov       iov[3];
+	size_t        hlen;
+	size_t        blen;
+	uint8_t *     ptr;
+	int           rv;
 
-	len = nni_msg_len(msg) + nni_msg_header_len(msg);
+	hlen = nni_msg_header_len(msg);
+	blen = nni_msg_len(msg);
 
 	nni_mtx_lock(&p->mtx);
 
@@ -363,30 +518,47 @@ nni_tcp_pipe_send(void *arg, nni_aio *aio)
 		nni_mtx_unlock(&p->mtx);
 		return;
 	}
+	if ((rv = p->txerr) != 0) {
+		nni_mtx_unlock(&p->mtx);
+		nni_aio_finish_error(aio, rv);
+		return;
+	}
 
-	p->user_txaio = aio;
-
-	NNI_PUT64(p->txlen, len);
+	if ((p->batchmax == 0) ||
+	    (sizeof(p->txlen) + hlen + blen > p->batchmax - p->batchlen)) {
+		// Too large to batch, so it is sent by itself, after any
+		// batch already waiting.
+		p->user_txaio = aio;
+		nni_tcp_pipe_send_next(p);
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
 
-	niov              = 0;
-	txaio             = p->txaio;
-	iov[niov].iov_buf = p->txlen;
-	iov[niov].iov_len = sizeof(p->txlen);
-	niov++;
-	if (nni_msg_header_len(msg) > 0) {
-		iov[niov].iov_buf = nni_msg_header(msg);
-		iov[niov].iov_len = nni_msg_header_len(msg);
-		niov++;
+	// Frame it into the batch, exactly as it would go on the wire.
+	ptr = p->batchbuf + p->batchlen;
+	NNI_PUT64(ptr, (uint64_t)(hlen + blen));
+	ptr += sizeof(p->txlen);
+	if (hlen > 0) {
+		memcpy(ptr, nni_msg_header(msg), hlen);
 	}
-	if (nni_msg_len(msg) > 0) {
-		iov[niov].iov_buf = nni_msg_body(msg);
-		iov[niov].iov_len = nni_msg_len(msg);
-		niov++;
+	if (blen > 0) {
+		memcpy(ptr + hlen, nni_msg_body(msg), blen);
+	}
+	p->batchlen += sizeof(p->txlen) + hlen + blen;
+
+	if (!p->txbusy) {
+		if (p->batchtime <= 0) {
+			nni_tcp_pipe_send_batch(p);
+		} else if (!p->tmbusy &&
+		    (nni_aio_start(p->tmaio, nni_tcp_cancel_timer, p) == 0)) {
+			p->tmbusy = true;
+		}
 	}
-	nni_aio_set_iov(txaio, niov, iov);
-
-	nni_plat_tcp_pipe_send(p->tpp, txaio);
 	nni_mtx_unlock(&p->mtx);
+
+	nni_aio_set_msg(aio, NULL);
+	nni_msg_free(msg);
+	nni_aio_finish(aio, 0, blen);
 }
 
 static void
@@ -592,8 +764,9 @@ nni_tcp_ep_init(void **epp, nni_url *url, nni_sock *sock, int mode)
 		nni_tcp_ep_fini(ep);
 		return (rv);
 	}
-	ep->proto = nni_sock_proto(sock);
-	ep->mode  = mode;
+	ep->proto     = nni_sock_proto(sock);
+	ep->mode      = mode;
+	ep->listeners = 1;
 
 	*epp = ep;
 	return (0);
@@ -759,6 +932,43 @@ nni_tcp_ep_getopt_recvmaxsz(void *arg, void *v, size_t *szp)
 	return (nni_getopt_size(ep->rcvmax, v, szp));
 }
 
+// Batches are copied twice over, so there is no point in large ones.
+#define NNI_TCP_BATCH_MAX (1024 * 1024)
+
+static int
+nni_tcp_ep_setopt_batch(void *arg, const void *v, size_t sz)
+{
+	nni_tcp_ep *ep = arg;
+	if (ep == NULL) {
+		return (nni_chkopt_size(v, sz, 0, NNI_TCP_BATCH_MAX));
+	}
+	return (nni_setopt_size(&ep->batchmax, v, sz, 0, NNI_TCP_BATCH_MAX));
+}
+
+static int
+nni_tcp_ep_getopt_batch(void *arg, void *v, size_t *szp)
+{
+	nni_tcp_ep *ep = arg;
+	return (nni_getopt_size(ep->batchmax, v, szp));
+}
+
+static int
+nni_tcp_ep_setopt_batchtime(void *arg, const void *v, size_t sz)
+{
+	nni_tcp_ep *ep = arg;
+	if (ep == NULL) {
+		return (nni_chkopt_ms(v, sz));
+	}
+	return (nni_setopt_ms(&ep->batchtime, v, sz));
+}
+
+static int
+nni_tcp_ep_getopt_batchtime(void *arg, void *v, size_t *szp)
+{
+	nni_tcp_ep *ep = arg;
+	return (nni_getopt_ms(ep->batchtime, v, szp));
+}
+
 static int
 nni_tcp_ep_setopt_linger(void *arg, const void *v, size_t sz)
 {
@@ -776,6 +986,38 @@ nni_tcp_ep_getopt_linger(void *arg, void *v, size_t *szp)
 	return (nni_getopt_ms(ep->linger, v, szp));
 }
 
+static int
+nni_tcp_ep_setopt_listeners(void *arg, const void *v, size_t sz)
+{
+	nni_tcp_ep *ep = arg;
+	int         n;
+	int         rv;
+
+	if ((rv = nni_setopt_int(&n, v, sz, 1, NNI_PLAT_TCP_MAX_LISTENERS)) !=
+	    0) {
+		return (rv);
+	}
+	if (ep == NULL) {
+		return (0);
+	}
+	if (ep->mode == NNI_EP_MODE_DIAL) {
+		return (NNG_ENOTSUP);
+	}
+	nni_mtx_lock(&ep->mtx);
+	if ((rv = nni_plat_tcp_ep_set_listeners(ep->tep, n)) == 0) {
+		ep->listeners = n;
+	}
+	nni_mtx_unlock(&ep->mtx);
+	return (rv);
+}
+
+static int
+nni_tcp_ep_getopt_listeners(void *arg, void *v, size_t *szp)
+{
+	nni_tcp_ep *ep = arg;
+	return (nni_getopt_int(ep->listeners, v, szp));
+}
+
 static nni_tran_pipe_option nni_tcp_pipe_options[] = {
 	{ NNG_OPT_LOCADDR, nni_tcp_pipe_getopt_locaddr },
 	{ NNG_OPT_REMADDR, nni_tcp_pipe_getopt_remaddr },
@@ -809,6 +1051,21 @@ static nni_tran_ep_option nni_tcp_ep_options[] = {
 	    .eo_getopt = nni_tcp_ep_getopt_linger,
 	    .eo_setopt = nni_tcp_ep_setopt_linger,
 	},
+	{
+	    .eo_name   = NNG_OPT_TCP_LISTENERS,
+	    .eo_getopt = nni_tcp_ep_getopt_listeners,
+	    .eo_setopt = nni_tcp_ep_setopt_listeners,
+	},
+	{
+	    .eo_name   = NNG_OPT_SEND_BATCH,
+	    .eo_getopt = nni_tcp_ep_getopt_batch,
+	    .eo_setopt = nni_tcp_ep_setopt_batch,
+	},
+	{
+	    .eo_name   = NNG_OPT_SEND_BATCH_TIME,
+	    .eo_getopt = nni_tcp_ep_getopt_batchtime,
+	    .eo_setopt = nni_tcp_ep_setopt_batchtime,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
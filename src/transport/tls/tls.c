@@ -57,6 +57,7 @@ struct nni_tls_ep {
 	nni_duration     linger;
 	int              ipv4only;
 	int              authmode;
+	int              listeners;
 	nni_aio *        aio;
 	nni_aio *        user_aio;
 	nni_mtx          mtx;
@@ -599,8 +600,9 @@ nni_tls_ep_init(void **epp, nni_url *url, nni_sock *sock, int mode)
 		return (NNG_ENOMEM);
 	}
 	nni_mtx_init(&ep->mtx);
-	ep->url  = url;
-	ep->mode = mode;
+	ep->url       = url;
+	ep->mode      = mode;
+	ep->listeners = 1;
 
 	if (((rv = nni_plat_tcp_ep_init(&ep->tep, &lsa, &rsa, mode)) != 0) ||
 	    ((rv = nni_tls_config_init(&ep->cfg, tlsmode)) != 0) ||
@@ -799,6 +801,38 @@ nni_tls_ep_getopt_linger(void *arg, void *v, size_t *szp)
 	return (nni_getopt_ms(ep->linger, v, szp));
 }
 
+static int
+nni_tls_ep_setopt_listeners(void *arg, const void *v, size_t sz)
+{
+	nni_tls_ep *ep = arg;
+	int         n;
+	int         rv;
+
+	if ((rv = nni_setopt_int(&n, v, sz, 1, NNI_PLAT_TCP_MAX_LISTENERS)) !=
+	    0) {
+		return (rv);
+	}
+	if (ep == NULL) {
+		return (0);
+	}
+	if (ep->mode == NNI_EP_MODE_DIAL) {
+		return (NNG_ENOTSUP);
+	}
+	nni_mtx_lock(&ep->mtx);
+	if ((rv = nni_plat_tcp_ep_set_listeners(ep->tep, n)) == 0) {
+		ep->listeners = n;
+	}
+	nni_mtx_unlock(&ep->mtx);
+	return (rv);
+}
+
+static int
+nni_tls_ep_getopt_listeners(void *arg, void *v, size_t *szp)
+{
+	nni_tls_ep *ep = arg;
+	return (nni_getopt_int(ep->listeners, v, szp));
+}
+
 static int
 tls_setopt_config(void *arg, const void *data, size_t sz)
 {
@@ -925,6 +959,11 @@ static nni_tran_ep_option nni_tls_ep_options[] = {
 	    .eo_getopt = nni_tls_ep_getopt_linger,
 	    .eo_setopt = nni_tls_ep_setopt_linger,
 	},
+	{
+	    .eo_name   = NNG_OPT_TCP_LISTENERS,
+	    .eo_getopt = nni_tls_ep_getopt_listeners,
+	    .eo_setopt = nni_tls_ep_setopt_listeners,
+	},
 	{
 	    .eo_name   = NNG_OPT_URL,
 	    .eo_getopt = nni_tls_ep_getopt_url,
@@ -43,6 +43,7 @@ struct ws_ep {
 	nni_ws_listener *listener;
 	nni_ws_dialer *  dialer;
 	nni_list         headers; // to send, res or req
+	int              listeners;
 	bool             started;
 };
 
@@ -476,6 +477,36 @@ ws_ep_getopt_recvmaxsz(void *arg, void *v, size_t *szp)
 	return (nni_getopt_size(ep->rcvmax, v, szp));
 }
 
+static int
+ws_ep_setopt_listeners(void *arg, const void *v, size_t sz)
+{
+	ws_ep *ep = arg;
+	int    n;
+	int    rv;
+
+	if ((rv = nni_setopt_int(&n, v, sz, 1, NNI_PLAT_TCP_MAX_LISTENERS)) !=
+	    0) {
+		return (rv);
+	}
+	if (ep == NULL) {
+		return (0);
+	}
+	if (ep->mode == NNI_EP_MODE_DIAL) {
+		return (NNG_ENOTSUP);
+	}
+	if ((rv = nni_ws_listener_set_listeners(ep->listener, n)) == 0) {
+		ep->listeners = n;
+	}
+	return (rv);
+}
+
+static int
+ws_ep_getopt_listeners(void *arg, void *v, size_t *szp)
+{
+	ws_ep *ep = arg;
+	return (nni_getopt_int(ep->listeners, v, szp));
+}
+
 static int
 ws_pipe_getopt_locaddr(void *arg, void *v, size_t *szp)
 {
@@ -574,6 +605,11 @@ static nni_tran_ep_option ws_ep_options[] = {
 	    .eo_getopt = NULL,
 	    .eo_setopt = ws_ep_setopt_reshdrs,
 	},
+	{
+	    .eo_name   = NNG_OPT_TCP_LISTENERS,
+	    .eo_getopt = ws_ep_getopt_listeners,
+	    .eo_setopt = ws_ep_setopt_listeners,
+	},
 
 	// terminate list
 	{ NULL, NULL, NULL },
@@ -706,9 +742,10 @@ ws_ep_init(void **epp, nni_url *url, nni_sock *sock, int mode)
 	// List of pipes (server only).
 	nni_aio_list_init(&ep->aios);
 
-	ep->mode   = mode;
-	ep->lproto = nni_sock_proto(sock);
-	ep->rproto = nni_sock_peer(sock);
+	ep->mode      = mode;
+	ep->lproto    = nni_sock_proto(sock);
+	ep->rproto    = nni_sock_peer(sock);
+	ep->listeners = 1;
 
 	if (mode == NNI_EP_MODE_DIAL) {
 		pname = nni_sock_peer_name(sock);
@@ -923,6 +960,11 @@ static nni_tran_ep_option wss_ep_options[] = {
 	    .eo_getopt = NULL,
 	    .eo_setopt = ws_ep_setopt_reshdrs,
 	},
+	{
+	    .eo_name   = NNG_OPT_TCP_LISTENERS,
+	    .eo_getopt = ws_ep_getopt_listeners,
+	    .eo_setopt = ws_ep_setopt_listeners,
+	},
 	{
 	    .eo_name   = NNG_OPT_TLS_CONFIG,
 	    .eo_getopt = wss_ep_getopt_tlsconfig,
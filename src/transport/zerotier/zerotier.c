@@ -66,6 +66,7 @@ typedef struct zt_ep       zt_ep;
 typedef struct zt_node     zt_node;
 typedef struct zt_frag     zt_frag;
 typedef struct zt_fraglist zt_fraglist;
+typedef struct zt_rcv      zt_rcv;
 
 // Port numbers are stored as 24-bit values in network byte order.
 #define ZT_GET24(ptr, v)                              \
@@ -95,6 +96,7 @@ enum zt_tunables {
 	zt_conn_attempts = 12,    // connection attempts (default)
 	zt_conn_interval = 5000,  // between attempts (msec)
 	zt_udp_sendq     = 16,    // outgoing UDP queue length
+	zt_udp_recvs     = 16,    // UDP receives posted (per family)
 	zt_recvq         = 2,     // max pending recv (per pipe)
 	zt_recv_stale    = 1000,  // frags older than are stale (msec)
 	zt_ping_time     = 60000, // keepalive time (msec)
@@ -168,18 +170,24 @@ struct zt_node {
 	nni_idhash *    zn_lpipes;
 	nni_idhash *    zn_rpipes;
 	nni_idhash *    zn_peers; // indexed by remote address
-	nni_aio *       zn_rcv4_aio;
-	uint8_t *       zn_rcv4_buf;
-	nng_sockaddr    zn_rcv4_addr;
-	nni_aio *       zn_rcv6_aio;
-	uint8_t *       zn_rcv6_buf;
-	nng_sockaddr    zn_rcv6_addr;
+	zt_rcv *        zn_rcv4;
+	zt_rcv *        zn_rcv6;
 	nni_thr         zn_bgthr;
 	int64_t         zn_bgtime;
 	nni_cv          zn_bgcv;
 	nni_cv          zn_snd6_cv;
 };
 
+// Each node keeps several UDP receives posted per address family, so
+// that a burst of wire packets can be collected by the platform in a
+// single batched system call, rather than one call per packet.
+struct zt_rcv {
+	zt_node *    r_ztn;
+	nni_aio *    r_aio;
+	uint8_t *    r_buf;
+	nng_sockaddr r_addr;
+};
+
 // The fragment list is used to keep track of incoming received
 // fragments for reassembly into a complete message.
 struct zt_fraglist {
@@ -334,11 +342,24 @@ zt_node_resched(zt_node *ztn, int64_t msec)
 	nni_cv_wake1(&ztn->zn_bgcv);
 }
 
+static void
+zt_node_rcv_post(nni_plat_udp *udp, zt_rcv *rcv)
+{
+	nni_iov iov;
+
+	iov.iov_buf = rcv->r_buf;
+	iov.iov_len = zt_rcv_bufsize;
+	nni_aio_set_iov(rcv->r_aio, 1, &iov);
+	nni_aio_set_input(rcv->r_aio, 0, &rcv->r_addr);
+	nni_plat_udp_recv(udp, rcv->r_aio);
+}
+
 static void
 zt_node_rcv4_cb(void *arg)
 {
-	zt_node *               ztn = arg;
-	nni_aio *               aio = ztn->zn_rcv4_aio;
+	zt_rcv *                rcv = arg;
+	zt_node *               ztn = rcv->r_ztn;
+	nni_aio *               aio = rcv->r_aio;
 	struct sockaddr_storage sa;
 	struct sockaddr_in *    sin;
 	nng_sockaddr_in *       nsin;
@@ -354,7 +375,7 @@ zt_node_rcv4_cb(void *arg)
 
 	memset(&sa, 0, sizeof(sa));
 	sin                  = (void *) &sa;
-	nsin                 = &ztn->zn_rcv4_addr.s_un.s_in;
+	nsin                 = &rcv->r_addr.s_un.s_in;
 	sin->sin_family      = AF_INET;
 	sin->sin_port        = nsin->sa_port;
 	sin->sin_addr.s_addr = nsin->sa_addr;
@@ -367,21 +388,14 @@ zt_node_rcv4_cb(void *arg)
 	// XXX: CHECK THIS, if it fails then we have a fatal error with
 	// the znode, and have to shut everything down.
 	ZT_Node_processWirePacket(ztn->zn_znode, NULL, now, 0, (void *) &sa,
-	    ztn->zn_rcv4_buf, nni_aio_count(aio), &now);
+	    rcv->r_buf, nni_aio_count(aio), &now);
 
 	// Schedule background work
 	zt_node_resched(ztn, now);
 
 	// Schedule another receive.
 	if (ztn->zn_udp4 != NULL) {
-		nni_iov iov;
-		iov.iov_buf = ztn->zn_rcv4_buf;
-		iov.iov_len = zt_rcv_bufsize;
-		nni_aio_set_iov(aio, 1, &iov);
-
-		nni_aio_set_input(aio, 0, &ztn->zn_rcv4_addr);
-
-		nni_plat_udp_recv(ztn->zn_udp4, aio);
+		zt_node_rcv_post(ztn->zn_udp4, rcv);
 	}
 	nni_mtx_unlock(&zt_lk);
 }
@@ -389,8 +403,9 @@ zt_node_rcv4_cb(void *arg)
 static void
 zt_node_rcv6_cb(void *arg)
 {
-	zt_node *                ztn = arg;
-	nni_aio *                aio = ztn->zn_rcv6_aio;
+	zt_rcv *                 rcv = arg;
+	zt_node *                ztn = rcv->r_ztn;
+	nni_aio *                aio = rcv->r_aio;
 	struct sockaddr_storage  sa;
 	struct sockaddr_in6 *    sin6;
 	struct nng_sockaddr_in6 *nsin6;
@@ -406,7 +421,7 @@ zt_node_rcv6_cb(void *arg)
 
 	memset(&sa, 0, sizeof(sa));
 	sin6              = (void *) &sa;
-	nsin6             = &ztn->zn_rcv6_addr.s_un.s_in6;
+	nsin6             = &rcv->r_addr.s_un.s_in6;
 	sin6->sin6_family = AF_INET6;
 	sin6->sin6_port   = nsin6->sa_port;
 	memcpy(&sin6->sin6_addr, nsin6->sa_addr, 16);
@@ -417,19 +432,14 @@ zt_node_rcv6_cb(void *arg)
 	// We are not going to perform any validation of the data; we
 	// just pass this straight into the ZeroTier core.
 	ZT_Node_processWirePacket(ztn->zn_znode, NULL, now, 0, (void *) &sa,
-	    ztn->zn_rcv6_buf, nni_aio_count(aio), &now);
+	    rcv->r_buf, nni_aio_count(aio), &now);
 
 	// Schedule background work
 	zt_node_resched(ztn, now);
 
 	// Schedule another receive.
 	if (ztn->zn_udp6 != NULL) {
-		nni_iov iov;
-		iov.iov_buf = ztn->zn_rcv6_buf;
-		iov.iov_len = zt_rcv_bufsize;
-		nni_aio_set_iov(aio, 1, &iov);
-		nni_aio_set_input(aio, 0, &ztn->zn_rcv6_addr);
-		nni_plat_udp_recv(ztn->zn_udp6, aio);
+		zt_node_rcv_post(ztn->zn_udp6, rcv);
 	}
 	nni_mtx_unlock(&zt_lk);
 }
@@ -739,7 +749,7 @@ zt_ep_recv_conn_req(zt_ep *ep, uint64_t raddr, const uint8_t *data, size_t len)
 
 	NNI_GET16(data + zt_offset_creq_proto, ep->ze_creqs[i].cr_proto);
 	ep->ze_creqs[i].cr_raddr  = raddr;
-	ep->ze_creqs[i].cr_expire = nni_clock() + zt_listen_expire;
+	ep->ze_creqs[i].cr_expire = nni_clock_coarse() + zt_listen_expire;
 	ep->ze_creq_head++;
 
 	zt_ep_doaccept(ep);
@@ -1397,11 +1407,56 @@ static struct ZT_Node_Callbacks zt_callbacks = {
 	.pathLookupFunction           = NULL,
 };
 
+static void
+zt_node_rcv_fini(zt_rcv *rcvs)
+{
+	if (rcvs == NULL) {
+		return;
+	}
+	for (int i = 0; i < zt_udp_recvs; i++) {
+		zt_rcv *rcv = &rcvs[i];
+		if (rcv->r_buf != NULL) {
+			nni_free(rcv->r_buf, zt_rcv_bufsize);
+		}
+		nni_aio_fini(rcv->r_aio);
+	}
+	NNI_FREE_STRUCTS(rcvs, zt_udp_recvs);
+}
+
+static int
+zt_node_rcv_init(zt_node *ztn, zt_rcv **rcvsp, nni_cb cb)
+{
+	zt_rcv *rcvs;
+	int     rv;
+
+	if ((rcvs = NNI_ALLOC_STRUCTS(rcvs, zt_udp_recvs)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	*rcvsp = rcvs;
+	for (int i = 0; i < zt_udp_recvs; i++) {
+		zt_rcv *rcv = &rcvs[i];
+		rcv->r_ztn  = ztn;
+		if ((rv = nni_aio_init(&rcv->r_aio, cb, rcv)) != 0) {
+			return (rv);
+		}
+		if ((rcv->r_buf = nni_alloc(zt_rcv_bufsize)) == NULL) {
+			return (NNG_ENOMEM);
+		}
+	}
+	return (0);
+}
+
 static void
 zt_node_destroy(zt_node *ztn)
 {
-	nni_aio_stop(ztn->zn_rcv4_aio);
-	nni_aio_stop(ztn->zn_rcv6_aio);
+	for (int i = 0; i < zt_udp_recvs; i++) {
+		if (ztn->zn_rcv4 != NULL) {
+			nni_aio_stop(ztn->zn_rcv4[i].r_aio);
+		}
+		if (ztn->zn_rcv6 != NULL) {
+			nni_aio_stop(ztn->zn_rcv6[i].r_aio);
+		}
+	}
 
 	// Wait for background thread to exit!
 	nni_thr_fini(&ztn->zn_bgthr);
@@ -1417,17 +1472,11 @@ zt_node_destroy(zt_node *ztn)
 		nni_plat_udp_close(ztn->zn_udp6);
 	}
 
-	if (ztn->zn_rcv4_buf != NULL) {
-		nni_free(ztn->zn_rcv4_buf, zt_rcv_bufsize);
-	}
-	if (ztn->zn_rcv6_buf != NULL) {
-		nni_free(ztn->zn_rcv6_buf, zt_rcv_bufsize);
-	}
 	if (ztn->zn_flock != NULL) {
 		nni_file_unlock(ztn->zn_flock);
 	}
-	nni_aio_fini(ztn->zn_rcv4_aio);
-	nni_aio_fini(ztn->zn_rcv6_aio);
+	zt_node_rcv_fini(ztn->zn_rcv4);
+	zt_node_rcv_fini(ztn->zn_rcv6);
 	nni_idhash_fini(ztn->zn_eps);
 	nni_idhash_fini(ztn->zn_lpipes);
 	nni_idhash_fini(ztn->zn_rpipes);
@@ -1444,7 +1493,6 @@ zt_node_create(zt_node **ztnp, const char *path)
 	nng_sockaddr       sa6;
 	int                rv;
 	enum ZT_ResultCode zrv;
-	nni_iov            iov;
 
 	// We want to bind to any address we can (for now).
 	// Note that at the moment we only support IPv4.  Its
@@ -1464,15 +1512,11 @@ zt_node_create(zt_node **ztnp, const char *path)
 	NNI_LIST_INIT(&ztn->zn_eplist, zt_ep, ze_link);
 	NNI_LIST_INIT(&ztn->zn_plist, zt_pipe, zp_link);
 	nni_cv_init(&ztn->zn_bgcv, &zt_lk);
-	nni_aio_init(&ztn->zn_rcv4_aio, zt_node_rcv4_cb, ztn);
-	nni_aio_init(&ztn->zn_rcv6_aio, zt_node_rcv6_cb, ztn);
-
-	if (((ztn->zn_rcv4_buf = nni_alloc(zt_rcv_bufsize)) == NULL) ||
-	    ((ztn->zn_rcv6_buf = nni_alloc(zt_rcv_bufsize)) == NULL)) {
-		zt_node_destroy(ztn);
-		return (NNG_ENOMEM);
-	}
-	if (((rv = nni_idhash_init(&ztn->zn_ports)) != 0) ||
+	if (((rv = zt_node_rcv_init(ztn, &ztn->zn_rcv4, zt_node_rcv4_cb)) !=
+	        0) ||
+	    ((rv = zt_node_rcv_init(ztn, &ztn->zn_rcv6, zt_node_rcv6_cb)) !=
+	        0) ||
+	    ((rv = nni_idhash_init(&ztn->zn_ports)) != 0) ||
 	    ((rv = nni_idhash_init(&ztn->zn_eps)) != 0) ||
 	    ((rv = nni_idhash_init(&ztn->zn_lpipes)) != 0) ||
 	    ((rv = nni_idhash_init(&ztn->zn_rpipes)) != 0) ||
@@ -1523,18 +1567,11 @@ zt_node_create(zt_node **ztnp, const char *path)
 	// Schedule an initial background run.
 	zt_node_resched(ztn, 1);
 
-	// Schedule receive
-	iov.iov_buf = ztn->zn_rcv4_buf;
-	iov.iov_len = zt_rcv_bufsize;
-	nni_aio_set_iov(ztn->zn_rcv4_aio, 1, &iov);
-	nni_aio_set_input(ztn->zn_rcv4_aio, 0, &ztn->zn_rcv4_addr);
-	iov.iov_buf = ztn->zn_rcv6_buf;
-	iov.iov_len = zt_rcv_bufsize;
-	nni_aio_set_iov(ztn->zn_rcv6_aio, 1, &iov);
-	nni_aio_set_input(ztn->zn_rcv6_aio, 0, &ztn->zn_rcv6_addr);
-
-	nni_plat_udp_recv(ztn->zn_udp4, ztn->zn_rcv4_aio);
-	nni_plat_udp_recv(ztn->zn_udp6, ztn->zn_rcv6_aio);
+	// Schedule receives
+	for (int i = 0; i < zt_udp_recvs; i++) {
+		zt_node_rcv_post(ztn->zn_udp4, &ztn->zn_rcv4[i]);
+		zt_node_rcv_post(ztn->zn_udp6, &ztn->zn_rcv6[i]);
+	}
 
 	*ztnp = ztn;
 	return (0);
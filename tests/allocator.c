@@ -0,0 +1,211 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "core/nng_impl.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The counters are updated from whatever thread the library allocates
+// in, so they use atomics.  The byte counts are kept modulo 2^32, which
+// is enough to check that they balance.
+typedef struct {
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t bytes;
+	uint32_t large_allocs;
+	uint32_t large_frees;
+} counts;
+
+static counts cnt;
+
+static void *
+count_alloc(size_t sz, void *arg)
+{
+	counts *c = arg;
+
+	nni_plat_atomic_add32(&c->allocs, 1);
+	nni_plat_atomic_add32(&c->bytes, (int32_t) sz);
+	return (malloc(sz));
+}
+
+static void
+count_free(void *ptr, size_t sz, void *arg)
+{
+	counts *c = arg;
+
+	nni_plat_atomic_add32(&c->frees, 1);
+	nni_plat_atomic_add32(&c->bytes, -(int32_t) sz);
+	free(ptr);
+}
+
+static void *
+count_alloc_large(size_t sz, void *arg)
+{
+	counts *c = arg;
+
+	nni_plat_atomic_add32(&c->large_allocs, 1);
+	return (malloc(sz));
+}
+
+static void
+count_free_large(void *ptr, size_t sz, void *arg)
+{
+	counts *c = arg;
+
+	(void) sz;
+	nni_plat_atomic_add32(&c->large_frees, 1);
+	free(ptr);
+}
+
+static uint32_t
+allocs(void)
+{
+	return (nni_plat_atomic_load32(&cnt.allocs));
+}
+
+// Sends and receives msgs messages of the given size, reusing the same
+// aios, as a steady state application would.
+static void
+exchange(nng_socket s1, nng_socket s2, int msgs, size_t sz)
+{
+	nng_aio *saio;
+	nng_aio *raio;
+	nng_msg *msg;
+
+	So(nng_aio_alloc(&saio, NULL, NULL) == 0);
+	So(nng_aio_alloc(&raio, NULL, NULL) == 0);
+	nng_aio_set_timeout(saio, 5000);
+	nng_aio_set_timeout(raio, 5000);
+	for (int i = 0; i < msgs; i++) {
+		if (nng_msg_alloc(&msg, sz) != 0) {
+			So(false);
+			break;
+		}
+		nng_aio_set_msg(saio, msg);
+		nng_recv_aio(s2, raio);
+		nng_send_aio(s1, saio);
+		nng_aio_wait(saio);
+		nng_aio_wait(raio);
+		if ((nng_aio_result(saio) != 0) ||
+		    (nng_aio_result(raio) != 0)) {
+			So(nng_aio_result(saio) == 0);
+			So(nng_aio_result(raio) == 0);
+			break;
+		}
+		nng_msg_free(nng_aio_get_msg(raio));
+	}
+	nng_aio_free(saio);
+	nng_aio_free(raio);
+}
+
+// Returns the allocations per message once the connection is warm.
+static double
+steady_state(const char *addr, size_t sz)
+{
+	nng_socket s1;
+	nng_socket s2;
+	uint32_t   start;
+	int        msgs = 2000;
+	double     per;
+
+	So(nng_pair1_open(&s1) == 0);
+	So(nng_pair1_open(&s2) == 0);
+	So(nng_listen(s2, addr, NULL, 0) == 0);
+	So(nng_dial(s1, addr, NULL, 0) == 0);
+
+	// Until enough buffers are circulating between the threads, the
+	// pool still misses occasionally, so warm up well.
+	exchange(s1, s2, 5000, sz);
+	start = allocs();
+	exchange(s1, s2, msgs, sz);
+	per = (double) (allocs() - start) / msgs;
+
+	nng_close(s1);
+	nng_close(s2);
+	return (per);
+}
+
+TestMain("Allocator hooks", {
+	nng_allocator a;
+
+	memset(&cnt, 0, sizeof(cnt));
+	memset(&a, 0, sizeof(a));
+	a.na_alloc = count_alloc;
+	a.na_free  = count_free;
+	a.na_arg   = &cnt;
+
+	Reset({
+		nng_fini();
+		nng_init_set_allocator(NULL);
+	});
+
+	Convey("Incomplete hooks are rejected", {
+		a.na_free = NULL;
+		So(nng_init_set_allocator(&a) == NNG_EINVAL);
+		a.na_free        = count_free;
+		a.na_alloc_large = count_alloc_large;
+		So(nng_init_set_allocator(&a) == NNG_EINVAL);
+		a.na_free_large = count_free_large;
+		So(nng_init_set_allocator(&a) == 0);
+	});
+
+	Convey("Hooks cannot change while initialized", {
+		nng_msg *msg;
+
+		So(nng_msg_alloc(&msg, 0) == 0);
+		So(nng_init_set_allocator(&a) == NNG_EBUSY);
+		nng_msg_free(msg);
+		nng_fini();
+		So(nng_init_set_allocator(&a) == 0);
+	});
+
+	Convey("All memory goes through the hooks", {
+		So(nng_init_set_allocator(&a) == 0);
+		So(steady_state("inproc://alloc", 100) >= 0);
+		nng_fini();
+		So(cnt.allocs > 0);
+		So(cnt.frees == cnt.allocs);
+		So(cnt.bytes == 0);
+	});
+
+	Convey("Large message buffers use the large hooks", {
+		nng_msg *msg;
+
+		a.na_alloc_large = count_alloc_large;
+		a.na_free_large  = count_free_large;
+		So(nng_init_set_allocator(&a) == 0);
+
+		So(nng_msg_alloc(&msg, 1000) == 0);
+		nng_msg_free(msg);
+		So(cnt.large_allocs == 0);
+
+		So(nng_msg_alloc(&msg, 100000) == 0);
+		So(cnt.large_allocs == 1);
+		So(nng_msg_append(msg, "abc", 3) == 0);
+		nng_msg_free(msg);
+		So(cnt.large_frees == cnt.large_allocs);
+	});
+
+	Convey("Steady state messaging does not allocate", {
+		So(nng_init_set_allocator(&a) == 0);
+
+		Convey("Over inproc", {
+			So(steady_state("inproc://alloc", 100) < 0.01);
+		});
+
+		Convey("Over IPC", {
+			So(steady_state("ipc:///tmp/nng_alloc", 100) < 0.01);
+		});
+	});
+});
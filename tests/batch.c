@@ -0,0 +1,204 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "protocol/pipeline0/pull.h"
+#include "protocol/pipeline0/push.h"
+#include "protocol/pubsub0/pub.h"
+#include "protocol/pubsub0/sub.h"
+#include "stubs.h"
+#include "supplemental/util/platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NMSGS 32
+
+static void
+mkmsgs(nng_msg **msgv, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		if ((nng_msg_alloc(&msgv[i], 0) != 0) ||
+		    (nng_msg_append_u32(msgv[i], (uint32_t) i) != 0)) {
+			abort();
+		}
+	}
+}
+
+static void
+freemsgs(nng_msg **msgv, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		nng_msg_free(msgv[i]);
+	}
+}
+
+// recvall receives n messages, in batches, checking that they arrive
+// in order.  It returns the number of calls it took.
+static int
+recvall(nng_socket s, size_t n)
+{
+	nng_msg *msgv[NMSGS];
+	size_t   got = 0;
+	size_t   cnt;
+	uint32_t v;
+	int      calls = 0;
+
+	while (got < n) {
+		if (nng_recvmsgv(s, msgv, NMSGS, &cnt, 0) != 0) {
+			return (-1);
+		}
+		calls++;
+		for (size_t i = 0; i < cnt; i++) {
+			if ((nng_msg_trim_u32(msgv[i], &v) != 0) ||
+			    (v != got + i)) {
+				freemsgs(msgv, cnt);
+				return (-1);
+			}
+		}
+		freemsgs(msgv, cnt);
+		got += cnt;
+	}
+	return (calls);
+}
+
+TestMain("Batched send and receive", {
+	atexit(nng_fini);
+
+	Convey("Given a PUSH socket with no peer", {
+		nng_socket push;
+		nng_msg *  msgv[10];
+		size_t     cnt;
+
+		So(nng_push0_open(&push) == 0);
+		Reset({ nng_close(push); });
+		So(nng_setopt_int(push, NNG_OPT_SENDBUF, 4) == 0);
+
+		Convey("An empty batch is invalid", {
+			So(nng_sendmsgv(push, msgv, 0, &cnt, 0) == NNG_EINVAL);
+			So(cnt == 0);
+		});
+
+		Convey("Nonblocking sends take what fits", {
+			mkmsgs(msgv, 10);
+
+			// One is held by the protocol, the rest queued.
+			So(nng_sendmsgv(push, msgv, 10, &cnt,
+			       NNG_FLAG_NONBLOCK) == 0);
+			So(cnt == 5);
+			So(nng_sendmsgv(push, msgv + cnt, 10 - cnt, &cnt,
+			       NNG_FLAG_NONBLOCK) == NNG_EAGAIN);
+			So(cnt == 0);
+			freemsgs(msgv + 5, 5);
+		});
+
+		Convey("Blocking sends time out", {
+			So(nng_setopt_ms(push, NNG_OPT_SENDTIMEO, 10) == 0);
+			mkmsgs(msgv, 10);
+			So(nng_sendmsgv(push, msgv, 10, &cnt, 0) == 0);
+			So(cnt == 5);
+			freemsgs(msgv + 5, 5);
+		});
+	});
+
+	Convey("Given a connected PUSH/PULL pair", {
+		nng_socket push;
+		nng_socket pull;
+		nng_msg *  msgv[NMSGS];
+		size_t     cnt;
+
+		So(nng_push0_open(&push) == 0);
+		So(nng_pull0_open(&pull) == 0);
+		Reset({
+			nng_close(push);
+			nng_close(pull);
+		});
+		So(nng_setopt_int(push, NNG_OPT_SENDBUF, NMSGS) == 0);
+		So(nng_setopt_int(pull, NNG_OPT_RECVBUF, NMSGS) == 0);
+		So(nng_setopt_ms(pull, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_listen(pull, "inproc://batch", NULL, 0) == 0);
+		So(nng_dial(push, "inproc://batch", NULL, 0) == 0);
+
+		Convey("Nothing to receive", {
+			So(nng_recvmsgv(pull, msgv, NMSGS, &cnt,
+			       NNG_FLAG_NONBLOCK) == NNG_EAGAIN);
+			So(cnt == 0);
+		});
+
+		Convey("Batches arrive in order", {
+			mkmsgs(msgv, NMSGS);
+			So(nng_sendmsgv(push, msgv, NMSGS, &cnt, 0) == 0);
+			So(cnt == NMSGS);
+			So(recvall(pull, NMSGS) > 0);
+		});
+
+		Convey("Queued messages are received together", {
+			mkmsgs(msgv, NMSGS);
+			So(nng_sendmsgv(push, msgv, NMSGS, &cnt, 0) == 0);
+			So(cnt == NMSGS);
+			nng_msleep(100);
+			So(recvall(pull, NMSGS) < NMSGS);
+		});
+	});
+
+	Convey("Given a connected PUB/SUB pair", {
+		nng_socket pub;
+		nng_socket sub;
+		nng_msg *  msgv[NMSGS];
+		size_t     cnt;
+
+		So(nng_pub0_open(&pub) == 0);
+		So(nng_sub0_open(&sub) == 0);
+		Reset({
+			nng_close(pub);
+			nng_close(sub);
+		});
+		So(nng_setopt_int(pub, NNG_OPT_SENDBUF, NMSGS) == 0);
+		So(nng_setopt_int(sub, NNG_OPT_RECVBUF, NMSGS) == 0);
+		So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_setopt(sub, NNG_OPT_SUB_SUBSCRIBE, "", 0) == 0);
+		So(nng_listen(sub, "inproc://batch", NULL, 0) == 0);
+		So(nng_dial(pub, "inproc://batch", NULL, 0) == 0);
+		nng_msleep(100);
+
+		// PUB drops what a pipe cannot keep up with, so the batch
+		// is kept within the pipe's queue.
+		Convey("Batches are published in order", {
+			mkmsgs(msgv, 8);
+			So(nng_sendmsgv(pub, msgv, 8, &cnt, 0) == 0);
+			So(cnt == 8);
+			So(recvall(sub, 8) > 0);
+		});
+	});
+
+	Convey("Protocols without batch support still work", {
+		nng_socket s1;
+		nng_socket s2;
+		nng_msg *  msgv[4];
+		size_t     cnt;
+
+		So(nng_pair1_open(&s1) == 0);
+		So(nng_pair1_open(&s2) == 0);
+		Reset({
+			nng_close(s1);
+			nng_close(s2);
+		});
+		So(nng_setopt_ms(s2, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_listen(s2, "inproc://batch", NULL, 0) == 0);
+		So(nng_dial(s1, "inproc://batch", NULL, 0) == 0);
+
+		mkmsgs(msgv, 4);
+		So(nng_sendmsgv(s1, msgv, 4, &cnt, 0) == 0);
+		So(cnt == 4);
+		So(recvall(s2, 4) == 4);
+	});
+})
@@ -0,0 +1,115 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "nng.h"
+#include "supplemental/util/platform.h"
+
+#define NMSGS 5000
+
+static nng_msg *msgs[NMSGS];
+
+static void
+allocator(void *arg)
+{
+	size_t sz = *(size_t *) arg;
+
+	for (int i = 0; i < NMSGS; i++) {
+		if (nng_msg_alloc(&msgs[i], sz) != 0) {
+			msgs[i] = NULL;
+		}
+	}
+}
+
+static void
+freer(void *arg)
+{
+	(void) arg;
+	for (int i = 0; i < NMSGS; i++) {
+		nng_msg_free(msgs[i]);
+	}
+}
+
+static void
+run(void (*fn)(void *), void *arg)
+{
+	nng_thread *thr;
+
+	So(nng_thread_create(&thr, fn, arg) == 0);
+	nng_thread_destroy(thr);
+}
+
+TestMain("Message buffer pool", {
+	Convey("Freed buffers are reused", {
+		nng_bufpool_stats st;
+		nng_msg *         msg;
+
+		for (int i = 0; i < 1000; i++) {
+			So(nng_msg_alloc(&msg, 100) == 0);
+			nng_msg_free(msg);
+		}
+		nng_bufpool_get_stats(&st);
+		So(st.s_allocs >= 512);
+		So(st.s_hits >= 511);
+		So(st.s_hits <= st.s_allocs);
+		So(st.s_cached > 0);
+		nng_fini();
+	});
+
+	Convey("Buffers cycle between threads", {
+		nng_bufpool_stats st;
+		size_t            sz = 1000;
+
+		// One thread allocates, another frees, and then the first
+		// allocates again, which it can only do from the pool if
+		// the freed buffers made their way back.
+		run(allocator, &sz);
+		run(freer, NULL);
+		nng_bufpool_get_stats(&st);
+		So(st.s_drains > 0);
+		So(st.s_refills == 0);
+
+		run(allocator, &sz);
+		nng_bufpool_get_stats(&st);
+		So(st.s_refills > 0);
+		So(st.s_hits > NMSGS / 2);
+		run(freer, NULL);
+		nng_fini();
+	});
+
+	Convey("Large messages are not pooled", {
+		nng_bufpool_stats st;
+		nng_msg *         msg;
+
+		So(nng_msg_alloc(&msg, 1000000) == 0);
+		nng_msg_append(msg, "abc", 3);
+		nng_msg_free(msg);
+		nng_bufpool_get_stats(&st);
+		So(st.s_cached < 1000000);
+		nng_fini();
+	});
+
+	Convey("The pool can be disabled", {
+		nng_bufpool_stats st;
+		nng_msg *         msg;
+
+		nng_init_set_parameter(NNG_INIT_BUFPOOL_THREAD_CACHE, 0);
+		for (int i = 0; i < 1000; i++) {
+			So(nng_msg_alloc(&msg, 100) == 0);
+			nng_msg_free(msg);
+		}
+		nng_bufpool_get_stats(&st);
+		So(st.s_allocs == 0);
+		So(st.s_cached == 0);
+		nng_fini();
+		nng_init_set_parameter(
+		    NNG_INIT_BUFPOOL_THREAD_CACHE, 256 * 1024);
+	});
+})
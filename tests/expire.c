@@ -0,0 +1,139 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "protocol/pipeline0/pull.h"
+#include "protocol/pipeline0/push.h"
+#include "supplemental/util/platform.h"
+
+#include <string.h>
+
+// send queues a message holding the string, which goes stale after the
+// given time (or never, if negative).
+static void
+send_str(nng_socket s, const char *str, nng_duration timeout)
+{
+	nng_msg *msg;
+
+	So(nng_msg_alloc(&msg, 0) == 0);
+	So(nng_msg_append(msg, str, strlen(str) + 1) == 0);
+	nng_msg_set_timeout(msg, timeout);
+	So(nng_sendmsg(s, msg, 0) == 0);
+}
+
+static void
+recv_str(nng_socket s, const char *str)
+{
+	nng_msg *msg;
+
+	So(nng_recvmsg(s, &msg, 0) == 0);
+	So(strcmp(nng_msg_body(msg), str) == 0);
+	nng_msg_free(msg);
+}
+
+static uint64_t
+expired(nng_socket s)
+{
+	uint64_t n;
+
+	So(nng_getopt_uint64(s, NNG_OPT_EXPIRED, &n) == 0);
+	return (n);
+}
+
+TestMain("Message deadlines", {
+	Convey("Messages have no deadline by default", {
+		nng_msg *msg;
+		nng_msg *dup;
+
+		So(nng_msg_alloc(&msg, 0) == 0);
+		Reset({ nng_msg_free(msg); });
+		So(nng_msg_get_timeout(msg) == NNG_DURATION_INFINITE);
+
+		nng_msg_set_timeout(msg, 1000);
+		So(nng_msg_get_timeout(msg) > 900);
+		So(nng_msg_get_timeout(msg) <= 1000);
+
+		Convey("Duplicates keep the deadline", {
+			So(nng_msg_dup(&dup, msg) == 0);
+			So(nng_msg_get_timeout(dup) > 900);
+			nng_msg_free(dup);
+		});
+
+		Convey("The deadline can be removed", {
+			nng_msg_set_timeout(msg, NNG_DURATION_INFINITE);
+			So(nng_msg_get_timeout(msg) == NNG_DURATION_INFINITE);
+		});
+
+		Convey("The time left does not go negative", {
+			nng_msg_set_timeout(msg, 0);
+			nng_msleep(10);
+			So(nng_msg_get_timeout(msg) == 0);
+		});
+	});
+
+	Convey("Stale messages are dropped from receive queues", {
+		nng_socket s1;
+		nng_socket s2;
+
+		So(nng_pair1_open(&s1) == 0);
+		So(nng_pair1_open(&s2) == 0);
+		Reset({
+			nng_close(s1);
+			nng_close(s2);
+		});
+		So(nng_setopt_int(s2, NNG_OPT_RECVBUF, 16) == 0);
+		So(nng_setopt_ms(s1, NNG_OPT_SENDTIMEO, 1000) == 0);
+		So(nng_setopt_ms(s2, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_listen(s2, "inproc://expire", NULL, 0) == 0);
+		So(nng_dial(s1, "inproc://expire", NULL, 0) == 0);
+		So(expired(s2) == 0);
+
+		send_str(s1, "stale1", 50);
+		send_str(s1, "stale2", 50);
+		send_str(s1, "fresh1", 5000);
+		send_str(s1, "stale3", 50);
+		nng_msleep(200);
+		send_str(s1, "fresh2", -1);
+
+		recv_str(s2, "fresh1");
+		recv_str(s2, "fresh2");
+		So(expired(s2) == 3);
+		So(expired(s1) == 0);
+	});
+
+	Convey("PUSH does not send stale messages", {
+		nng_socket push;
+		nng_socket pull;
+
+		So(nng_push0_open(&push) == 0);
+		So(nng_pull0_open(&pull) == 0);
+		Reset({
+			nng_close(push);
+			nng_close(pull);
+		});
+		So(nng_setopt_int(push, NNG_OPT_SENDBUF, 8) == 0);
+		So(nng_setopt_ms(push, NNG_OPT_SENDTIMEO, 1000) == 0);
+		So(nng_setopt_ms(pull, NNG_OPT_RECVTIMEO, 1000) == 0);
+
+		// With no peer yet, these wait in the socket.
+		send_str(push, "stale1", 50);
+		send_str(push, "stale2", 50);
+		send_str(push, "stale3", 50);
+		nng_msleep(200);
+
+		So(nng_listen(pull, "inproc://expire_push", NULL, 0) == 0);
+		So(nng_dial(push, "inproc://expire_push", NULL, 0) == 0);
+		send_str(push, "fresh", -1);
+		recv_str(pull, "fresh");
+		So(expired(push) == 3);
+	});
+});
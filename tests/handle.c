@@ -0,0 +1,179 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/handle.c"
+#include "convey.h"
+
+#include "core/nng_impl.h"
+#include "supplemental/util/platform.h"
+
+struct finder {
+	nni_handle_table *t;
+	uint32_t          id;
+	void *            ptr;
+	int               bad;
+};
+
+static void
+finder(void *arg)
+{
+	struct finder *f = arg;
+	void *         ptr;
+
+	for (int i = 0; i < 100000; i++) {
+		if ((nni_handle_find(f->t, f->id, &ptr) != 0) ||
+		    (ptr != f->ptr)) {
+			f->bad++;
+			continue;
+		}
+		nni_handle_rele(f->t, f->id);
+	}
+}
+
+static void
+releaser(void *arg)
+{
+	struct finder *f = arg;
+
+	nng_msleep(100);
+	nni_handle_rele(f->t, f->id);
+}
+
+Main({
+	nni_init();
+	atexit(nni_fini);
+	Test("Handle Tables", {
+		Convey("Given a handle table", {
+			nni_handle_table *t = NULL;
+			char *            one = "one";
+			char *            two = "two";
+			uint32_t          id1;
+			uint32_t          id2;
+			void *            ptr;
+
+			So(nni_handle_table_init(&t) == 0);
+			So(t != NULL);
+			Reset({ nni_handle_table_fini(t); });
+
+			So(nni_handle_alloc(t, &id1, one, 0) == 0);
+			So(nni_handle_alloc(t, &id2, two, 0) == 0);
+
+			Convey("IDs are non-zero and positive", {
+				So(id1 != 0);
+				So(id2 != 0);
+				So(id1 != id2);
+				So((id1 & 0x80000000u) == 0);
+				So((id2 & 0x80000000u) == 0);
+			});
+
+			Convey("We can find objects", {
+				So(nni_handle_find(t, id1, &ptr) == 0);
+				So(ptr == one);
+				So(nni_handle_find(t, id2, &ptr) == 0);
+				So(ptr == two);
+				nni_handle_rele(t, id1);
+				nni_handle_rele(t, id2);
+			});
+
+			Convey("Bogus IDs are not found", {
+				So(nni_handle_find(t, 0, &ptr) == NNG_ENOENT);
+				id1 ^= (1u << 25);
+				So(nni_handle_find(t, id1, NULL) ==
+				    NNG_ENOENT);
+				So(nni_handle_find(t, 0x7fffffff, &ptr) ==
+				    NNG_ENOENT);
+			});
+
+			Convey("Closed objects are not found", {
+				nni_handle_close(t, id1);
+				So(nni_handle_find(t, id1, NULL) ==
+				    NNG_ECLOSED);
+				So(nni_handle_find(t, id2, &ptr) == 0);
+				nni_handle_rele(t, id2);
+			});
+
+			Convey("Freed IDs are not reused", {
+				uint32_t id3;
+
+				nni_handle_close(t, id1);
+				nni_handle_free(t, id1);
+				So(nni_handle_find(t, id1, NULL) ==
+				    NNG_ENOENT);
+				So(nni_handle_alloc(t, &id3, one, 0) == 0);
+				So(id3 != id1);
+				So(nni_handle_find(t, id1, NULL) ==
+				    NNG_ENOENT);
+				So(nni_handle_find(t, id3, &ptr) == 0);
+				So(ptr == one);
+				nni_handle_rele(t, id3);
+			});
+
+			Convey("Close waits for references", {
+				struct finder f;
+				nng_thread *  thr;
+				nng_time      now;
+
+				f.t  = t;
+				f.id = id1;
+				So(nni_handle_find(t, id1, &ptr) == 0);
+				nni_handle_close(t, id1);
+				now = nng_clock();
+				So(nng_thread_create(&thr, releaser, &f) == 0);
+				nni_handle_wait(t, id1, 0);
+				So(nng_clock() >= now + 90);
+				nng_thread_destroy(thr);
+				nni_handle_free(t, id1);
+			});
+
+			Convey("Concurrent lookups are consistent", {
+				struct finder f[4];
+				nng_thread *  thrs[4];
+
+				for (int i = 0; i < 4; i++) {
+					f[i].t   = t;
+					f[i].id  = (i % 2) ? id1 : id2;
+					f[i].ptr = (i % 2) ? one : two;
+					f[i].bad = 0;
+					So(nng_thread_create(
+					       &thrs[i], finder, &f[i]) == 0);
+				}
+				for (int i = 0; i < 4; i++) {
+					nng_thread_destroy(thrs[i]);
+					So(f[i].bad == 0);
+				}
+				nni_handle_close(t, id1);
+				nni_handle_close(t, id2);
+				nni_handle_wait(t, id1, 0);
+				nni_handle_wait(t, id2, 0);
+			});
+		});
+
+		Convey("Many handles can be allocated", {
+			nni_handle_table *t = NULL;
+			uint32_t          id;
+			uint32_t          last = 0;
+			void *            ptr;
+
+			So(nni_handle_table_init(&t) == 0);
+			Reset({ nni_handle_table_fini(t); });
+			for (uint32_t i = 1; i <= 5000; i++) {
+				if ((nni_handle_alloc(t, &id, t, 0) != 0) ||
+				    (id == last)) {
+					So(false);
+					break;
+				}
+				last = id;
+			}
+			So(nni_handle_find(t, last, &ptr) == 0);
+			So(ptr == t);
+			nni_handle_rele(t, last);
+		});
+	});
+})
@@ -19,6 +19,7 @@
 #include "core/nng_impl.h"
 #include "supplemental/tls/tls.h"
 #include "supplemental/http/http.h"
+#include "supplemental/http/http_api.h"
 
 const char *doc1 = "<html><body>Someone <b>is</b> home!</body</html>";
 const char *doc2 = "This is a text file.";
@@ -156,6 +157,181 @@ fail:
 	return (rv);
 }
 
+// httproute issues a request for path under base, with the given method
+// and Host: (if not NULL), and returns the status and body as a string.
+static int
+httproute(const char *base, const char *path, const char *meth,
+    const char *host, uint16_t *statp, char *body, size_t bodysz)
+{
+	int           rv;
+	char          addr[256];
+	nng_http_req *req  = NULL;
+	nng_http_res *res  = NULL;
+	nng_url *     url  = NULL;
+	void *        data = NULL;
+	size_t        size = 0;
+	size_t        len;
+
+	snprintf(addr, sizeof(addr), "%s%s", base, path);
+	if (((rv = nng_url_parse(&url, addr)) != 0) ||
+	    ((rv = nng_http_req_alloc(&req, url)) != 0) ||
+	    ((rv = nng_http_res_alloc(&res)) != 0) ||
+	    ((rv = nng_http_req_set_method(req, meth)) != 0)) {
+		goto fail;
+	}
+	if ((host != NULL) &&
+	    ((rv = nng_http_req_set_header(req, "Host", host)) != 0)) {
+		goto fail;
+	}
+	if ((rv = httpdo(url, req, res, &data, &size)) != 0) {
+		goto fail;
+	}
+	*statp = nng_http_res_get_status(res);
+	len    = size < bodysz ? size : bodysz - 1;
+	memcpy(body, data, len);
+	body[len] = '\0';
+
+fail:
+	if (data != NULL) {
+		nni_free(data, size);
+	}
+	if (url != NULL) {
+		nni_url_free(url);
+	}
+	if (req != NULL) {
+		nng_http_req_free(req);
+	}
+	if (res != NULL) {
+		nng_http_res_free(res);
+	}
+	return (rv);
+}
+
+// A streamer is the state of a handler that sends or receives a chunked
+// entity, one aio at a time.
+typedef struct {
+	nng_aio *      uaio; // the handler's aio
+	nng_aio *      aio;  // our own I/O
+	nng_http_conn *conn;
+	nng_http_res * res;
+	int            nchunk;
+	size_t         len;
+	char           buf[4096];
+} streamer;
+
+#define NCHUNKS 50
+
+static void
+streamer_done(streamer *st, int rv)
+{
+	nng_http_res_free(st->res);
+	st->res = NULL;
+	nng_aio_finish(st->uaio, rv);
+}
+
+// stream_cb sends NCHUNKS chunks, each a line with its number, after
+// the response header.
+static void
+stream_cb(void *arg)
+{
+	streamer *st = arg;
+	nng_iov   iov;
+	int       rv;
+
+	if ((rv = nng_aio_result(st->aio)) != 0) {
+		streamer_done(st, rv);
+		return;
+	}
+	if (st->nchunk == NCHUNKS + 1) {
+		streamer_done(st, 0);
+		return;
+	}
+	if (st->nchunk < NCHUNKS) {
+		iov.iov_buf = st->buf;
+		iov.iov_len = (size_t) snprintf(
+		    st->buf, sizeof(st->buf), "chunk %d\n", st->nchunk);
+		nng_aio_set_iov(st->aio, 1, &iov);
+	} else {
+		nng_aio_set_iov(st->aio, 0, NULL);
+	}
+	st->nchunk++;
+	nng_http_conn_write_chunk(st->conn, st->aio);
+}
+
+static void
+stream_handler(nng_aio *aio)
+{
+	streamer *st;
+
+	st = nng_http_handler_get_data(nng_aio_get_input(aio, 1));
+	st->uaio   = aio;
+	st->conn   = nng_aio_get_input(aio, 2);
+	st->nchunk = 0;
+	nng_aio_set_output(aio, 0, NULL);
+	if ((nng_http_res_alloc(&st->res) != 0) ||
+	    (nng_http_res_set_header(
+	         st->res, "Transfer-Encoding", "chunked") != 0)) {
+		streamer_done(st, NNG_ENOMEM);
+		return;
+	}
+	nng_http_conn_write_res(st->conn, st->res, st->aio);
+}
+
+static void
+upload_read(streamer *st)
+{
+	nng_iov iov;
+
+	iov.iov_buf = st->buf + st->len;
+	iov.iov_len = sizeof(st->buf) - st->len;
+	nng_aio_set_iov(st->aio, 1, &iov);
+	nng_http_conn_read_chunk(st->conn, st->aio);
+}
+
+// upload_cb reads a chunked request entity, and then echoes it back
+// with a plain response.
+static void
+upload_cb(void *arg)
+{
+	streamer *st = arg;
+	int       rv;
+
+	if ((rv = nng_aio_result(st->aio)) != 0) {
+		streamer_done(st, rv);
+		return;
+	}
+	if (st->res != NULL) {
+		// The response was sent.
+		streamer_done(st, 0);
+		return;
+	}
+	if (nng_aio_count(st->aio) != 0) {
+		st->len += nng_aio_count(st->aio);
+		upload_read(st);
+		return;
+	}
+	if ((nng_http_res_alloc(&st->res) != 0) ||
+	    (nng_http_res_copy_data(st->res, st->buf, st->len) != 0)) {
+		streamer_done(st, NNG_ENOMEM);
+		return;
+	}
+	nng_http_conn_write_res(st->conn, st->res, st->aio);
+}
+
+static void
+upload_handler(nng_aio *aio)
+{
+	streamer *st;
+
+	st = nng_http_handler_get_data(nng_aio_get_input(aio, 1));
+	st->uaio = aio;
+	st->conn = nng_aio_get_input(aio, 2);
+	st->len  = 0;
+	st->res  = NULL;
+	nng_aio_set_output(aio, 0, NULL);
+	upload_read(st);
+}
+
 TestMain("HTTP Server", {
 
 	nng_http_server * s;
@@ -260,6 +436,43 @@ TestMain("HTTP Server", {
 				So(nng_aio_count(aio) == strlen(doc1));
 				So(memcmp(chunk, doc1, strlen(doc1)) == 0);
 			});
+
+			Convey("Requests can be repeated on a connection", {
+				char          chunk[1024];
+				nng_http_res *res2;
+				nng_iov       iov;
+				const char *  ptr;
+
+				for (int i = 0; i < 3; i++) {
+					ptr = i == 1 ? "/bogus" : "/home.html";
+					So(nng_http_req_set_uri(req, ptr) ==
+					    0);
+					nng_http_conn_write_req(h, req, aio);
+					nng_aio_wait(aio);
+					So(nng_aio_result(aio) == 0);
+
+					So(nng_http_res_alloc(&res2) == 0);
+					nng_http_conn_read_res(h, res2, aio);
+					nng_aio_wait(aio);
+					So(nng_aio_result(aio) == 0);
+					So(nng_http_res_get_status(res2) ==
+					    (i == 1 ? 404 : 200));
+					ptr = nng_http_res_get_header(
+					    res2, "Content-Length");
+					So(ptr != NULL);
+					iov.iov_len = atoi(ptr);
+					iov.iov_buf = chunk;
+					nng_http_res_free(res2);
+
+					// Drain the body before the next one.
+					So(iov.iov_len > 0);
+					So(iov.iov_len <= sizeof(chunk));
+					So(nng_aio_set_iov(aio, 1, &iov) == 0);
+					nng_http_conn_read_all(h, aio);
+					nng_aio_wait(aio);
+					So(nng_aio_result(aio) == 0);
+				}
+			});
 		});
 	});
 	Convey("Directory serving works", {
@@ -447,4 +660,424 @@ TestMain("HTTP Server", {
 		});
 
 	});
+
+	Convey("Headers work", {
+		nng_http_req *req;
+		char          name[32];
+		char          val[32];
+		const char *  ptr;
+		char *        hdrs;
+
+		So(nng_http_req_alloc(&req, NULL) == 0);
+		Reset({ nng_http_req_free(req); });
+
+		// More than fit in the index.
+		for (int i = 0; i < 40; i++) {
+			snprintf(name, sizeof(name), "X-Header-%d", i);
+			snprintf(val, sizeof(val), "value %d", i);
+			So(nng_http_req_set_header(req, name, val) == 0);
+		}
+		for (int i = 0; i < 40; i++) {
+			snprintf(name, sizeof(name), "x-HEADER-%d", i);
+			snprintf(val, sizeof(val), "value %d", i);
+			So((ptr = nng_http_req_get_header(req, name)) != NULL);
+			So(strcmp(ptr, val) == 0);
+		}
+		So(nng_http_req_get_header(req, "X-Header-40") == NULL);
+
+		So(nng_http_req_add_header(req, "X-Header-3", "more") == 0);
+		So((ptr = nng_http_req_get_header(req, "X-Header-3")) != NULL);
+		So(strcmp(ptr, "value 3, more") == 0);
+		So(nng_http_req_set_header(req, "X-Header-30", "new") == 0);
+		ptr = nng_http_req_get_header(req, "X-Header-30");
+		So(ptr != NULL);
+		So(strcmp(ptr, "new") == 0);
+
+		So(nng_http_req_del_header(req, "X-Header-0") == 0);
+		So(nng_http_req_del_header(req, "X-Header-0") == NNG_ENOENT);
+		So(nng_http_req_get_header(req, "X-Header-0") == NULL);
+		for (int i = 1; i < 40; i++) {
+			snprintf(name, sizeof(name), "X-Header-%d", i);
+			So(nng_http_req_get_header(req, name) != NULL);
+		}
+
+		// Order is preserved.
+		So((hdrs = nni_http_req_headers(req)) != NULL);
+		So(strncmp(hdrs, "X-Header-1: value 1\r\n", 21) == 0);
+		So(strstr(hdrs, "X-Header-3: value 3, more\r\n") != NULL);
+		nni_strfree(hdrs);
+
+		Convey("Repeated headers are merged", {
+			int rv = 0;
+			for (int i = 0; i < 10000; i++) {
+				rv |= nng_http_req_add_header(
+				    req, "X-R", "ab");
+			}
+			So(rv == 0);
+			ptr = nng_http_req_get_header(req, "X-R");
+			So(ptr != NULL);
+			So(strlen(ptr) == (10000 * 2) + (9999 * 2));
+			So(strncmp(ptr, "ab, ab, ", 8) == 0);
+		});
+
+		Convey("Replaced headers reuse their storage", {
+			const char *first;
+			const char *key = "X-S";
+			int         rv  = 0;
+
+			So(nng_http_req_set_header(req, key, "first") == 0);
+			first = nng_http_req_get_header(req, key);
+			for (int i = 0; i < 10000; i++) {
+				snprintf(val, sizeof(val), "v%d", i % 1000);
+				rv |= nng_http_req_set_header(req, key, val);
+			}
+			So(rv == 0);
+			ptr = nng_http_req_get_header(req, key);
+			So(ptr == first);
+			So(strcmp(ptr, "v999") == 0);
+
+			So(nng_http_req_set_header(req, key, "a longer one") ==
+			    0);
+			ptr = nng_http_req_get_header(req, key);
+			So(strcmp(ptr, "a longer one") == 0);
+			So(nng_http_req_set_header(req, key, ptr + 2) == 0);
+			ptr = nng_http_req_get_header(req, key);
+			So(strcmp(ptr, "longer one") == 0);
+			So(nng_http_req_add_header(req, key, "more") == 0);
+			ptr = nng_http_req_get_header(req, key);
+			So(strcmp(ptr, "longer one, more") == 0);
+		});
+
+		Convey("Parsed headers are limited", {
+			char * buf;
+			size_t sz = 128 * 1024;
+			size_t len;
+			size_t n;
+
+			So((buf = nni_alloc(sz)) != NULL);
+			len = (size_t) snprintf(buf, sz, "GET / HTTP/1.1\r\n");
+			for (int i = 0; i < 100; i++) {
+				len += (size_t) snprintf(
+				    buf + len, sz - len, "X-A: b\r\n");
+			}
+			(void) snprintf(buf + len, sz - len, "\r\n");
+			nni_http_req_reset(req);
+			So(nni_http_req_parse(req, buf, len + 2, &n) == 0);
+
+			len = (size_t) snprintf(buf, sz, "GET / HTTP/1.1\r\n");
+			for (int i = 0; i < 101; i++) {
+				len += (size_t) snprintf(
+				    buf + len, sz - len, "X-A: b\r\n");
+			}
+			(void) snprintf(buf + len, sz - len, "\r\n");
+			nni_http_req_reset(req);
+			So(nni_http_req_parse(req, buf, len + 2, &n) ==
+			    NNG_EMSGSIZE);
+
+			// One huge header is also too much.
+			len = (size_t) snprintf(
+			    buf, sz, "GET / HTTP/1.1\r\nX-B: ");
+			memset(buf + len, 'b', sz - len - 4);
+			memcpy(buf + sz - 4, "\r\n\r\n", 4);
+			nni_http_req_reset(req);
+			So(nni_http_req_parse(req, buf, sz, &n) ==
+			    NNG_EMSGSIZE);
+			nni_free(buf, sz);
+		});
+	});
+
+	Convey("Chunked entities work", {
+		char             urlstr[32];
+		nng_url *        url;
+		nng_aio *        aio;
+		nng_http_client *cli;
+		nng_http_conn *  conn;
+		nng_http_req *   req;
+		nng_http_res *   res;
+		streamer         st1;
+		streamer         st2;
+		char             buf[4096];
+		size_t           len;
+		nng_iov          iov[9];
+		const char *     ptr;
+
+		memset(&st1, 0, sizeof(st1));
+		memset(&st2, 0, sizeof(st2));
+		trantest_next_address(urlstr, "http://127.0.0.1:%u");
+		So(nng_url_parse(&url, urlstr) == 0);
+		So(nng_http_server_hold(&s, url) == 0);
+		So(nng_aio_alloc(&aio, NULL, NULL) == 0);
+		So(nng_aio_alloc(&st1.aio, stream_cb, &st1) == 0);
+		So(nng_aio_alloc(&st2.aio, upload_cb, &st2) == 0);
+
+		So(nng_http_handler_alloc(&h, "/stream", stream_handler) == 0);
+		So(nng_http_handler_set_data(h, &st1, NULL) == 0);
+		So(nng_http_server_add_handler(s, h) == 0);
+		So(nng_http_handler_alloc(&h, "/upload", upload_handler) == 0);
+		So(nng_http_handler_set_method(h, "POST") == 0);
+		So(nng_http_handler_set_data(h, &st2, NULL) == 0);
+		So(nng_http_server_add_handler(s, h) == 0);
+		So(nng_http_server_start(s) == 0);
+
+		So(nng_http_client_alloc(&cli, url) == 0);
+		nng_http_client_connect(cli, aio);
+		nng_aio_wait(aio);
+		So(nng_aio_result(aio) == 0);
+		conn = nng_aio_get_output(aio, 0);
+		So(nng_http_req_alloc(&req, url) == 0);
+		Reset({
+			nng_http_client_free(cli);
+			nng_http_conn_close(conn);
+			nng_http_req_free(req);
+			nng_http_server_release(s);
+			nng_aio_free(st1.aio);
+			nng_aio_free(st2.aio);
+			nng_aio_free(aio);
+			nng_url_free(url);
+		});
+
+		Convey("A streamed response can be read", {
+			char expect[4096];
+
+			len = 0;
+			for (int i = 0; i < NCHUNKS; i++) {
+				len += snprintf(expect + len,
+				    sizeof(expect) - len, "chunk %d\n", i);
+			}
+
+			// Twice, to see the connection is still usable.
+			for (int i = 0; i < 2; i++) {
+				So(nng_http_req_set_uri(req, "/stream") == 0);
+				nng_http_conn_write_req(conn, req, aio);
+				nng_aio_wait(aio);
+				So(nng_aio_result(aio) == 0);
+
+				So(nng_http_res_alloc(&res) == 0);
+				nng_http_conn_read_res(conn, res, aio);
+				nng_aio_wait(aio);
+				So(nng_aio_result(aio) == 0);
+				So(nng_http_res_get_status(res) == 200);
+				ptr = nng_http_res_get_header(
+				    res, "Transfer-Encoding");
+				So(ptr != NULL);
+				So(strcmp(ptr, "chunked") == 0);
+				nng_http_res_free(res);
+
+				len = 0;
+				for (;;) {
+					iov[0].iov_buf = buf + len;
+					iov[0].iov_len = sizeof(buf) - len;
+					So(nng_aio_set_iov(aio, 1, iov) == 0);
+					nng_http_conn_read_chunk(conn, aio);
+					nng_aio_wait(aio);
+					So(nng_aio_result(aio) == 0);
+					if (nng_aio_count(aio) == 0) {
+						break;
+					}
+					len += nng_aio_count(aio);
+				}
+				So(len == strlen(expect));
+				So(memcmp(buf, expect, len) == 0);
+			}
+		});
+
+		Convey("A chunked request can be sent", {
+			const char *body = "hello chunked world";
+
+			So(nng_http_req_set_method(req, "POST") == 0);
+			So(nng_http_req_set_uri(req, "/upload") == 0);
+			So(nng_http_req_set_header(
+			       req, "Transfer-Encoding", "chunked") == 0);
+			nng_http_conn_write_req(conn, req, aio);
+			nng_aio_wait(aio);
+			So(nng_aio_result(aio) == 0);
+
+			iov[0].iov_buf = (void *) body;
+			iov[0].iov_len = 6;
+			So(nng_aio_set_iov(aio, 1, iov) == 0);
+			nng_http_conn_write_chunk(conn, aio);
+			nng_aio_wait(aio);
+			So(nng_aio_result(aio) == 0);
+			So(nng_aio_count(aio) == 6);
+
+			// More than eight iovs are refused, also on an aio
+			// that has been used before.
+			for (int i = 0; i < 9; i++) {
+				iov[i].iov_buf = (void *) body;
+				iov[i].iov_len = 1;
+			}
+			So(nng_aio_set_iov(aio, 9, iov) == 0);
+			nng_http_conn_write_chunk(conn, aio);
+			nng_aio_wait(aio);
+			So(nng_aio_result(aio) == NNG_EINVAL);
+
+			iov[0].iov_buf = (void *) (body + 6);
+			iov[0].iov_len = 8;
+			iov[1].iov_buf = (void *) (body + 14);
+			iov[1].iov_len = 5;
+			So(nng_aio_set_iov(aio, 2, iov) == 0);
+			nng_http_conn_write_chunk(conn, aio);
+			nng_aio_wait(aio);
+			So(nng_aio_result(aio) == 0);
+			So(nng_aio_count(aio) == 13);
+
+			So(nng_aio_set_iov(aio, 0, NULL) == 0);
+			nng_http_conn_write_chunk(conn, aio);
+			nng_aio_wait(aio);
+			So(nng_aio_result(aio) == 0);
+
+			So(nng_http_res_alloc(&res) == 0);
+			nng_http_conn_read_res(conn, res, aio);
+			nng_aio_wait(aio);
+			So(nng_aio_result(aio) == 0);
+			So(nng_http_res_get_status(res) == 200);
+			ptr = nng_http_res_get_header(res, "Content-Length");
+			So(ptr != NULL);
+			So(atoi(ptr) == (int) strlen(body));
+			nng_http_res_free(res);
+
+			iov[0].iov_buf = buf;
+			iov[0].iov_len = strlen(body);
+			So(nng_aio_set_iov(aio, 1, iov) == 0);
+			nng_http_conn_read_all(conn, aio);
+			nng_aio_wait(aio);
+			So(nng_aio_result(aio) == 0);
+			So(memcmp(buf, body, strlen(body)) == 0);
+		});
+	});
+
+	Convey("Routing works", {
+		char              urlstr[32];
+		char              path[64];
+		char              body[64];
+		nng_url *         url;
+		nng_http_handler *h7;
+		uint16_t          stat;
+
+		trantest_next_address(urlstr, "http://127.0.0.1:%u");
+		So(nng_url_parse(&url, urlstr) == 0);
+		So(nng_http_server_hold(&s, url) == 0);
+		Reset({
+			nng_http_server_release(s);
+			nng_url_free(url);
+		});
+
+		for (int i = 0; i < 1000; i++) {
+			snprintf(path, sizeof(path), "/api/r%d/item", i);
+			snprintf(body, sizeof(body), "r%d", i);
+			So(nng_http_handler_alloc_static(&h, path, body,
+			       strlen(body), "text/plain") == 0);
+			So(nng_http_server_add_handler(s, h) == 0);
+			if (i == 7) {
+				h7 = h;
+			}
+		}
+		So(nng_http_handler_alloc_static(
+		       &h, "/api/r5/item", "post", 4, "text/plain") == 0);
+		So(nng_http_handler_set_method(h, "POST") == 0);
+		So(nng_http_server_add_handler(s, h) == 0);
+		So(nng_http_handler_alloc_static(
+		       &h, "/api/r5/item", "vhost", 5, "text/plain") == 0);
+		So(nng_http_handler_set_host(h, "vhost.example") == 0);
+		So(nng_http_server_add_handler(s, h) == 0);
+		So(nng_http_handler_alloc_static(
+		       &h, "/files", "files", 5, "text/plain") == 0);
+		So(nng_http_handler_set_tree(h) == 0);
+		So(nng_http_server_add_handler(s, h) == 0);
+		So(nng_http_server_start(s) == 0);
+		nng_msleep(100);
+
+		Convey("Each path finds its handler", {
+			So(httproute(urlstr, "/api/r0/item", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "r0") == 0);
+			So(httproute(urlstr, "/api/r999/item", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "r999") == 0);
+			So(httproute(urlstr, "/api/r7/item/", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "r7") == 0);
+			So(httproute(urlstr, "/api/r7", "GET", NULL, &stat,
+			       body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_NOT_FOUND);
+			So(httproute(urlstr, "/api/r7/item/x", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_NOT_FOUND);
+		});
+
+		Convey("Methods are matched", {
+			So(httproute(urlstr, "/api/r5/item", "POST", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "post") == 0);
+			So(httproute(urlstr, "/api/r6/item", "POST", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_METHOD_NOT_ALLOWED);
+		});
+
+		Convey("Hosts are matched", {
+			So(httproute(urlstr, "/api/r5/item", "GET",
+			       "VHost.Example:80", &stat, body,
+			       sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "vhost") == 0);
+			So(httproute(urlstr, "/api/r6/item", "GET",
+			       "vhost.example", &stat, body,
+			       sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "r6") == 0);
+			So(httproute(urlstr, "/api/r5/item", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "r5") == 0);
+		});
+
+		Convey("Trees match below their path", {
+			So(httproute(urlstr, "/files/a/b/c", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "files") == 0);
+			So(httproute(urlstr, "/filesx", "GET", NULL, &stat,
+			       body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_NOT_FOUND);
+		});
+
+		Convey("Conflicts are refused", {
+			So(nng_http_handler_alloc_static(&h, "/api/r1/item/",
+			       "x", 1, "text/plain") == 0);
+			So(nng_http_server_add_handler(s, h) ==
+			    NNG_EADDRINUSE);
+			nng_http_handler_free(h);
+			So(nng_http_handler_alloc_static(
+			       &h, "/files/x", "x", 1, "text/plain") == 0);
+			So(nng_http_server_add_handler(s, h) ==
+			    NNG_EADDRINUSE);
+			nng_http_handler_free(h);
+			So(nng_http_handler_alloc_static(
+			       &h, "/api", "x", 1, "text/plain") == 0);
+			So(nng_http_handler_set_tree(h) == 0);
+			So(nng_http_server_add_handler(s, h) ==
+			    NNG_EADDRINUSE);
+			nng_http_handler_free(h);
+		});
+
+		Convey("Handlers can be removed and added back", {
+			So(nng_http_server_del_handler(s, h7) == 0);
+			So(nng_http_server_del_handler(s, h7) == NNG_ENOENT);
+			So(httproute(urlstr, "/api/r7/item", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_NOT_FOUND);
+			So(httproute(urlstr, "/api/r8/item", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(nng_http_server_add_handler(s, h7) == 0);
+			So(httproute(urlstr, "/api/r7/item", "GET", NULL,
+			       &stat, body, sizeof(body)) == 0);
+			So(stat == NNG_HTTP_STATUS_OK);
+			So(strcmp(body, "r7") == 0);
+		});
+	});
 })
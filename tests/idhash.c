@@ -137,6 +137,26 @@ Main({
 					So(nni_idhash_count(h) == 0);
 				});
 			});
+
+			Convey("We can resize with 64-bit keys", {
+				void *ptr;
+
+				// The high bits take part in the index, so
+				// they must also be used when rehashing.
+				for (i = 0; i < 1024; i++) {
+					uint64_t id = ((uint64_t) i << 40) | 1;
+					int *    v  = &expect[i];
+					So(nni_idhash_insert(h, id, v) == 0);
+				}
+				So(nni_idhash_count(h) == 1024);
+				for (i = 0; i < 1024; i++) {
+					uint64_t id = ((uint64_t) i << 40) | 1;
+					So(nni_idhash_find(h, id, &ptr) == 0);
+					So(ptr == &expect[i]);
+					So(nni_idhash_remove(h, id) == 0);
+				}
+				So(nni_idhash_count(h) == 0);
+			});
 		});
 	});
 
@@ -0,0 +1,85 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "trantest.h"
+
+#include "stubs.h"
+
+static void
+roundtrip(nng_socket s1, nng_socket s2)
+{
+	nng_msg *msg;
+
+	So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+	So(nng_msg_alloc(&msg, 0) == 0);
+	So(nng_msg_append(msg, "ping", 4) == 0);
+	So(nng_sendmsg(s2, msg, 0) == 0);
+	So(nng_recvmsg(s1, &msg, 0) == 0);
+	So(nng_msg_len(msg) == 4);
+	nng_msg_free(msg);
+}
+
+TestMain("Initialization parameters", {
+	Convey("A single task thread is enough", {
+		nng_socket s1;
+		nng_socket s2;
+
+		nng_init_set_parameter(NNG_INIT_NUM_TASK_THREADS, 1);
+		So(nng_pair1_open(&s1) == 0);
+		So(nng_pair1_open(&s2) == 0);
+		So(nng_listen(s1, "inproc://initparams", NULL, 0) == 0);
+		So(nng_dial(s2, "inproc://initparams", NULL, 0) == 0);
+		roundtrip(s1, s2);
+		nng_close(s2);
+		nng_close(s1);
+		nng_fini();
+		nng_init_set_parameter(NNG_INIT_NUM_TASK_THREADS, 16);
+	});
+
+	Convey("A single poller thread works", {
+		nng_socket s1;
+		nng_socket s2;
+		char       addr[NNG_MAXADDRLEN];
+
+		nng_init_set_parameter(NNG_INIT_NUM_POLLER_THREADS, 1);
+		So(nng_pair1_open(&s1) == 0);
+		So(nng_pair1_open(&s2) == 0);
+		trantest_next_address(addr, "tcp://127.0.0.1:%u");
+		So(nng_listen(s1, addr, NULL, 0) == 0);
+		So(nng_dial(s2, addr, NULL, 0) == 0);
+		roundtrip(s1, s2);
+		nng_close(s2);
+		nng_close(s1);
+		nng_fini();
+	});
+
+	Convey("Without a resolver only numeric addresses work", {
+		nng_socket s1;
+		nng_socket s2;
+		char       addr[NNG_MAXADDRLEN];
+
+		nng_init_set_parameter(NNG_INIT_NUM_RESOLVER_THREADS, 0);
+		So(nng_pair1_open(&s1) == 0);
+		So(nng_pair1_open(&s2) == 0);
+		trantest_next_address(addr, "tcp://127.0.0.1:%u");
+		So(nng_listen(s1, addr, NULL, 0) == 0);
+		So(nng_dial(s2, addr, NULL, 0) == 0);
+		roundtrip(s1, s2);
+		trantest_next_address(addr, "tcp://localhost:%u");
+		So(nng_dial(s2, addr, NULL, 0) == NNG_EADDRINVAL);
+		nng_close(s2);
+		nng_close(s1);
+		nng_fini();
+		nng_init_set_parameter(NNG_INIT_NUM_RESOLVER_THREADS, 4);
+	});
+})
@@ -9,12 +9,236 @@
 //
 
 #include "convey.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "transport/ipc/ipc.h"
 #include "trantest.h"
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 // Inproc tests.
 
 TestMain("IPC Transport", {
 	trantest_test_all("ipc:///tmp/nng_ipc_test_%u");
 
+	Convey("Large messages can be passed by descriptor", {
+		nng_socket   s1;
+		nng_socket   s2;
+		nng_listener l;
+		nng_dialer   d;
+		nng_msg *    msg;
+		char         addr[NNG_MAXADDRLEN];
+		size_t       sz;
+		size_t       size = 256 * 1024;
+
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s2);
+			nng_close(s1);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+		So(nng_setopt_ms(s2, NNG_OPT_RECVTIMEO, 2000) == 0);
+		trantest_next_address(addr, "ipc:///tmp/nng_ipc_test_%u");
+		So(nng_listener_create(&l, s1, addr) == 0);
+		So(nng_listener_getopt_size(
+		       l, NNG_OPT_IPC_MEMFD_THRESHOLD, &sz) == 0);
+		So(sz == 0);
+		So(nng_listener_setopt_size(
+		       l, NNG_OPT_IPC_MEMFD_THRESHOLD, 4096) == 0);
+		So(nng_listener_start(l, 0) == 0);
+		So(nng_dialer_create(&d, s2, addr) == 0);
+		So(nng_dialer_setopt_size(
+		       d, NNG_OPT_IPC_MEMFD_THRESHOLD, 4096) == 0);
+		So(nng_dialer_start(d, 0) == 0);
+
+		So(nng_msg_alloc(&msg, size) == 0);
+		for (size_t i = 0; i < size; i++) {
+			((uint8_t *) nng_msg_body(msg))[i] = (uint8_t) i;
+		}
+		So(nng_sendmsg(s2, msg, 0) == 0);
+		So(nng_recvmsg(s1, &msg, 0) == 0);
+		So(nng_msg_len(msg) == size);
+		for (size_t i = 0; i < size; i++) {
+			uint8_t *body = nng_msg_body(msg);
+			if (body[i] != (uint8_t) i) {
+				So(false);
+				break;
+			}
+		}
+
+		// The body can be written in place.
+		((uint8_t *) nng_msg_body(msg))[0] = 0xff;
+		So(((uint8_t *) nng_msg_body(msg))[0] == 0xff);
+		((uint8_t *) nng_msg_body(msg))[0] = 0;
+
+		// Growing the body gives us a private copy.
+		So(nng_msg_append(msg, "end", 4) == 0);
+		So(nng_msg_len(msg) == size + 4);
+		So(strcmp((char *) nng_msg_body(msg) + size, "end") == 0);
+		So(((uint8_t *) nng_msg_body(msg))[size - 1] ==
+		    (uint8_t)(size - 1));
+
+		// Send it back, then as a small message that goes the
+		// usual way.
+		So(nng_sendmsg(s1, msg, 0) == 0);
+		So(nng_recvmsg(s2, &msg, 0) == 0);
+		So(nng_msg_len(msg) == size + 4);
+		So(nng_msg_chop(msg, size) == 0);
+		So(nng_sendmsg(s2, msg, 0) == 0);
+		So(nng_recvmsg(s1, &msg, 0) == 0);
+		So(nng_msg_len(msg) == 4);
+		nng_msg_free(msg);
+	});
+
+#ifndef _WIN32
+	Convey("Peers without descriptor support are sent inline", {
+		nng_socket         s1;
+		nng_listener       l;
+		nng_msg *          msg;
+		char               addr[NNG_MAXADDRLEN];
+		struct sockaddr_un sun;
+		uint8_t            head[9];
+		size_t             size = 8192;
+		size_t             got;
+		int                fd;
+
+		So(nng_pair_open(&s1) == 0);
+		So((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0);
+		Reset({
+			close(fd);
+			nng_close(s1);
+		});
+		trantest_next_address(addr, "ipc:///tmp/nng_ipc_test_%u");
+		So(nng_listener_create(&l, s1, addr) == 0);
+		So(nng_listener_setopt_size(
+		       l, NNG_OPT_IPC_MEMFD_THRESHOLD, 4096) == 0);
+		So(nng_listener_start(l, 0) == 0);
+
+		// Act as an older peer, which passes no token with its
+		// header, and reads with plain reads.
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		snprintf(sun.sun_path, sizeof(sun.sun_path), "%s",
+		    addr + strlen("ipc://"));
+		So(connect(fd, (struct sockaddr *) &sun, sizeof(sun)) == 0);
+		memcpy(head, "\0SP\0\0\x11\0\0", 8);
+		So(write(fd, head, 8) == 8);
+		So(read(fd, head, 8) == 8);
+		So(memcmp(head, "\0SP\0\0\x11\0\0", 8) == 0);
+		nng_msleep(100);
+
+		So(nng_msg_alloc(&msg, size) == 0);
+		So(nng_sendmsg(s1, msg, 0) == 0);
+		for (got = 0; got < sizeof(head);) {
+			ssize_t n = read(fd, head + got, sizeof(head) - got);
+			So(n > 0);
+			got += (size_t) n;
+		}
+		// Message type 1, with the pair hop count header.
+		So(head[0] == 1);
+		So(head[7] == ((size + 4) >> 8));
+		So(head[8] == ((size + 4) & 0xff));
+	});
+#endif
+
+	Convey("Batched messages are held until the batch time", {
+		nng_socket   s1;
+		nng_socket   s2;
+		nng_listener l;
+		nng_dialer   d;
+		nng_msg *    msg;
+		char         addr[NNG_MAXADDRLEN];
+		uint32_t     v;
+
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s2);
+			nng_close(s1);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 200) == 0);
+		trantest_next_address(addr, "ipc:///tmp/nng_ipc_test_%u");
+		So(nng_listen(s1, addr, &l, 0) == 0);
+		So(nng_dialer_create(&d, s2, addr) == 0);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SEND_BATCH, 4096) == 0);
+		So(nng_dialer_setopt_ms(d, NNG_OPT_SEND_BATCH_TIME, 1000) ==
+		    0);
+		So(nng_dialer_start(d, 0) == 0);
+		nng_msleep(100);
+
+		// The sends complete at once, but nothing is written until
+		// the batch timer fires, and then all of it arrives together.
+		for (uint32_t i = 0; i < 10; i++) {
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_msg_append_u32(msg, i) == 0);
+			So(nng_sendmsg(s2, msg, 0) == 0);
+		}
+		So(nng_recvmsg(s1, &msg, 0) == NNG_ETIMEDOUT);
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+		for (uint32_t i = 0; i < 10; i++) {
+			So(nng_recvmsg(s1, &msg, 0) == 0);
+			So(nng_msg_trim_u32(msg, &v) == 0);
+			So(v == i);
+			So(nng_msg_len(msg) == 0);
+			nng_msg_free(msg);
+		}
+	});
+
+	trantest_batch_behind_large("ipc:///tmp/nng_ipc_test_%u");
+
+	Convey("Small messages can be sent in batches", {
+		nng_socket   s1;
+		nng_socket   s2;
+		nng_listener l;
+		nng_dialer   d;
+		nng_msg *    msg;
+		char         addr[NNG_MAXADDRLEN];
+		size_t       sz;
+		uint32_t     v;
+
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s2);
+			nng_close(s1);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+		trantest_next_address(addr, "ipc:///tmp/nng_ipc_test_%u");
+		So(nng_listen(s1, addr, &l, 0) == 0);
+		So(nng_dialer_create(&d, s2, addr) == 0);
+		So(nng_dialer_getopt_size(d, NNG_OPT_SEND_BATCH, &sz) == 0);
+		So(sz == 0);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SEND_BATCH, 1 << 30) ==
+		    NNG_EINVAL);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SEND_BATCH, 4096) == 0);
+		So(nng_dialer_getopt_size(d, NNG_OPT_SEND_BATCH, &sz) == 0);
+		So(sz == 4096);
+		So(nng_dialer_setopt_size(
+		       d, NNG_OPT_IPC_MEMFD_THRESHOLD, 2048) == 0);
+		So(nng_dialer_start(d, 0) == 0);
+		nng_msleep(100);
+
+		// Every tenth message goes by descriptor, the rest are
+		// batched around it.
+		for (uint32_t i = 0; i < 200; i++) {
+			So(nng_msg_alloc(&msg, (i % 10) == 5 ? 3000 : 12) ==
+			    0);
+			So(nng_msg_insert_u32(msg, i) == 0);
+			So(nng_sendmsg(s2, msg, 0) == 0);
+		}
+		for (uint32_t i = 0; i < 200; i++) {
+			So(nng_recvmsg(s1, &msg, 0) == 0);
+			So(nng_msg_trim_u32(msg, &v) == 0);
+			So(v == i);
+			So(nng_msg_len(msg) == ((i % 10) == 5 ? 3000 : 12));
+			nng_msg_free(msg);
+		}
+	});
+
 	nng_fini();
 })
@@ -148,6 +148,42 @@ TestMain("Message Tests", {
 			So(strcmp(nng_msg_body(msg), "++abc") == 0);
 		});
 
+		Convey("Growing beyond the inline space works", {
+			char     chunk[2000];
+			nng_msg *m2;
+			nng_msg *m3;
+
+			for (int i = 0; i < (int) sizeof(chunk); i++) {
+				chunk[i] = (char) i;
+			}
+			So(nng_msg_append(msg, chunk, 100) == 0);
+			So(nng_msg_header_append(msg, chunk, 100) == 0);
+			So(nng_msg_append(msg, chunk + 100, 1900) == 0);
+			So(nng_msg_header_insert(msg, "abc", 3) == 0);
+			So(nng_msg_len(msg) == sizeof(chunk));
+			So(memcmp(nng_msg_body(msg), chunk, sizeof(chunk)) ==
+			    0);
+			So(nng_msg_header_len(msg) == 103);
+			So(memcmp(nng_msg_header(msg), "abc", 3) == 0);
+			So(memcmp((char *) nng_msg_header(msg) + 3, chunk,
+			       100) == 0);
+
+			So(nng_msg_dup(&m2, msg) == 0);
+			Reset({ nng_msg_free(m2); });
+			So(nng_msg_len(m2) == sizeof(chunk));
+			So(memcmp(nng_msg_body(m2), chunk, sizeof(chunk)) ==
+			    0);
+			So(nng_msg_header_len(m2) == 103);
+			So(memcmp(nng_msg_header(m2), nng_msg_header(msg),
+			       103) == 0);
+
+			So(nng_msg_realloc(msg, 10) == 0);
+			So(nng_msg_dup(&m3, msg) == 0);
+			So(nng_msg_len(m3) == 10);
+			So(memcmp(nng_msg_body(m3), chunk, 10) == 0);
+			nng_msg_free(m3);
+		});
+
 		Convey("Message dup works", {
 			nng_msg *m2;
 
@@ -166,4 +166,177 @@ TestMain("PIPELINE (PUSH/PULL) pattern", {
 		So(nng_recvmsg(pull1, &abc, 0) == NNG_ETIMEDOUT);
 		So(nng_recvmsg(pull2, &abc, 0) == NNG_ETIMEDOUT);
 	});
+
+	Convey("Load balancing policies", {
+		nng_socket push;
+		nng_socket pull1;
+		nng_socket pull2;
+		nng_dialer d1;
+		nng_dialer d2;
+		nng_msg *  msg;
+		int        v;
+		size_t     sz;
+
+		So(nng_push_open(&push) == 0);
+		So(nng_pull_open(&pull1) == 0);
+		So(nng_pull_open(&pull2) == 0);
+
+		Reset({
+			nng_close(push);
+			nng_close(pull1);
+			nng_close(pull2);
+		});
+
+		So(nng_getopt_int(push, NNG_OPT_LB_POLICY, &v) == 0);
+		So(v == NNG_LB_ROUND_ROBIN);
+		So(nng_setopt_int(push, NNG_OPT_LB_POLICY, -1) == NNG_EINVAL);
+		So(nng_setopt_int(push, NNG_OPT_LB_POLICY, 5) == NNG_EINVAL);
+		So(nng_getopt_size(push, NNG_OPT_LB_HASHLEN, &sz) == 0);
+		So(sz == 0);
+
+		So(nng_setopt_int(pull1, NNG_OPT_RECVBUF, 64) == 0);
+		So(nng_setopt_int(pull2, NNG_OPT_RECVBUF, 64) == 0);
+		So(nng_setopt_ms(pull1, NNG_OPT_RECVTIMEO, 100) == 0);
+		So(nng_setopt_ms(pull2, NNG_OPT_RECVTIMEO, 100) == 0);
+
+		// Weights belong to the PUSH side endpoints.
+		So(nng_listen(pull1, "inproc://lb1", NULL, 0) == 0);
+		So(nng_listen(pull2, "inproc://lb2", NULL, 0) == 0);
+		So(nng_dialer_create(&d1, push, "inproc://lb1") == 0);
+		So(nng_dialer_create(&d2, push, "inproc://lb2") == 0);
+		So(nng_dialer_getopt_int(d1, NNG_OPT_LB_WEIGHT, &v) == 0);
+		So(v == 1);
+		So(nng_dialer_setopt_int(d1, NNG_OPT_LB_WEIGHT, 0) ==
+		    NNG_EINVAL);
+
+		Convey("Weighted round robin honors weights", {
+			int n1 = 0;
+			int n2 = 0;
+
+			So(nng_setopt_int(push, NNG_OPT_LB_POLICY,
+			       NNG_LB_WEIGHTED) == 0);
+			So(nng_dialer_setopt_int(d1, NNG_OPT_LB_WEIGHT, 3) ==
+			    0);
+			So(nng_dialer_start(d1, 0) == 0);
+			So(nng_dialer_start(d2, 0) == 0);
+			nng_msleep(100);
+
+			for (int i = 0; i < 40; i++) {
+				So(nng_msg_alloc(&msg, 0) == 0);
+				So(nng_sendmsg(push, msg, 0) == 0);
+				nng_msleep(1);
+			}
+			while (nng_recvmsg(pull1, &msg, 0) == 0) {
+				nng_msg_free(msg);
+				n1++;
+			}
+			while (nng_recvmsg(pull2, &msg, 0) == 0) {
+				nng_msg_free(msg);
+				n2++;
+			}
+			So(n1 == 30);
+			So(n2 == 10);
+		});
+
+		Convey("Least pending avoids a stalled pipe", {
+			int n1[2];
+			int n2[2];
+
+			// Nobody reads pull1 until the end of each round, so
+			// once its buffer fills, what is given to it stays
+			// pending.  Round robin fills it to the pipe depth,
+			// least pending stops after one.
+			So(nng_setopt_int(pull1, NNG_OPT_RECVBUF, 1) == 0);
+			So(nng_dialer_start(d1, 0) == 0);
+			So(nng_dialer_start(d2, 0) == 0);
+			nng_msleep(100);
+
+			for (int r = 0; r < 2; r++) {
+				n1[r] = 0;
+				n2[r] = 0;
+				for (int i = 0; i < 40; i++) {
+					So(nng_msg_alloc(&msg, 0) == 0);
+					So(nng_sendmsg(push, msg, 0) == 0);
+					nng_msleep(1);
+				}
+				while (nng_recvmsg(pull2, &msg, 0) == 0) {
+					nng_msg_free(msg);
+					n2[r]++;
+				}
+				while (nng_recvmsg(pull1, &msg, 0) == 0) {
+					nng_msg_free(msg);
+					n1[r]++;
+				}
+				So(n1[r] + n2[r] == 40);
+
+				// Round robin, the default, went first.
+				So(nng_setopt_int(push, NNG_OPT_LB_POLICY,
+				       NNG_LB_LEAST_PENDING) == 0);
+			}
+			So(n1[1] + 3 <= n1[0]);
+		});
+
+		Convey("The pipe buffer limits a stalled pipe", {
+			int n1 = 0;
+			int n2 = 0;
+
+			// As above, pull1 stalls.  The limit leaves room for
+			// only one message waiting behind the one being sent,
+			// rather than three, so it is given two fewer.
+			So(nng_setopt_int(pull1, NNG_OPT_RECVBUF, 1) == 0);
+			So(nng_setopt_size(push, NNG_OPT_PIPEBUFSZ, 100) == 0);
+			So(nng_dialer_start(d1, 0) == 0);
+			So(nng_dialer_start(d2, 0) == 0);
+			nng_msleep(100);
+
+			for (int i = 0; i < 40; i++) {
+				So(nng_msg_alloc(&msg, 100) == 0);
+				So(nng_sendmsg(push, msg, 0) == 0);
+				nng_msleep(1);
+			}
+			while (nng_recvmsg(pull2, &msg, 0) == 0) {
+				nng_msg_free(msg);
+				n2++;
+			}
+			while (nng_recvmsg(pull1, &msg, 0) == 0) {
+				nng_msg_free(msg);
+				n1++;
+			}
+			So(n1 + n2 == 40);
+			So(n1 <= 8);
+		});
+
+		Convey("Hashing keeps keys on one pipe", {
+			int where[8];
+
+			So(nng_setopt_int(push, NNG_OPT_LB_POLICY,
+			       NNG_LB_HASH) == 0);
+			So(nng_setopt_size(push, NNG_OPT_LB_HASHLEN, 1) == 0);
+			So(nng_dialer_start(d1, 0) == 0);
+			So(nng_dialer_start(d2, 0) == 0);
+			nng_msleep(100);
+
+			for (int i = 0; i < 32; i++) {
+				uint8_t key = (uint8_t)(i % 8);
+				So(nng_msg_alloc(&msg, 0) == 0);
+				So(nng_msg_append(msg, &key, 1) == 0);
+				So(nng_msg_append_u32(msg, (uint32_t) i) == 0);
+				So(nng_sendmsg(push, msg, 0) == 0);
+			}
+			for (int i = 0; i < 8; i++) {
+				where[i] = 0;
+			}
+			while (nng_recvmsg(pull1, &msg, 0) == 0) {
+				where[((uint8_t *) nng_msg_body(msg))[0]] |= 1;
+				nng_msg_free(msg);
+			}
+			while (nng_recvmsg(pull2, &msg, 0) == 0) {
+				where[((uint8_t *) nng_msg_body(msg))[0]] |= 2;
+				nng_msg_free(msg);
+			}
+			for (int i = 0; i < 8; i++) {
+				So((where[i] == 1) || (where[i] == 2));
+			}
+		});
+	});
 });
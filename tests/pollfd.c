@@ -90,6 +90,41 @@ TestMain("Poll FDs", {
 				So(poll(&pfd, 1, 1000) == 1);
 				So((pfd.revents & POLLIN) != 0);
 			});
+
+			Convey("And readiness follows the queue", {
+				struct pollfd pfd;
+				char          buf[8];
+				size_t        len;
+
+				pfd.fd     = fd;
+				pfd.events = POLLIN;
+
+				// Buffer, so both messages are queued at once.
+				So(nng_setopt_int(s1, NNG_OPT_RECVBUF, 4) ==
+				    0);
+				So(nng_send(s2, "one", 4, 0) == 0);
+				So(nng_send(s2, "two", 4, 0) == 0);
+				nng_msleep(50);
+				pfd.revents = 0;
+				So(poll(&pfd, 1, 1000) == 1);
+
+				// Still readable with one message left.
+				len = sizeof(buf);
+				So(nng_recv(s1, buf, &len, 0) == 0);
+				pfd.revents = 0;
+				So(poll(&pfd, 1, 0) == 1);
+
+				// Cleared once drained.
+				len = sizeof(buf);
+				So(nng_recv(s1, buf, &len, 0) == 0);
+				pfd.revents = 0;
+				So(poll(&pfd, 1, 0) == 0);
+
+				// And raised again by the next message.
+				So(nng_send(s2, "three", 6, 0) == 0);
+				pfd.revents = 0;
+				So(poll(&pfd, 1, 1000) == 1);
+			});
 		});
 
 		Convey("We can get a send FD", {
@@ -22,6 +22,12 @@
 	So(nng_msg_len(m) == strlen(s)); \
 	So(memcmp(nng_msg_body(m), s, strlen(s)) == 0)
 
+// Topics that nest, or share leading bytes, along with bodies that do or
+// do not begin with one of them (or with "/some/").
+static const char *match_topics[] = { "/aa", "/ab/c", "/b" };
+static const char *match_yes[]    = { "/aaa", "/ab/cd", "/b", "/bb/c" };
+static const char *match_no[]     = { "/a", "/ab/d", "/ab", "/c", "/" };
+
 TestMain("PUB/SUB pattern", {
 	const char *addr = "inproc://test";
 
@@ -81,6 +87,205 @@ TestMain("PUB/SUB pattern", {
 		});
 	});
 
+	Convey("PUB can conflate messages by key", {
+		nng_socket pub;
+		nng_socket sub;
+		nng_msg *  msg;
+		size_t     sz;
+		int        v;
+		int        n;
+		char       last[16];
+
+		So(nng_pub_open(&pub) == 0);
+		So(nng_sub_open(&sub) == 0);
+		Reset({
+			nng_close(pub);
+			nng_close(sub);
+		});
+
+		So(nng_getopt_size(pub, NNG_OPT_PUB_CONFLATE, &sz) == 0);
+		So(sz == 0);
+		So(nng_getopt_int(pub, NNG_OPT_PUB_LVC, &v) == 0);
+		So(v == 0);
+		So(nng_setopt_size(pub, NNG_OPT_PUB_CONFLATE, 4) == 0);
+		So(nng_setopt_int(pub, NNG_OPT_PUB_LVC, 1) == 0);
+
+		// With no subscribers, these only land in the cache.
+		So(nng_msg_alloc(&msg, 0) == 0);
+		APPENDSTR(msg, "AAAA1");
+		So(nng_sendmsg(pub, msg, 0) == 0);
+		So(nng_msg_alloc(&msg, 0) == 0);
+		APPENDSTR(msg, "BBBB1");
+		So(nng_sendmsg(pub, msg, 0) == 0);
+		So(nng_msg_alloc(&msg, 0) == 0);
+		APPENDSTR(msg, "AAAA2");
+		So(nng_sendmsg(pub, msg, 0) == 0);
+		nng_msleep(20);
+
+		So(nng_setopt(sub, NNG_OPT_SUB_SUBSCRIBE, "", 0) == 0);
+		So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 90) == 0);
+		So(nng_listen(sub, "inproc://conflate", NULL, 0) == 0);
+		So(nng_dial(pub, "inproc://conflate", NULL, 0) == 0);
+		nng_msleep(20);
+
+		So(nng_setopt_size(pub, NNG_OPT_PUB_CONFLATE, 8) == NNG_EBUSY);
+
+		// A late joiner gets the latest value for each key.
+		So(nng_recvmsg(sub, &msg, 0) == 0);
+		CHECKSTR(msg, "AAAA2");
+		nng_msg_free(msg);
+		So(nng_recvmsg(sub, &msg, 0) == 0);
+		CHECKSTR(msg, "BBBB1");
+		nng_msg_free(msg);
+		So(nng_recvmsg(sub, &msg, 0) == NNG_ETIMEDOUT);
+
+		// A burst for one key may be conflated, but the newest
+		// value always makes it through.
+		for (int i = 0; i < 100; i++) {
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_msg_append(msg, "CCCC", 4) == 0);
+			So(nng_msg_append_u32(msg, (uint32_t) i) == 0);
+			So(nng_sendmsg(pub, msg, 0) == 0);
+		}
+		n = 0;
+		while (nng_recvmsg(sub, &msg, 0) == 0) {
+			So(nng_msg_len(msg) == 8);
+			memcpy(last, nng_msg_body(msg), 8);
+			nng_msg_free(msg);
+			n++;
+		}
+		So(n > 0);
+		So(n <= 100);
+		So(memcmp(last, "CCCC\0\0\0\x63", 8) == 0);
+	});
+
+	Convey("The pipe buffer limits conflated messages", {
+		nng_socket pub;
+		nng_socket sub;
+		nng_msg *  msg;
+		int        n;
+
+		So(nng_pub_open(&pub) == 0);
+		So(nng_sub_open(&sub) == 0);
+		Reset({
+			nng_close(pub);
+			nng_close(sub);
+		});
+
+		So(nng_setopt_size(pub, NNG_OPT_PUB_CONFLATE, 4) == 0);
+		So(nng_setopt_size(pub, NNG_OPT_PIPEBUFSZ, 250) == 0);
+		So(nng_setopt(sub, NNG_OPT_SUB_SUBSCRIBE, "", 0) == 0);
+		So(nng_setopt_int(sub, NNG_OPT_RECVBUF, 1) == 0);
+		So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 100) == 0);
+		So(nng_listen(sub, "inproc://conflatemax", NULL, 0) == 0);
+		So(nng_dial(pub, "inproc://conflatemax", NULL, 0) == 0);
+		nng_msleep(50);
+
+		// Nobody reads until the end, so once the subscriber
+		// stalls, distinct keys queue up, but only two fit in the
+		// limit; without it all 20 would be delivered.
+		for (uint32_t i = 0; i < 20; i++) {
+			So(nng_msg_alloc(&msg, 100) == 0);
+			memcpy(nng_msg_body(msg), &i, sizeof(i));
+			So(nng_sendmsg(pub, msg, 0) == 0);
+		}
+		nng_msleep(50);
+		n = 0;
+		while (nng_recvmsg(sub, &msg, 0) == 0) {
+			nng_msg_free(msg);
+			n++;
+		}
+		So(n > 2);
+		So(n <= 9);
+	});
+
+	Convey("Every key in the last-value cache is replaced", {
+		nng_socket pub;
+		nng_socket sub;
+		nng_msg *  msg;
+		uint32_t   key;
+		uint32_t   val;
+
+		So(nng_pub_open(&pub) == 0);
+		So(nng_sub_open(&sub) == 0);
+		Reset({
+			nng_close(pub);
+			nng_close(sub);
+		});
+
+		So(nng_setopt_size(pub, NNG_OPT_PUB_CONFLATE, 4) == 0);
+		So(nng_setopt_int(pub, NNG_OPT_PUB_LVC, 1) == 0);
+
+		// Many keys, each sent twice; only the newest is kept.
+		for (uint32_t v = 0; v < 2; v++) {
+			for (uint32_t i = 0; i < 2000; i++) {
+				So(nng_msg_alloc(&msg, 0) == 0);
+				So(nng_msg_append_u32(msg, i) == 0);
+				So(nng_msg_append_u32(msg, v) == 0);
+				So(nng_sendmsg(pub, msg, 0) == 0);
+			}
+		}
+		nng_msleep(100);
+
+		So(nng_setopt(sub, NNG_OPT_SUB_SUBSCRIBE, "", 0) == 0);
+		So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_listen(sub, "inproc://lvcall", NULL, 0) == 0);
+		So(nng_dial(pub, "inproc://lvcall", NULL, 0) == 0);
+		nng_msleep(50);
+
+		for (uint32_t i = 0; i < 2000; i++) {
+			So(nng_recvmsg(sub, &msg, 0) == 0);
+			So(nng_msg_trim_u32(msg, &key) == 0);
+			So(nng_msg_trim_u32(msg, &val) == 0);
+			So(key == i);
+			So(val == 1);
+			nng_msg_free(msg);
+		}
+		So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 100) == 0);
+		So(nng_recvmsg(sub, &msg, 0) == NNG_ETIMEDOUT);
+	});
+
+	Convey("The last-value cache is bounded", {
+		nng_socket pub;
+		nng_socket sub;
+		nng_msg *  msg;
+		uint32_t   key;
+
+		So(nng_pub_open(&pub) == 0);
+		So(nng_sub_open(&sub) == 0);
+		Reset({
+			nng_close(pub);
+			nng_close(sub);
+		});
+
+		So(nng_setopt_size(pub, NNG_OPT_PUB_CONFLATE, 4) == 0);
+		So(nng_setopt_int(pub, NNG_OPT_PUB_LVC, 1) == 0);
+
+		// Only the first 4096 keys are cached; the rest are
+		// published (to nobody here), but not kept.
+		for (uint32_t i = 0; i < 4200; i++) {
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_msg_append_u32(msg, i) == 0);
+			So(nng_sendmsg(pub, msg, 0) == 0);
+		}
+		nng_msleep(100);
+
+		So(nng_setopt(sub, NNG_OPT_SUB_SUBSCRIBE, "", 0) == 0);
+		So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_listen(sub, "inproc://lvcmax", NULL, 0) == 0);
+		So(nng_dial(pub, "inproc://lvcmax", NULL, 0) == 0);
+		nng_msleep(50);
+
+		for (uint32_t i = 0; i < 4096; i++) {
+			So(nng_recvmsg(sub, &msg, 0) == 0);
+			So(nng_msg_trim_u32(msg, &key) == 0);
+			So(key == i);
+			nng_msg_free(msg);
+		}
+		So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 100) == 0);
+		So(nng_recvmsg(sub, &msg, 0) == NNG_ETIMEDOUT);
+	});
+
 	Convey("We can create a linked PUB/SUB pair", {
 		nng_socket pub;
 		nng_socket sub;
@@ -146,6 +351,89 @@ TestMain("PUB/SUB pattern", {
 			So(nng_recvmsg(sub, &msg, 0) == NNG_ETIMEDOUT);
 		});
 
+		Convey("Subscriptions can be forwarded to pubs", {
+			nng_socket sub2;
+			nng_msg *  msg;
+			int        v;
+
+			// We use raw subs, as they do not filter themselves,
+			// so anything filtered had to be done by the pub.
+			So(nng_sub_open(&sub2) == 0);
+			Reset({ nng_close(sub2); });
+			So(nng_listen(sub2, "inproc://test2", NULL, 0) == 0);
+			So(nng_dial(pub, "inproc://test2", NULL, 0) == 0);
+			So(nng_setopt_int(sub2, NNG_OPT_RAW, 1) == 0);
+			So(nng_setopt_ms(sub2, NNG_OPT_RECVTIMEO, 90) == 0);
+
+			So(nng_getopt_int(sub, NNG_OPT_SUB_FORWARD, &v) == 0);
+			So(v == 0);
+			So(nng_setopt_int(sub, NNG_OPT_SUB_FORWARD, 2) ==
+			    NNG_EINVAL);
+			So(nng_setopt_int(sub, NNG_OPT_RAW, 1) == 0);
+			So(nng_setopt_ms(sub, NNG_OPT_RECVTIMEO, 90) == 0);
+			So(nng_setopt_int(sub, NNG_OPT_SUB_FORWARD, 1) == 0);
+			So(nng_getopt_int(sub, NNG_OPT_SUB_FORWARD, &v) == 0);
+			So(v == 1);
+			So(nng_setopt(sub, NNG_OPT_SUB_SUBSCRIBE, "/some/",
+			       strlen("/some/")) == 0);
+			nng_msleep(50);
+
+			So(nng_msg_alloc(&msg, 0) == 0);
+			APPENDSTR(msg, "/some/like/it/hot");
+			So(nng_sendmsg(pub, msg, 0) == 0);
+			So(nng_recvmsg(sub, &msg, 0) == 0);
+			CHECKSTR(msg, "/some/like/it/hot");
+			nng_msg_free(msg);
+			So(nng_recvmsg(sub2, &msg, 0) == 0);
+			CHECKSTR(msg, "/some/like/it/hot");
+			nng_msg_free(msg);
+
+			So(nng_msg_alloc(&msg, 0) == 0);
+			APPENDSTR(msg, "/other/stuff");
+			So(nng_sendmsg(pub, msg, 0) == 0);
+			So(nng_recvmsg(sub2, &msg, 0) == 0);
+			CHECKSTR(msg, "/other/stuff");
+			nng_msg_free(msg);
+			So(nng_recvmsg(sub, &msg, 0) == NNG_ETIMEDOUT);
+
+			Convey("Forwarded topics are matched by prefix", {
+				const char *opt = NNG_OPT_SUB_SUBSCRIBE;
+
+				for (size_t i = 0; i < 3; i++) {
+					const char *t = match_topics[i];
+					size_t      n = strlen(t);
+					So(nng_setopt(sub, opt, t, n) == 0);
+				}
+				nng_msleep(50);
+				for (size_t i = 0; i < 4; i++) {
+					So(nng_msg_alloc(&msg, 0) == 0);
+					APPENDSTR(msg, match_yes[i]);
+					So(nng_sendmsg(pub, msg, 0) == 0);
+					So(nng_recvmsg(sub, &msg, 0) == 0);
+					CHECKSTR(msg, match_yes[i]);
+					nng_msg_free(msg);
+				}
+				for (size_t i = 0; i < 5; i++) {
+					So(nng_msg_alloc(&msg, 0) == 0);
+					APPENDSTR(msg, match_no[i]);
+					So(nng_sendmsg(pub, msg, 0) == 0);
+				}
+				So(nng_recvmsg(sub, &msg, 0) == NNG_ETIMEDOUT);
+			});
+
+			Convey("And forwarding can be turned off", {
+				So(nng_setopt_int(
+				       sub, NNG_OPT_SUB_FORWARD, 0) == 0);
+				nng_msleep(50);
+				So(nng_msg_alloc(&msg, 0) == 0);
+				APPENDSTR(msg, "/other/stuff");
+				So(nng_sendmsg(pub, msg, 0) == 0);
+				So(nng_recvmsg(sub, &msg, 0) == 0);
+				CHECKSTR(msg, "/other/stuff");
+				nng_msg_free(msg);
+			});
+		});
+
 		Convey("Subs in raw receive", {
 
 			nng_msg *msg;
@@ -0,0 +1,178 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "core/nng_impl.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+
+static nni_msg *
+mkmsg(size_t sz)
+{
+	nni_msg *msg;
+
+	if (nni_msg_alloc(&msg, sz) != 0) {
+		return (NULL);
+	}
+	return (msg);
+}
+
+TestMain("Queue byte limits", {
+	nni_init();
+
+	Convey("Given a queue limited to 1000 bytes", {
+		nni_msgq *mq;
+		nni_msg * msg;
+
+		So(nni_msgq_init(&mq, 10) == 0);
+		Reset({ nni_msgq_fini(mq); });
+		nni_msgq_set_maxbytes(mq, 1000);
+		So(nni_msgq_maxbytes(mq) == 1000);
+
+		Convey("Messages are admitted by size", {
+			So(nni_msgq_tryput(mq, mkmsg(400)) == 0);
+			So(nni_msgq_tryput(mq, mkmsg(400)) == 0);
+			So(nni_msgq_bytes(mq) == 800);
+
+			msg = mkmsg(400);
+			So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+			nni_msg_free(msg);
+			So(nni_msgq_len(mq) == 2);
+
+			// Something smaller still fits.
+			So(nni_msgq_tryput(mq, mkmsg(200)) == 0);
+			So(nni_msgq_bytes(mq) == 1000);
+		});
+
+		Convey("Writers wait for room", {
+			nni_aio *put;
+			nni_aio *get;
+
+			So(nni_aio_init(&put, NULL, NULL) == 0);
+			So(nni_aio_init(&get, NULL, NULL) == 0);
+			Reset({
+				nni_aio_fini(put);
+				nni_aio_fini(get);
+			});
+
+			So(nni_msgq_tryput(mq, mkmsg(600)) == 0);
+			nni_aio_set_msg(put, mkmsg(600));
+			nni_msgq_aio_put(mq, put);
+			So(nni_msgq_len(mq) == 1);
+
+			nni_msgq_aio_get(mq, get);
+			nni_aio_wait(get);
+			So(nni_aio_result(get) == 0);
+			nni_msg_free(nni_aio_get_msg(get));
+
+			nni_aio_wait(put);
+			So(nni_aio_result(put) == 0);
+			So(nni_msgq_len(mq) == 1);
+			So(nni_msgq_bytes(mq) == 600);
+		});
+
+		Convey("Best effort mode drops by size", {
+			nni_aio *put;
+
+			So(nni_aio_init(&put, NULL, NULL) == 0);
+			Reset({ nni_aio_fini(put); });
+			nni_msgq_set_best_effort(mq, 1);
+
+			So(nni_msgq_tryput(mq, mkmsg(600)) == 0);
+			nni_aio_set_msg(put, mkmsg(600));
+			nni_msgq_aio_put(mq, put);
+			nni_aio_wait(put);
+			So(nni_aio_result(put) == 0);
+			So(nni_msgq_len(mq) == 1);
+			So(nni_msgq_bytes(mq) == 600);
+		});
+
+		Convey("Headers count against the limit", {
+			msg = mkmsg(500);
+			So(nni_msg_header_append(msg, "abcd", 4) == 0);
+			So(nni_msgq_tryput(mq, msg) == 0);
+			So(nni_msgq_bytes(mq) == 504);
+			msg = mkmsg(500);
+			So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+			nni_msg_free(msg);
+		});
+
+		Convey("An empty queue takes one large message", {
+			So(nni_msgq_tryput(mq, mkmsg(5000)) == 0);
+			msg = mkmsg(1);
+			So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+			nni_msg_free(msg);
+		});
+
+		Convey("Raising the limit admits more", {
+			So(nni_msgq_tryput(mq, mkmsg(800)) == 0);
+			msg = mkmsg(800);
+			So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+			nni_msgq_set_maxbytes(mq, 0);
+			So(nni_msgq_tryput(mq, msg) == 0);
+			So(nni_msgq_bytes(mq) == 1600);
+		});
+
+		Convey("The message count still applies", {
+			for (int i = 0; i < 10; i++) {
+				So(nni_msgq_tryput(mq, mkmsg(1)) == 0);
+			}
+			msg = mkmsg(1);
+			So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+			nni_msg_free(msg);
+		});
+	});
+
+	Convey("Given a PAIR socket", {
+		nng_socket s;
+		size_t     sz;
+		nng_msg *  msg;
+
+		So(nng_pair1_open(&s) == 0);
+		Reset({ nng_close(s); });
+
+		Convey("The limits are off by default", {
+			So(nng_getopt_size(s, NNG_OPT_SENDBUFSZ, &sz) == 0);
+			So(sz == 0);
+			So(nng_getopt_size(s, NNG_OPT_RECVBUFSZ, &sz) == 0);
+			So(sz == 0);
+			So(nng_getopt_size(s, NNG_OPT_PIPEBUFSZ, &sz) == 0);
+			So(sz == 0);
+		});
+
+		Convey("The limits can be set", {
+			So(nng_setopt_size(s, NNG_OPT_SENDBUFSZ, 1234) == 0);
+			So(nng_getopt_size(s, NNG_OPT_SENDBUFSZ, &sz) == 0);
+			So(sz == 1234);
+			So(nng_setopt_size(s, NNG_OPT_RECVBUFSZ, 4321) == 0);
+			So(nng_getopt_size(s, NNG_OPT_RECVBUFSZ, &sz) == 0);
+			So(sz == 4321);
+			So(nng_setopt_size(s, NNG_OPT_PIPEBUFSZ, 100) == 0);
+			So(nng_getopt_size(s, NNG_OPT_PIPEBUFSZ, &sz) == 0);
+			So(sz == 100);
+		});
+
+		Convey("Sends are held back by bytes", {
+			So(nng_setopt_int(s, NNG_OPT_SENDBUF, 8) == 0);
+			So(nng_setopt_size(s, NNG_OPT_SENDBUFSZ, 1000) == 0);
+
+			// No peer, so the messages stay queued.
+			So(nng_msg_alloc(&msg, 600) == 0);
+			So(nng_sendmsg(s, msg, NNG_FLAG_NONBLOCK) == 0);
+			So(nng_msg_alloc(&msg, 600) == 0);
+			So(nng_sendmsg(s, msg, NNG_FLAG_NONBLOCK) ==
+			    NNG_EAGAIN);
+			So(nng_msg_realloc(msg, 300) == 0);
+			So(nng_sendmsg(s, msg, NNG_FLAG_NONBLOCK) == 0);
+		});
+	});
+
+	nng_fini();
+})
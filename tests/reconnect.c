@@ -15,8 +15,69 @@
 #include "supplemental/util/platform.h"
 
 #include "stubs.h"
+#include <stdio.h>
 #include <string.h>
 
+#if defined(NNG_PLATFORM_LINUX) && defined(NNG_TRANSPORT_TCP)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// stuck_listener opens a TCP listener whose accept queue is already
+// full, so that further connection attempts to it stay in progress
+// (their SYNs are dropped).  It returns the listening socket, and the
+// socket used to fill the queue in cfdp.
+static int
+stuck_listener(uint16_t *portp, int *cfdp)
+{
+	struct sockaddr_in sin;
+	socklen_t          sz = sizeof(sin);
+	int                lfd;
+	int                cfd;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family      = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+	    (bind(lfd, (void *) &sin, sizeof(sin)) != 0) ||
+	    (listen(lfd, 0) != 0) ||
+	    (getsockname(lfd, (void *) &sin, &sz) != 0) ||
+	    ((cfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+	    (connect(cfd, (void *) &sin, sizeof(sin)) != 0)) {
+		return (-1);
+	}
+	*portp = ntohs(sin.sin_port);
+	*cfdp  = cfd;
+	return (lfd);
+}
+
+// count_connecting counts our connection attempts to the port that are
+// still in progress.
+static int
+count_connecting(uint16_t port)
+{
+	FILE *   f;
+	char     line[256];
+	unsigned rport;
+	unsigned state;
+	int      n = 0;
+
+	if ((f = fopen("/proc/net/tcp", "r")) == NULL) {
+		return (-1);
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if ((sscanf(line, " %*u: %*x:%*x %*x:%x %x", &rport, &state) ==
+		        2) &&
+		    (rport == port) && (state == 0x02)) { // SYN_SENT
+			n++;
+		}
+	}
+	(void) fclose(f);
+	return (n);
+}
+#endif
+
 #define APPENDSTR(m, s) nng_msg_append(m, s, strlen(s))
 #define CHECKSTR(m, s)                   \
 	So(nng_msg_len(m) == strlen(s)); \
@@ -100,5 +161,90 @@ TestMain("Reconnect works", {
 				});
 			});
 		});
+
+		Convey("Pending connects can be limited", {
+			int          v;
+			nng_dialer   d1;
+			nng_dialer   d2;
+			nng_dialer   d3;
+			nng_listener l;
+
+			So(nng_getopt_int(push, NNG_OPT_RECONNMAXPEND, &v) == 0);
+			So(v == 0);
+			So(nng_setopt_int(push, NNG_OPT_RECONNMAXPEND, -1) ==
+			    NNG_EINVAL);
+			So(nng_setopt_int(push, NNG_OPT_RECONNMAXPEND, 1) == 0);
+			So(nng_getopt_int(push, NNG_OPT_RECONNMAXPEND, &v) == 0);
+			So(v == 1);
+			So(nng_setopt_ms(push, NNG_OPT_RECONNMINT, 10) == 0);
+			So(nng_setopt_ms(push, NNG_OPT_RECONNMAXT, 50) == 0);
+
+			So(nng_dial(push, addr, &d1, NNG_FLAG_NONBLOCK) == 0);
+			So(nng_dial(push, addr, &d2, NNG_FLAG_NONBLOCK) == 0);
+			So(nng_dial(push, addr, &d3, NNG_FLAG_NONBLOCK) == 0);
+			nng_msleep(100);
+			So(nng_listen(pull, addr, &l, 0) == 0);
+
+			Convey("All dialers eventually connect", {
+				nng_msg *msg;
+
+				So(nng_setopt_ms(pull, NNG_OPT_RECVTIMEO, 1000) ==
+				    0);
+				nng_msleep(500);
+				for (int i = 0; i < 3; i++) {
+					So(nng_msg_alloc(&msg, 0) == 0);
+					APPENDSTR(msg, "hello");
+					So(nng_sendmsg(push, msg, 0) == 0);
+				}
+				for (int i = 0; i < 3; i++) {
+					So(nng_recvmsg(pull, &msg, 0) == 0);
+					CHECKSTR(msg, "hello");
+					nng_msg_free(msg);
+				}
+				So(nng_dialer_close(d1) == 0);
+				So(nng_dialer_close(d2) == 0);
+				So(nng_dialer_close(d3) == 0);
+			});
+		});
+
+#if defined(NNG_PLATFORM_LINUX) && defined(NNG_TRANSPORT_TCP)
+		Convey("Connects in progress are counted against the limit", {
+			nng_socket other;
+			uint16_t   port;
+			int        lfd;
+			int        cfd;
+			char       url[64];
+
+			So((lfd = stuck_listener(&port, &cfd)) >= 0);
+			So(nng_push_open(&other) == 0);
+			Reset({
+				nng_close(other);
+				close(cfd);
+				close(lfd);
+			});
+			(void) snprintf(
+			    url, sizeof(url), "tcp://127.0.0.1:%u", port);
+
+			So(nng_setopt_int(push, NNG_OPT_RECONNMAXPEND, 1) ==
+			    0);
+			for (int i = 0; i < 3; i++) {
+				So(nng_dial(push, url, NULL,
+				       NNG_FLAG_NONBLOCK) == 0);
+			}
+			nng_msleep(200);
+			So(count_connecting(port) == 1);
+
+			// Each socket's dialers use their own limit; this one
+			// can add two more attempts to the one in progress.
+			So(nng_setopt_int(other, NNG_OPT_RECONNMAXPEND, 3) ==
+			    0);
+			for (int i = 0; i < 3; i++) {
+				So(nng_dial(other, url, NULL,
+				       NNG_FLAG_NONBLOCK) == 0);
+			}
+			nng_msleep(200);
+			So(count_connecting(port) == 3);
+		});
+#endif
 	});
 });
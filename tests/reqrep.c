@@ -13,6 +13,7 @@
 #include "protocol/reqrep0/rep.h"
 #include "protocol/reqrep0/req.h"
 #include "stubs.h"
+#include "supplemental/util/platform.h"
 
 #include <string.h>
 
@@ -149,5 +150,262 @@ TestMain("REQ/REP pattern", {
 		So(memcmp(nng_msg_body(cmd), "def", 4) == 0);
 		nng_msg_free(cmd);
 	});
+
+	Convey("Requests can be routed by key", {
+		nng_socket req;
+		nng_socket rep1;
+		nng_socket rep2;
+		nng_socket last = 0;
+		nng_msg *  msg;
+		int        v;
+
+		So(nng_req_open(&req) == 0);
+		So(nng_rep_open(&rep1) == 0);
+		So(nng_rep_open(&rep2) == 0);
+
+		Reset({
+			nng_close(req);
+			nng_close(rep1);
+			nng_close(rep2);
+		});
+
+		So(nng_getopt_int(req, NNG_OPT_LB_POLICY, &v) == 0);
+		So(v == NNG_LB_ROUND_ROBIN);
+		So(nng_setopt_int(req, NNG_OPT_LB_POLICY, 99) == NNG_EINVAL);
+		So(nng_setopt_int(req, NNG_OPT_LB_POLICY, NNG_LB_HASH) == 0);
+		So(nng_setopt_size(req, NNG_OPT_LB_HASHLEN, 3) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_setopt_ms(rep1, NNG_OPT_RECVTIMEO, 100) == 0);
+		So(nng_setopt_ms(rep2, NNG_OPT_RECVTIMEO, 100) == 0);
+
+		So(nng_listen(rep1, "inproc://lb1", NULL, 0) == 0);
+		So(nng_listen(rep2, "inproc://lb2", NULL, 0) == 0);
+		So(nng_dial(req, "inproc://lb1", NULL, 0) == 0);
+		So(nng_dial(req, "inproc://lb2", NULL, 0) == 0);
+		nng_msleep(100);
+
+		for (int i = 0; i < 6; i++) {
+			nng_socket rep;
+
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_msg_append(msg, "key", 3) == 0);
+			So(nng_msg_append_u32(msg, (uint32_t) i) == 0);
+			So(nng_sendmsg(req, msg, 0) == 0);
+			rep = rep1;
+			rv  = nng_recvmsg(rep, &msg, 0);
+			if (rv == NNG_ETIMEDOUT) {
+				rep = rep2;
+				rv  = nng_recvmsg(rep, &msg, 0);
+			}
+			So(rv == 0);
+			if (i > 0) {
+				So(rep == last);
+			}
+			last = rep;
+			So(nng_sendmsg(rep, msg, 0) == 0);
+			So(nng_recvmsg(req, &msg, 0) == 0);
+			So(nng_msg_len(msg) == 7);
+			nng_msg_free(msg);
+		}
+	});
+
+	Convey("Two choices avoids a peer that does not answer", {
+		nng_socket req;
+		nng_socket rep1;
+		nng_socket rep2;
+		nng_msg *  msg;
+		int        n1 = 0;
+
+		So(nng_req_open(&req) == 0);
+		So(nng_rep_open(&rep1) == 0);
+		So(nng_rep_open(&rep2) == 0);
+
+		Reset({
+			nng_close(req);
+			nng_close(rep1);
+			nng_close(rep2);
+		});
+
+		So(nng_setopt_int(req, NNG_OPT_LB_POLICY,
+		       NNG_LB_TWO_CHOICES) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_REQ_RESENDTIME, 50) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_setopt_ms(rep1, NNG_OPT_RECVTIMEO, 100) == 0);
+		So(nng_setopt_ms(rep2, NNG_OPT_RECVTIMEO, 1000) == 0);
+
+		So(nng_listen(rep1, "inproc://two1", NULL, 0) == 0);
+		So(nng_listen(rep2, "inproc://two2", NULL, 0) == 0);
+		So(nng_dial(req, "inproc://two1", NULL, 0) == 0);
+		So(nng_dial(req, "inproc://two2", NULL, 0) == 0);
+		nng_msleep(100);
+
+		// Only rep2 answers.  A request given to rep1 is resent
+		// after the resend time, which is charged to rep1 as its
+		// latency, so it should not be chosen again.
+		for (int i = 0; i < 10; i++) {
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_msg_append_u32(msg, (uint32_t) i) == 0);
+			So(nng_sendmsg(req, msg, 0) == 0);
+			So(nng_recvmsg(rep2, &msg, 0) == 0);
+			So(nng_sendmsg(rep2, msg, 0) == 0);
+			So(nng_recvmsg(req, &msg, 0) == 0);
+			nng_msg_free(msg);
+		}
+		while (nng_recvmsg(rep1, &msg, 0) == 0) {
+			nng_msg_free(msg);
+			n1++;
+		}
+		So(n1 <= 1);
+	});
+
+	Convey("Slow requests are hedged", {
+		nng_socket   req;
+		nng_socket   rep1;
+		nng_socket   rep2;
+		nng_msg *    msg;
+		nng_msg *    stale;
+		nng_duration ms;
+		int          v;
+
+		So(nng_req_open(&req) == 0);
+		So(nng_rep_open(&rep1) == 0);
+		So(nng_rep_open(&rep2) == 0);
+
+		Reset({
+			nng_close(req);
+			nng_close(rep1);
+			nng_close(rep2);
+		});
+
+		So(nng_getopt_int(req, NNG_OPT_REQ_HEDGE, &v) == 0);
+		So(v == 0);
+		So(nng_setopt_int(req, NNG_OPT_REQ_HEDGE, -1) == NNG_EINVAL);
+		So(nng_setopt_int(req, NNG_OPT_REQ_HEDGEPCT, 0) == NNG_EINVAL);
+		So(nng_setopt_int(req, NNG_OPT_REQ_HEDGEPCT, 101) ==
+		    NNG_EINVAL);
+		So(nng_setopt_ms(req, NNG_OPT_REQ_HEDGEDELAY, 1) ==
+		    NNG_EREADONLY);
+		So(nng_setopt_int(req, NNG_OPT_REQ_HEDGE, 1) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_REQ_HEDGETIME, 50) == 0);
+		So(nng_getopt_ms(req, NNG_OPT_REQ_HEDGEDELAY, &ms) == 0);
+		So(ms == 50);
+		So(nng_setopt_ms(req, NNG_OPT_REQ_RESENDTIME, 10000) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_setopt_ms(rep1, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_setopt_ms(rep2, NNG_OPT_RECVTIMEO, 1000) == 0);
+
+		So(nng_listen(rep1, "inproc://hedge1", NULL, 0) == 0);
+		So(nng_listen(rep2, "inproc://hedge2", NULL, 0) == 0);
+		So(nng_dial(req, "inproc://hedge1", NULL, 0) == 0);
+		nng_msleep(50);
+		So(nng_dial(req, "inproc://hedge2", NULL, 0) == 0);
+		nng_msleep(50);
+
+		// The first request goes to rep1, which sits on it.
+		// The copy sent to rep2 gets the answer.
+		So(nng_msg_alloc(&msg, 0) == 0);
+		So(nng_msg_append(msg, "one", 4) == 0);
+		So(nng_sendmsg(req, msg, 0) == 0);
+		So(nng_recvmsg(rep1, &stale, 0) == 0);
+		So(nng_recvmsg(rep2, &msg, 0) == 0);
+		So(nng_sendmsg(rep2, msg, 0) == 0);
+		So(nng_recvmsg(req, &msg, 0) == 0);
+		So(nng_msg_len(msg) == 4);
+		So(memcmp(nng_msg_body(msg), "one", 4) == 0);
+
+		// The late reply is discarded.  (The next request goes to
+		// rep1 again, and is hedged to rep2 in the same way.)
+		So(nng_sendmsg(rep1, stale, 0) == 0);
+		nng_msg_free(msg);
+		So(nng_msg_alloc(&msg, 0) == 0);
+		So(nng_msg_append(msg, "two", 4) == 0);
+		So(nng_sendmsg(req, msg, 0) == 0);
+		So(nng_recvmsg(rep2, &msg, 0) == 0);
+		So(nng_sendmsg(rep2, msg, 0) == 0);
+		So(nng_recvmsg(req, &msg, 0) == 0);
+		So(memcmp(nng_msg_body(msg), "two", 4) == 0);
+		nng_msg_free(msg);
+	});
+
+	Convey("Losing a hedged copy does not resend", {
+		nng_socket req;
+		nng_socket rep1;
+		nng_socket rep2;
+		nng_msg *  msg;
+		nng_msg *  copy;
+
+		So(nng_req_open(&req) == 0);
+		So(nng_rep_open(&rep1) == 0);
+		So(nng_rep_open(&rep2) == 0);
+
+		Reset({
+			nng_close(req);
+			nng_close(rep1);
+			nng_close(rep2);
+		});
+
+		So(nng_setopt_int(req, NNG_OPT_REQ_HEDGE, 1) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_REQ_HEDGETIME, 50) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_REQ_RESENDTIME, 10000) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_setopt_ms(rep1, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_setopt_ms(rep2, NNG_OPT_RECVTIMEO, 1000) == 0);
+
+		So(nng_listen(rep1, "inproc://hedge4", NULL, 0) == 0);
+		So(nng_listen(rep2, "inproc://hedge5", NULL, 0) == 0);
+		So(nng_dial(req, "inproc://hedge4", NULL, 0) == 0);
+		nng_msleep(50);
+		So(nng_dial(req, "inproc://hedge5", NULL, 0) == 0);
+		nng_msleep(50);
+
+		So(nng_msg_alloc(&msg, 0) == 0);
+		So(nng_msg_append(msg, "one", 4) == 0);
+		So(nng_sendmsg(req, msg, 0) == 0);
+		So(nng_recvmsg(rep1, &msg, 0) == 0);
+		So(nng_recvmsg(rep2, &copy, 0) == 0);
+		nng_msg_free(copy);
+
+		// rep1 still has the request, so it is not sent again.
+		So(nng_close(rep2) == 0);
+		So(nng_setopt_ms(rep1, NNG_OPT_RECVTIMEO, 200) == 0);
+		So(nng_recvmsg(rep1, &copy, 0) == NNG_ETIMEDOUT);
+
+		So(nng_sendmsg(rep1, msg, 0) == 0);
+		So(nng_recvmsg(req, &msg, 0) == 0);
+		So(memcmp(nng_msg_body(msg), "one", 4) == 0);
+		nng_msg_free(msg);
+	});
+
+	Convey("Hedge delay follows reply latency", {
+		nng_socket   req;
+		nng_socket   rep;
+		nng_msg *    msg;
+		nng_duration ms;
+
+		So(nng_req_open(&req) == 0);
+		So(nng_rep_open(&rep) == 0);
+
+		Reset({
+			nng_close(req);
+			nng_close(rep);
+		});
+
+		So(nng_setopt_int(req, NNG_OPT_REQ_HEDGE, 1) == 0);
+		So(nng_setopt_ms(req, NNG_OPT_REQ_HEDGETIME, 5000) == 0);
+		So(nng_listen(rep, "inproc://hedge3", NULL, 0) == 0);
+		So(nng_dial(req, "inproc://hedge3", NULL, 0) == 0);
+
+		for (int i = 0; i < 20; i++) {
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_sendmsg(req, msg, 0) == 0);
+			So(nng_recvmsg(rep, &msg, 0) == 0);
+			So(nng_sendmsg(rep, msg, 0) == 0);
+			So(nng_recvmsg(req, &msg, 0) == 0);
+			nng_msg_free(msg);
+		}
+		So(nng_getopt_ms(req, NNG_OPT_REQ_HEDGEDELAY, &ms) == 0);
+		So(ms > 0);
+		So(ms < 5000);
+	});
 	nng_fini();
 })
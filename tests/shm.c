@@ -0,0 +1,71 @@
+//
+// Copyright 2018 Staysail Systems, Inc. <info@staysail.tech>
+// Copyright 2018 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "transport/shm/shm.h"
+#include "trantest.h"
+
+// Shared memory tests.
+
+TestMain("SHM Transport", {
+	trantest_test_all("shm:///tmp/nng_shm_test_%u");
+
+	Convey("Messages larger than the ring work", {
+		nng_socket s1;
+		nng_socket s2;
+		nng_dialer d;
+		nng_msg *  msg;
+		char       addr[NNG_MAXADDRLEN];
+		size_t     sz;
+		size_t     size = 100 * 1024;
+
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s2);
+			nng_close(s1);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+		So(nng_setopt_ms(s2, NNG_OPT_RECVTIMEO, 2000) == 0);
+		trantest_next_address(addr, "shm:///tmp/nng_shm_test_%u");
+		So(nng_listen(s1, addr, NULL, 0) == 0);
+		So(nng_dialer_create(&d, s2, addr) == 0);
+		So(nng_dialer_getopt_size(d, NNG_OPT_SHM_RINGSZ, &sz) == 0);
+		So(sz == 1024 * 1024);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SHM_RINGSZ, 5000) ==
+		    NNG_EINVAL);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SHM_RINGSZ, 1024) ==
+		    NNG_EINVAL);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SHM_RINGSZ, 4096) == 0);
+		So(nng_dialer_start(d, 0) == 0);
+
+		So(nng_msg_alloc(&msg, size) == 0);
+		for (size_t i = 0; i < size; i++) {
+			((uint8_t *) nng_msg_body(msg))[i] = (uint8_t) i;
+		}
+		So(nng_sendmsg(s2, msg, 0) == 0);
+		So(nng_recvmsg(s1, &msg, 0) == 0);
+		So(nng_msg_len(msg) == size);
+		for (size_t i = 0; i < size; i++) {
+			if (((uint8_t *) nng_msg_body(msg))[i] != (uint8_t) i) {
+				So(false);
+				break;
+			}
+		}
+		So(nng_sendmsg(s1, msg, 0) == 0);
+		So(nng_recvmsg(s2, &msg, 0) == 0);
+		So(nng_msg_len(msg) == size);
+		nng_msg_free(msg);
+	});
+
+	nng_fini();
+})
@@ -14,6 +14,7 @@
 #include "protocol/survey0/respond.h"
 #include "protocol/survey0/survey.h"
 #include "stubs.h"
+#include "supplemental/util/platform.h"
 
 #include <string.h>
 
@@ -115,4 +116,73 @@ TestMain("SURVEY pattern", {
 			});
 		});
 	});
+
+	Convey("Surveys can complete early", {
+		nng_socket surv;
+		nng_socket resp1;
+		nng_socket resp2;
+		nng_msg *  msg;
+		uint64_t   start;
+		int        v;
+
+		So(nng_surveyor_open(&surv) == 0);
+		So(nng_respondent_open(&resp1) == 0);
+		So(nng_respondent_open(&resp2) == 0);
+
+		Reset({
+			nng_close(surv);
+			nng_close(resp1);
+			nng_close(resp2);
+		});
+
+		So(nng_getopt_int(surv, NNG_OPT_SURVEYOR_QUORUM, &v) == 0);
+		So(v == 0);
+		So(nng_setopt_int(surv, NNG_OPT_SURVEYOR_QUORUM, -1) ==
+		    NNG_EINVAL);
+		So(nng_getopt_int(surv, NNG_OPT_SURVEYOR_ALL, &v) == 0);
+		So(v == 0);
+		So(nng_setopt_int(surv, NNG_OPT_SURVEYOR_ALL, 2) ==
+		    NNG_EINVAL);
+
+		So(nng_setopt_ms(surv, NNG_OPT_SURVEYOR_SURVEYTIME, 5000) ==
+		    0);
+		So(nng_setopt_int(surv, NNG_OPT_RECVBUF, 8) == 0);
+		So(nng_listen(surv, "inproc://quorum", NULL, 0) == 0);
+		So(nng_dial(resp1, "inproc://quorum", NULL, 0) == 0);
+		So(nng_dial(resp2, "inproc://quorum", NULL, 0) == 0);
+		nng_msleep(50);
+
+		Convey("After a quorum of responses", {
+			So(nng_setopt_int(surv, NNG_OPT_SURVEYOR_QUORUM, 1) ==
+			    0);
+			start = nng_clock();
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_sendmsg(surv, msg, 0) == 0);
+			So(nng_recvmsg(resp1, &msg, 0) == 0);
+			So(nng_sendmsg(resp1, msg, 0) == 0);
+			So(nng_recvmsg(resp2, &msg, 0) == 0);
+			So(nng_sendmsg(resp2, msg, 0) == 0);
+			So(nng_recvmsg(surv, &msg, 0) == 0);
+			nng_msg_free(msg);
+			So(nng_recvmsg(surv, &msg, 0) == NNG_ETIMEDOUT);
+			So(nng_clock() - start < 1000);
+		});
+
+		Convey("When every respondent has answered", {
+			So(nng_setopt_int(surv, NNG_OPT_SURVEYOR_ALL, 1) == 0);
+			start = nng_clock();
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_sendmsg(surv, msg, 0) == 0);
+			So(nng_recvmsg(resp1, &msg, 0) == 0);
+			So(nng_sendmsg(resp1, msg, 0) == 0);
+			So(nng_recvmsg(surv, &msg, 0) == 0);
+			nng_msg_free(msg);
+			So(nng_recvmsg(resp2, &msg, 0) == 0);
+			So(nng_sendmsg(resp2, msg, 0) == 0);
+			So(nng_recvmsg(surv, &msg, 0) == 0);
+			nng_msg_free(msg);
+			So(nng_recvmsg(surv, &msg, 0) == NNG_ETIMEDOUT);
+			So(nng_clock() - start < 1000);
+		});
+	});
 });
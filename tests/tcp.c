@@ -20,6 +20,36 @@
 #include <arpa/inet.h>
 #endif
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NNG_PLATFORM_LINUX
+// count_listeners counts the sockets listening on the local port.
+static int
+count_listeners(uint16_t port)
+{
+	FILE *   f;
+	char     line[256];
+	unsigned lport;
+	unsigned state;
+	int      n = 0;
+
+	if ((f = fopen("/proc/net/tcp", "r")) == NULL) {
+		return (-1);
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if ((sscanf(line, " %*u: %*x:%x %*x:%*x %x", &lport, &state) ==
+		        2) &&
+		    (lport == port) && (state == 0x0a)) {
+			n++;
+		}
+	}
+	(void) fclose(f);
+	return (n);
+}
+#endif
+
 static int
 check_props_v4(nng_msg *msg)
 {
@@ -99,6 +129,197 @@ TestMain("TCP Transport", {
 		So(nng_dial(s2, addr, NULL, 0) == 0);
 	});
 
+	Convey("We can use multiple listening sockets", {
+		nng_socket   s1;
+		nng_socket   s2;
+		nng_listener l;
+		nng_dialer   d;
+		nng_msg *    msg;
+		char         addr[NNG_MAXADDRLEN];
+		size_t       sz;
+		int          n;
+
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s2);
+			nng_close(s1);
+		});
+		So(nng_listener_create(&l, s1, "tcp://127.0.0.1:0") == 0);
+		So(nng_listener_getopt_int(l, NNG_OPT_TCP_LISTENERS, &n) == 0);
+		So(n == 1);
+		So(nng_listener_setopt_int(l, NNG_OPT_TCP_LISTENERS, 0) ==
+		    NNG_EINVAL);
+		So(nng_listener_setopt_int(l, NNG_OPT_TCP_LISTENERS, 4) == 0);
+		So(nng_listener_getopt_int(l, NNG_OPT_TCP_LISTENERS, &n) == 0);
+		So(n == 4);
+		So(nng_listener_start(l, 0) == 0);
+		So(nng_listener_setopt_int(l, NNG_OPT_TCP_LISTENERS, 2) ==
+		    NNG_EBUSY);
+
+		sz = NNG_MAXADDRLEN;
+		So(nng_listener_getopt(l, NNG_OPT_URL, addr, &sz) == 0);
+		So(nng_dialer_create(&d, s2, addr) == 0);
+		So(nng_dialer_setopt_int(d, NNG_OPT_TCP_LISTENERS, 2) ==
+		    NNG_ENOTSUP);
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 1000) == 0);
+		So(nng_dialer_start(d, 0) == 0);
+		So(nng_msg_alloc(&msg, 0) == 0);
+		So(nng_msg_append(msg, "ping", 4) == 0);
+		So(nng_sendmsg(s2, msg, 0) == 0);
+		So(nng_recvmsg(s1, &msg, 0) == 0);
+		So(nng_msg_len(msg) == 4);
+		nng_msg_free(msg);
+	});
+
+	Convey("Connections are accepted on every listening socket", {
+		nng_socket   s1;
+		nng_socket   s2[64];
+		int          ns2 = 0;
+		nng_listener l;
+		nng_msg *    msg;
+		char         addr[NNG_MAXADDRLEN];
+		size_t       sz;
+
+		So(nng_pair1_open(&s1) == 0);
+		Reset({
+			for (int i = 0; i < ns2; i++) {
+				nng_close(s2[i]);
+			}
+			nng_close(s1);
+		});
+		So(nng_setopt_int(s1, NNG_OPT_PAIR1_POLY, 1) == 0);
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+		So(nng_setopt_int(s1, NNG_OPT_RECVBUF, 64) == 0);
+		So(nng_listener_create(&l, s1, "tcp://127.0.0.1:0") == 0);
+		So(nng_listener_setopt_int(l, NNG_OPT_TCP_LISTENERS, 4) == 0);
+		So(nng_listener_start(l, 0) == 0);
+		sz = NNG_MAXADDRLEN;
+		So(nng_listener_getopt(l, NNG_OPT_URL, addr, &sz) == 0);
+#ifdef NNG_PLATFORM_LINUX
+		So(count_listeners((uint16_t) atoi(strrchr(addr, ':') + 1)) ==
+		    4);
+#endif
+
+		// The kernel hashes each connection to one of the sockets, so
+		// with this many some land on every one of them.  Each must
+		// be accepted (and negotiated) for its message to arrive.
+		for (int i = 0; i < 64; i++) {
+			So(nng_pair1_open(&s2[i]) == 0);
+			ns2++;
+			So(nng_dial(s2[i], addr, NULL, 0) == 0);
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_msg_append_u32(msg, (uint32_t) i) == 0);
+			So(nng_sendmsg(s2[i], msg, 0) == 0);
+		}
+		for (int i = 0; i < 64; i++) {
+			So(nng_recvmsg(s1, &msg, 0) == 0);
+			So(nng_msg_len(msg) == 4);
+			nng_msg_free(msg);
+		}
+	});
+
+	Convey("Batched messages are held until the batch time", {
+		nng_socket   s1;
+		nng_socket   s2;
+		nng_listener l;
+		nng_dialer   d;
+		nng_msg *    msg;
+		char         addr[NNG_MAXADDRLEN];
+		size_t       sz;
+		uint32_t     v;
+
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s2);
+			nng_close(s1);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 200) == 0);
+		So(nng_listen(s1, "tcp://127.0.0.1:0", &l, 0) == 0);
+		sz = NNG_MAXADDRLEN;
+		So(nng_listener_getopt(l, NNG_OPT_URL, addr, &sz) == 0);
+		So(nng_dialer_create(&d, s2, addr) == 0);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SEND_BATCH, 4096) == 0);
+		So(nng_dialer_setopt_ms(d, NNG_OPT_SEND_BATCH_TIME, 1000) ==
+		    0);
+		So(nng_dialer_start(d, 0) == 0);
+		nng_msleep(100);
+
+		// The sends complete at once, but nothing is written until
+		// the batch timer fires, and then all of it arrives together.
+		for (uint32_t i = 0; i < 10; i++) {
+			So(nng_msg_alloc(&msg, 0) == 0);
+			So(nng_msg_append_u32(msg, i) == 0);
+			So(nng_sendmsg(s2, msg, 0) == 0);
+		}
+		So(nng_recvmsg(s1, &msg, 0) == NNG_ETIMEDOUT);
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+		for (uint32_t i = 0; i < 10; i++) {
+			So(nng_recvmsg(s1, &msg, 0) == 0);
+			So(nng_msg_trim_u32(msg, &v) == 0);
+			So(v == i);
+			So(nng_msg_len(msg) == 0);
+			nng_msg_free(msg);
+		}
+	});
+
+	trantest_batch_behind_large("tcp://127.0.0.1:%u");
+
+	Convey("Small messages can be sent in batches", {
+		nng_socket   s1;
+		nng_socket   s2;
+		nng_listener l;
+		nng_dialer   d;
+		nng_msg *    msg;
+		char         addr[NNG_MAXADDRLEN];
+		size_t       sz;
+		nng_duration t;
+		uint32_t     v;
+
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s2);
+			nng_close(s1);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 2000) == 0);
+		So(nng_listen(s1, "tcp://127.0.0.1:0", &l, 0) == 0);
+		sz = NNG_MAXADDRLEN;
+		So(nng_listener_getopt(l, NNG_OPT_URL, addr, &sz) == 0);
+		So(nng_dialer_create(&d, s2, addr) == 0);
+		So(nng_dialer_getopt_size(d, NNG_OPT_SEND_BATCH, &sz) == 0);
+		So(sz == 0);
+		So(nng_dialer_getopt_ms(d, NNG_OPT_SEND_BATCH_TIME, &t) == 0);
+		So(t == 0);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SEND_BATCH, 1 << 30) ==
+		    NNG_EINVAL);
+		So(nng_dialer_setopt_size(d, NNG_OPT_SEND_BATCH, 4096) == 0);
+		So(nng_dialer_getopt_size(d, NNG_OPT_SEND_BATCH, &sz) == 0);
+		So(sz == 4096);
+		So(nng_dialer_setopt_ms(d, NNG_OPT_SEND_BATCH_TIME, 5) == 0);
+		So(nng_dialer_getopt_ms(d, NNG_OPT_SEND_BATCH_TIME, &t) == 0);
+		So(t == 5);
+		So(nng_dialer_start(d, 0) == 0);
+		nng_msleep(100);
+
+		// Every tenth message is too large to batch, and goes
+		// between the batches.
+		for (uint32_t i = 0; i < 200; i++) {
+			So(nng_msg_alloc(&msg, (i % 10) == 5 ? 5000 : 12) ==
+			    0);
+			So(nng_msg_insert_u32(msg, i) == 0);
+			So(nng_sendmsg(s2, msg, 0) == 0);
+		}
+		for (uint32_t i = 0; i < 200; i++) {
+			So(nng_recvmsg(s1, &msg, 0) == 0);
+			So(nng_msg_trim_u32(msg, &v) == 0);
+			So(v == i);
+			So(nng_msg_len(msg) == ((i % 10) == 5 ? 5000 : 12));
+			nng_msg_free(msg);
+		}
+	});
+
 	Convey("Malformed TCP addresses do not panic", {
 		nng_socket s1;
 
@@ -52,6 +52,7 @@ extern void trantest_scheme(trantest *tt);
 extern void trantest_test(trantest *tt);
 extern void trantest_test_extended(const char *addr, trantest_proptest_t f);
 extern void trantest_test_all(const char *addr);
+extern void trantest_batch_behind_large(const char *tmpl);
 
 #ifndef NNG_TRANSPORT_ZEROTIER
 #define nng_zt_register notransport
@@ -62,6 +63,9 @@ extern void trantest_test_all(const char *addr);
 #ifndef NNG_TRANSPORT_IPC
 #define nng_ipc_register notransport
 #endif
+#ifndef NNG_TRANSPORT_SHM
+#define nng_shm_register notransport
+#endif
 #ifndef NNG_TRANSPORT_TCP
 #define nng_tcp_register notransport
 #endif
@@ -95,6 +99,9 @@ trantest_checktran(const char *url)
 #ifndef NNG_TRANSPORT_IPC
 	CHKTRAN(url, "ipc:");
 #endif
+#ifndef NNG_TRANSPORT_SHM
+	CHKTRAN(url, "shm:");
+#endif
 #ifndef NNG_TRANSPORT_TCP
 	CHKTRAN(url, "tcp:");
 #endif
@@ -465,6 +472,128 @@ trantest_send_recv_large(trantest *tt)
 	})
 }
 
+// trantest_ep_setopt sets an option directly on a transport endpoint.
+static int
+trantest_ep_setopt(
+    nni_tran *t, void *ep, const char *name, const void *v, size_t sz)
+{
+	nni_tran_ep_option *o;
+
+	for (o = t->tran_ep->ep_options; o && o->eo_name; o++) {
+		if (strcmp(o->eo_name, name) == 0) {
+			return (o->eo_setopt(ep, v, sz));
+		}
+	}
+	return (NNG_ENOTSUP);
+}
+
+// trantest_batch_behind_large drives the transport pipes directly,
+// because the protocols never give a pipe a second message before the
+// first one is done.  A small message is batched while a large one is
+// being written, with nothing sent after it.  It must still go out.
+void
+trantest_batch_behind_large(const char *tmpl)
+{
+	Convey("A batch queued behind a large write is flushed", {
+		nng_socket   s;
+		nni_sock *   sock;
+		nni_url *    url;
+		nni_tran *   t;
+		void *       lep;
+		void *       dep;
+		void *       lp;
+		void *       dp;
+		nni_aio *    aio1;
+		nni_aio *    aio2;
+		nni_msg *    msg;
+		char         addr[NNG_MAXADDRLEN + 1];
+		size_t       batch = 4096;
+		nng_duration bt    = 1000;
+		size_t       size  = 8 * 1024 * 1024;
+
+		trantest_next_address(addr, tmpl);
+		So(nng_rep_open(&s) == 0);
+		So(nni_sock_find(&sock, s) == 0);
+		So(nni_url_parse(&url, addr) == 0);
+		So((t = nni_tran_find(url)) != NULL);
+		So(nni_aio_init(&aio1, NULL, NULL) == 0);
+		So(nni_aio_init(&aio2, NULL, NULL) == 0);
+		So(t->tran_ep->ep_init(&lep, url, sock, NNI_EP_MODE_LISTEN) ==
+		    0);
+		So(t->tran_ep->ep_init(&dep, url, sock, NNI_EP_MODE_DIAL) ==
+		    0);
+		Reset({
+			t->tran_ep->ep_close(dep);
+			t->tran_ep->ep_close(lep);
+			t->tran_ep->ep_fini(dep);
+			t->tran_ep->ep_fini(lep);
+			nni_aio_fini(aio2);
+			nni_aio_fini(aio1);
+			nni_url_free(url);
+			nni_sock_rele(sock);
+			nng_close(s);
+		});
+		So(trantest_ep_setopt(t, lep, NNG_OPT_RECVMAXSZ, &size,
+		       sizeof(size)) == 0);
+		So(trantest_ep_setopt(t, dep, NNG_OPT_SEND_BATCH, &batch,
+		       sizeof(batch)) == 0);
+		So(trantest_ep_setopt(t, dep, NNG_OPT_SEND_BATCH_TIME, &bt,
+		       sizeof(bt)) == 0);
+
+		So(t->tran_ep->ep_bind(lep) == 0);
+		t->tran_ep->ep_accept(lep, aio1);
+		t->tran_ep->ep_connect(dep, aio2);
+		nni_aio_wait(aio1);
+		nni_aio_wait(aio2);
+		So(nni_aio_result(aio1) == 0);
+		So(nni_aio_result(aio2) == 0);
+		lp = nni_aio_get_output(aio1, 0);
+		dp = nni_aio_get_output(aio2, 0);
+		t->tran_pipe->p_start(lp, aio1);
+		t->tran_pipe->p_start(dp, aio2);
+		nni_aio_wait(aio1);
+		nni_aio_wait(aio2);
+		So(nni_aio_result(aio1) == 0);
+		So(nni_aio_result(aio2) == 0);
+
+		// Nobody reads yet, so the large write cannot finish
+		// before the small message is given to the pipe.
+		So(nni_msg_alloc(&msg, size) == 0);
+		nni_aio_set_msg(aio1, msg);
+		t->tran_pipe->p_send(dp, aio1);
+		So(nni_msg_alloc(&msg, 0) == 0);
+		So(nni_msg_append(msg, "small", 6) == 0);
+		nni_aio_set_msg(aio2, msg);
+		t->tran_pipe->p_send(dp, aio2);
+		nni_aio_wait(aio2);
+		So(nni_aio_result(aio2) == 0);
+
+		nni_aio_set_timeout(aio2, 5000);
+		t->tran_pipe->p_recv(lp, aio2);
+		nni_aio_wait(aio2);
+		So(nni_aio_result(aio2) == 0);
+		msg = nni_aio_get_msg(aio2);
+		So(nni_msg_len(msg) == size);
+		nni_msg_free(msg);
+		nni_aio_wait(aio1);
+		So(nni_aio_result(aio1) == 0);
+
+		nni_aio_set_timeout(aio2, 2000);
+		t->tran_pipe->p_recv(lp, aio2);
+		nni_aio_wait(aio2);
+		So(nni_aio_result(aio2) == 0);
+		msg = nni_aio_get_msg(aio2);
+		So(nni_msg_len(msg) == 6);
+		So(memcmp(nni_msg_body(msg), "small", 6) == 0);
+		nni_msg_free(msg);
+
+		t->tran_pipe->p_close(lp);
+		t->tran_pipe->p_close(dp);
+		t->tran_pipe->p_fini(lp);
+		t->tran_pipe->p_fini(dp);
+	});
+}
+
 void
 trantest_test_all(const char *addr)
 {
@@ -103,6 +103,109 @@ TestMain("UDP support", {
 			nng_aio_free(aio2);
 		});
 
+		Convey("Many datagrams can be in flight", {
+			enum { NDG = 32 };
+			nng_aio *    saio[NDG];
+			nng_aio *    raio[NDG];
+			char         sbuf[NDG][64];
+			char         rbuf[NDG][64];
+			nng_sockaddr from[NDG];
+			nng_sockaddr to = sa2;
+			nng_iov      iov;
+			int          seen = 0;
+
+			// These are all posted before any are sent, so the
+			// platform can move them in batches.
+			for (int i = 0; i < NDG; i++) {
+				So(nng_aio_alloc(&raio[i], NULL, NULL) == 0);
+				iov.iov_buf = rbuf[i];
+				iov.iov_len = sizeof(rbuf[i]);
+				So(nng_aio_set_iov(raio[i], 1, &iov) == 0);
+				nng_aio_set_input(raio[i], 0, &from[i]);
+				nni_plat_udp_recv(u2, raio[i]);
+			}
+			for (int i = 0; i < NDG; i++) {
+				So(nng_aio_alloc(&saio[i], NULL, NULL) == 0);
+				// Equal sizes, with a short one at the end.
+				memset(sbuf[i], 'a' + (i % 26), 64);
+				iov.iov_buf = sbuf[i];
+				iov.iov_len = (i == NDG - 1) ? 10 : 32;
+				So(nng_aio_set_iov(saio[i], 1, &iov) == 0);
+				nng_aio_set_input(saio[i], 0, &to);
+				nni_plat_udp_send(u1, saio[i]);
+			}
+			for (int i = 0; i < NDG; i++) {
+				nng_aio_wait(saio[i]);
+				So(nng_aio_result(saio[i]) == 0);
+				nng_aio_free(saio[i]);
+			}
+			for (int i = 0; i < NDG; i++) {
+				size_t len;
+				nng_aio_wait(raio[i]);
+				So(nng_aio_result(raio[i]) == 0);
+				len = nng_aio_count(raio[i]);
+				So((len == 32) || (len == 10));
+				So(rbuf[i][0] >= 'a');
+				So(rbuf[i][0] <= 'z');
+				So(from[i].s_un.s_in.sa_port ==
+				    sa1.s_un.s_in.sa_port);
+				seen += (int) len;
+				nng_aio_free(raio[i]);
+			}
+			So(seen == ((NDG - 1) * 32) + 10);
+		});
+
+		Convey("Datagrams may have up to 64 iovs", {
+			enum { NDG = 8 };
+			enum { NIOV = 64 };
+			nng_aio *    saio[NDG];
+			nng_aio *    raio[NDG];
+			char         sbuf[NIOV + 1];
+			char         rbuf[NDG][128];
+			nng_sockaddr to = sa2;
+			nng_iov      iov[NIOV + 1];
+
+			for (int i = 0; i < NIOV + 1; i++) {
+				sbuf[i]        = 'a' + (i % 26);
+				iov[i].iov_buf = &sbuf[i];
+				iov[i].iov_len = 1;
+			}
+			// Enough that they do not all fit in one batch.
+			for (int i = 0; i < NDG; i++) {
+				nng_iov riov;
+				So(nng_aio_alloc(&raio[i], NULL, NULL) == 0);
+				riov.iov_buf = rbuf[i];
+				riov.iov_len = sizeof(rbuf[i]);
+				So(nng_aio_set_iov(raio[i], 1, &riov) == 0);
+				nni_plat_udp_recv(u2, raio[i]);
+			}
+			for (int i = 0; i < NDG; i++) {
+				So(nng_aio_alloc(&saio[i], NULL, NULL) == 0);
+				So(nng_aio_set_iov(saio[i], NIOV, iov) == 0);
+				nng_aio_set_input(saio[i], 0, &to);
+				nni_plat_udp_send(u1, saio[i]);
+			}
+			for (int i = 0; i < NDG; i++) {
+				nng_aio_wait(saio[i]);
+				So(nng_aio_result(saio[i]) == 0);
+				So(nng_aio_count(saio[i]) == NIOV);
+				nng_aio_wait(raio[i]);
+				So(nng_aio_result(raio[i]) == 0);
+				So(nng_aio_count(raio[i]) == NIOV);
+				So(memcmp(rbuf[i], sbuf, NIOV) == 0);
+				nng_aio_free(raio[i]);
+			}
+
+			// One more is too many.
+			So(nni_aio_set_iov(saio[0], NIOV + 1, iov) == 0);
+			nni_plat_udp_send(u1, saio[0]);
+			nng_aio_wait(saio[0]);
+			So(nng_aio_result(saio[0]) == NNG_EINVAL);
+			for (int i = 0; i < NDG; i++) {
+				nng_aio_free(saio[i]);
+			}
+		});
+
 		Convey("Sending without an address fails", {
 			nng_aio *aio1;
 			char *   msg = "nope";